@@ -0,0 +1,83 @@
+//
+//  AllocCounter.h
+//  Conta as alocações do processo (malloc, calloc, realloc e operator new)
+//  entre startAllocCount() e stopAllocCount(), em todas as threads, para as
+//  ferramentas verificarem que um caminho não aloca nada. Substitui o
+//  alocador global, então só pode ser incluído em um arquivo do programa.
+//  Só existe com a glibc (repassa para __libc_malloc e companhia); nas
+//  outras plataformas allocCountAvailable() retorna false.
+//
+
+#ifndef AllocCounter_h
+#define AllocCounter_h
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+#if defined(__GLIBC__)
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void __libc_free(void *p);
+}
+
+static std::atomic<bool> allocCounting(false);
+static std::atomic<long> allocCount(0);
+
+static inline void countAlloc() {
+    if (allocCounting.load(std::memory_order_relaxed)) allocCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" void *malloc(size_t size) noexcept {
+    countAlloc();
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) noexcept {
+    countAlloc();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *p, size_t size) noexcept {
+    countAlloc();
+    return __libc_realloc(p, size);
+}
+
+void *operator new(size_t size) {
+    countAlloc();
+    void *p = __libc_malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { __libc_free(p); }
+void operator delete[](void *p) noexcept { __libc_free(p); }
+void operator delete(void *p, size_t) noexcept { __libc_free(p); }
+void operator delete[](void *p, size_t) noexcept { __libc_free(p); }
+
+inline bool allocCountAvailable() { return true; }
+
+inline void startAllocCount() {
+    allocCount.store(0);
+    allocCounting.store(true);
+}
+
+// Quantas alocações houve desde startAllocCount().
+inline long stopAllocCount() {
+    allocCounting.store(false);
+    return allocCount.load();
+}
+
+#else
+
+inline bool allocCountAvailable() { return false; }
+inline void startAllocCount() {}
+inline long stopAllocCount() { return 0; }
+
+#endif
+
+#endif /* AllocCounter_h */
@@ -0,0 +1,359 @@
+//
+//  Batch.h
+//  Filtragem em lote de todos os .ppm de um diretório, sem interação.
+//
+//  Dois modos:
+//  - por arquivo (depth = 0): até jobs arquivos ao mesmo tempo, um por
+//    thread do pool. Os P6, de 8 ou 16 bits, passam pelo modo em faixas
+//    (PPMStream.h), então a memória fica em torno de jobs * 3 faixas; os P3
+//    (texto) são carregados inteiros.
+//  - pipeline (depth > 0): uma thread lê a imagem N+1 enquanto a thread que
+//    chama filtra a N (com todos os núcleos) e outra grava a N-1. As imagens
+//    inteiras circulam por depth buffers entre filas limitadas; cada buffer
+//    só cresce quando chega uma imagem maior que as anteriores, então com
+//    imagens de mesmo tamanho nada de pixel é alocado depois das primeiras.
+//    As estatísticas trazem o tempo ocupado de cada estágio: o de maior
+//    utilização (ocupado / total) é o gargalo.
+//
+
+#ifndef Batch_h
+#define Batch_h
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlockingQueue.h"
+#include "FilterChain.h"
+#include "PPMStream.h"
+
+struct BatchOptions {
+    std::string inputDir;
+    std::string outputDir;
+    int jobs;            // arquivos simultâneos; 0 = número de núcleos
+    int depth;           // > 0: pipeline com depth imagens em circulação (mínimo 3)
+};
+
+struct BatchStats {
+    int files;
+    int failed;
+    size_t bytes;         // bytes de pixel processados
+    double wallSeconds;
+    // tempos somados de todos os arquivos (segundos de thread); no pipeline,
+    // o tempo ocupado de cada estágio
+    double readSeconds;
+    double filterSeconds;
+    double writeSeconds;
+    // só no pipeline
+    int buffers;
+    size_t bufferBytes;   // memória dos buffers ao final
+    int allocations;      // vezes que um buffer precisou crescer
+};
+
+// Fração do tempo total em que o estágio ficou ocupado.
+inline double stageUtilization(const BatchStats &stats, double stageSeconds) {
+    return stats.wallSeconds > 0.0 ? stageSeconds / stats.wallSeconds : 0.0;
+}
+
+// Nome do estágio mais ocupado.
+inline const char *batchBottleneck(const BatchStats &stats) {
+    if (stats.readSeconds >= stats.filterSeconds && stats.readSeconds >= stats.writeSeconds) return "leitura";
+    return stats.filterSeconds >= stats.writeSeconds ? "filtro" : "escrita";
+}
+
+// Lista os .ppm de um diretório, em ordem alfabética.
+inline std::vector<std::string> listPPMFiles(const std::string &dir) {
+    std::vector<std::string> files;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file()) continue;
+        std::string ext = it->path().extension().string();
+        for (size_t i = 0; i < ext.size(); i++) ext[i] = (char)tolower((unsigned char)ext[i]);
+        if (ext == ".ppm") files.push_back(it->path().string());
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// Filtra um arquivo; os tempos de cada estágio são somados em stats.
+inline bool filterFile(const std::string &in, const std::string &out, const FilterChain &chain,
+                       bool threaded, BatchStats &stats) {
+    typedef std::chrono::steady_clock Clock;
+    PPMHeader head;
+    if (!readPPMHeader(in, head)) {
+        std::cerr << "Cabeçalho PPM inválido em " << in << std::endl;
+        return false;
+    }
+    std::error_code ec;
+    uintmax_t fileSize = std::filesystem::file_size(in, ec);
+    if (ec || !head.fitsIn((size_t)fileSize)) {
+        std::cerr << "Arquivo truncado: " << in << std::endl;
+        return false;
+    }
+    if (head.type == '6') {
+        bool wide = head.sampleBytes() == 2;
+        if (wide && !chain.supports16()) {
+            std::cerr << "Os filtros escolhidos não aceitam 16 bits: " << in << std::endl;
+            return false;
+        }
+        StreamStats s;
+        StripFilter filter = [&](unsigned char *strip, int w, int, int rows, int) {
+            if (wide) {
+                uint16_t *samples = (uint16_t *)strip;
+                if (threaded) chain.apply16(samples, w, rows, head.maxValue);
+                else chain.apply16(samples, (size_t)w * rows, head.maxValue);
+            } else if (threaded) {
+                chain.apply(strip, w, rows);
+            } else {
+                chain.apply(strip, (size_t)w * rows);
+            }
+        };
+        if (!streamFilterPPM(in, out, filter, 0, 3, &s)) return false;
+        stats.readSeconds += s.readSeconds;
+        stats.filterSeconds += s.filterSeconds;
+        stats.writeSeconds += s.writeSeconds;
+        stats.bytes += (size_t)s.width * s.height * s.channels * head.sampleBytes();
+        return true;
+    }
+
+    Clock::time_point t0 = Clock::now();
+    PPMImage image;
+    if (!image.open(in)) return false;
+    if (image.channels() != 3) {
+        std::cerr << "Os filtros exigem uma imagem colorida: " << in << std::endl;
+        return false;
+    }
+    Clock::time_point t1 = Clock::now();
+    size_t pixels = (size_t)image.width() * image.height();
+    if (image.sampleBytes() == 2) {
+        bool ok = threaded ? chain.apply16(image.data16(), image.width(), image.height(), image.maxValue())
+                           : chain.apply16(image.data16(), pixels, image.maxValue());
+        if (!ok) return false;
+    } else if (threaded) {
+        chain.apply(image.data(), image.width(), image.height());
+    } else {
+        chain.apply(image.data(), pixels);
+    }
+    Clock::time_point t2 = Clock::now();
+    if (!savePPM(out, image.view(), image.sampleBytes() == 2 ? image.maxValue() : 0)) return false;
+    Clock::time_point t3 = Clock::now();
+    stats.readSeconds += std::chrono::duration<double>(t1 - t0).count();
+    stats.filterSeconds += std::chrono::duration<double>(t2 - t1).count();
+    stats.writeSeconds += std::chrono::duration<double>(t3 - t2).count();
+    stats.bytes += image.size() * image.sampleBytes();
+    return true;
+}
+
+// Uma imagem em circulação no pipeline.
+struct BatchSlot {
+    std::vector<unsigned char> data;
+    size_t file;
+    int width, height, channels, maxValue;
+    bool ok;
+
+    size_t bytes() const {
+        return (size_t)width * height * channels * (maxValue > 255 ? 2 : 1);
+    }
+};
+
+// Lê um PPM inteiro para slot.data, já na ordem da máquina. Os binários vão
+// direto do arquivo para o buffer; os de texto passam por text, reaproveitado
+// entre as chamadas.
+inline bool readIntoSlot(const std::string &path, PPMImage &text, BatchSlot &slot, int &allocations) {
+    FILE *in = fopen(path.c_str(), "rb");
+    if (!in) {
+        std::cerr << "Não foi possível abrir " << path << std::endl;
+        return false;
+    }
+    unsigned char prefix[4096];
+    size_t n = fread(prefix, 1, sizeof(prefix), in);
+    PPMHeader head;
+    if (!parsePPMHeader(prefix, n, head)) {
+        std::cerr << "Cabeçalho PPM inválido em " << path << std::endl;
+        fclose(in);
+        return false;
+    }
+    if (head.channels != 3) {
+        std::cerr << "Os filtros exigem uma imagem colorida: " << path << std::endl;
+        fclose(in);
+        return false;
+    }
+    // O cabeçalho não pode prometer mais amostras do que o arquivo contém: um
+    // arquivo curto que declara 100000 x 100000 falha aqui, antes de alocar.
+    std::error_code ec;
+    uintmax_t fileSize = std::filesystem::file_size(path, ec);
+    if (ec || !head.fitsIn((size_t)fileSize)) {
+        std::cerr << "Arquivo truncado: " << path << std::endl;
+        fclose(in);
+        return false;
+    }
+    slot.width = head.width;
+    slot.height = head.height;
+    slot.channels = head.channels;
+    slot.maxValue = head.maxValue;
+    size_t bytes = slot.bytes();
+    if (slot.data.capacity() < bytes) allocations++;
+    slot.data.resize(bytes);
+
+    bool ok = true;
+    if (head.isBinary()) {
+        ok = fseek(in, (long)head.dataOffset, SEEK_SET) == 0 && fread(slot.data.data(), 1, bytes, in) == bytes;
+        if (!ok) std::cerr << "Arquivo truncado: " << path << std::endl;
+        if (ok && head.sampleBytes() == 2) {
+            uint16_t *samples = (uint16_t *)slot.data.data();
+            ppm_detail::swapBytes16(samples, samples, head.sampleCount(), (uint16_t)head.maxValue);
+        }
+    }
+    fclose(in);
+    if (!head.isBinary()) {
+        ok = text.open(path);
+        if (ok) memcpy(slot.data.data(), text.data(), bytes);
+    }
+    return ok;
+}
+
+inline bool runPipeline(const BatchOptions &options, const std::vector<std::string> &files,
+                        const FilterChain &chain, BatchStats &stats) {
+    typedef std::chrono::steady_clock Clock;
+    int buffers = options.depth < 3 ? 3 : options.depth;
+    std::vector<BatchSlot> slots(buffers);
+    BlockingQueue<int> freeSlots(buffers);
+    BlockingQueue<int> toFilter(buffers);
+    BlockingQueue<int> toWrite(buffers);
+    for (int i = 0; i < buffers; i++) freeSlots.push(i);
+
+    std::atomic<int> failed(0);
+    double readSeconds = 0.0, writeSeconds = 0.0, filterSeconds = 0.0;
+    int allocations = 0;
+    size_t bytes = 0;
+
+    std::thread readThread([&] {
+        PPMImage text;
+        int slot;
+        for (size_t i = 0; i < files.size() && freeSlots.pop(slot); i++) {
+            Clock::time_point t0 = Clock::now();
+            BatchSlot &s = slots[slot];
+            s.file = i;
+            s.ok = readIntoSlot(files[i], text, s, allocations);
+            readSeconds += std::chrono::duration<double>(Clock::now() - t0).count();
+            toFilter.push(slot);
+        }
+        toFilter.close();
+    });
+
+    std::thread writeThread([&] {
+        PPMWriter writer;
+        int slot;
+        while (toWrite.pop(slot)) {
+            BatchSlot &s = slots[slot];
+            if (s.ok) {
+                Clock::time_point t0 = Clock::now();
+                std::filesystem::path in(files[s.file]);
+                std::string out = (std::filesystem::path(options.outputDir) / in.filename()).string();
+                bool wide = s.maxValue > 255;
+                s.ok = writer.open(out, s.width, s.height, s.channels, wide ? s.maxValue : 255);
+                if (s.ok) {
+                    s.ok = wide ? writer.write16((const uint16_t *)s.data.data(), s.bytes() / 2)
+                                : writer.write(s.data.data(), s.bytes());
+                    s.ok = writer.close() && s.ok;
+                }
+                writeSeconds += std::chrono::duration<double>(Clock::now() - t0).count();
+            }
+            if (!s.ok) {
+                failed++;
+                std::cerr << "Falha: " << files[s.file] << std::endl;
+            } else {
+                bytes += s.bytes();
+            }
+            freeSlots.push(slot);
+        }
+    });
+
+    int slot;
+    while (toFilter.pop(slot)) {
+        BatchSlot &s = slots[slot];
+        if (s.ok) {
+            Clock::time_point t0 = Clock::now();
+            if (s.maxValue > 255) {
+                s.ok = chain.apply16((uint16_t *)s.data.data(), s.width, s.height, s.maxValue);
+            } else {
+                chain.apply(s.data.data(), s.width, s.height);
+            }
+            filterSeconds += std::chrono::duration<double>(Clock::now() - t0).count();
+        }
+        toWrite.push(slot);
+    }
+    toWrite.close();
+    readThread.join();
+    writeThread.join();
+
+    stats.files = (int)files.size();
+    stats.failed = failed;
+    stats.bytes = bytes;
+    stats.readSeconds = readSeconds;
+    stats.filterSeconds = filterSeconds;
+    stats.writeSeconds = writeSeconds;
+    stats.buffers = buffers;
+    stats.allocations = allocations;
+    for (int i = 0; i < buffers; i++) stats.bufferBytes += slots[i].data.capacity();
+    return failed == 0;
+}
+
+inline bool runBatch(const BatchOptions &options, const FilterChain &chain, BatchStats &stats) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    memset(&stats, 0, sizeof(stats));
+
+    std::vector<std::string> files = listPPMFiles(options.inputDir);
+    std::error_code ec;
+    std::filesystem::create_directories(options.outputDir, ec);
+    if (ec) {
+        std::cerr << "Não foi possível criar " << options.outputDir << std::endl;
+        return false;
+    }
+
+    if (options.depth > 0) {
+        bool ok = runPipeline(options, files, chain, stats);
+        stats.wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return ok;
+    }
+
+    unsigned jobs = options.jobs > 0 ? (unsigned)options.jobs : ThreadPool::shared().size();
+    if (jobs > files.size() && !files.empty()) jobs = (unsigned)files.size();
+    // com um arquivo por vez, o próprio filtro usa todos os núcleos
+    bool threaded = jobs <= 1;
+
+    std::mutex mutex;
+    ThreadPool workers(jobs);
+    workers.parallelFor(files.size(), [&](size_t i) {
+        std::filesystem::path in(files[i]);
+        std::string out = (std::filesystem::path(options.outputDir) / in.filename()).string();
+        BatchStats local;
+        memset(&local, 0, sizeof(local));
+        bool ok = filterFile(files[i], out, chain, threaded, local);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.files++;
+        if (!ok) {
+            stats.failed++;
+            std::cerr << "Falha: " << files[i] << std::endl;
+        }
+        stats.bytes += local.bytes;
+        stats.readSeconds += local.readSeconds;
+        stats.filterSeconds += local.filterSeconds;
+        stats.writeSeconds += local.writeSeconds;
+    });
+
+    stats.wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return stats.failed == 0;
+}
+
+#endif /* Batch_h */
@@ -0,0 +1,61 @@
+//
+//  BlockingQueue.h
+//  Fila limitada entre threads de um pipeline. push bloqueia quando a fila
+//  está cheia e pop bloqueia quando está vazia; close() libera todos e faz
+//  pop retornar false depois que a fila esvaziar.
+//
+
+#ifndef BlockingQueue_h
+#define BlockingQueue_h
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+template <class T>
+class BlockingQueue {
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+public:
+    explicit BlockingQueue(size_t capacity) : capacity(capacity ? capacity : 1), closed(false) {}
+
+    // Retorna false se a fila já foi fechada.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Retorna false quando a fila foi fechada e não há mais itens.
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+};
+
+#endif /* BlockingQueue_h */
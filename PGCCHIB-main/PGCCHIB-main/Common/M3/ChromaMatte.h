@@ -0,0 +1,309 @@
+//
+//  ChromaMatte.h
+//  Chroma-key com matte suave: em vez de pintar de preto os pixels perto da
+//  cor-chave (chromaKey de Filters.h), gera RGBA com alfa de 8 bits.
+//
+//  A distância é medida só na crominância (Cb, Cr do YCbCr BT.601), então
+//  sombras e reflexos do fundo, que mudam a luminância mas não a cor, também
+//  são recortados. Abaixo de inner o alfa é 0, acima de outer é 255 e entre
+//  os dois cresce linearmente com a distância. A supressão de spill tira da
+//  crominância de cada pixel a componente na direção da cor-chave (só a
+//  positiva), sem mudar a luminância: o verde refletido no cabelo vira cinza.
+//
+//  Uma passada lê RGB e grava RGBA (alfa não pré-multiplicado). As contas
+//  são em float, com mul e add separados na mesma ordem em todas as
+//  versões, e sqrt correto: SSE2 e AVX2 dão os mesmos bytes que a escalar.
+//  Só para entrada RGB de 8 bits por canal.
+//
+
+#ifndef ChromaMatte_h
+#define ChromaMatte_h
+
+#include <iostream>
+#include <math.h>
+#include <stddef.h>
+
+#include "ColorSpace.h"
+#include "FilterExecutor.h"
+
+struct ChromaMatteParams {
+    float keyCb, keyCr;     // crominância da cor-chave (-128..128)
+    float inner;            // distância abaixo da qual o alfa é 0
+    float invRange;         // 1 / (outer - inner)
+    float spill;            // 0 (nada) a 1 (toda a componente da chave)
+    // variação de R, G, B por unidade de crominância removida na direção
+    // da chave (inversa do BT.601 aplicada ao vetor unitário)
+    float spillR, spillG, spillB;
+    float dirCb, dirCr;     // direção unitária da chave (0 para chave cinza)
+};
+
+// Tolerâncias em fração de 255 (a faixa de cada eixo de crominância);
+// inner = outer dá um recorte duro.
+inline ChromaMatteParams makeChromaMatte(int r, int g, int b, double inner, double outer, double spill = 1.0) {
+    ChromaMatteParams p;
+    p.keyCb = (float)r * CB_FROM_R + (float)g * CB_FROM_G + (float)b * CB_FROM_B;
+    p.keyCr = (float)r * CR_FROM_R + (float)g * CR_FROM_G + (float)b * CR_FROM_B;
+    if (inner < 0.0) inner = 0.0;
+    if (outer < inner) outer = inner;
+    p.inner = (float)(inner * 255.0);
+    double range = (outer - inner) * 255.0;
+    p.invRange = range > 1e-6 ? (float)(1.0 / range) : 1e30f;
+    p.spill = (float)(spill < 0.0 ? 0.0 : spill > 1.0 ? 1.0 : spill);
+    double len = sqrt((double)p.keyCb * p.keyCb + (double)p.keyCr * p.keyCr);
+    p.dirCb = len > 1.0 ? (float)(p.keyCb / len) : 0.0f;
+    p.dirCr = len > 1.0 ? (float)(p.keyCr / len) : 0.0f;
+    p.spillR = CR_TO_R * p.dirCr;
+    p.spillG = -CB_TO_G * p.dirCb - CR_TO_G * p.dirCr;
+    p.spillB = CB_TO_B * p.dirCb;
+    return p;
+}
+
+typedef void (*ChromaMatteKernel)(const unsigned char *rgb, unsigned char *rgba, size_t pixels,
+                                  const ChromaMatteParams &p);
+
+/*---------------------------------ESCALAR----------------------------------*/
+namespace matte_scalar {
+
+inline unsigned char toByte(float v) {
+    v = v > 0.0f ? v : 0.0f;
+    v = v < 255.0f ? v : 255.0f;
+    return (unsigned char)(int)(v + 0.5f);
+}
+
+inline void chromaMatte(const unsigned char *rgb, unsigned char *rgba, size_t pixels, const ChromaMatteParams &p) {
+    for (size_t i = 0; i < pixels; i++, rgb += 3, rgba += 4) {
+        float r = rgb[0], g = rgb[1], b = rgb[2];
+        float cb = r * CB_FROM_R + g * CB_FROM_G + b * CB_FROM_B;
+        float cr = r * CR_FROM_R + g * CR_FROM_G + b * CR_FROM_B;
+        float dcb = cb - p.keyCb, dcr = cr - p.keyCr;
+        float a = (sqrtf(dcb * dcb + dcr * dcr) - p.inner) * p.invRange;
+        a = a > 0.0f ? a : 0.0f;
+        a = a < 1.0f ? a : 1.0f;
+        float s = cb * p.dirCb + cr * p.dirCr;
+        s = (s > 0.0f ? s : 0.0f) * p.spill;
+        rgba[0] = toByte(r - s * p.spillR);
+        rgba[1] = toByte(g - s * p.spillG);
+        rgba[2] = toByte(b - s * p.spillB);
+        rgba[3] = (unsigned char)(int)(a * 255.0f + 0.5f);
+    }
+}
+
+} // namespace matte_scalar
+
+#ifdef M3_X86
+/*-----------------------------------SSE2-----------------------------------*/
+namespace matte_sse2 {
+
+struct Constants {
+    __m128 cbR, cbG, cbB, crR, crG, crB;
+    __m128 keyCb, keyCr, inner, invRange, spill, spillR, spillG, spillB, dirCb, dirCr;
+};
+
+M3_TARGET_SSE2 inline void loadConstants(const ChromaMatteParams &p, Constants &c) {
+    c.cbR = _mm_set1_ps(CB_FROM_R); c.cbG = _mm_set1_ps(CB_FROM_G); c.cbB = _mm_set1_ps(CB_FROM_B);
+    c.crR = _mm_set1_ps(CR_FROM_R); c.crG = _mm_set1_ps(CR_FROM_G); c.crB = _mm_set1_ps(CR_FROM_B);
+    c.keyCb = _mm_set1_ps(p.keyCb); c.keyCr = _mm_set1_ps(p.keyCr);
+    c.inner = _mm_set1_ps(p.inner); c.invRange = _mm_set1_ps(p.invRange);
+    c.spill = _mm_set1_ps(p.spill);
+    c.spillR = _mm_set1_ps(p.spillR); c.spillG = _mm_set1_ps(p.spillG); c.spillB = _mm_set1_ps(p.spillB);
+    c.dirCb = _mm_set1_ps(p.dirCb); c.dirCr = _mm_set1_ps(p.dirCr);
+}
+
+// 4 pixels em float: mesmas operações, na mesma ordem, da versão escalar.
+// Retorna r, g, b, a já em inteiros de 32 bits (0..255).
+M3_TARGET_SSE2 inline void matte4(__m128 r, __m128 g, __m128 b, const Constants &c, __m128i out[4]) {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 top = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+    __m128 cb = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, c.cbR), _mm_mul_ps(g, c.cbG)), _mm_mul_ps(b, c.cbB));
+    __m128 cr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, c.crR), _mm_mul_ps(g, c.crG)), _mm_mul_ps(b, c.crB));
+    __m128 dcb = _mm_sub_ps(cb, c.keyCb), dcr = _mm_sub_ps(cr, c.keyCr);
+    __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dcb, dcb), _mm_mul_ps(dcr, dcr)));
+    __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(d, c.inner), c.invRange), zero), one);
+    __m128 s = _mm_add_ps(_mm_mul_ps(cb, c.dirCb), _mm_mul_ps(cr, c.dirCr));
+    s = _mm_mul_ps(_mm_max_ps(s, zero), c.spill);
+    r = _mm_sub_ps(r, _mm_mul_ps(s, c.spillR));
+    g = _mm_sub_ps(g, _mm_mul_ps(s, c.spillG));
+    b = _mm_sub_ps(b, _mm_mul_ps(s, c.spillB));
+    out[0] = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(r, zero), top), half));
+    out[1] = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(g, zero), top), half));
+    out[2] = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(b, zero), top), half));
+    out[3] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, top), half));
+}
+
+// Grava 16 pixels RGBA a partir de um registrador por canal.
+M3_TARGET_SSE2 inline void storeRGBA16(unsigned char *p, __m128i r, __m128i g, __m128i b, __m128i a) {
+    __m128i rgLo = _mm_unpacklo_epi8(r, g), rgHi = _mm_unpackhi_epi8(r, g);
+    __m128i baLo = _mm_unpacklo_epi8(b, a), baHi = _mm_unpackhi_epi8(b, a);
+    _mm_storeu_si128((__m128i *)p, _mm_unpacklo_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i *)(p + 16), _mm_unpackhi_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i *)(p + 32), _mm_unpacklo_epi16(rgHi, baHi));
+    _mm_storeu_si128((__m128i *)(p + 48), _mm_unpackhi_epi16(rgHi, baHi));
+}
+
+// 16 pixels com um byte por canal em r, g, b.
+M3_TARGET_SSE2 inline void matte16(__m128i r8, __m128i g8, __m128i b8, const Constants &c, unsigned char *rgba) {
+    const __m128i z = _mm_setzero_si128();
+    __m128i words[3][2] = {
+        { _mm_unpacklo_epi8(r8, z), _mm_unpackhi_epi8(r8, z) },
+        { _mm_unpacklo_epi8(g8, z), _mm_unpackhi_epi8(g8, z) },
+        { _mm_unpacklo_epi8(b8, z), _mm_unpackhi_epi8(b8, z) },
+    };
+    __m128i q[4][4];   // [grupo de 4 pixels][canal]
+    for (int j = 0; j < 4; j++) {
+        __m128 f[3];
+        for (int ch = 0; ch < 3; ch++) {
+            __m128i w = words[ch][j / 2];
+            f[ch] = _mm_cvtepi32_ps(j % 2 ? _mm_unpackhi_epi16(w, z) : _mm_unpacklo_epi16(w, z));
+        }
+        matte4(f[0], f[1], f[2], c, q[j]);
+    }
+    __m128i ch[4];
+    for (int k = 0; k < 4; k++) {
+        ch[k] = _mm_packus_epi16(_mm_packs_epi32(q[0][k], q[1][k]), _mm_packs_epi32(q[2][k], q[3][k]));
+    }
+    storeRGBA16(rgba, ch[0], ch[1], ch[2], ch[3]);
+}
+
+M3_TARGET_SSE2 inline void chromaMatte(const unsigned char *rgb, unsigned char *rgba, size_t pixels,
+                                       const ChromaMatteParams &p) {
+    Constants c;
+    loadConstants(p, c);
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32, rgb += 96, rgba += 128) {
+        __m128i v[6];
+        filters_sse2::load32(rgb, v);
+        filters_sse2::deinterleave(v);
+        matte16(v[0], v[2], v[4], c, rgba);
+        matte16(v[1], v[3], v[5], c, rgba + 64);
+    }
+    matte_scalar::chromaMatte(rgb, rgba, pixels - i, p);
+}
+
+} // namespace matte_sse2
+
+/*-----------------------------------AVX2-----------------------------------*/
+namespace matte_avx2 {
+
+struct Constants {
+    __m256 cbR, cbG, cbB, crR, crG, crB;
+    __m256 keyCb, keyCr, inner, invRange, spill, spillR, spillG, spillB, dirCb, dirCr;
+};
+
+M3_TARGET_AVX2 inline void loadConstants(const ChromaMatteParams &p, Constants &c) {
+    c.cbR = _mm256_set1_ps(CB_FROM_R); c.cbG = _mm256_set1_ps(CB_FROM_G); c.cbB = _mm256_set1_ps(CB_FROM_B);
+    c.crR = _mm256_set1_ps(CR_FROM_R); c.crG = _mm256_set1_ps(CR_FROM_G); c.crB = _mm256_set1_ps(CR_FROM_B);
+    c.keyCb = _mm256_set1_ps(p.keyCb); c.keyCr = _mm256_set1_ps(p.keyCr);
+    c.inner = _mm256_set1_ps(p.inner); c.invRange = _mm256_set1_ps(p.invRange);
+    c.spill = _mm256_set1_ps(p.spill);
+    c.spillR = _mm256_set1_ps(p.spillR); c.spillG = _mm256_set1_ps(p.spillG); c.spillB = _mm256_set1_ps(p.spillB);
+    c.dirCb = _mm256_set1_ps(p.dirCb); c.dirCr = _mm256_set1_ps(p.dirCr);
+}
+
+// 8 pixels; a mesma sequência de matte_sse2::matte4.
+M3_TARGET_AVX2 inline void matte8(__m256 r, __m256 g, __m256 b, const Constants &c, __m256i out[4]) {
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    const __m256 top = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+    __m256 cb = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, c.cbR), _mm256_mul_ps(g, c.cbG)),
+                              _mm256_mul_ps(b, c.cbB));
+    __m256 cr = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, c.crR), _mm256_mul_ps(g, c.crG)),
+                              _mm256_mul_ps(b, c.crB));
+    __m256 dcb = _mm256_sub_ps(cb, c.keyCb), dcr = _mm256_sub_ps(cr, c.keyCr);
+    __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dcb, dcb), _mm256_mul_ps(dcr, dcr)));
+    __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(d, c.inner), c.invRange), zero), one);
+    __m256 s = _mm256_add_ps(_mm256_mul_ps(cb, c.dirCb), _mm256_mul_ps(cr, c.dirCr));
+    s = _mm256_mul_ps(_mm256_max_ps(s, zero), c.spill);
+    r = _mm256_sub_ps(r, _mm256_mul_ps(s, c.spillR));
+    g = _mm256_sub_ps(g, _mm256_mul_ps(s, c.spillG));
+    b = _mm256_sub_ps(b, _mm256_mul_ps(s, c.spillB));
+    out[0] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_min_ps(_mm256_max_ps(r, zero), top), half));
+    out[1] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_min_ps(_mm256_max_ps(g, zero), top), half));
+    out[2] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_min_ps(_mm256_max_ps(b, zero), top), half));
+    out[3] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(a, top), half));
+}
+
+// Dois grupos de 8 inteiros (0..255) para 16 bytes em ordem.
+M3_TARGET_AVX2 inline __m128i toBytes(__m256i lo, __m256i hi) {
+    __m256i w = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+    return _mm_packus_epi16(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+}
+
+// 16 pixels com um byte por canal.
+M3_TARGET_AVX2 inline void matte16(__m128i r8, __m128i g8, __m128i b8, const Constants &c, unsigned char *rgba) {
+    __m256i q[2][4];
+    for (int j = 0; j < 2; j++) {
+        __m128i r = j ? _mm_srli_si128(r8, 8) : r8;
+        __m128i g = j ? _mm_srli_si128(g8, 8) : g8;
+        __m128i b = j ? _mm_srli_si128(b8, 8) : b8;
+        matte8(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(r)), _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(g)),
+               _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(b)), c, q[j]);
+    }
+    matte_sse2::storeRGBA16(rgba, toBytes(q[0][0], q[1][0]), toBytes(q[0][1], q[1][1]),
+                            toBytes(q[0][2], q[1][2]), toBytes(q[0][3], q[1][3]));
+}
+
+M3_TARGET_AVX2 inline void chromaMatte(const unsigned char *rgb, unsigned char *rgba, size_t pixels,
+                                       const ChromaMatteParams &p) {
+    filters_avx2::Shuffles s;
+    filters_avx2::loadShuffles(s);
+    Constants c;
+    loadConstants(p, c);
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32, rgb += 96, rgba += 128) {
+        __m256i v[3];
+        filters_avx2::load32(rgb, v);
+        __m256i r = filters_avx2::channel(v, s, 0);
+        __m256i g = filters_avx2::channel(v, s, 1);
+        __m256i b = filters_avx2::channel(v, s, 2);
+        matte16(_mm256_castsi256_si128(r), _mm256_castsi256_si128(g), _mm256_castsi256_si128(b), c, rgba);
+        matte16(_mm256_extracti128_si256(r, 1), _mm256_extracti128_si256(g, 1), _mm256_extracti128_si256(b, 1),
+                c, rgba + 64);
+    }
+    matte_scalar::chromaMatte(rgb, rgba, pixels - i, p);
+}
+
+} // namespace matte_avx2
+#endif
+
+struct MatteKernels {
+    SimdLevel level;
+    ChromaMatteKernel chromaMatte;
+};
+
+inline const MatteKernels &matteKernels(SimdLevel level) {
+    static const MatteKernels table[] = {
+        { SIMD_SCALAR, matte_scalar::chromaMatte },
+#ifdef M3_X86
+        { SIMD_SSE2, matte_sse2::chromaMatte },
+        { SIMD_AVX2, matte_avx2::chromaMatte },
+#endif
+    };
+    if (level > cpuSimdLevel()) level = cpuSimdLevel();
+    return table[level];
+}
+
+inline const MatteKernels &matteKernels() {
+    static const MatteKernels &kernels = matteKernels(simdLevel());
+    return kernels;
+}
+
+// src RGB e dst RGBA intercalados de 8 bits, do mesmo tamanho; as faixas
+// do executor rodam em paralelo e cada pixel é lido e gravado uma vez.
+inline bool chromaMatte(const ImageView &src, const ImageView &dst, const ChromaMatteParams &p,
+                        const FilterExecutor &ex = FilterExecutor(), const MatteKernels &k = matteKernels()) {
+    if (src.isPlanar() || dst.isPlanar() || src.channels != 3 || dst.channels != 4 || src.sampleBytes != 1 ||
+        dst.sampleBytes != 1 || src.width != dst.width || src.height != dst.height) {
+        std::cerr << "chromaMatte: a entrada deve ser RGB e a saída RGBA, de 8 bits e mesmo tamanho" << std::endl;
+        return false;
+    }
+    ex.forEachBand(src, [&](const ImageView &band, int y0) {
+        ImageView out = dst.rows(y0, band.height);
+        if (band.contiguous() && out.contiguous()) {
+            k.chromaMatte(band.data, out.data, (size_t)band.width * band.height, p);
+            return;
+        }
+        for (int y = 0; y < band.height; y++) k.chromaMatte(band.row(y), out.row(y), (size_t)band.width, p);
+    });
+    return true;
+}
+
+#endif /* ChromaMatte_h */
@@ -0,0 +1,1021 @@
+//
+//  ColorConvert.h
+//  Conversões de cor em linha, nos dois sentidos, com versões escalar, SSE2
+//  e AVX2 (constantes e referências em ColorSpace.h):
+//   - YCbCr <-> RGB e luma BT.601, inteiras em Q14 (as mesmas contas em
+//     todos os níveis), usadas pelo decodificador JPEG do stb_image;
+//   - HSV, HSL e CIE Lab (D65, sRGB) entre RGB de 8 bits intercalado e três
+//     planos float (H em graus, S/V/L em [0, 1], Lab com L em [0, 100]).
+//
+//  As versões float fazem mul, add, div, sqrt, min e max na mesma ordem em
+//  todos os níveis (sem FMA), então SSE2 e AVX2 dão os mesmos bytes que a
+//  escalar. A raiz cúbica do Lab é uma estimativa pelos bits seguida de três
+//  passos de Newton; a linearização do sRGB é uma tabela de 256 floats e a
+//  codificação de volta uma tabela de 4097 bytes indexada por sqrt(linear).
+//
+//  Erro máximo contra color_reference sem arredondar (bench_colorspace,
+//  todos os 2^24 valores), igual nos três níveis:
+//   - YCbCr -> RGB 0.505, RGB -> YCbCr e luma 0.506 (no máximo 1 do
+//     valor arredondado);
+//   - HSV: H 3.2e-5 graus, S 3e-8, V 8e-8; HSL: H 3.2e-5, S 1.6e-5, L 8e-8;
+//   - Lab: L 1.9e-5, a 9.9e-5, b 4.1e-5;
+//   - inversas a partir da referência e idas e voltas: exatas.
+//
+//  As linhas intercaladas são separadas/reunidas em blocos de TILE pixels
+//  na pilha (layoutKernels de Image.h) e convertidas plano a plano.
+//
+
+#ifndef ColorConvert_h
+#define ColorConvert_h
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ColorSpace.h"
+#include "Image.h"
+
+// y, cb, cr planos -> RGB (step 3) ou RGBA com alfa 255 (step 4).
+typedef void (*YCbCrToRgbKernel)(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+                                 unsigned char *out, size_t n, int step);
+typedef void (*RgbToYCbCrKernel)(const unsigned char *rgb, unsigned char *y, unsigned char *cb, unsigned char *cr,
+                                 size_t n);
+// Luma BT.601 de pixels com 3 ou 4 canais (o quarto é ignorado).
+typedef void (*LumaKernel)(const unsigned char *src, unsigned char *y, size_t n, int channels);
+typedef void (*RgbToPlanesKernel)(const unsigned char *rgb, float *c0, float *c1, float *c2, size_t n);
+typedef void (*PlanesToRgbKernel)(const float *c0, const float *c1, const float *c2, unsigned char *rgb, size_t n);
+
+namespace color_detail {
+
+const float INV255 = 1.0f / 255.0f;
+const float INV510 = 1.0f / 510.0f;
+const float INV60 = 1.0f / 60.0f;
+const float INV30 = 1.0f / 30.0f;
+const float INV6 = 1.0f / 6.0f;
+const float INV12 = 1.0f / 12.0f;
+const float THIRD = 1.0f / 3.0f;
+
+// RGB linear -> XYZ com X e Z já divididos pelo branco D65, e a inversa com
+// as colunas de X e Z multiplicadas por ele.
+const float TO_X[3] = { (float)(0.4124564 / 0.95047), (float)(0.3575761 / 0.95047), (float)(0.1804375 / 0.95047) };
+const float TO_Y[3] = { 0.2126729f, 0.7151522f, 0.0721750f };
+const float TO_Z[3] = { (float)(0.0193339 / 1.08883), (float)(0.1191920 / 1.08883), (float)(0.9503041 / 1.08883) };
+const float TO_R[3] = { (float)(3.2404542 * 0.95047), -1.5371385f, (float)(-0.4985314 * 1.08883) };
+const float TO_G[3] = { (float)(-0.9692660 * 0.95047), 1.8760108f, (float)(0.0415560 * 1.08883) };
+const float TO_B[3] = { (float)(0.0556434 * 0.95047), -0.2040259f, (float)(1.0572252 * 1.08883) };
+
+const float LAB_EPSILON = (float)(216.0 / 24389.0);     // (6/29)^3
+const float LAB_SLOPE = (float)(24389.0 / 3132.0);      // 1 / (3 (6/29)^2)
+const float LAB_DELTA = (float)(6.0 / 29.0);
+const float LAB_SLOPE_INV = (float)(3132.0 / 24389.0);  // 3 (6/29)^2
+const float LAB_OFFSET = (float)(4.0 / 29.0);
+const int CBRT_BIAS = 709958130;                        // estimativa de cbrtf do fdlibm
+
+const int ENCODE_SIZE = 4096;
+
+// sRGB de 8 bits -> linear.
+inline const float *linearTable() {
+    static const struct Table {
+        float v[256];
+        Table() {
+            for (int i = 0; i < 256; i++) v[i] = (float)color_reference::srgbToLinear(i);
+        }
+    } table;
+    return table.v;
+}
+
+// Linear -> sRGB de 8 bits, indexado por sqrt(linear) * ENCODE_SIZE: a raiz
+// espalha a parte escura, onde a curva é mais íngreme.
+inline const unsigned char *encodeTable() {
+    static const struct Table {
+        unsigned char v[ENCODE_SIZE + 1];
+        Table() {
+            for (int i = 0; i <= ENCODE_SIZE; i++) {
+                double s = (double)i / ENCODE_SIZE;
+                v[i] = (unsigned char)(int)(color_reference::linearToSrgb(s * s) + 0.5);
+            }
+        }
+    } table;
+    return table.v;
+}
+
+inline void linearize(const unsigned char *src, float *dst, size_t n) {
+    const float *t = linearTable();
+    for (size_t i = 0; i < n; i++) dst[i] = t[src[i]];
+}
+
+inline void encode(const float *src, unsigned char *dst, size_t n) {
+    const unsigned char *t = encodeTable();
+    for (size_t i = 0; i < n; i++) {
+        float v = src[i];
+        v = v > 0.0f ? v : 0.0f;
+        v = v < 1.0f ? v : 1.0f;
+        dst[i] = t[(int)(sqrtf(v) * (float)ENCODE_SIZE + 0.5f)];
+    }
+}
+
+} // namespace color_detail
+
+/*---------------------------------ESCALAR----------------------------------*/
+namespace color_scalar {
+
+using namespace color_detail;
+
+inline void ycbcrToRgb(const unsigned char *y, const unsigned char *cb, const unsigned char *cr, unsigned char *r,
+                       unsigned char *g, unsigned char *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        unsigned char rgb[3];
+        ycc::toRgb(y[i], cb[i], cr[i], rgb);
+        r[i] = rgb[0];
+        g[i] = rgb[1];
+        b[i] = rgb[2];
+    }
+}
+
+inline void rgbToYcbcr(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *y,
+                       unsigned char *cb, unsigned char *cr, size_t n) {
+    for (size_t i = 0; i < n; i++) ycc::fromRgb(r[i], g[i], b[i], y[i], cb[i], cr[i]);
+}
+
+inline void luma(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *y, size_t n) {
+    for (size_t i = 0; i < n; i++) y[i] = ycc::luma(r[i], g[i], b[i]);
+}
+
+inline void toFloats(const unsigned char *src, float *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = (float)src[i];
+}
+
+inline void toBytes(const float *src, unsigned char *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        float v = src[i];
+        v = v > 0.0f ? v : 0.0f;
+        v = v < 255.0f ? v : 255.0f;
+        dst[i] = (unsigned char)(int)(v + 0.5f);
+    }
+}
+
+inline float maxf(float a, float b) { return a > b ? a : b; }
+inline float minf(float a, float b) { return a < b ? a : b; }
+
+// Matiz em graus de r, g, b em 0..255; mx e d são o máximo e max - min.
+inline float hue(float r, float g, float b, float mx, float d) {
+    float sd = d == 0.0f ? 1.0f : d;
+    float hr = (g - b) / sd * 60.0f;
+    float hg = ((b - r) / sd + 2.0f) * 60.0f;
+    float hb = ((r - g) / sd + 4.0f) * 60.0f;
+    float h = mx == r ? hr : (mx == g ? hg : hb);
+    h = h < 0.0f ? h + 360.0f : h;
+    return d == 0.0f ? 0.0f : h;
+}
+
+inline void hsvFromRgb(const float *r, const float *g, const float *b, float *h, float *s, float *v, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        float mx = maxf(r[i], maxf(g[i], b[i])), mn = minf(r[i], minf(g[i], b[i]));
+        float d = mx - mn;
+        h[i] = hue(r[i], g[i], b[i], mx, d);
+        s[i] = mx > 0.0f ? d / (mx > 0.0f ? mx : 1.0f) : 0.0f;
+        v[i] = mx * INV255;
+    }
+}
+
+// k - m * floor(k / m), com a divisão feita como produto por 1/m.
+inline float wrap(float k, float m, float invM) {
+    return k - m * floorf(k * invM);
+}
+
+inline void rgbFromHsv(const float *h, const float *s, const float *v, float *r, float *g, float *b, size_t n) {
+    float *out[3] = { r, g, b };
+    const float offset[3] = { 5.0f, 3.0f, 1.0f };
+    for (size_t i = 0; i < n; i++) {
+        float vs = v[i] * s[i];
+        for (int c = 0; c < 3; c++) {
+            float k = wrap(offset[c] + h[i] * INV60, 6.0f, INV6);
+            float t = maxf(minf(minf(k, 4.0f - k), 1.0f), 0.0f);
+            out[c][i] = (v[i] - vs * t) * 255.0f;
+        }
+    }
+}
+
+inline void hslFromRgb(const float *r, const float *g, const float *b, float *h, float *s, float *l, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        float mx = maxf(r[i], maxf(g[i], b[i])), mn = minf(r[i], minf(g[i], b[i]));
+        float d = mx - mn;
+        h[i] = hue(r[i], g[i], b[i], mx, d);
+        float li = (mx + mn) * INV510;
+        float den = 1.0f - fabsf(li + li - 1.0f);
+        s[i] = d == 0.0f ? 0.0f : d * INV255 / (d == 0.0f ? 1.0f : den);
+        l[i] = li;
+    }
+}
+
+inline void rgbFromHsl(const float *h, const float *s, const float *l, float *r, float *g, float *b, size_t n) {
+    float *out[3] = { r, g, b };
+    const float offset[3] = { 0.0f, 8.0f, 4.0f };
+    for (size_t i = 0; i < n; i++) {
+        float a = s[i] * minf(l[i], 1.0f - l[i]);
+        for (int c = 0; c < 3; c++) {
+            float k = wrap(offset[c] + h[i] * INV30, 12.0f, INV12);
+            float t = maxf(minf(minf(k - 3.0f, 9.0f - k), 1.0f), -1.0f);
+            out[c][i] = (l[i] - a * t) * 255.0f;
+        }
+    }
+}
+
+inline float cbrtPositive(float t) {
+    int bits;
+    memcpy(&bits, &t, sizeof(bits));
+    bits = (int)((float)bits * THIRD) + CBRT_BIAS;
+    float y;
+    memcpy(&y, &bits, sizeof(y));
+    for (int k = 0; k < 3; k++) y = (y + y + t / (y * y)) * THIRD;
+    return y;
+}
+
+inline float labF(float t) {
+    return t > LAB_EPSILON ? cbrtPositive(t) : t * LAB_SLOPE + LAB_OFFSET;
+}
+
+inline float labFInverse(float t) {
+    return t > LAB_DELTA ? t * t * t : (t - LAB_OFFSET) * LAB_SLOPE_INV;
+}
+
+// r, g, b lineares em [0, 1].
+inline void labFromLinear(const float *r, const float *g, const float *b, float *L, float *A, float *B, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        float fx = labF(r[i] * TO_X[0] + g[i] * TO_X[1] + b[i] * TO_X[2]);
+        float fy = labF(r[i] * TO_Y[0] + g[i] * TO_Y[1] + b[i] * TO_Y[2]);
+        float fz = labF(r[i] * TO_Z[0] + g[i] * TO_Z[1] + b[i] * TO_Z[2]);
+        L[i] = fy * 116.0f - 16.0f;
+        A[i] = (fx - fy) * 500.0f;
+        B[i] = (fy - fz) * 200.0f;
+    }
+}
+
+inline void linearFromLab(const float *L, const float *A, const float *B, float *r, float *g, float *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        float fy = (L[i] + 16.0f) * (1.0f / 116.0f);
+        float x = labFInverse(fy + A[i] * (1.0f / 500.0f));
+        float y = labFInverse(fy);
+        float z = labFInverse(fy - B[i] * (1.0f / 200.0f));
+        r[i] = x * TO_R[0] + y * TO_R[1] + z * TO_R[2];
+        g[i] = x * TO_G[0] + y * TO_G[1] + z * TO_G[2];
+        b[i] = x * TO_B[0] + y * TO_B[1] + z * TO_B[2];
+    }
+}
+
+} // namespace color_scalar
+
+#ifdef M3_X86
+/*-----------------------------------SSE2-----------------------------------*/
+namespace color_sse2 {
+
+using namespace color_detail;
+
+// (a0 * k0 + b0 * k1, ...) >> SHIFT para 4 pares de 16 bits, com o
+// arredondamento vindo de um par (x, 1) * (k, ROUND).
+M3_TARGET_SSE2 inline __m128i dot2(__m128i ab, __m128i k) {
+    return _mm_madd_epi16(ab, k);
+}
+
+M3_TARGET_SSE2 inline __m128i pair(short a, short b) {
+    return _mm_set1_epi32((int)((unsigned short)a | ((unsigned)(unsigned short)b << 16)));
+}
+
+M3_TARGET_SSE2 inline void ycbcrToRgb(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+                                      unsigned char *r, unsigned char *g, unsigned char *b, size_t n) {
+    const __m128i z = _mm_setzero_si128(), c128 = _mm_set1_epi16(128);
+    const __m128i kr = pair(1 << ycc::SHIFT, ycc::R_CR), kgY = pair(1 << ycc::SHIFT, ycc::G_CR);
+    const __m128i kgC = pair(ycc::G_CB, ycc::ROUND), kb = pair(1 << ycc::SHIFT, ycc::B_CB);
+    const __m128i round = _mm_set1_epi32(ycc::ROUND), one = _mm_set1_epi16(1);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i yv = _mm_loadu_si128((const __m128i *)(y + i));
+        __m128i cbv = _mm_loadu_si128((const __m128i *)(cb + i));
+        __m128i crv = _mm_loadu_si128((const __m128i *)(cr + i));
+        __m128i out[3][2];
+        for (int h = 0; h < 2; h++) {
+            __m128i yw = h ? _mm_unpackhi_epi8(yv, z) : _mm_unpacklo_epi8(yv, z);
+            __m128i cbw = _mm_sub_epi16(h ? _mm_unpackhi_epi8(cbv, z) : _mm_unpacklo_epi8(cbv, z), c128);
+            __m128i crw = _mm_sub_epi16(h ? _mm_unpackhi_epi8(crv, z) : _mm_unpacklo_epi8(crv, z), c128);
+            __m128i q[3][2];
+            for (int k = 0; k < 2; k++) {
+                __m128i ycr = k ? _mm_unpackhi_epi16(yw, crw) : _mm_unpacklo_epi16(yw, crw);
+                __m128i ycb = k ? _mm_unpackhi_epi16(yw, cbw) : _mm_unpacklo_epi16(yw, cbw);
+                __m128i cb1 = k ? _mm_unpackhi_epi16(cbw, one) : _mm_unpacklo_epi16(cbw, one);
+                q[0][k] = _mm_srai_epi32(_mm_add_epi32(dot2(ycr, kr), round), ycc::SHIFT);
+                q[1][k] = _mm_srai_epi32(_mm_add_epi32(dot2(ycr, kgY), dot2(cb1, kgC)), ycc::SHIFT);
+                q[2][k] = _mm_srai_epi32(_mm_add_epi32(dot2(ycb, kb), round), ycc::SHIFT);
+            }
+            for (int c = 0; c < 3; c++) out[c][h] = _mm_packs_epi32(q[c][0], q[c][1]);
+        }
+        _mm_storeu_si128((__m128i *)(r + i), _mm_packus_epi16(out[0][0], out[0][1]));
+        _mm_storeu_si128((__m128i *)(g + i), _mm_packus_epi16(out[1][0], out[1][1]));
+        _mm_storeu_si128((__m128i *)(b + i), _mm_packus_epi16(out[2][0], out[2][1]));
+    }
+    color_scalar::ycbcrToRgb(y + i, cb + i, cr + i, r + i, g + i, b + i, n - i);
+}
+
+// (r * k[0] + g * k[1] + b * k[2] + ROUND) >> SHIFT para 8 pixels de 16 bits.
+M3_TARGET_SSE2 inline __m128i combine8(__m128i r, __m128i g, __m128i b, __m128i krg, __m128i kb) {
+    const __m128i one = _mm_set1_epi16(1);
+    __m128i lo = _mm_add_epi32(dot2(_mm_unpacklo_epi16(r, g), krg), dot2(_mm_unpacklo_epi16(b, one), kb));
+    __m128i hi = _mm_add_epi32(dot2(_mm_unpackhi_epi16(r, g), krg), dot2(_mm_unpackhi_epi16(b, one), kb));
+    return _mm_packs_epi32(_mm_srai_epi32(lo, ycc::SHIFT), _mm_srai_epi32(hi, ycc::SHIFT));
+}
+
+M3_TARGET_SSE2 inline void rgbToYcbcr(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                                      unsigned char *y, unsigned char *cb, unsigned char *cr, size_t n) {
+    const __m128i z = _mm_setzero_si128(), c128 = _mm_set1_epi16(128);
+    const __m128i kyRG = pair(ycc::Y_R, ycc::Y_G), kyB = pair(ycc::Y_B, ycc::ROUND);
+    const __m128i kcbRG = pair(ycc::CB_R, ycc::CB_G), kcbB = pair(ycc::CB_B, ycc::ROUND);
+    const __m128i kcrRG = pair(ycc::CR_R, ycc::CR_G), kcrB = pair(ycc::CR_B, ycc::ROUND);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i rv = _mm_loadu_si128((const __m128i *)(r + i));
+        __m128i gv = _mm_loadu_si128((const __m128i *)(g + i));
+        __m128i bv = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i rl = _mm_unpacklo_epi8(rv, z), rh = _mm_unpackhi_epi8(rv, z);
+        __m128i gl = _mm_unpacklo_epi8(gv, z), gh = _mm_unpackhi_epi8(gv, z);
+        __m128i bl = _mm_unpacklo_epi8(bv, z), bh = _mm_unpackhi_epi8(bv, z);
+        _mm_storeu_si128((__m128i *)(y + i), _mm_packus_epi16(combine8(rl, gl, bl, kyRG, kyB),
+                                                              combine8(rh, gh, bh, kyRG, kyB)));
+        __m128i cbl = _mm_add_epi16(combine8(rl, gl, bl, kcbRG, kcbB), c128);
+        __m128i cbh = _mm_add_epi16(combine8(rh, gh, bh, kcbRG, kcbB), c128);
+        _mm_storeu_si128((__m128i *)(cb + i), _mm_packus_epi16(cbl, cbh));
+        __m128i crl = _mm_add_epi16(combine8(rl, gl, bl, kcrRG, kcrB), c128);
+        __m128i crh = _mm_add_epi16(combine8(rh, gh, bh, kcrRG, kcrB), c128);
+        _mm_storeu_si128((__m128i *)(cr + i), _mm_packus_epi16(crl, crh));
+    }
+    color_scalar::rgbToYcbcr(r + i, g + i, b + i, y + i, cb + i, cr + i, n - i);
+}
+
+M3_TARGET_SSE2 inline void luma(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                                unsigned char *y, size_t n) {
+    const __m128i z = _mm_setzero_si128();
+    const __m128i krg = pair(ycc::Y_R, ycc::Y_G), kb = pair(ycc::Y_B, ycc::ROUND);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i rv = _mm_loadu_si128((const __m128i *)(r + i));
+        __m128i gv = _mm_loadu_si128((const __m128i *)(g + i));
+        __m128i bv = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i lo = combine8(_mm_unpacklo_epi8(rv, z), _mm_unpacklo_epi8(gv, z), _mm_unpacklo_epi8(bv, z), krg, kb);
+        __m128i hi = combine8(_mm_unpackhi_epi8(rv, z), _mm_unpackhi_epi8(gv, z), _mm_unpackhi_epi8(bv, z), krg, kb);
+        _mm_storeu_si128((__m128i *)(y + i), _mm_packus_epi16(lo, hi));
+    }
+    color_scalar::luma(r + i, g + i, b + i, y + i, n - i);
+}
+
+M3_TARGET_SSE2 inline void toFloats(const unsigned char *src, float *dst, size_t n) {
+    const __m128i z = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(v, z), hi = _mm_unpackhi_epi8(v, z);
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, z)));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, z)));
+        _mm_storeu_ps(dst + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, z)));
+        _mm_storeu_ps(dst + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, z)));
+    }
+    color_scalar::toFloats(src + i, dst + i, n - i);
+}
+
+M3_TARGET_SSE2 inline __m128i roundClamp(__m128 v) {
+    const __m128 top = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), top), half));
+}
+
+M3_TARGET_SSE2 inline void toBytes(const float *src, unsigned char *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_packs_epi32(roundClamp(_mm_loadu_ps(src + i)), roundClamp(_mm_loadu_ps(src + i + 4)));
+        __m128i b = _mm_packs_epi32(roundClamp(_mm_loadu_ps(src + i + 8)), roundClamp(_mm_loadu_ps(src + i + 12)));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b));
+    }
+    color_scalar::toBytes(src + i, dst + i, n - i);
+}
+
+// mask ? a : b
+M3_TARGET_SSE2 inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// floorf sem SSE4.1: trunca e corrige os negativos não inteiros.
+M3_TARGET_SSE2 inline __m128 floor4(__m128 x) {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+}
+
+M3_TARGET_SSE2 inline __m128 wrap4(__m128 k, float m, float invM) {
+    return _mm_sub_ps(k, _mm_mul_ps(_mm_set1_ps(m), floor4(_mm_mul_ps(k, _mm_set1_ps(invM)))));
+}
+
+M3_TARGET_SSE2 inline __m128 hue4(__m128 r, __m128 g, __m128 b, __m128 mx, __m128 d) {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), k60 = _mm_set1_ps(60.0f);
+    __m128 dZero = _mm_cmpeq_ps(d, zero);
+    __m128 sd = select(dZero, one, d);
+    __m128 hr = _mm_mul_ps(_mm_div_ps(_mm_sub_ps(g, b), sd), k60);
+    __m128 hg = _mm_mul_ps(_mm_add_ps(_mm_div_ps(_mm_sub_ps(b, r), sd), _mm_set1_ps(2.0f)), k60);
+    __m128 hb = _mm_mul_ps(_mm_add_ps(_mm_div_ps(_mm_sub_ps(r, g), sd), _mm_set1_ps(4.0f)), k60);
+    __m128 h = select(_mm_cmpeq_ps(mx, r), hr, select(_mm_cmpeq_ps(mx, g), hg, hb));
+    h = select(_mm_cmplt_ps(h, zero), _mm_add_ps(h, _mm_set1_ps(360.0f)), h);
+    return _mm_andnot_ps(dZero, h);
+}
+
+M3_TARGET_SSE2 inline void hsvFromRgb(const float *r, const float *g, const float *b, float *h, float *s, float *v,
+                                      size_t n) {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), inv255 = _mm_set1_ps(INV255);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 rv = _mm_loadu_ps(r + i), gv = _mm_loadu_ps(g + i), bv = _mm_loadu_ps(b + i);
+        __m128 mx = _mm_max_ps(rv, _mm_max_ps(gv, bv)), mn = _mm_min_ps(rv, _mm_min_ps(gv, bv));
+        __m128 d = _mm_sub_ps(mx, mn);
+        __m128 pos = _mm_cmpgt_ps(mx, zero);
+        _mm_storeu_ps(h + i, hue4(rv, gv, bv, mx, d));
+        _mm_storeu_ps(s + i, _mm_and_ps(pos, _mm_div_ps(d, select(pos, mx, one))));
+        _mm_storeu_ps(v + i, _mm_mul_ps(mx, inv255));
+    }
+    color_scalar::hsvFromRgb(r + i, g + i, b + i, h + i, s + i, v + i, n - i);
+}
+
+M3_TARGET_SSE2 inline void rgbFromHsv(const float *h, const float *s, const float *v, float *r, float *g, float *b,
+                                      size_t n) {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), four = _mm_set1_ps(4.0f);
+    const __m128 inv60 = _mm_set1_ps(INV60), k255 = _mm_set1_ps(255.0f);
+    float *out[3] = { r, g, b };
+    const float offset[3] = { 5.0f, 3.0f, 1.0f };
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 hv = _mm_loadu_ps(h + i), vv = _mm_loadu_ps(v + i);
+        __m128 vs = _mm_mul_ps(vv, _mm_loadu_ps(s + i));
+        __m128 h60 = _mm_mul_ps(hv, inv60);
+        for (int c = 0; c < 3; c++) {
+            __m128 k = wrap4(_mm_add_ps(_mm_set1_ps(offset[c]), h60), 6.0f, INV6);
+            __m128 t = _mm_max_ps(_mm_min_ps(_mm_min_ps(k, _mm_sub_ps(four, k)), one), zero);
+            _mm_storeu_ps(out[c] + i, _mm_mul_ps(_mm_sub_ps(vv, _mm_mul_ps(vs, t)), k255));
+        }
+    }
+    color_scalar::rgbFromHsv(h + i, s + i, v + i, r + i, g + i, b + i, n - i);
+}
+
+M3_TARGET_SSE2 inline void hslFromRgb(const float *r, const float *g, const float *b, float *h, float *s, float *l,
+                                      size_t n) {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 inv255 = _mm_set1_ps(INV255), inv510 = _mm_set1_ps(INV510);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 rv = _mm_loadu_ps(r + i), gv = _mm_loadu_ps(g + i), bv = _mm_loadu_ps(b + i);
+        __m128 mx = _mm_max_ps(rv, _mm_max_ps(gv, bv)), mn = _mm_min_ps(rv, _mm_min_ps(gv, bv));
+        __m128 d = _mm_sub_ps(mx, mn);
+        __m128 dZero = _mm_cmpeq_ps(d, zero);
+        __m128 li = _mm_mul_ps(_mm_add_ps(mx, mn), inv510);
+        __m128 den = _mm_sub_ps(one, _mm_andnot_ps(sign, _mm_sub_ps(_mm_add_ps(li, li), one)));
+        _mm_storeu_ps(h + i, hue4(rv, gv, bv, mx, d));
+        _mm_storeu_ps(s + i, _mm_andnot_ps(dZero, _mm_div_ps(_mm_mul_ps(d, inv255), select(dZero, one, den))));
+        _mm_storeu_ps(l + i, li);
+    }
+    color_scalar::hslFromRgb(r + i, g + i, b + i, h + i, s + i, l + i, n - i);
+}
+
+M3_TARGET_SSE2 inline void rgbFromHsl(const float *h, const float *s, const float *l, float *r, float *g, float *b,
+                                      size_t n) {
+    const __m128 one = _mm_set1_ps(1.0f), minusOne = _mm_set1_ps(-1.0f);
+    const __m128 three = _mm_set1_ps(3.0f), nine = _mm_set1_ps(9.0f);
+    const __m128 inv30 = _mm_set1_ps(INV30), k255 = _mm_set1_ps(255.0f);
+    float *out[3] = { r, g, b };
+    const float offset[3] = { 0.0f, 8.0f, 4.0f };
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 hv = _mm_loadu_ps(h + i), lv = _mm_loadu_ps(l + i);
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(s + i), _mm_min_ps(lv, _mm_sub_ps(one, lv)));
+        __m128 h30 = _mm_mul_ps(hv, inv30);
+        for (int c = 0; c < 3; c++) {
+            __m128 k = wrap4(_mm_add_ps(_mm_set1_ps(offset[c]), h30), 12.0f, INV12);
+            __m128 t = _mm_max_ps(_mm_min_ps(_mm_min_ps(_mm_sub_ps(k, three), _mm_sub_ps(nine, k)), one), minusOne);
+            _mm_storeu_ps(out[c] + i, _mm_mul_ps(_mm_sub_ps(lv, _mm_mul_ps(a, t)), k255));
+        }
+    }
+    color_scalar::rgbFromHsl(h + i, s + i, l + i, r + i, g + i, b + i, n - i);
+}
+
+M3_TARGET_SSE2 inline __m128 labF4(__m128 t) {
+    const __m128 third = _mm_set1_ps(THIRD);
+    __m128i bits = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(t)), third));
+    __m128 y = _mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(CBRT_BIAS)));
+    for (int k = 0; k < 3; k++) y = _mm_mul_ps(_mm_add_ps(_mm_add_ps(y, y), _mm_div_ps(t, _mm_mul_ps(y, y))), third);
+    __m128 linear = _mm_add_ps(_mm_mul_ps(t, _mm_set1_ps(LAB_SLOPE)), _mm_set1_ps(LAB_OFFSET));
+    return select(_mm_cmpgt_ps(t, _mm_set1_ps(LAB_EPSILON)), y, linear);
+}
+
+M3_TARGET_SSE2 inline __m128 labFInverse4(__m128 t) {
+    __m128 cube = _mm_mul_ps(_mm_mul_ps(t, t), t);
+    __m128 linear = _mm_mul_ps(_mm_sub_ps(t, _mm_set1_ps(LAB_OFFSET)), _mm_set1_ps(LAB_SLOPE_INV));
+    return select(_mm_cmpgt_ps(t, _mm_set1_ps(LAB_DELTA)), cube, linear);
+}
+
+M3_TARGET_SSE2 inline __m128 dot3(__m128 a, __m128 b, __m128 c, const float *k) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_set1_ps(k[0])), _mm_mul_ps(b, _mm_set1_ps(k[1]))),
+                      _mm_mul_ps(c, _mm_set1_ps(k[2])));
+}
+
+M3_TARGET_SSE2 inline void labFromLinear(const float *r, const float *g, const float *b, float *L, float *A,
+                                         float *B, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 rv = _mm_loadu_ps(r + i), gv = _mm_loadu_ps(g + i), bv = _mm_loadu_ps(b + i);
+        __m128 fx = labF4(dot3(rv, gv, bv, TO_X));
+        __m128 fy = labF4(dot3(rv, gv, bv, TO_Y));
+        __m128 fz = labF4(dot3(rv, gv, bv, TO_Z));
+        _mm_storeu_ps(L + i, _mm_sub_ps(_mm_mul_ps(fy, _mm_set1_ps(116.0f)), _mm_set1_ps(16.0f)));
+        _mm_storeu_ps(A + i, _mm_mul_ps(_mm_sub_ps(fx, fy), _mm_set1_ps(500.0f)));
+        _mm_storeu_ps(B + i, _mm_mul_ps(_mm_sub_ps(fy, fz), _mm_set1_ps(200.0f)));
+    }
+    color_scalar::labFromLinear(r + i, g + i, b + i, L + i, A + i, B + i, n - i);
+}
+
+M3_TARGET_SSE2 inline void linearFromLab(const float *L, const float *A, const float *B, float *r, float *g,
+                                         float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 fy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(L + i), _mm_set1_ps(16.0f)), _mm_set1_ps(1.0f / 116.0f));
+        __m128 x = labFInverse4(_mm_add_ps(fy, _mm_mul_ps(_mm_loadu_ps(A + i), _mm_set1_ps(1.0f / 500.0f))));
+        __m128 y = labFInverse4(fy);
+        __m128 z = labFInverse4(_mm_sub_ps(fy, _mm_mul_ps(_mm_loadu_ps(B + i), _mm_set1_ps(1.0f / 200.0f))));
+        _mm_storeu_ps(r + i, dot3(x, y, z, TO_R));
+        _mm_storeu_ps(g + i, dot3(x, y, z, TO_G));
+        _mm_storeu_ps(b + i, dot3(x, y, z, TO_B));
+    }
+    color_scalar::linearFromLab(L + i, A + i, B + i, r + i, g + i, b + i, n - i);
+}
+
+} // namespace color_sse2
+
+/*-----------------------------------AVX2-----------------------------------*/
+namespace color_avx2 {
+
+using namespace color_detail;
+
+M3_TARGET_AVX2 inline __m256i pair(short a, short b) {
+    return _mm256_set1_epi32((int)((unsigned short)a | ((unsigned)(unsigned short)b << 16)));
+}
+
+// unpack/pack trabalham por metade de 128 bits; como a volta desfaz a ida
+// na mesma metade, os bytes saem na ordem de entrada sem permutações.
+M3_TARGET_AVX2 inline void ycbcrToRgb(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+                                      unsigned char *r, unsigned char *g, unsigned char *b, size_t n) {
+    const __m256i z = _mm256_setzero_si256(), c128 = _mm256_set1_epi16(128);
+    const __m256i kr = pair(1 << ycc::SHIFT, ycc::R_CR), kgY = pair(1 << ycc::SHIFT, ycc::G_CR);
+    const __m256i kgC = pair(ycc::G_CB, ycc::ROUND), kb = pair(1 << ycc::SHIFT, ycc::B_CB);
+    const __m256i round = _mm256_set1_epi32(ycc::ROUND), one = _mm256_set1_epi16(1);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i yv = _mm256_loadu_si256((const __m256i *)(y + i));
+        __m256i cbv = _mm256_loadu_si256((const __m256i *)(cb + i));
+        __m256i crv = _mm256_loadu_si256((const __m256i *)(cr + i));
+        __m256i out[3][2];
+        for (int h = 0; h < 2; h++) {
+            __m256i yw = h ? _mm256_unpackhi_epi8(yv, z) : _mm256_unpacklo_epi8(yv, z);
+            __m256i cbw = _mm256_sub_epi16(h ? _mm256_unpackhi_epi8(cbv, z) : _mm256_unpacklo_epi8(cbv, z), c128);
+            __m256i crw = _mm256_sub_epi16(h ? _mm256_unpackhi_epi8(crv, z) : _mm256_unpacklo_epi8(crv, z), c128);
+            __m256i q[3][2];
+            for (int k = 0; k < 2; k++) {
+                __m256i ycr = k ? _mm256_unpackhi_epi16(yw, crw) : _mm256_unpacklo_epi16(yw, crw);
+                __m256i ycb = k ? _mm256_unpackhi_epi16(yw, cbw) : _mm256_unpacklo_epi16(yw, cbw);
+                __m256i cb1 = k ? _mm256_unpackhi_epi16(cbw, one) : _mm256_unpacklo_epi16(cbw, one);
+                q[0][k] = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(ycr, kr), round), ycc::SHIFT);
+                q[1][k] = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(ycr, kgY), _mm256_madd_epi16(cb1, kgC)),
+                                            ycc::SHIFT);
+                q[2][k] = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(ycb, kb), round), ycc::SHIFT);
+            }
+            for (int c = 0; c < 3; c++) out[c][h] = _mm256_packs_epi32(q[c][0], q[c][1]);
+        }
+        _mm256_storeu_si256((__m256i *)(r + i), _mm256_packus_epi16(out[0][0], out[0][1]));
+        _mm256_storeu_si256((__m256i *)(g + i), _mm256_packus_epi16(out[1][0], out[1][1]));
+        _mm256_storeu_si256((__m256i *)(b + i), _mm256_packus_epi16(out[2][0], out[2][1]));
+    }
+    color_sse2::ycbcrToRgb(y + i, cb + i, cr + i, r + i, g + i, b + i, n - i);
+}
+
+M3_TARGET_AVX2 inline __m256i combine16(__m256i r, __m256i g, __m256i b, __m256i krg, __m256i kb) {
+    const __m256i one = _mm256_set1_epi16(1);
+    __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(r, g), krg),
+                                  _mm256_madd_epi16(_mm256_unpacklo_epi16(b, one), kb));
+    __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(r, g), krg),
+                                  _mm256_madd_epi16(_mm256_unpackhi_epi16(b, one), kb));
+    return _mm256_packs_epi32(_mm256_srai_epi32(lo, ycc::SHIFT), _mm256_srai_epi32(hi, ycc::SHIFT));
+}
+
+M3_TARGET_AVX2 inline void rgbToYcbcr(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                                      unsigned char *y, unsigned char *cb, unsigned char *cr, size_t n) {
+    const __m256i z = _mm256_setzero_si256(), c128 = _mm256_set1_epi16(128);
+    const __m256i kyRG = pair(ycc::Y_R, ycc::Y_G), kyB = pair(ycc::Y_B, ycc::ROUND);
+    const __m256i kcbRG = pair(ycc::CB_R, ycc::CB_G), kcbB = pair(ycc::CB_B, ycc::ROUND);
+    const __m256i kcrRG = pair(ycc::CR_R, ycc::CR_G), kcrB = pair(ycc::CR_B, ycc::ROUND);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i rv = _mm256_loadu_si256((const __m256i *)(r + i));
+        __m256i gv = _mm256_loadu_si256((const __m256i *)(g + i));
+        __m256i bv = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i rl = _mm256_unpacklo_epi8(rv, z), rh = _mm256_unpackhi_epi8(rv, z);
+        __m256i gl = _mm256_unpacklo_epi8(gv, z), gh = _mm256_unpackhi_epi8(gv, z);
+        __m256i bl = _mm256_unpacklo_epi8(bv, z), bh = _mm256_unpackhi_epi8(bv, z);
+        _mm256_storeu_si256((__m256i *)(y + i), _mm256_packus_epi16(combine16(rl, gl, bl, kyRG, kyB),
+                                                                    combine16(rh, gh, bh, kyRG, kyB)));
+        __m256i cbl = _mm256_add_epi16(combine16(rl, gl, bl, kcbRG, kcbB), c128);
+        __m256i cbh = _mm256_add_epi16(combine16(rh, gh, bh, kcbRG, kcbB), c128);
+        _mm256_storeu_si256((__m256i *)(cb + i), _mm256_packus_epi16(cbl, cbh));
+        __m256i crl = _mm256_add_epi16(combine16(rl, gl, bl, kcrRG, kcrB), c128);
+        __m256i crh = _mm256_add_epi16(combine16(rh, gh, bh, kcrRG, kcrB), c128);
+        _mm256_storeu_si256((__m256i *)(cr + i), _mm256_packus_epi16(crl, crh));
+    }
+    color_sse2::rgbToYcbcr(r + i, g + i, b + i, y + i, cb + i, cr + i, n - i);
+}
+
+M3_TARGET_AVX2 inline void luma(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                                unsigned char *y, size_t n) {
+    const __m256i z = _mm256_setzero_si256();
+    const __m256i krg = pair(ycc::Y_R, ycc::Y_G), kb = pair(ycc::Y_B, ycc::ROUND);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i rv = _mm256_loadu_si256((const __m256i *)(r + i));
+        __m256i gv = _mm256_loadu_si256((const __m256i *)(g + i));
+        __m256i bv = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i lo = combine16(_mm256_unpacklo_epi8(rv, z), _mm256_unpacklo_epi8(gv, z),
+                               _mm256_unpacklo_epi8(bv, z), krg, kb);
+        __m256i hi = combine16(_mm256_unpackhi_epi8(rv, z), _mm256_unpackhi_epi8(gv, z),
+                               _mm256_unpackhi_epi8(bv, z), krg, kb);
+        _mm256_storeu_si256((__m256i *)(y + i), _mm256_packus_epi16(lo, hi));
+    }
+    color_sse2::luma(r + i, g + i, b + i, y + i, n - i);
+}
+
+M3_TARGET_AVX2 inline void toFloats(const unsigned char *src, float *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)));
+        _mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8))));
+    }
+    color_scalar::toFloats(src + i, dst + i, n - i);
+}
+
+M3_TARGET_AVX2 inline __m256i roundClamp(__m256 v) {
+    const __m256 top = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+    return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), top), half));
+}
+
+M3_TARGET_AVX2 inline void toBytes(const float *src, unsigned char *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i w = _mm256_permute4x64_epi64(_mm256_packs_epi32(roundClamp(_mm256_loadu_ps(src + i)),
+                                                                roundClamp(_mm256_loadu_ps(src + i + 8))), 0xd8);
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_packus_epi16(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1)));
+    }
+    color_scalar::toBytes(src + i, dst + i, n - i);
+}
+
+M3_TARGET_AVX2 inline __m256 select(__m256 mask, __m256 a, __m256 b) {
+    return _mm256_blendv_ps(b, a, mask);
+}
+
+M3_TARGET_AVX2 inline __m256 wrap8(__m256 k, float m, float invM) {
+    return _mm256_sub_ps(k, _mm256_mul_ps(_mm256_set1_ps(m), _mm256_floor_ps(_mm256_mul_ps(k, _mm256_set1_ps(invM)))));
+}
+
+M3_TARGET_AVX2 inline __m256 hue8(__m256 r, __m256 g, __m256 b, __m256 mx, __m256 d) {
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), k60 = _mm256_set1_ps(60.0f);
+    __m256 dZero = _mm256_cmp_ps(d, zero, _CMP_EQ_OQ);
+    __m256 sd = select(dZero, one, d);
+    __m256 hr = _mm256_mul_ps(_mm256_div_ps(_mm256_sub_ps(g, b), sd), k60);
+    __m256 hg = _mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(_mm256_sub_ps(b, r), sd), _mm256_set1_ps(2.0f)), k60);
+    __m256 hb = _mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(_mm256_sub_ps(r, g), sd), _mm256_set1_ps(4.0f)), k60);
+    __m256 h = select(_mm256_cmp_ps(mx, r, _CMP_EQ_OQ), hr, select(_mm256_cmp_ps(mx, g, _CMP_EQ_OQ), hg, hb));
+    h = select(_mm256_cmp_ps(h, zero, _CMP_LT_OQ), _mm256_add_ps(h, _mm256_set1_ps(360.0f)), h);
+    return _mm256_andnot_ps(dZero, h);
+}
+
+M3_TARGET_AVX2 inline void hsvFromRgb(const float *r, const float *g, const float *b, float *h, float *s, float *v,
+                                      size_t n) {
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), inv255 = _mm256_set1_ps(INV255);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 rv = _mm256_loadu_ps(r + i), gv = _mm256_loadu_ps(g + i), bv = _mm256_loadu_ps(b + i);
+        __m256 mx = _mm256_max_ps(rv, _mm256_max_ps(gv, bv)), mn = _mm256_min_ps(rv, _mm256_min_ps(gv, bv));
+        __m256 d = _mm256_sub_ps(mx, mn);
+        __m256 pos = _mm256_cmp_ps(mx, zero, _CMP_GT_OQ);
+        _mm256_storeu_ps(h + i, hue8(rv, gv, bv, mx, d));
+        _mm256_storeu_ps(s + i, _mm256_and_ps(pos, _mm256_div_ps(d, select(pos, mx, one))));
+        _mm256_storeu_ps(v + i, _mm256_mul_ps(mx, inv255));
+    }
+    color_sse2::hsvFromRgb(r + i, g + i, b + i, h + i, s + i, v + i, n - i);
+}
+
+M3_TARGET_AVX2 inline void rgbFromHsv(const float *h, const float *s, const float *v, float *r, float *g, float *b,
+                                      size_t n) {
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), four = _mm256_set1_ps(4.0f);
+    const __m256 inv60 = _mm256_set1_ps(INV60), k255 = _mm256_set1_ps(255.0f);
+    float *out[3] = { r, g, b };
+    const float offset[3] = { 5.0f, 3.0f, 1.0f };
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 hv = _mm256_loadu_ps(h + i), vv = _mm256_loadu_ps(v + i);
+        __m256 vs = _mm256_mul_ps(vv, _mm256_loadu_ps(s + i));
+        __m256 h60 = _mm256_mul_ps(hv, inv60);
+        for (int c = 0; c < 3; c++) {
+            __m256 k = wrap8(_mm256_add_ps(_mm256_set1_ps(offset[c]), h60), 6.0f, INV6);
+            __m256 t = _mm256_max_ps(_mm256_min_ps(_mm256_min_ps(k, _mm256_sub_ps(four, k)), one), zero);
+            _mm256_storeu_ps(out[c] + i, _mm256_mul_ps(_mm256_sub_ps(vv, _mm256_mul_ps(vs, t)), k255));
+        }
+    }
+    color_sse2::rgbFromHsv(h + i, s + i, v + i, r + i, g + i, b + i, n - i);
+}
+
+M3_TARGET_AVX2 inline void hslFromRgb(const float *r, const float *g, const float *b, float *h, float *s, float *l,
+                                      size_t n) {
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    const __m256 inv255 = _mm256_set1_ps(INV255), inv510 = _mm256_set1_ps(INV510);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 rv = _mm256_loadu_ps(r + i), gv = _mm256_loadu_ps(g + i), bv = _mm256_loadu_ps(b + i);
+        __m256 mx = _mm256_max_ps(rv, _mm256_max_ps(gv, bv)), mn = _mm256_min_ps(rv, _mm256_min_ps(gv, bv));
+        __m256 d = _mm256_sub_ps(mx, mn);
+        __m256 dZero = _mm256_cmp_ps(d, zero, _CMP_EQ_OQ);
+        __m256 li = _mm256_mul_ps(_mm256_add_ps(mx, mn), inv510);
+        __m256 den = _mm256_sub_ps(one, _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_add_ps(li, li), one)));
+        _mm256_storeu_ps(h + i, hue8(rv, gv, bv, mx, d));
+        _mm256_storeu_ps(s + i, _mm256_andnot_ps(dZero, _mm256_div_ps(_mm256_mul_ps(d, inv255),
+                                                                      select(dZero, one, den))));
+        _mm256_storeu_ps(l + i, li);
+    }
+    color_sse2::hslFromRgb(r + i, g + i, b + i, h + i, s + i, l + i, n - i);
+}
+
+M3_TARGET_AVX2 inline void rgbFromHsl(const float *h, const float *s, const float *l, float *r, float *g, float *b,
+                                      size_t n) {
+    const __m256 one = _mm256_set1_ps(1.0f), minusOne = _mm256_set1_ps(-1.0f);
+    const __m256 three = _mm256_set1_ps(3.0f), nine = _mm256_set1_ps(9.0f);
+    const __m256 inv30 = _mm256_set1_ps(INV30), k255 = _mm256_set1_ps(255.0f);
+    float *out[3] = { r, g, b };
+    const float offset[3] = { 0.0f, 8.0f, 4.0f };
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 hv = _mm256_loadu_ps(h + i), lv = _mm256_loadu_ps(l + i);
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(s + i), _mm256_min_ps(lv, _mm256_sub_ps(one, lv)));
+        __m256 h30 = _mm256_mul_ps(hv, inv30);
+        for (int c = 0; c < 3; c++) {
+            __m256 k = wrap8(_mm256_add_ps(_mm256_set1_ps(offset[c]), h30), 12.0f, INV12);
+            __m256 t = _mm256_max_ps(_mm256_min_ps(_mm256_min_ps(_mm256_sub_ps(k, three), _mm256_sub_ps(nine, k)),
+                                                   one), minusOne);
+            _mm256_storeu_ps(out[c] + i, _mm256_mul_ps(_mm256_sub_ps(lv, _mm256_mul_ps(a, t)), k255));
+        }
+    }
+    color_sse2::rgbFromHsl(h + i, s + i, l + i, r + i, g + i, b + i, n - i);
+}
+
+M3_TARGET_AVX2 inline __m256 labF8(__m256 t) {
+    const __m256 third = _mm256_set1_ps(THIRD);
+    __m256i bits = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(t)), third));
+    __m256 y = _mm256_castsi256_ps(_mm256_add_epi32(bits, _mm256_set1_epi32(CBRT_BIAS)));
+    for (int k = 0; k < 3; k++) {
+        y = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(y, y), _mm256_div_ps(t, _mm256_mul_ps(y, y))), third);
+    }
+    __m256 linear = _mm256_add_ps(_mm256_mul_ps(t, _mm256_set1_ps(LAB_SLOPE)), _mm256_set1_ps(LAB_OFFSET));
+    return select(_mm256_cmp_ps(t, _mm256_set1_ps(LAB_EPSILON), _CMP_GT_OQ), y, linear);
+}
+
+M3_TARGET_AVX2 inline __m256 labFInverse8(__m256 t) {
+    __m256 cube = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+    __m256 linear = _mm256_mul_ps(_mm256_sub_ps(t, _mm256_set1_ps(LAB_OFFSET)), _mm256_set1_ps(LAB_SLOPE_INV));
+    return select(_mm256_cmp_ps(t, _mm256_set1_ps(LAB_DELTA), _CMP_GT_OQ), cube, linear);
+}
+
+M3_TARGET_AVX2 inline __m256 dot3(__m256 a, __m256 b, __m256 c, const float *k) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, _mm256_set1_ps(k[0])), _mm256_mul_ps(b, _mm256_set1_ps(k[1]))),
+                         _mm256_mul_ps(c, _mm256_set1_ps(k[2])));
+}
+
+M3_TARGET_AVX2 inline void labFromLinear(const float *r, const float *g, const float *b, float *L, float *A,
+                                         float *B, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 rv = _mm256_loadu_ps(r + i), gv = _mm256_loadu_ps(g + i), bv = _mm256_loadu_ps(b + i);
+        __m256 fx = labF8(dot3(rv, gv, bv, TO_X));
+        __m256 fy = labF8(dot3(rv, gv, bv, TO_Y));
+        __m256 fz = labF8(dot3(rv, gv, bv, TO_Z));
+        _mm256_storeu_ps(L + i, _mm256_sub_ps(_mm256_mul_ps(fy, _mm256_set1_ps(116.0f)), _mm256_set1_ps(16.0f)));
+        _mm256_storeu_ps(A + i, _mm256_mul_ps(_mm256_sub_ps(fx, fy), _mm256_set1_ps(500.0f)));
+        _mm256_storeu_ps(B + i, _mm256_mul_ps(_mm256_sub_ps(fy, fz), _mm256_set1_ps(200.0f)));
+    }
+    color_sse2::labFromLinear(r + i, g + i, b + i, L + i, A + i, B + i, n - i);
+}
+
+M3_TARGET_AVX2 inline void linearFromLab(const float *L, const float *A, const float *B, float *r, float *g,
+                                         float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 fy = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(L + i), _mm256_set1_ps(16.0f)),
+                                  _mm256_set1_ps(1.0f / 116.0f));
+        __m256 x = labFInverse8(_mm256_add_ps(fy, _mm256_mul_ps(_mm256_loadu_ps(A + i), _mm256_set1_ps(1.0f / 500.0f))));
+        __m256 y = labFInverse8(fy);
+        __m256 z = labFInverse8(_mm256_sub_ps(fy, _mm256_mul_ps(_mm256_loadu_ps(B + i), _mm256_set1_ps(1.0f / 200.0f))));
+        _mm256_storeu_ps(r + i, dot3(x, y, z, TO_R));
+        _mm256_storeu_ps(g + i, dot3(x, y, z, TO_G));
+        _mm256_storeu_ps(b + i, dot3(x, y, z, TO_B));
+    }
+    color_sse2::linearFromLab(L + i, A + i, B + i, r + i, g + i, b + i, n - i);
+}
+
+} // namespace color_avx2
+#endif
+
+/*-------------------------LINHAS INTERCALADAS----------------------------*/
+
+// Kernels planares de um nível; as funções de linha abaixo são as mesmas
+// para todos e só trocam esta tabela.
+struct PlanarColorKernels {
+    void (*ycbcrToRgb)(const unsigned char *, const unsigned char *, const unsigned char *, unsigned char *,
+                       unsigned char *, unsigned char *, size_t);
+    void (*rgbToYcbcr)(const unsigned char *, const unsigned char *, const unsigned char *, unsigned char *,
+                       unsigned char *, unsigned char *, size_t);
+    void (*luma)(const unsigned char *, const unsigned char *, const unsigned char *, unsigned char *, size_t);
+    void (*toFloats)(const unsigned char *, float *, size_t);
+    void (*toBytes)(const float *, unsigned char *, size_t);
+    void (*hsvFromRgb)(const float *, const float *, const float *, float *, float *, float *, size_t);
+    void (*rgbFromHsv)(const float *, const float *, const float *, float *, float *, float *, size_t);
+    void (*hslFromRgb)(const float *, const float *, const float *, float *, float *, float *, size_t);
+    void (*rgbFromHsl)(const float *, const float *, const float *, float *, float *, float *, size_t);
+    void (*labFromLinear)(const float *, const float *, const float *, float *, float *, float *, size_t);
+    void (*linearFromLab)(const float *, const float *, const float *, float *, float *, float *, size_t);
+};
+
+#define M3_PLANAR_COLOR_KERNELS(ns)                                                                        \
+    { ns::ycbcrToRgb, ns::rgbToYcbcr, ns::luma, ns::toFloats, ns::toBytes, ns::hsvFromRgb, ns::rgbFromHsv, \
+      ns::hslFromRgb, ns::rgbFromHsl, ns::labFromLinear, ns::linearFromLab }
+
+inline const PlanarColorKernels &planarColorKernels(SimdLevel level) {
+    static const PlanarColorKernels table[] = {
+        M3_PLANAR_COLOR_KERNELS(color_scalar),
+#ifdef M3_X86
+        M3_PLANAR_COLOR_KERNELS(color_sse2),
+        M3_PLANAR_COLOR_KERNELS(color_avx2),
+#endif
+    };
+    if (level > cpuSimdLevel()) level = cpuSimdLevel();
+    return table[level];
+}
+
+#undef M3_PLANAR_COLOR_KERNELS
+
+namespace color_rows {
+
+using namespace color_detail;
+
+const size_t TILE = 64;
+
+template <SimdLevel L>
+void ycbcrToRgb(const unsigned char *y, const unsigned char *cb, const unsigned char *cr, unsigned char *out,
+                size_t n, int step) {
+    const PlanarColorKernels &k = planarColorKernels(L);
+    const LayoutKernels &layout = layoutKernels(L);
+    unsigned char r[TILE], g[TILE], b[TILE], a[TILE];
+    memset(a, 255, sizeof(a));
+    for (size_t i = 0; i < n; i += TILE) {
+        size_t m = n - i < TILE ? n - i : TILE;
+        k.ycbcrToRgb(y + i, cb + i, cr + i, r, g, b, m);
+        if (step == 4) {
+            const unsigned char *planes[4] = { r, g, b, a };
+            layout.merge4(planes, out + i * 4, m);
+        } else {
+            layout.merge3(r, g, b, out + i * 3, m);
+        }
+    }
+}
+
+// Separa os canais de m pixels com 3 ou 4 canais.
+inline void split(const LayoutKernels &layout, const unsigned char *src, int channels, unsigned char *r,
+                  unsigned char *g, unsigned char *b, unsigned char *a, size_t m) {
+    if (channels == 4) {
+        unsigned char *planes[4] = { r, g, b, a };
+        layout.split4(src, planes, m);
+    } else {
+        layout.split3(src, r, g, b, m);
+    }
+}
+
+template <SimdLevel L>
+void rgbToYcbcr(const unsigned char *rgb, unsigned char *y, unsigned char *cb, unsigned char *cr, size_t n) {
+    const PlanarColorKernels &k = planarColorKernels(L);
+    const LayoutKernels &layout = layoutKernels(L);
+    unsigned char r[TILE], g[TILE], b[TILE];
+    for (size_t i = 0; i < n; i += TILE) {
+        size_t m = n - i < TILE ? n - i : TILE;
+        layout.split3(rgb + i * 3, r, g, b, m);
+        k.rgbToYcbcr(r, g, b, y + i, cb + i, cr + i, m);
+    }
+}
+
+template <SimdLevel L>
+void luma(const unsigned char *src, unsigned char *y, size_t n, int channels) {
+    const PlanarColorKernels &k = planarColorKernels(L);
+    const LayoutKernels &layout = layoutKernels(L);
+    unsigned char r[TILE], g[TILE], b[TILE], a[TILE];
+    for (size_t i = 0; i < n; i += TILE) {
+        size_t m = n - i < TILE ? n - i : TILE;
+        split(layout, src + i * channels, channels, r, g, b, a, m);
+        k.luma(r, g, b, y + i, m);
+    }
+}
+
+enum FloatSpace { SPACE_HSV, SPACE_HSL, SPACE_LAB };
+
+template <SimdLevel L, FloatSpace S>
+void toPlanes(const unsigned char *rgb, float *c0, float *c1, float *c2, size_t n) {
+    const PlanarColorKernels &k = planarColorKernels(L);
+    const LayoutKernels &layout = layoutKernels(L);
+    unsigned char r[TILE], g[TILE], b[TILE];
+    float rf[TILE], gf[TILE], bf[TILE];
+    for (size_t i = 0; i < n; i += TILE) {
+        size_t m = n - i < TILE ? n - i : TILE;
+        layout.split3(rgb + i * 3, r, g, b, m);
+        if (S == SPACE_LAB) {
+            linearize(r, rf, m);
+            linearize(g, gf, m);
+            linearize(b, bf, m);
+            k.labFromLinear(rf, gf, bf, c0 + i, c1 + i, c2 + i, m);
+            continue;
+        }
+        k.toFloats(r, rf, m);
+        k.toFloats(g, gf, m);
+        k.toFloats(b, bf, m);
+        if (S == SPACE_HSV) k.hsvFromRgb(rf, gf, bf, c0 + i, c1 + i, c2 + i, m);
+        else k.hslFromRgb(rf, gf, bf, c0 + i, c1 + i, c2 + i, m);
+    }
+}
+
+template <SimdLevel L, FloatSpace S>
+void fromPlanes(const float *c0, const float *c1, const float *c2, unsigned char *rgb, size_t n) {
+    const PlanarColorKernels &k = planarColorKernels(L);
+    const LayoutKernels &layout = layoutKernels(L);
+    unsigned char r[TILE], g[TILE], b[TILE];
+    float rf[TILE], gf[TILE], bf[TILE];
+    for (size_t i = 0; i < n; i += TILE) {
+        size_t m = n - i < TILE ? n - i : TILE;
+        if (S == SPACE_LAB) {
+            k.linearFromLab(c0 + i, c1 + i, c2 + i, rf, gf, bf, m);
+            encode(rf, r, m);
+            encode(gf, g, m);
+            encode(bf, b, m);
+        } else {
+            if (S == SPACE_HSV) k.rgbFromHsv(c0 + i, c1 + i, c2 + i, rf, gf, bf, m);
+            else k.rgbFromHsl(c0 + i, c1 + i, c2 + i, rf, gf, bf, m);
+            k.toBytes(rf, r, m);
+            k.toBytes(gf, g, m);
+            k.toBytes(bf, b, m);
+        }
+        layout.merge3(r, g, b, rgb + i * 3, m);
+    }
+}
+
+} // namespace color_rows
+
+struct ColorKernels {
+    SimdLevel level;
+    YCbCrToRgbKernel ycbcrToRgb;
+    RgbToYCbCrKernel rgbToYcbcr;
+    LumaKernel luma;
+    RgbToPlanesKernel rgbToHsv;
+    PlanesToRgbKernel hsvToRgb;
+    RgbToPlanesKernel rgbToHsl;
+    PlanesToRgbKernel hslToRgb;
+    RgbToPlanesKernel rgbToLab;
+    PlanesToRgbKernel labToRgb;
+};
+
+#define M3_COLOR_KERNELS(L)                                                                                      \
+    { L, color_rows::ycbcrToRgb<L>, color_rows::rgbToYcbcr<L>, color_rows::luma<L>,                              \
+      color_rows::toPlanes<L, color_rows::SPACE_HSV>, color_rows::fromPlanes<L, color_rows::SPACE_HSV>,          \
+      color_rows::toPlanes<L, color_rows::SPACE_HSL>, color_rows::fromPlanes<L, color_rows::SPACE_HSL>,          \
+      color_rows::toPlanes<L, color_rows::SPACE_LAB>, color_rows::fromPlanes<L, color_rows::SPACE_LAB> }
+
+inline const ColorKernels &colorKernels(SimdLevel level) {
+    static const ColorKernels table[] = {
+        M3_COLOR_KERNELS(SIMD_SCALAR),
+#ifdef M3_X86
+        M3_COLOR_KERNELS(SIMD_SSE2),
+        M3_COLOR_KERNELS(SIMD_AVX2),
+#endif
+    };
+    if (level > cpuSimdLevel()) level = cpuSimdLevel();
+    return table[level];
+}
+
+#undef M3_COLOR_KERNELS
+
+inline const ColorKernels &colorKernels() {
+    static const ColorKernels &kernels = colorKernels(simdLevel());
+    return kernels;
+}
+
+#endif /* ColorConvert_h */
@@ -0,0 +1,382 @@
+//
+//  ColorLUT.h
+//  Tabelas de cor 3D (LUT) para qualquer filtro pontual RGB.
+//
+//  ColorLUT guarda uma grade N x N x N (17, 33, 65, ...) e interpola
+//  tetraedricamente. Cada vértice é um uint32 com os três canais em 10 bits
+//  (valor * 4, ou seja 8 bits com 2 de fração) e a interpolação é feita em
+//  ponto fixo, de modo que a versão AVX2 (com gathers) dá exatamente o
+//  mesmo resultado que a escalar. Lê e grava arquivos .cube (Adobe/Resolve).
+//
+//  ExactColorLUT é a tabela completa de 2^24 cores (64 MB): sem
+//  interpolação, reproduz o filtro exatamente, inclusive o chroma-key, e
+//  custa uma leitura por pixel. A opção 8 de exemplo_03 assa a cadeia de
+//  filtros escolhida em uma das duas.
+//
+//  Só existem em 8 bits por canal; imagens de 16 bits passam pelos filtros
+//  diretos de Filters16.h.
+//
+
+#ifndef ColorLUT_h
+#define ColorLUT_h
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CpuFeatures.h"
+
+// filter(rgb, pixels): filtro pontual sobre pixels RGB intercalados
+typedef std::function<void(unsigned char *, size_t)> PointFilter;
+
+namespace lut_detail {
+
+inline uint32_t pack10(int r4, int g4, int b4) {
+    return (uint32_t)r4 | ((uint32_t)g4 << 10) | ((uint32_t)b4 << 20);
+}
+
+#ifdef M3_X86
+// 8 pixels RGB (24 bytes) -> um pixel por lane de 32 bits (r | g<<8 | b<<16).
+M3_TARGET_AVX2 inline __m256i load8(const unsigned char *p) {
+    const __m256i spread = _mm256_setr_epi8(
+        0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128,
+        0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128);
+    __m128i lo = _mm_loadu_si128((const __m128i *)p);
+    __m128i hi = _mm_loadl_epi64((const __m128i *)(p + 16));
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    // bytes 0..11 na metade baixa e 12..23 na alta
+    v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 2, 3, 4, 5, 5));
+    return _mm256_shuffle_epi8(v, spread);
+}
+
+// Inverso de load8: grava exatamente 24 bytes.
+M3_TARGET_AVX2 inline void store8(unsigned char *p, __m256i v) {
+    const __m256i pack = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -128, -128, -128, -128,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -128, -128, -128, -128);
+    v = _mm256_shuffle_epi8(v, pack);
+    v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+    _mm_storeu_si128((__m128i *)p, _mm256_castsi256_si128(v));
+    _mm_storel_epi64((__m128i *)(p + 16), _mm256_extracti128_si256(v, 1));
+}
+#endif
+
+} // namespace lut_detail
+
+class ColorLUT {
+    int n;
+    std::vector<uint32_t> table;   // índice (b * n + g) * n + r, como no .cube
+    // por eixo e valor de entrada: deslocamento do vértice inferior (bits
+    // 0..22) e fração em 1/256 (bits 23..31)
+    std::vector<uint32_t> axis[3];
+
+public:
+    static const int MAX_SIZE = 129;
+
+    ColorLUT() : n(0) {}
+
+    int size() const {
+        return n;
+    }
+
+    bool empty() const {
+        return n == 0;
+    }
+
+    // Amostra filter nos vértices de uma grade size^3.
+    void bake(const PointFilter &filter, int size = 33) {
+        if (size < 2) size = 2;
+        if (size > MAX_SIZE) size = MAX_SIZE;
+        size_t count = (size_t)size * size * size;
+        std::vector<unsigned char> rgb(count * 3);
+        size_t k = 0;
+        for (int b = 0; b < size; b++) {
+            for (int g = 0; g < size; g++) {
+                for (int r = 0; r < size; r++) {
+                    rgb[k++] = lattice(r, size);
+                    rgb[k++] = lattice(g, size);
+                    rgb[k++] = lattice(b, size);
+                }
+            }
+        }
+        filter(rgb.data(), count);
+        table.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            table[i] = lut_detail::pack10(rgb[3 * i] * 4, rgb[3 * i + 1] * 4, rgb[3 * i + 2] * 4);
+        }
+        setSize(size);
+    }
+
+    // Lê um .cube 3D com domínio 0..1.
+    bool loadCube(const std::string &path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "Não foi possível abrir " << path << std::endl;
+            return false;
+        }
+        int size = 0;
+        std::vector<uint32_t> values;
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t start = line.find_first_not_of(" \t\r");
+            if (start == std::string::npos || line[start] == '#') continue;
+            std::istringstream tok(line.substr(start));
+            if (isalpha((unsigned char)line[start])) {
+                std::string key;
+                tok >> key;
+                if (key == "LUT_3D_SIZE") {
+                    tok >> size;
+                } else if (key == "LUT_1D_SIZE") {
+                    std::cerr << "LUT 1D não suportada: " << path << std::endl;
+                    return false;
+                } else if (key == "DOMAIN_MIN" || key == "DOMAIN_MAX") {
+                    float d[3] = { 0, 0, 0 };
+                    tok >> d[0] >> d[1] >> d[2];
+                    float expected = key == "DOMAIN_MIN" ? 0.0f : 1.0f;
+                    if (d[0] != expected || d[1] != expected || d[2] != expected) {
+                        std::cerr << "Apenas domínio 0..1 é suportado: " << path << std::endl;
+                        return false;
+                    }
+                }
+                continue;
+            }
+            float r, g, b;
+            if (!(tok >> r >> g >> b)) {
+                std::cerr << "Linha inválida em " << path << ": " << line << std::endl;
+                return false;
+            }
+            values.push_back(lut_detail::pack10(quantize(r), quantize(g), quantize(b)));
+        }
+        if (size < 2 || size > MAX_SIZE || values.size() != (size_t)size * size * size) {
+            std::cerr << "Tamanho de LUT inválido em " << path << std::endl;
+            return false;
+        }
+        table.swap(values);
+        setSize(size);
+        return true;
+    }
+
+    bool saveCube(const std::string &path, const std::string &title = "PGCCHIB") const {
+        FILE *out = fopen(path.c_str(), "w");
+        if (!out) {
+            std::cerr << "Não foi possível criar " << path << std::endl;
+            return false;
+        }
+        fprintf(out, "TITLE \"%s\"\nLUT_3D_SIZE %d\nDOMAIN_MIN 0 0 0\nDOMAIN_MAX 1 1 1\n", title.c_str(), n);
+        for (size_t i = 0; i < table.size(); i++) {
+            uint32_t c = table[i];
+            fprintf(out, "%.6f %.6f %.6f\n", (c & 1023) / 1020.0, ((c >> 10) & 1023) / 1020.0,
+                    ((c >> 20) & 1023) / 1020.0);
+        }
+        return fclose(out) == 0;
+    }
+
+    // Aplica a LUT (interpolação tetraédrica) in-place.
+    void apply(unsigned char *rgb, size_t pixels, SimdLevel level = simdLevel()) const {
+        size_t i = 0;
+#ifdef M3_X86
+        if (level >= SIMD_AVX2 && cpuSimdLevel() >= SIMD_AVX2) i = applyAVX2(rgb, pixels);
+#else
+        (void)level;
+#endif
+        for (; i < pixels; i++) interpolate(rgb + 3 * i);
+    }
+
+    PointFilter filter() const {
+        const ColorLUT *self = this;
+        return [self](unsigned char *rgb, size_t pixels) { self->apply(rgb, pixels); };
+    }
+
+private:
+    static unsigned char lattice(int i, int size) {
+        return (unsigned char)((i * 255 + (size - 1) / 2) / (size - 1));
+    }
+
+    static int quantize(float v) {
+        if (!(v > 0.0f)) return 0;
+        if (v >= 1.0f) return 1020;
+        return (int)lroundf(v * 1020.0f);
+    }
+
+    void setSize(int size) {
+        n = size;
+        uint32_t stride[3] = { 1, (uint32_t)size, (uint32_t)(size * size) };
+        for (int a = 0; a < 3; a++) {
+            axis[a].resize(256);
+            for (int v = 0; v < 256; v++) {
+                int pos = v * (size - 1) * 256 / 255;  // posição na grade em 1/256
+                int idx = pos >> 8;
+                int frac = pos & 255;
+                if (idx >= size - 1) {
+                    idx = size - 2;
+                    frac = 256;
+                }
+                axis[a][v] = idx * stride[a] | ((uint32_t)frac << 23);
+            }
+        }
+    }
+
+    void interpolate(unsigned char *px) const {
+        const uint32_t mask = 0x7fffff;
+        uint32_t ar = axis[0][px[0]], ag = axis[1][px[1]], ab = axis[2][px[2]];
+        uint32_t base = (ar & mask) + (ag & mask) + (ab & mask);
+        int f0 = ar >> 23, f1 = ag >> 23, f2 = ab >> 23;
+        uint32_t s0 = 1, s1 = n, s2 = n * n;
+        // ordena as frações em ordem decrescente, levando junto os passos
+        if (f0 < f1) { std::swap(f0, f1); std::swap(s0, s1); }
+        if (f1 < f2) { std::swap(f1, f2); std::swap(s1, s2); }
+        if (f0 < f1) { std::swap(f0, f1); std::swap(s0, s1); }
+        uint32_t c0 = table[base];
+        uint32_t c1 = table[base + s0];
+        uint32_t c2 = table[base + s0 + s1];
+        uint32_t c3 = table[base + 1 + n + n * n];
+        int w0 = 256 - f0, w1 = f0 - f1, w2 = f1 - f2, w3 = f2;
+        for (int ch = 0; ch < 3; ch++) {
+            int shift = 10 * ch;
+            int v = w0 * (int)((c0 >> shift) & 1023) + w1 * (int)((c1 >> shift) & 1023) +
+                    w2 * (int)((c2 >> shift) & 1023) + w3 * (int)((c3 >> shift) & 1023);
+            px[ch] = (unsigned char)((v + 512) >> 10);
+        }
+    }
+
+#ifdef M3_X86
+    M3_TARGET_AVX2 static void sortStep(__m256i &fa, __m256i &sa, __m256i &fb, __m256i &sb) {
+        __m256i swap = _mm256_cmpgt_epi32(fb, fa);
+        __m256i f = _mm256_blendv_epi8(fa, fb, swap);
+        __m256i s = _mm256_blendv_epi8(sa, sb, swap);
+        fb = _mm256_blendv_epi8(fb, fa, swap);
+        sb = _mm256_blendv_epi8(sb, sa, swap);
+        fa = f;
+        sa = s;
+    }
+
+    M3_TARGET_AVX2 static __m256i channel(__m256i c, int shift) {
+        return _mm256_and_si256(_mm256_srli_epi32(c, shift), _mm256_set1_epi32(1023));
+    }
+
+    M3_TARGET_AVX2 size_t applyAVX2(unsigned char *rgb, size_t pixels) const {
+        const __m256i byteMask = _mm256_set1_epi32(255);
+        const __m256i offsetMask = _mm256_set1_epi32(0x7fffff);
+        const __m256i full = _mm256_set1_epi32(256);
+        const __m256i round = _mm256_set1_epi32(512);
+        const __m256i farCorner = _mm256_set1_epi32(1 + n + n * n);
+        const int *tab = (const int *)table.data();
+        const int *axr = (const int *)axis[0].data();
+        const int *axg = (const int *)axis[1].data();
+        const int *axb = (const int *)axis[2].data();
+        size_t i = 0;
+        for (; i + 8 <= pixels; i += 8) {
+            unsigned char *p = rgb + 3 * i;
+            __m256i px = lut_detail::load8(p);
+            __m256i ar = _mm256_i32gather_epi32(axr, _mm256_and_si256(px, byteMask), 4);
+            __m256i ag = _mm256_i32gather_epi32(axg, _mm256_and_si256(_mm256_srli_epi32(px, 8), byteMask), 4);
+            __m256i ab = _mm256_i32gather_epi32(axb, _mm256_srli_epi32(px, 16), 4);
+            __m256i base = _mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(ar, offsetMask),
+                                                             _mm256_and_si256(ag, offsetMask)),
+                                            _mm256_and_si256(ab, offsetMask));
+            __m256i f0 = _mm256_srli_epi32(ar, 23), f1 = _mm256_srli_epi32(ag, 23), f2 = _mm256_srli_epi32(ab, 23);
+            __m256i s0 = _mm256_set1_epi32(1), s1 = _mm256_set1_epi32(n), s2 = _mm256_set1_epi32(n * n);
+            sortStep(f0, s0, f1, s1);
+            sortStep(f1, s1, f2, s2);
+            sortStep(f0, s0, f1, s1);
+            __m256i v1 = _mm256_add_epi32(base, s0);
+            __m256i c0 = _mm256_i32gather_epi32(tab, base, 4);
+            __m256i c1 = _mm256_i32gather_epi32(tab, v1, 4);
+            __m256i c2 = _mm256_i32gather_epi32(tab, _mm256_add_epi32(v1, s1), 4);
+            __m256i c3 = _mm256_i32gather_epi32(tab, _mm256_add_epi32(base, farCorner), 4);
+            __m256i w0 = _mm256_sub_epi32(full, f0);
+            __m256i w1 = _mm256_sub_epi32(f0, f1);
+            __m256i w2 = _mm256_sub_epi32(f1, f2);
+            __m256i out = _mm256_setzero_si256();
+            for (int ch = 0; ch < 3; ch++) {
+                int shift = 10 * ch;
+                __m256i v = _mm256_add_epi32(
+                    _mm256_add_epi32(_mm256_mullo_epi32(w0, channel(c0, shift)), _mm256_mullo_epi32(w1, channel(c1, shift))),
+                    _mm256_add_epi32(_mm256_mullo_epi32(w2, channel(c2, shift)), _mm256_mullo_epi32(f2, channel(c3, shift))));
+                v = _mm256_srli_epi32(_mm256_add_epi32(v, round), 10);
+                out = _mm256_or_si256(out, _mm256_slli_epi32(v, 8 * ch));
+            }
+            lut_detail::store8(p, out);
+        }
+        return i;
+    }
+#endif
+};
+
+class ExactColorLUT {
+    std::vector<uint32_t> table;  // índice r << 16 | g << 8 | b, valor r | g<<8 | b<<16
+
+public:
+    static const size_t ENTRIES = 1 << 24;
+
+    bool empty() const {
+        return table.empty();
+    }
+
+    // Passa as 2^24 cores pelo filtro, 64K de cada vez.
+    void bake(const PointFilter &filter) {
+        table.resize(ENTRIES);
+        std::vector<unsigned char> rgb(65536 * 3);
+        for (int r = 0; r < 256; r++) {
+            for (int i = 0; i < 65536; i++) {
+                rgb[3 * i] = (unsigned char)r;
+                rgb[3 * i + 1] = (unsigned char)(i >> 8);
+                rgb[3 * i + 2] = (unsigned char)i;
+            }
+            filter(rgb.data(), 65536);
+            uint32_t *dst = table.data() + ((size_t)r << 16);
+            for (int i = 0; i < 65536; i++) {
+                dst[i] = rgb[3 * i] | (rgb[3 * i + 1] << 8) | (rgb[3 * i + 2] << 16);
+            }
+        }
+    }
+
+    void apply(unsigned char *rgb, size_t pixels, SimdLevel level = simdLevel()) const {
+        size_t i = 0;
+#ifdef M3_X86
+        if (level >= SIMD_AVX2 && cpuSimdLevel() >= SIMD_AVX2) i = applyAVX2(rgb, pixels);
+#else
+        (void)level;
+#endif
+        for (; i < pixels; i++) {
+            unsigned char *px = rgb + 3 * i;
+            uint32_t c = table[(px[0] << 16) | (px[1] << 8) | px[2]];
+            px[0] = (unsigned char)c;
+            px[1] = (unsigned char)(c >> 8);
+            px[2] = (unsigned char)(c >> 16);
+        }
+    }
+
+    PointFilter filter() const {
+        const ExactColorLUT *self = this;
+        return [self](unsigned char *rgb, size_t pixels) { self->apply(rgb, pixels); };
+    }
+
+private:
+#ifdef M3_X86
+    M3_TARGET_AVX2 size_t applyAVX2(unsigned char *rgb, size_t pixels) const {
+        // r | g<<8 | b<<16  ->  r<<16 | g<<8 | b
+        const __m256i swapRB = _mm256_setr_epi8(
+            2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128,
+            2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128);
+        const int *tab = (const int *)table.data();
+        size_t i = 0;
+        for (; i + 8 <= pixels; i += 8) {
+            unsigned char *p = rgb + 3 * i;
+            __m256i idx = _mm256_shuffle_epi8(lut_detail::load8(p), swapRB);
+            lut_detail::store8(p, _mm256_i32gather_epi32(tab, idx, 4));
+        }
+        return i;
+    }
+#endif
+};
+
+#endif /* ColorLUT_h */
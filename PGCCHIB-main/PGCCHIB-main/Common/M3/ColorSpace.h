@@ -0,0 +1,191 @@
+//
+//  ColorSpace.h
+//  Constantes dos espaços de cor usados no projeto e as conversões de
+//  referência. É o lugar único dos pesos: os filtros (tons de cinza,
+//  ChromaMatte) e o decodificador JPEG lêem daqui, e as versões em linha
+//  (escalar, SSE2, AVX2) ficam em ColorConvert.h.
+//
+//  - YCbCr: o do JPEG (BT.601, faixa completa, Cb e Cr centrados em 128),
+//    em ponto fixo Q14 com coeficientes que cabem em 16 bits com sinal,
+//    para que os kernels SIMD façam as contas com madd_epi16 sem perder
+//    nada: a versão inteira é a mesma em todos os níveis.
+//  - Luma: BT.601 (a do YCbCr) e Rec. 709 (a do filtro de tons de cinza),
+//    em float e em Q15.
+//  - color_reference: as conversões em double (RGB de 8 bits <-> YCbCr,
+//    HSV, HSL e CIE Lab D65 com sRGB), contra as quais bench_colorspace
+//    mede o erro máximo dos kernels.
+//
+
+#ifndef ColorSpace_h
+#define ColorSpace_h
+
+#include <math.h>
+
+struct LumaWeights {
+    float r, g, b;
+    int qr, qg, qb;     // Q15, somando 32768
+};
+
+// 0.299, 0.587, 0.114
+const LumaWeights LUMA_BT601 = { 0.299f, 0.587f, 0.114f, 9798, 19235, 3735 };
+// 0.2125, 0.7154, 0.0721
+const LumaWeights LUMA_BT709 = { 0.2125f, 0.7154f, 0.0721f, 6963, 23442, 2363 };
+
+// Crominância BT.601 em float (Cb e Cr sem o deslocamento de 128) e a
+// inversa: R = Y + CR_TO_R * Cr, G = Y - CB_TO_G * Cb - CR_TO_G * Cr, B = Y + CB_TO_B * Cb.
+const float CB_FROM_R = -0.168736f, CB_FROM_G = -0.331264f, CB_FROM_B = 0.5f;
+const float CR_FROM_R = 0.5f, CR_FROM_G = -0.418688f, CR_FROM_B = -0.081312f;
+const float CR_TO_R = 1.402f, CB_TO_G = 0.344136f, CR_TO_G = 0.714136f, CB_TO_B = 1.772f;
+
+namespace ycc {
+
+// Q14: linhas de RGB -> YCbCr somam 16384 (Y) ou 0 (Cb, Cr), então cinza
+// vai para (v, 128, 128) exatamente.
+const int SHIFT = 14;
+const int ROUND = 1 << (SHIFT - 1);
+const int Y_R = 4899, Y_G = 9617, Y_B = 1868;
+const int CB_R = -2765, CB_G = -5427, CB_B = 8192;
+const int CR_R = 8192, CR_G = -6860, CR_B = -1332;
+const int R_CR = 22970, G_CB = -5638, G_CR = -11700, B_CB = 29032;
+
+inline unsigned char clampByte(int v) {
+    return (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+inline unsigned char luma(int r, int g, int b) {
+    return clampByte((r * Y_R + g * Y_G + b * Y_B + ROUND) >> SHIFT);
+}
+
+inline void fromRgb(int r, int g, int b, unsigned char &y, unsigned char &cb, unsigned char &cr) {
+    y = luma(r, g, b);
+    cb = clampByte(((r * CB_R + g * CB_G + b * CB_B + ROUND) >> SHIFT) + 128);
+    cr = clampByte(((r * CR_R + g * CR_G + b * CR_B + ROUND) >> SHIFT) + 128);
+}
+
+inline void toRgb(int y, int cb, int cr, unsigned char *rgb) {
+    int base = (y << SHIFT) + ROUND;
+    cb -= 128;
+    cr -= 128;
+    rgb[0] = clampByte((base + cr * R_CR) >> SHIFT);
+    rgb[1] = clampByte((base + cb * G_CB + cr * G_CR) >> SHIFT);
+    rgb[2] = clampByte((base + cb * B_CB) >> SHIFT);
+}
+
+} // namespace ycc
+
+// Conversões exatas (double) para medir o erro dos kernels. RGB em 0..255;
+// H em graus [0, 360), S, V e L de HSV/HSL em [0, 1]; Lab com L em [0, 100].
+namespace color_reference {
+
+inline double clamp01(double v) {
+    return v < 0.0 ? 0.0 : v > 1.0 ? 1.0 : v;
+}
+
+inline void rgbToYcbcr(double r, double g, double b, double &y, double &cb, double &cr) {
+    y = 0.299 * r + 0.587 * g + 0.114 * b;
+    cb = 128.0 - 0.168736 * r - 0.331264 * g + 0.5 * b;
+    cr = 128.0 + 0.5 * r - 0.418688 * g - 0.081312 * b;
+}
+
+inline void ycbcrToRgb(double y, double cb, double cr, double &r, double &g, double &b) {
+    r = y + 1.402 * (cr - 128.0);
+    g = y - 0.344136 * (cb - 128.0) - 0.714136 * (cr - 128.0);
+    b = y + 1.772 * (cb - 128.0);
+}
+
+inline double hue(double r, double g, double b, double max, double d) {
+    if (d == 0.0) return 0.0;
+    double h;
+    if (max == r) h = 60.0 * ((g - b) / d);
+    else if (max == g) h = 60.0 * ((b - r) / d + 2.0);
+    else h = 60.0 * ((r - g) / d + 4.0);
+    return h < 0.0 ? h + 360.0 : h;
+}
+
+inline void rgbToHsv(double r, double g, double b, double &h, double &s, double &v) {
+    double max = fmax(r, fmax(g, b)), min = fmin(r, fmin(g, b)), d = max - min;
+    h = hue(r, g, b, max, d);
+    s = max > 0.0 ? d / max : 0.0;
+    v = max / 255.0;
+}
+
+inline void hsvToRgb(double h, double s, double v, double &r, double &g, double &b) {
+    double out[3];
+    for (int i = 0; i < 3; i++) {
+        double k = fmod(5.0 - 2.0 * i + h / 60.0, 6.0);
+        if (k < 0.0) k += 6.0;
+        out[i] = 255.0 * (v - v * s * fmax(0.0, fmin(fmin(k, 4.0 - k), 1.0)));
+    }
+    r = out[0];
+    g = out[1];
+    b = out[2];
+}
+
+inline void rgbToHsl(double r, double g, double b, double &h, double &s, double &l) {
+    double max = fmax(r, fmax(g, b)), min = fmin(r, fmin(g, b)), d = max - min;
+    h = hue(r, g, b, max, d);
+    l = (max + min) / 510.0;
+    s = d == 0.0 ? 0.0 : d / 255.0 / (1.0 - fabs(2.0 * l - 1.0));
+}
+
+inline void hslToRgb(double h, double s, double l, double &r, double &g, double &b) {
+    double a = s * fmin(l, 1.0 - l);
+    double out[3];
+    const int n[3] = { 0, 8, 4 };
+    for (int i = 0; i < 3; i++) {
+        double k = fmod(n[i] + h / 30.0, 12.0);
+        if (k < 0.0) k += 12.0;
+        out[i] = 255.0 * (l - a * fmax(-1.0, fmin(fmin(k - 3.0, 9.0 - k), 1.0)));
+    }
+    r = out[0];
+    g = out[1];
+    b = out[2];
+}
+
+inline double srgbToLinear(double c) {
+    c /= 255.0;
+    return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+inline double linearToSrgb(double c) {
+    c = clamp01(c);
+    return 255.0 * (c <= 0.0031308 ? 12.92 * c : 1.055 * pow(c, 1.0 / 2.4) - 0.055);
+}
+
+const double LAB_XN = 0.95047, LAB_ZN = 1.08883;
+const double LAB_DELTA = 6.0 / 29.0;
+
+inline double labF(double t) {
+    return t > LAB_DELTA * LAB_DELTA * LAB_DELTA ? cbrt(t) : t / (3.0 * LAB_DELTA * LAB_DELTA) + 4.0 / 29.0;
+}
+
+inline double labFInverse(double t) {
+    return t > LAB_DELTA ? t * t * t : 3.0 * LAB_DELTA * LAB_DELTA * (t - 4.0 / 29.0);
+}
+
+inline void rgbToLab(double r, double g, double b, double &L, double &A, double &B) {
+    r = srgbToLinear(r);
+    g = srgbToLinear(g);
+    b = srgbToLinear(b);
+    double x = (0.4124564 * r + 0.3575761 * g + 0.1804375 * b) / LAB_XN;
+    double y = 0.2126729 * r + 0.7151522 * g + 0.0721750 * b;
+    double z = (0.0193339 * r + 0.1191920 * g + 0.9503041 * b) / LAB_ZN;
+    double fx = labF(x), fy = labF(y), fz = labF(z);
+    L = 116.0 * fy - 16.0;
+    A = 500.0 * (fx - fy);
+    B = 200.0 * (fy - fz);
+}
+
+inline void labToRgb(double L, double A, double B, double &r, double &g, double &b) {
+    double fy = (L + 16.0) / 116.0;
+    double x = LAB_XN * labFInverse(fy + A / 500.0);
+    double y = labFInverse(fy);
+    double z = LAB_ZN * labFInverse(fy - B / 200.0);
+    r = linearToSrgb(3.2404542 * x - 1.5371385 * y - 0.4985314 * z);
+    g = linearToSrgb(-0.9692660 * x + 1.8760108 * y + 0.0415560 * z);
+    b = linearToSrgb(0.0556434 * x - 0.2040259 * y + 1.0572252 * z);
+}
+
+} // namespace color_reference
+
+#endif /* ColorSpace_h */
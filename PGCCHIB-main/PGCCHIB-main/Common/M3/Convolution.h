@@ -0,0 +1,760 @@
+//
+//  Convolution.h
+//  Convolução 2D (separável ou geral) de imagens de 8 ou 16 bits por canal, com
+//  borda por repetição (clamp) ou espelhamento, e os filtros prontos blur
+//  gaussiano, unsharp mask e magnitude de Sobel.
+//
+//  A imagem é processada em blocos: para cada bloco, a passada horizontal
+//  gera (altura + 2 * raio) linhas em float num buffer que cabe na L2 e a
+//  passada vertical lê esse buffer para gravar a saída. Os blocos são
+//  tarefas do ThreadPool. Nas duas passadas o laço interno é o mesmo:
+//  dst[i] = soma de taps[t] * src[i + t * step], contíguo em i (em RGB
+//  intercalado, step = 3 na horizontal e uma linha do buffer na vertical),
+//  com versões escalar, SSE2 e AVX2 que dão o mesmo resultado bit a bit.
+//
+//  Entrada e saída também podem ser visões (Image.h): recortes com stride
+//  ou imagens planares, convoluídas plano a plano. A saída não pode ser a
+//  mesma memória da entrada. Visões de 16 bits (sampleBytes == 2) passam
+//  pelas mesmas passadas em float, só muda a conversão nas pontas; a saída
+//  satura em 65535 (PPMWriter::write16 limita ao maxValue do arquivo).
+//
+
+#ifndef Convolution_h
+#define Convolution_h
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "Image.h"
+#include "ThreadPool.h"
+
+enum BorderMode {
+    BORDER_CLAMP,   // aaa|abcd|ddd
+    BORDER_MIRROR   // cb|abcd|cb
+};
+
+// Kernel separável: horizontal e vertical com tamanho ímpar (2 * raio + 1).
+struct SeparableKernel {
+    std::vector<float> horizontal;
+    std::vector<float> vertical;
+
+    int radiusX() const { return (int)horizontal.size() / 2; }
+    int radiusY() const { return (int)vertical.size() / 2; }
+};
+
+// Kernel geral width x height (ímpares), em ordem de linhas.
+struct Kernel2D {
+    int width;
+    int height;
+    std::vector<float> taps;
+
+    int radiusX() const { return width / 2; }
+    int radiusY() const { return height / 2; }
+};
+
+// Gaussiana normalizada; radius = 0 usa ceil(3 * sigma).
+inline std::vector<float> gaussianTaps(double sigma, int radius = 0) {
+    if (sigma <= 0.0) sigma = 1e-3;
+    if (radius <= 0) radius = (int)ceil(3.0 * sigma);
+    std::vector<double> g(2 * radius + 1);
+    double sum = 0.0;
+    for (int i = -radius; i <= radius; i++) {
+        g[i + radius] = exp(-(double)i * i / (2.0 * sigma * sigma));
+        sum += g[i + radius];
+    }
+    std::vector<float> taps(g.size());
+    for (size_t i = 0; i < g.size(); i++) taps[i] = (float)(g[i] / sum);
+    return taps;
+}
+
+inline SeparableKernel makeGaussian(double sigma, int radius = 0) {
+    SeparableKernel k;
+    k.horizontal = gaussianTaps(sigma, radius);
+    k.vertical = k.horizontal;
+    return k;
+}
+
+inline SeparableKernel makeBox(int radius) {
+    SeparableKernel k;
+    k.horizontal.assign(2 * radius + 1, 1.0f / (2 * radius + 1));
+    k.vertical = k.horizontal;
+    return k;
+}
+
+// Índice de uma posição fora de [0, n) conforme a borda.
+inline int borderIndex(int i, int n, BorderMode mode) {
+    if (i >= 0 && i < n) return i;
+    if (mode == BORDER_CLAMP || n == 1) return i < 0 ? 0 : n - 1;
+    int period = 2 * (n - 1);
+    i %= period;
+    if (i < 0) i += period;
+    return i < n ? i : period - i;
+}
+
+typedef void (*LoadRowKernel)(const unsigned char *src, float *dst, size_t n);
+typedef void (*ConvolveRowKernel)(const float *src, float *dst, size_t n, const float *taps, int count,
+                                  ptrdiff_t step, bool accumulate);
+typedef void (*StoreRowKernel)(const float *src, unsigned char *dst, size_t n);
+typedef void (*UnsharpRowKernel)(const float *blur, const unsigned char *orig, unsigned char *dst, size_t n,
+                                 float amount);
+typedef void (*MagnitudeRowKernel)(const float *gx, const float *gy, unsigned char *dst, size_t n);
+typedef void (*LoadRow16Kernel)(const uint16_t *src, float *dst, size_t n);
+typedef void (*StoreRow16Kernel)(const float *src, uint16_t *dst, size_t n);
+typedef void (*UnsharpRow16Kernel)(const float *blur, const uint16_t *orig, uint16_t *dst, size_t n, float amount);
+typedef void (*MagnitudeRow16Kernel)(const float *gx, const float *gy, uint16_t *dst, size_t n);
+
+namespace conv_scalar {
+
+inline void loadRow(const unsigned char *src, float *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = (float)src[i];
+}
+
+inline void convolveRow(const float *src, float *dst, size_t n, const float *taps, int count, ptrdiff_t step,
+                        bool accumulate) {
+    for (size_t i = 0; i < n; i++) {
+        float acc = accumulate ? dst[i] : 0.0f;
+        for (int t = 0; t < count; t++) acc = acc + taps[t] * src[i + t * step];
+        dst[i] = acc;
+    }
+}
+
+inline unsigned char toByte(float v) {
+    v = v < 0.0f ? 0.0f : v;
+    v = v > 255.0f ? 255.0f : v;
+    return (unsigned char)(int)(v + 0.5f);
+}
+
+inline void storeRow(const float *src, unsigned char *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = toByte(src[i]);
+}
+
+inline void unsharpRow(const float *blur, const unsigned char *orig, unsigned char *dst, size_t n, float amount) {
+    for (size_t i = 0; i < n; i++) {
+        float o = (float)orig[i];
+        dst[i] = toByte(o + amount * (o - blur[i]));
+    }
+}
+
+inline void magnitudeRow(const float *gx, const float *gy, unsigned char *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = toByte(sqrtf(gx[i] * gx[i] + gy[i] * gy[i]));
+}
+
+/*-----------------------------16 BITS---------------------------------*/
+inline void loadRow16(const uint16_t *src, float *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = (float)src[i];
+}
+
+inline uint16_t toWord(float v) {
+    v = v < 0.0f ? 0.0f : v;
+    v = v > 65535.0f ? 65535.0f : v;
+    return (uint16_t)(int)(v + 0.5f);
+}
+
+inline void storeRow16(const float *src, uint16_t *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = toWord(src[i]);
+}
+
+inline void unsharpRow16(const float *blur, const uint16_t *orig, uint16_t *dst, size_t n, float amount) {
+    for (size_t i = 0; i < n; i++) {
+        float o = (float)orig[i];
+        dst[i] = toWord(o + amount * (o - blur[i]));
+    }
+}
+
+inline void magnitudeRow16(const float *gx, const float *gy, uint16_t *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = toWord(sqrtf(gx[i] * gx[i] + gy[i] * gy[i]));
+}
+
+} // namespace conv_scalar
+
+#ifdef M3_X86
+namespace conv_sse2 {
+
+M3_TARGET_SSE2 inline void loadRow(const unsigned char *src, float *dst, size_t n) {
+    const __m128i z = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(v, z), hi = _mm_unpackhi_epi8(v, z);
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, z)));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, z)));
+        _mm_storeu_ps(dst + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, z)));
+        _mm_storeu_ps(dst + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, z)));
+    }
+    conv_scalar::loadRow(src + i, dst + i, n - i);
+}
+
+M3_TARGET_SSE2 inline void convolveRow(const float *src, float *dst, size_t n, const float *taps, int count,
+                                       ptrdiff_t step, bool accumulate) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 a0 = accumulate ? _mm_loadu_ps(dst + i) : _mm_setzero_ps();
+        __m128 a1 = accumulate ? _mm_loadu_ps(dst + i + 4) : _mm_setzero_ps();
+        const float *s = src + i;
+        for (int t = 0; t < count; t++, s += step) {
+            __m128 k = _mm_set1_ps(taps[t]);
+            a0 = _mm_add_ps(a0, _mm_mul_ps(k, _mm_loadu_ps(s)));
+            a1 = _mm_add_ps(a1, _mm_mul_ps(k, _mm_loadu_ps(s + 4)));
+        }
+        _mm_storeu_ps(dst + i, a0);
+        _mm_storeu_ps(dst + i + 4, a1);
+    }
+    conv_scalar::convolveRow(src + i, dst + i, n - i, taps, count, step, accumulate);
+}
+
+M3_TARGET_SSE2 inline __m128i toBytes(__m128 a, __m128 b, __m128 c, __m128 d) {
+    const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+    __m128i ia = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(a, lo), hi), half));
+    __m128i ib = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(b, lo), hi), half));
+    __m128i ic = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(c, lo), hi), half));
+    __m128i id = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(d, lo), hi), half));
+    return _mm_packus_epi16(_mm_packs_epi32(ia, ib), _mm_packs_epi32(ic, id));
+}
+
+M3_TARGET_SSE2 inline void storeRow(const float *src, unsigned char *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = toBytes(_mm_loadu_ps(src + i), _mm_loadu_ps(src + i + 4),
+                            _mm_loadu_ps(src + i + 8), _mm_loadu_ps(src + i + 12));
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+    conv_scalar::storeRow(src + i, dst + i, n - i);
+}
+
+M3_TARGET_SSE2 inline void unsharpRow(const float *blur, const unsigned char *orig, unsigned char *dst, size_t n,
+                                      float amount) {
+    const __m128 k = _mm_set1_ps(amount);
+    float o[16];
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        loadRow(orig + i, o, 16);
+        __m128 r[4];
+        for (int j = 0; j < 4; j++) {
+            __m128 v = _mm_loadu_ps(o + 4 * j);
+            r[j] = _mm_add_ps(v, _mm_mul_ps(k, _mm_sub_ps(v, _mm_loadu_ps(blur + i + 4 * j))));
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), toBytes(r[0], r[1], r[2], r[3]));
+    }
+    conv_scalar::unsharpRow(blur + i, orig + i, dst + i, n - i, amount);
+}
+
+M3_TARGET_SSE2 inline void magnitudeRow(const float *gx, const float *gy, unsigned char *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128 r[4];
+        for (int j = 0; j < 4; j++) {
+            __m128 x = _mm_loadu_ps(gx + i + 4 * j), y = _mm_loadu_ps(gy + i + 4 * j);
+            r[j] = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), toBytes(r[0], r[1], r[2], r[3]));
+    }
+    conv_scalar::magnitudeRow(gx + i, gy + i, dst + i, n - i);
+}
+
+/*-----------------------------16 BITS---------------------------------*/
+M3_TARGET_SSE2 inline void loadRow16(const uint16_t *src, float *dst, size_t n) {
+    const __m128i z = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, z)));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, z)));
+    }
+    conv_scalar::loadRow16(src + i, dst + i, n - i);
+}
+
+// packus_epi32 é SSE4.1: desloca para a faixa com sinal, empacota com
+// saturação e desfaz o deslocamento.
+M3_TARGET_SSE2 inline __m128i toWords(__m128 a, __m128 b) {
+    const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(65535.0f), half = _mm_set1_ps(0.5f);
+    const __m128i bias = _mm_set1_epi32(32768);
+    __m128i ia = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(a, lo), hi), half));
+    __m128i ib = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(b, lo), hi), half));
+    __m128i w = _mm_packs_epi32(_mm_sub_epi32(ia, bias), _mm_sub_epi32(ib, bias));
+    return _mm_xor_si128(w, _mm_set1_epi16((short)0x8000));
+}
+
+M3_TARGET_SSE2 inline void storeRow16(const float *src, uint16_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128((__m128i *)(dst + i), toWords(_mm_loadu_ps(src + i), _mm_loadu_ps(src + i + 4)));
+    }
+    conv_scalar::storeRow16(src + i, dst + i, n - i);
+}
+
+M3_TARGET_SSE2 inline void unsharpRow16(const float *blur, const uint16_t *orig, uint16_t *dst, size_t n,
+                                        float amount) {
+    const __m128 k = _mm_set1_ps(amount);
+    float o[8];
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        loadRow16(orig + i, o, 8);
+        __m128 r[2];
+        for (int j = 0; j < 2; j++) {
+            __m128 v = _mm_loadu_ps(o + 4 * j);
+            r[j] = _mm_add_ps(v, _mm_mul_ps(k, _mm_sub_ps(v, _mm_loadu_ps(blur + i + 4 * j))));
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), toWords(r[0], r[1]));
+    }
+    conv_scalar::unsharpRow16(blur + i, orig + i, dst + i, n - i, amount);
+}
+
+M3_TARGET_SSE2 inline void magnitudeRow16(const float *gx, const float *gy, uint16_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 r[2];
+        for (int j = 0; j < 2; j++) {
+            __m128 x = _mm_loadu_ps(gx + i + 4 * j), y = _mm_loadu_ps(gy + i + 4 * j);
+            r[j] = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), toWords(r[0], r[1]));
+    }
+    conv_scalar::magnitudeRow16(gx + i, gy + i, dst + i, n - i);
+}
+
+} // namespace conv_sse2
+
+namespace conv_avx2 {
+
+M3_TARGET_AVX2 inline void loadRow(const unsigned char *src, float *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)));
+        _mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8))));
+    }
+    conv_scalar::loadRow(src + i, dst + i, n - i);
+}
+
+// Quatro acumuladores de 8 floats por iteração; mul e add separados (sem
+// FMA) para arredondar igual à versão escalar.
+M3_TARGET_AVX2 inline void convolveRow(const float *src, float *dst, size_t n, const float *taps, int count,
+                                       ptrdiff_t step, bool accumulate) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256 a0, a1, a2, a3;
+        if (accumulate) {
+            a0 = _mm256_loadu_ps(dst + i);
+            a1 = _mm256_loadu_ps(dst + i + 8);
+            a2 = _mm256_loadu_ps(dst + i + 16);
+            a3 = _mm256_loadu_ps(dst + i + 24);
+        } else {
+            a0 = a1 = a2 = a3 = _mm256_setzero_ps();
+        }
+        const float *s = src + i;
+        for (int t = 0; t < count; t++, s += step) {
+            __m256 k = _mm256_broadcast_ss(taps + t);
+            a0 = _mm256_add_ps(a0, _mm256_mul_ps(k, _mm256_loadu_ps(s)));
+            a1 = _mm256_add_ps(a1, _mm256_mul_ps(k, _mm256_loadu_ps(s + 8)));
+            a2 = _mm256_add_ps(a2, _mm256_mul_ps(k, _mm256_loadu_ps(s + 16)));
+            a3 = _mm256_add_ps(a3, _mm256_mul_ps(k, _mm256_loadu_ps(s + 24)));
+        }
+        _mm256_storeu_ps(dst + i, a0);
+        _mm256_storeu_ps(dst + i + 8, a1);
+        _mm256_storeu_ps(dst + i + 16, a2);
+        _mm256_storeu_ps(dst + i + 24, a3);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256 a = accumulate ? _mm256_loadu_ps(dst + i) : _mm256_setzero_ps();
+        const float *s = src + i;
+        for (int t = 0; t < count; t++, s += step) {
+            a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_broadcast_ss(taps + t), _mm256_loadu_ps(s)));
+        }
+        _mm256_storeu_ps(dst + i, a);
+    }
+    conv_scalar::convolveRow(src + i, dst + i, n - i, taps, count, step, accumulate);
+}
+
+M3_TARGET_AVX2 inline __m128i toBytes(__m256 a, __m256 b) {
+    const __m256 lo = _mm256_setzero_ps(), hi = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+    __m256i ia = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_min_ps(_mm256_max_ps(a, lo), hi), half));
+    __m256i ib = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_min_ps(_mm256_max_ps(b, lo), hi), half));
+    // packs por lane: [a0..3 b0..3 | a4..7 b4..7] -> reordena as metades
+    __m256i w = _mm256_permute4x64_epi64(_mm256_packs_epi32(ia, ib), 0xd8);
+    return _mm_packus_epi16(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+}
+
+M3_TARGET_AVX2 inline void storeRow(const float *src, unsigned char *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm_storeu_si128((__m128i *)(dst + i), toBytes(_mm256_loadu_ps(src + i), _mm256_loadu_ps(src + i + 8)));
+    }
+    conv_scalar::storeRow(src + i, dst + i, n - i);
+}
+
+M3_TARGET_AVX2 inline void unsharpRow(const float *blur, const unsigned char *orig, unsigned char *dst, size_t n,
+                                      float amount) {
+    const __m256 k = _mm256_set1_ps(amount);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(orig + i));
+        __m256 o0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+        __m256 o1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+        __m256 r0 = _mm256_add_ps(o0, _mm256_mul_ps(k, _mm256_sub_ps(o0, _mm256_loadu_ps(blur + i))));
+        __m256 r1 = _mm256_add_ps(o1, _mm256_mul_ps(k, _mm256_sub_ps(o1, _mm256_loadu_ps(blur + i + 8))));
+        _mm_storeu_si128((__m128i *)(dst + i), toBytes(r0, r1));
+    }
+    conv_scalar::unsharpRow(blur + i, orig + i, dst + i, n - i, amount);
+}
+
+M3_TARGET_AVX2 inline void magnitudeRow(const float *gx, const float *gy, unsigned char *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 x0 = _mm256_loadu_ps(gx + i), y0 = _mm256_loadu_ps(gy + i);
+        __m256 x1 = _mm256_loadu_ps(gx + i + 8), y1 = _mm256_loadu_ps(gy + i + 8);
+        __m256 m0 = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x0, x0), _mm256_mul_ps(y0, y0)));
+        __m256 m1 = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x1, x1), _mm256_mul_ps(y1, y1)));
+        _mm_storeu_si128((__m128i *)(dst + i), toBytes(m0, m1));
+    }
+    conv_scalar::magnitudeRow(gx + i, gy + i, dst + i, n - i);
+}
+
+/*-----------------------------16 BITS---------------------------------*/
+M3_TARGET_AVX2 inline void loadRow16(const uint16_t *src, float *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 8));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(a)));
+        _mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(b)));
+    }
+    conv_scalar::loadRow16(src + i, dst + i, n - i);
+}
+
+M3_TARGET_AVX2 inline __m256i toWords(__m256 a, __m256 b) {
+    const __m256 lo = _mm256_setzero_ps(), hi = _mm256_set1_ps(65535.0f), half = _mm256_set1_ps(0.5f);
+    __m256i ia = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_min_ps(_mm256_max_ps(a, lo), hi), half));
+    __m256i ib = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_min_ps(_mm256_max_ps(b, lo), hi), half));
+    return _mm256_permute4x64_epi64(_mm256_packus_epi32(ia, ib), 0xd8);
+}
+
+M3_TARGET_AVX2 inline void storeRow16(const float *src, uint16_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm256_storeu_si256((__m256i *)(dst + i), toWords(_mm256_loadu_ps(src + i), _mm256_loadu_ps(src + i + 8)));
+    }
+    conv_scalar::storeRow16(src + i, dst + i, n - i);
+}
+
+M3_TARGET_AVX2 inline void unsharpRow16(const float *blur, const uint16_t *orig, uint16_t *dst, size_t n,
+                                        float amount) {
+    const __m256 k = _mm256_set1_ps(amount);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 o0 = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(orig + i))));
+        __m256 o1 = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(orig + i + 8))));
+        __m256 r0 = _mm256_add_ps(o0, _mm256_mul_ps(k, _mm256_sub_ps(o0, _mm256_loadu_ps(blur + i))));
+        __m256 r1 = _mm256_add_ps(o1, _mm256_mul_ps(k, _mm256_sub_ps(o1, _mm256_loadu_ps(blur + i + 8))));
+        _mm256_storeu_si256((__m256i *)(dst + i), toWords(r0, r1));
+    }
+    conv_scalar::unsharpRow16(blur + i, orig + i, dst + i, n - i, amount);
+}
+
+M3_TARGET_AVX2 inline void magnitudeRow16(const float *gx, const float *gy, uint16_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 x0 = _mm256_loadu_ps(gx + i), y0 = _mm256_loadu_ps(gy + i);
+        __m256 x1 = _mm256_loadu_ps(gx + i + 8), y1 = _mm256_loadu_ps(gy + i + 8);
+        __m256 m0 = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x0, x0), _mm256_mul_ps(y0, y0)));
+        __m256 m1 = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x1, x1), _mm256_mul_ps(y1, y1)));
+        _mm256_storeu_si256((__m256i *)(dst + i), toWords(m0, m1));
+    }
+    conv_scalar::magnitudeRow16(gx + i, gy + i, dst + i, n - i);
+}
+
+} // namespace conv_avx2
+#endif
+
+struct ConvolutionKernels {
+    SimdLevel level;
+    LoadRowKernel loadRow;
+    ConvolveRowKernel convolveRow;
+    StoreRowKernel storeRow;
+    UnsharpRowKernel unsharpRow;
+    MagnitudeRowKernel magnitudeRow;
+    LoadRow16Kernel loadRow16;
+    StoreRow16Kernel storeRow16;
+    UnsharpRow16Kernel unsharpRow16;
+    MagnitudeRow16Kernel magnitudeRow16;
+};
+
+inline const ConvolutionKernels &convolutionKernels(SimdLevel level) {
+    static const ConvolutionKernels table[] = {
+        { SIMD_SCALAR, conv_scalar::loadRow, conv_scalar::convolveRow, conv_scalar::storeRow,
+          conv_scalar::unsharpRow, conv_scalar::magnitudeRow, conv_scalar::loadRow16, conv_scalar::storeRow16,
+          conv_scalar::unsharpRow16, conv_scalar::magnitudeRow16 },
+#ifdef M3_X86
+        { SIMD_SSE2, conv_sse2::loadRow, conv_sse2::convolveRow, conv_sse2::storeRow,
+          conv_sse2::unsharpRow, conv_sse2::magnitudeRow, conv_sse2::loadRow16, conv_sse2::storeRow16,
+          conv_sse2::unsharpRow16, conv_sse2::magnitudeRow16 },
+        { SIMD_AVX2, conv_avx2::loadRow, conv_avx2::convolveRow, conv_avx2::storeRow,
+          conv_avx2::unsharpRow, conv_avx2::magnitudeRow, conv_avx2::loadRow16, conv_avx2::storeRow16,
+          conv_avx2::unsharpRow16, conv_avx2::magnitudeRow16 },
+#endif
+    };
+    if (level > cpuSimdLevel()) level = cpuSimdLevel();
+    return table[level];
+}
+
+inline const ConvolutionKernels &convolutionKernels() {
+    static const ConvolutionKernels &kernels = convolutionKernels(simdLevel());
+    return kernels;
+}
+
+class Convolver {
+    ThreadPool *pool;
+    size_t tileBytes;
+    const ConvolutionKernels *k;
+
+    // Região de saída de um bloco.
+    struct Tile {
+        int x0, y0, w, h;
+    };
+
+public:
+    static const size_t DEFAULT_TILE_BYTES = 256 * 1024;
+    static const int TILE_WIDTH = 256;
+
+    explicit Convolver(ThreadPool &pool = ThreadPool::shared(), const ConvolutionKernels &kernels = convolutionKernels(),
+                       size_t tileBytes = DEFAULT_TILE_BYTES)
+        : pool(&pool), tileBytes(tileBytes), k(&kernels) {}
+
+    // dst = src * kernel (primeiro horizontal, depois vertical).
+    void separable(const unsigned char *src, unsigned char *dst, int w, int h, int channels,
+                   const SeparableKernel &kernel, BorderMode border = BORDER_CLAMP) const {
+        separable(ImageView(src, w, h, channels), ImageView(dst, w, h, channels), kernel, border);
+    }
+
+    // dst = src * kernel, kernel 2D qualquer.
+    void general(const unsigned char *src, unsigned char *dst, int w, int h, int channels,
+                 const Kernel2D &kernel, BorderMode border = BORDER_CLAMP) const {
+        general(ImageView(src, w, h, channels), ImageView(dst, w, h, channels), kernel, border);
+    }
+
+    void gaussianBlur(const unsigned char *src, unsigned char *dst, int w, int h, int channels, double sigma,
+                      BorderMode border = BORDER_MIRROR) const {
+        separable(src, dst, w, h, channels, makeGaussian(sigma), border);
+    }
+
+    // dst = src + amount * (src - blur(src)), fundido na passada vertical.
+    void unsharpMask(const unsigned char *src, unsigned char *dst, int w, int h, int channels, double sigma,
+                     float amount, BorderMode border = BORDER_MIRROR) const {
+        unsharpMask(ImageView(src, w, h, channels), ImageView(dst, w, h, channels), sigma, amount, border);
+    }
+
+    // Magnitude do gradiente de Sobel por canal: sqrt(gx^2 + gy^2).
+    void sobel(const unsigned char *src, unsigned char *dst, int w, int h, int channels,
+               BorderMode border = BORDER_MIRROR) const {
+        sobel(ImageView(src, w, h, channels), ImageView(dst, w, h, channels), border);
+    }
+
+    /*---------------VISÕES: mesmo tamanho e arranjo em src e dst---------------*/
+    void separable(const ImageView &src, const ImageView &dst, const SeparableKernel &kernel,
+                   BorderMode border = BORDER_CLAMP) const {
+        if (src.isPlanar()) {
+            for (int c = 0; c < src.channels; c++) separable(src.plane(c), dst.plane(c), kernel, border);
+            return;
+        }
+        const SeparableKernel *kernels[1] = { &kernel };
+        forEachTile(src, kernel.radiusY(), 1, [&](const Tile &t, std::vector<float> &scratch) {
+            float *rows[1];
+            separableTile(src, kernels, 1, border, t, scratch, rows);
+            size_t n = (size_t)t.w * src.channels;
+            for (int y = 0; y < t.h; y++) storeRow(rows[0] + y * n, dst, t.x0, t.y0 + y, n);
+        });
+    }
+
+    void general(const ImageView &src, const ImageView &dst, const Kernel2D &kernel,
+                 BorderMode border = BORDER_CLAMP) const {
+        if (src.isPlanar()) {
+            for (int c = 0; c < src.channels; c++) general(src.plane(c), dst.plane(c), kernel, border);
+            return;
+        }
+        const int channels = src.channels;
+        int rx = kernel.radiusX(), ry = kernel.radiusY();
+        forEachTile(src, ry, 0, [&](const Tile &t, std::vector<float> &scratch) {
+            size_t n = (size_t)t.w * channels;
+            size_t padded = (size_t)(t.w + 2 * rx) * channels;
+            int rows = t.h + 2 * ry;
+            scratch.resize(padded * rows + n);
+            float *in = scratch.data();
+            float *out = in + padded * rows;
+            for (int r = 0; r < rows; r++) {
+                loadPadded(src, t.x0, t.w, rx, t.y0 - ry + r, border, in + r * padded);
+            }
+            for (int y = 0; y < t.h; y++) {
+                for (int ky = 0; ky < kernel.height; ky++) {
+                    k->convolveRow(in + (y + ky) * padded, out, n, &kernel.taps[(size_t)ky * kernel.width],
+                                   kernel.width, channels, ky > 0);
+                }
+                storeRow(out, dst, t.x0, t.y0 + y, n);
+            }
+        });
+    }
+
+    void gaussianBlur(const ImageView &src, const ImageView &dst, double sigma,
+                      BorderMode border = BORDER_MIRROR) const {
+        separable(src, dst, makeGaussian(sigma), border);
+    }
+
+    void unsharpMask(const ImageView &src, const ImageView &dst, double sigma, float amount,
+                     BorderMode border = BORDER_MIRROR) const {
+        if (src.isPlanar()) {
+            for (int c = 0; c < src.channels; c++) unsharpMask(src.plane(c), dst.plane(c), sigma, amount, border);
+            return;
+        }
+        SeparableKernel kernel = makeGaussian(sigma);
+        const SeparableKernel *kernels[1] = { &kernel };
+        forEachTile(src, kernel.radiusY(), 1, [&](const Tile &t, std::vector<float> &scratch) {
+            float *rows[1];
+            separableTile(src, kernels, 1, border, t, scratch, rows);
+            size_t n = (size_t)t.w * src.channels;
+            for (int y = 0; y < t.h; y++) {
+                const unsigned char *orig = src.pixel(t.x0, t.y0 + y);
+                unsigned char *out = dst.pixel(t.x0, t.y0 + y);
+                if (src.sampleBytes == 2) {
+                    k->unsharpRow16(rows[0] + y * n, (const uint16_t *)orig, (uint16_t *)out, n, amount);
+                } else {
+                    k->unsharpRow(rows[0] + y * n, orig, out, n, amount);
+                }
+            }
+        });
+    }
+
+    void sobel(const ImageView &src, const ImageView &dst, BorderMode border = BORDER_MIRROR) const {
+        if (src.isPlanar()) {
+            for (int c = 0; c < src.channels; c++) sobel(src.plane(c), dst.plane(c), border);
+            return;
+        }
+        SeparableKernel gx, gy;
+        gx.horizontal = { -1.0f, 0.0f, 1.0f };
+        gx.vertical = { 1.0f, 2.0f, 1.0f };
+        gy.horizontal = gx.vertical;
+        gy.vertical = gx.horizontal;
+        const SeparableKernel *kernels[2] = { &gx, &gy };
+        forEachTile(src, 1, 2, [&](const Tile &t, std::vector<float> &scratch) {
+            float *rows[2];
+            separableTile(src, kernels, 2, border, t, scratch, rows);
+            size_t n = (size_t)t.w * src.channels;
+            for (int y = 0; y < t.h; y++) {
+                unsigned char *out = dst.pixel(t.x0, t.y0 + y);
+                if (dst.sampleBytes == 2) {
+                    k->magnitudeRow16(rows[0] + y * n, rows[1] + y * n, (uint16_t *)out, n);
+                } else {
+                    k->magnitudeRow(rows[0] + y * n, rows[1] + y * n, out, n);
+                }
+            }
+        });
+    }
+
+private:
+    // Divide a saída em blocos de TILE_WIDTH colunas e altura tal que as
+    // linhas intermediárias (altura + 2 * ry, de outputs kernels) caibam em
+    // tileBytes, e roda tile(bloco, scratch) em paralelo.
+    template <class TileFn>
+    void forEachTile(const ImageView &src, int ry, int outputs, TileFn tile) const {
+        const int w = src.width, h = src.height, channels = src.channels;
+        if (w <= 0 || h <= 0) return;
+        int tw = w < TILE_WIDTH ? w : TILE_WIDTH;
+        size_t rowBytes = (size_t)tw * channels * sizeof(float) * (outputs + 1);
+        int th = (int)(tileBytes / rowBytes) - 2 * ry;
+        // com raios grandes, blocos baixos refariam a passada horizontal
+        // das 2 * ry linhas extras muitas vezes
+        if (th < 2 * ry) th = 2 * ry;
+        if (th < 16) th = 16;
+        if (th > h) th = h;
+        int cols = (w + tw - 1) / tw;
+        int rows = (h + th - 1) / th;
+        pool->parallelFor((size_t)cols * rows, [&](size_t i) {
+            static thread_local std::vector<float> scratch;
+            Tile t;
+            t.x0 = (int)(i % cols) * tw;
+            t.y0 = (int)(i / cols) * th;
+            t.w = t.x0 + tw <= w ? tw : w - t.x0;
+            t.h = t.y0 + th <= h ? th : h - t.y0;
+            tile(t, scratch);
+        });
+    }
+
+    // Linha y da imagem (com borda) convertida para float, colunas
+    // [x0 - rx, x0 + tw + rx).
+    void loadPadded(const ImageView &src, int x0, int tw, int rx, int y, BorderMode border, float *out) const {
+        const int w = src.width, channels = src.channels;
+        const size_t pixelBytes = src.pixelBytes();
+        const unsigned char *row = src.row(borderIndex(y, src.height, border));
+        int first = x0 - rx, last = x0 + tw + rx;  // [first, last)
+        int inFirst = first < 0 ? 0 : first;
+        int inLast = last > w ? w : last;
+        for (int x = first; x < inFirst; x++, out += channels) {
+            loadRow(src, row + (size_t)borderIndex(x, w, border) * pixelBytes, out, channels);
+        }
+        size_t n = (size_t)(inLast - inFirst) * channels;
+        loadRow(src, row + (size_t)inFirst * pixelBytes, out, n);
+        out += n;
+        for (int x = inLast; x < last; x++, out += channels) {
+            loadRow(src, row + (size_t)borderIndex(x, w, border) * pixelBytes, out, channels);
+        }
+    }
+
+    // n amostras de p (8 ou 16 bits, conforme a visão) para float.
+    void loadRow(const ImageView &src, const unsigned char *p, float *out, size_t n) const {
+        if (src.sampleBytes == 2) {
+            k->loadRow16((const uint16_t *)p, out, n);
+        } else {
+            k->loadRow(p, out, n);
+        }
+    }
+
+    // n floats para a linha y da saída, a partir da coluna x.
+    void storeRow(const float *src, const ImageView &dst, int x, int y, size_t n) const {
+        unsigned char *p = dst.pixel(x, y);
+        if (dst.sampleBytes == 2) {
+            k->storeRow16(src, (uint16_t *)p, n);
+        } else {
+            k->storeRow(src, p, n);
+        }
+    }
+
+    // Passadas horizontal e vertical de count kernels separáveis sobre um
+    // bloco; rows[i] recebe t.h linhas de t.w * channels floats do kernel i.
+    void separableTile(const ImageView &src, const SeparableKernel *const *kernels, int count, BorderMode border,
+                       const Tile &t, std::vector<float> &scratch, float **rows) const {
+        const int channels = src.channels;
+        int rx = 0, ry = 0;
+        for (int i = 0; i < count; i++) {
+            if (kernels[i]->radiusX() > rx) rx = kernels[i]->radiusX();
+            if (kernels[i]->radiusY() > ry) ry = kernels[i]->radiusY();
+        }
+        size_t n = (size_t)t.w * channels;
+        size_t padded = (size_t)(t.w + 2 * rx) * channels;
+        int lines = t.h + 2 * ry;
+        scratch.resize(padded + count * (n * lines + n * t.h));
+        float *line = scratch.data();
+        float *inter = line + padded;
+        float *out = inter + count * n * lines;
+
+        for (int r = 0; r < lines; r++) {
+            loadPadded(src, t.x0, t.w, rx, t.y0 - ry + r, border, line);
+            for (int i = 0; i < count; i++) {
+                const SeparableKernel &kr = *kernels[i];
+                int skip = (rx - kr.radiusX()) * channels;
+                k->convolveRow(line + skip, inter + (i * lines + r) * n, n, kr.horizontal.data(),
+                               (int)kr.horizontal.size(), channels, false);
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            const SeparableKernel &kr = *kernels[i];
+            const float *first = inter + (i * lines + ry - kr.radiusY()) * n;
+            rows[i] = out + i * n * t.h;
+            for (int y = 0; y < t.h; y++) {
+                k->convolveRow(first + y * n, rows[i] + y * n, n, kr.vertical.data(), (int)kr.vertical.size(),
+                               (ptrdiff_t)n, false);
+            }
+        }
+    }
+};
+
+#endif /* Convolution_h */
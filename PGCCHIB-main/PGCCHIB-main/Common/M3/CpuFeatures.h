@@ -0,0 +1,110 @@
+//
+//  CpuFeatures.h
+//  Detecção (CPUID) do conjunto de instruções SIMD disponível, usada para
+//  escolher em tempo de execução entre os kernels escalares, SSE2 e AVX2.
+//
+
+#ifndef CpuFeatures_h
+#define CpuFeatures_h
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define M3_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(M3_X86) && (defined(__GNUC__) || defined(__clang__))
+#define M3_TARGET_SSE2 __attribute__((target("sse2")))
+#define M3_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define M3_TARGET_SSE2
+#define M3_TARGET_AVX2
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE2 = 1,
+    SIMD_AVX2 = 2
+};
+
+inline const char *simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX2: return "avx2";
+        case SIMD_SSE2: return "sse2";
+        default:        return "scalar";
+    }
+}
+
+#ifdef M3_X86
+inline void cpuid(int leaf, int sub, unsigned int regs[4]) {
+#ifdef _MSC_VER
+    __cpuidex((int *)regs, leaf, sub);
+#else
+    __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Estado dos registradores salvo pelo sistema operacional (XCR0).
+inline unsigned long long xgetbv0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+#endif
+
+inline SimdLevel detectSimdLevel() {
+#ifdef M3_X86
+    unsigned int r[4];
+    cpuid(0, 0, r);
+    unsigned int maxLeaf = r[0];
+    cpuid(1, 0, r);
+    bool sse2 = (r[3] >> 26) & 1;
+    bool osxsave = (r[2] >> 27) & 1;
+    bool avx = (r[2] >> 28) & 1;
+    bool avx2 = false;
+    // AVX2 exige também que o SO salve os registradores YMM
+    if (maxLeaf >= 7 && osxsave && avx && (xgetbv0() & 6) == 6) {
+        cpuid(7, 0, r);
+        avx2 = (r[1] >> 5) & 1;
+    }
+    if (avx2) return SIMD_AVX2;
+    if (sse2) return SIMD_SSE2;
+#endif
+    return SIMD_SCALAR;
+}
+
+// Nível suportado pela CPU, detectado uma única vez.
+inline SimdLevel cpuSimdLevel() {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+// Nível usado pelos filtros. A variável de ambiente M3_SIMD (scalar, sse2,
+// avx2) permite limitar o nível, por exemplo para comparar resultados.
+inline SimdLevel simdLevel() {
+    static const SimdLevel level = [] {
+        SimdLevel best = cpuSimdLevel();
+        const char *env = getenv("M3_SIMD");
+        if (env) {
+            SimdLevel wanted = SIMD_SCALAR;
+            if (strcmp(env, "avx2") == 0) wanted = SIMD_AVX2;
+            else if (strcmp(env, "sse2") == 0) wanted = SIMD_SSE2;
+            if (wanted < best) best = wanted;
+        }
+        return best;
+    }();
+    return level;
+}
+
+#endif /* CpuFeatures_h */
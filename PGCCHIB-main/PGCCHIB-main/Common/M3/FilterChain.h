@@ -0,0 +1,272 @@
+//
+//  FilterChain.h
+//  Encadeamento de filtros pontuais em uma única passada pela imagem.
+//
+//  Em vez de cada filtro percorrer a imagem inteira, a cadeia aplica todos
+//  os filtros a um bloco pequeno (TILE_PIXELS, cabe na L1) antes de seguir
+//  para o próximo: cada pixel é lido e gravado na memória uma só vez e os
+//  passos intermediários ficam na cache. compile() ainda simplifica a
+//  cadeia (negativos em par se anulam, tons de cinza repetido não muda
+//  nada).
+//
+//  apply16 roda a mesma cadeia sobre amostras de 16 bits (Filters16.h), com
+//  os parâmetros convertidos para a escala de maxValue; colorize seguidos
+//  viram um só já nessa escala. Operações CUSTOM só existem em 8 bits.
+//
+
+#ifndef FilterChain_h
+#define FilterChain_h
+
+#include <functional>
+#include <vector>
+
+#include "FilterExecutor.h"
+#include "Filters16.h"
+
+struct FilterOp {
+    enum Type { CHROMA_KEY, GRAY_SCALE, COLORIZE, NEGATIVE, CUSTOM };
+
+    Type type;
+    ChromaKeyParams key;
+    GrayScaleParams gray;
+    ColorizeParams color;
+    // CUSTOM: custom(rgb, pixels) sobre pixels RGB intercalados
+    std::function<void(unsigned char *, size_t)> custom;
+};
+
+class FilterChain {
+    std::vector<FilterOp> ops;
+
+public:
+    static const size_t TILE_PIXELS = 2048;
+
+    FilterChain &chromaKey(const ChromaKeyParams &p) {
+        FilterOp op = make(FilterOp::CHROMA_KEY);
+        op.key = p;
+        ops.push_back(op);
+        return *this;
+    }
+
+    FilterChain &grayScale(const GrayScaleParams &p) {
+        FilterOp op = make(FilterOp::GRAY_SCALE);
+        op.gray = p;
+        ops.push_back(op);
+        return *this;
+    }
+
+    FilterChain &colorize(const ColorizeParams &p) {
+        FilterOp op = make(FilterOp::COLORIZE);
+        op.color = p;
+        ops.push_back(op);
+        return *this;
+    }
+
+    FilterChain &negative() {
+        ops.push_back(make(FilterOp::NEGATIVE));
+        return *this;
+    }
+
+    // Qualquer operação pontual sobre um bloco de pixels RGB.
+    FilterChain &custom(const std::function<void(unsigned char *, size_t)> &fn) {
+        FilterOp op = make(FilterOp::CUSTOM);
+        op.custom = fn;
+        ops.push_back(op);
+        return *this;
+    }
+
+    size_t size() const {
+        return ops.size();
+    }
+
+    bool empty() const {
+        return ops.empty();
+    }
+
+    const std::vector<FilterOp> &operations() const {
+        return ops;
+    }
+
+    // Se apply16 aceita a cadeia (operações CUSTOM só existem em 8 bits).
+    bool supports16() const {
+        for (size_t j = 0; j < ops.size(); j++) {
+            if (ops[j].type == FilterOp::CUSTOM) return false;
+        }
+        return true;
+    }
+
+    // Remove passos redundantes sem alterar o resultado.
+    FilterChain &compile() {
+        std::vector<FilterOp> out;
+        for (size_t i = 0; i < ops.size(); i++) {
+            const FilterOp &op = ops[i];
+            if (!out.empty()) {
+                FilterOp &last = out.back();
+                if (op.type == FilterOp::NEGATIVE && last.type == FilterOp::NEGATIVE) {
+                    out.pop_back();
+                    continue;
+                }
+                // cinza de (y, y, y) é y quando os pesos garantem isso (em 16
+                // bits eles são reescalados para somar 32768): a segunda
+                // passada não muda nada
+                if (op.type == FilterOp::GRAY_SCALE && last.type == FilterOp::GRAY_SCALE &&
+                    grayScaleIdempotent(op.gray)) {
+                    continue;
+                }
+            }
+            out.push_back(op);
+        }
+        ops.swap(out);
+        return *this;
+    }
+
+    // Aplica toda a cadeia, bloco a bloco, em pixels RGB contíguos.
+    void apply(unsigned char *rgb, size_t pixels, const FilterKernels &k = filterKernels()) const {
+        for (size_t i = 0; i < pixels; i += TILE_PIXELS) {
+            size_t n = pixels - i < TILE_PIXELS ? pixels - i : TILE_PIXELS;
+            unsigned char *tile = rgb + i * 3;
+            for (size_t j = 0; j < ops.size(); j++) {
+                applyOp(ops[j], tile, n, k);
+            }
+        }
+    }
+
+    // Versão paralela: cada faixa do executor passa pela cadeia fundida.
+    void apply(unsigned char *rgb, int w, int h, const FilterExecutor &ex = FilterExecutor(),
+               const FilterKernels &k = filterKernels()) const {
+        ex.forEachBand(rgb, w, h, 3, [&](unsigned char *first, int, int rows) {
+            apply(first, (size_t)w * rows, k);
+        });
+    }
+
+    // Cadeia sobre uma visão RGB intercalada (um recorte, ou linhas com
+    // stride): as linhas de cada faixa são filtradas onde estão.
+    bool apply(const ImageView &view, const FilterExecutor &ex = FilterExecutor(),
+               const FilterKernels &k = filterKernels()) const {
+        if (view.isPlanar() || view.channels != 3) {
+            std::cerr << "FilterChain: os filtros exigem RGB intercalado" << std::endl;
+            return false;
+        }
+        if (view.sampleBytes != 1) {
+            std::cerr << "FilterChain: use apply16 para imagens de 16 bits" << std::endl;
+            return false;
+        }
+        ex.forEachBand(view, [&](const ImageView &band, int) {
+            if (band.contiguous()) {
+                apply(band.data, (size_t)band.width * band.height, k);
+                return;
+            }
+            for (int y = 0; y < band.height; y++) apply(band.row(y), (size_t)band.width, k);
+        });
+        return true;
+    }
+
+    // A cadeia sobre pixels RGB de 16 bits contíguos, com valores até
+    // maxValue. O bloco tem metade dos pixels para ocupar a mesma cache.
+    bool apply16(uint16_t *rgb, size_t pixels, int maxValue, const FilterKernels16 &k = filterKernels16()) const {
+        std::vector<Op16> ops16;
+        if (!prepare16(maxValue, ops16)) return false;
+        applyOps16(ops16, rgb, pixels, k);
+        return true;
+    }
+
+    // Versão paralela de apply16.
+    bool apply16(uint16_t *rgb, int w, int h, int maxValue, const FilterExecutor &ex = FilterExecutor(),
+                 const FilterKernels16 &k = filterKernels16()) const {
+        std::vector<Op16> ops16;
+        if (!prepare16(maxValue, ops16)) return false;
+        // faixas em bytes: 6 por pixel
+        ex.forEachBand((unsigned char *)rgb, w, h, 6, [&](unsigned char *first, int, int rows) {
+            applyOps16(ops16, (uint16_t *)first, (size_t)w * rows, k);
+        });
+        return true;
+    }
+
+    // Referência sem fusão: uma passada completa pela imagem por filtro.
+    void applyUnfused(unsigned char *rgb, int w, int h, const FilterExecutor &ex = FilterExecutor(),
+                      const FilterKernels &k = filterKernels()) const {
+        for (size_t j = 0; j < ops.size(); j++) {
+            const FilterOp &op = ops[j];
+            ex.forEachBand(rgb, w, h, 3, [&](unsigned char *first, int, int rows) {
+                applyOp(op, first, (size_t)w * rows, k);
+            });
+        }
+    }
+
+private:
+    // Uma operação com os parâmetros já na escala de 16 bits.
+    struct Op16 {
+        FilterOp::Type type;
+        ChromaKey16Params key;
+        GrayScale16Params gray;
+        Colorize16Params color;
+    };
+
+    bool prepare16(int maxValue, std::vector<Op16> &out) const {
+        if (maxValue <= 0 || maxValue > 65535) {
+            std::cerr << "FilterChain: maxValue inválido: " << maxValue << std::endl;
+            return false;
+        }
+        for (size_t j = 0; j < ops.size(); j++) {
+            const FilterOp &op = ops[j];
+            if (op.type == FilterOp::CUSTOM) {
+                std::cerr << "FilterChain: operações personalizadas não aceitam 16 bits" << std::endl;
+                return false;
+            }
+            // colorize seguidos: o OU dos valores já reescalados dá o mesmo
+            // que as duas passadas (reescalar o OU dos valores de 8 bits não)
+            if (op.type == FilterOp::COLORIZE && !out.empty() && out.back().type == FilterOp::COLORIZE) {
+                Colorize16Params c = makeColorize16(op.color, maxValue);
+                out.back().color.r |= c.r;
+                out.back().color.g |= c.g;
+                out.back().color.b |= c.b;
+                continue;
+            }
+            Op16 o;
+            o.type = op.type;
+            o.key = makeChromaKey16(op.key, maxValue);
+            o.gray = makeGrayScale16(op.gray, maxValue);
+            o.color = makeColorize16(op.color, maxValue);
+            out.push_back(o);
+        }
+        return true;
+    }
+
+    static void applyOps16(const std::vector<Op16> &ops16, uint16_t *rgb, size_t pixels, const FilterKernels16 &k) {
+        const size_t tile = TILE_PIXELS / 2;
+        for (size_t i = 0; i < pixels; i += tile) {
+            size_t n = pixels - i < tile ? pixels - i : tile;
+            uint16_t *first = rgb + i * 3;
+            for (size_t j = 0; j < ops16.size(); j++) {
+                const Op16 &op = ops16[j];
+                switch (op.type) {
+                    case FilterOp::CHROMA_KEY: k.chromaKey(first, n, op.key); break;
+                    case FilterOp::GRAY_SCALE: k.grayScale(first, n, op.gray); break;
+                    case FilterOp::COLORIZE:   k.colorize(first, n, op.color); break;
+                    case FilterOp::NEGATIVE:   k.negative(first, n, op.color.maxValue); break;
+                    case FilterOp::CUSTOM:     break;
+                }
+            }
+        }
+    }
+
+    static FilterOp make(FilterOp::Type type) {
+        FilterOp op;
+        op.type = type;
+        op.key = makeChromaKey(0, 0, 0, 0.0);
+        op.gray = makeGrayScale(false);
+        op.color = makeColorize(0, 0, 0);
+        return op;
+    }
+
+    static void applyOp(const FilterOp &op, unsigned char *rgb, size_t n, const FilterKernels &k) {
+        switch (op.type) {
+            case FilterOp::CHROMA_KEY: k.chromaKey(rgb, n, op.key); break;
+            case FilterOp::GRAY_SCALE: k.grayScale(rgb, n, op.gray); break;
+            case FilterOp::COLORIZE:   k.colorize(rgb, n, op.color); break;
+            case FilterOp::NEGATIVE:   k.negative(rgb, n); break;
+            case FilterOp::CUSTOM:     op.custom(rgb, n); break;
+        }
+    }
+};
+
+#endif /* FilterChain_h */
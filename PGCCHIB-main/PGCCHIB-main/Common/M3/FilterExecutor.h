@@ -0,0 +1,110 @@
+//
+//  FilterExecutor.h
+//  Executa filtros em paralelo dividindo a imagem em faixas de linhas do
+//  tamanho da cache L2. Cada faixa é uma tarefa do ThreadPool, e qualquer
+//  kernel por faixa, por linha ou por pixel pode ser aplicado.
+//
+
+#ifndef FilterExecutor_h
+#define FilterExecutor_h
+
+#include <stddef.h>
+
+#include "Filters.h"
+#include "Image.h"
+#include "ThreadPool.h"
+
+class FilterExecutor {
+    ThreadPool *pool;
+    size_t bandBytes;
+
+public:
+    static const size_t DEFAULT_BAND_BYTES = 256 * 1024;
+
+    explicit FilterExecutor(ThreadPool &pool = ThreadPool::shared(), size_t bandBytes = DEFAULT_BAND_BYTES)
+        : pool(&pool), bandBytes(bandBytes) {}
+
+    unsigned threads() const {
+        return pool->size();
+    }
+
+    // Linhas por faixa para uma linha de rowBytes bytes.
+    int bandRows(size_t rowBytes) const {
+        size_t rows = rowBytes ? bandBytes / rowBytes : 1;
+        return rows < 1 ? 1 : (int)rows;
+    }
+
+    // kernel(unsigned char *firstRow, int y0, int rows) para cada faixa.
+    template <class BandKernel>
+    void forEachBand(unsigned char *data, int w, int h, int channels, BandKernel kernel) const {
+        size_t rowBytes = (size_t)w * channels;
+        int rows = bandRows(rowBytes);
+        size_t bands = ((size_t)h + rows - 1) / rows;
+        pool->parallelFor(bands, [&](size_t band) {
+            int y0 = (int)band * rows;
+            int n = y0 + rows <= h ? rows : h - y0;
+            kernel(data + (size_t)y0 * rowBytes, y0, n);
+        });
+    }
+
+    // kernel(const ImageView &faixa, int y0) para cada faixa de uma visão;
+    // cada faixa é um recorte da mesma memória, com o stride da visão.
+    template <class BandKernel>
+    void forEachBand(const ImageView &view, BandKernel kernel) const {
+        int rows = bandRows(view.stride * (view.isPlanar() ? view.channels : 1));
+        size_t bands = ((size_t)view.height + rows - 1) / rows;
+        pool->parallelFor(bands, [&](size_t band) {
+            int y0 = (int)band * rows;
+            int n = y0 + rows <= view.height ? rows : view.height - y0;
+            kernel(view.rows(y0, n), y0);
+        });
+    }
+
+    // kernel(unsigned char *row, int y) para cada linha.
+    template <class RowKernel>
+    void forEachRow(unsigned char *data, int w, int h, int channels, RowKernel kernel) const {
+        size_t rowBytes = (size_t)w * channels;
+        forEachBand(data, w, h, channels, [&](unsigned char *first, int y0, int rows) {
+            for (int y = 0; y < rows; y++) kernel(first + y * rowBytes, y0 + y);
+        });
+    }
+
+    // kernel(unsigned char *pixel) para cada pixel.
+    template <class PixelKernel>
+    void forEachPixel(unsigned char *data, int w, int h, int channels, PixelKernel kernel) const {
+        forEachBand(data, w, h, channels, [&](unsigned char *first, int, int rows) {
+            size_t n = (size_t)w * rows;
+            for (size_t i = 0; i < n; i++, first += channels) kernel(first);
+        });
+    }
+
+    /*------------------------FILTROS DE exemplo_03-------------------------*/
+    void chromaKey(unsigned char *rgb, int w, int h, const ChromaKeyParams &p,
+                   const FilterKernels &k = filterKernels()) const {
+        forEachBand(rgb, w, h, 3, [&](unsigned char *first, int, int rows) {
+            k.chromaKey(first, (size_t)w * rows, p);
+        });
+    }
+
+    void grayScale(unsigned char *rgb, int w, int h, const GrayScaleParams &p,
+                   const FilterKernels &k = filterKernels()) const {
+        forEachBand(rgb, w, h, 3, [&](unsigned char *first, int, int rows) {
+            k.grayScale(first, (size_t)w * rows, p);
+        });
+    }
+
+    void colorize(unsigned char *rgb, int w, int h, const ColorizeParams &p,
+                  const FilterKernels &k = filterKernels()) const {
+        forEachBand(rgb, w, h, 3, [&](unsigned char *first, int, int rows) {
+            k.colorize(first, (size_t)w * rows, p);
+        });
+    }
+
+    void negative(unsigned char *rgb, int w, int h, const FilterKernels &k = filterKernels()) const {
+        forEachBand(rgb, w, h, 3, [&](unsigned char *first, int, int rows) {
+            k.negative(first, (size_t)w * rows);
+        });
+    }
+};
+
+#endif /* FilterExecutor_h */
@@ -0,0 +1,86 @@
+//
+//  FilterSpec.h
+//  Monta uma FilterChain a partir de uma descrição em texto, para uso na
+//  linha de comando. Os filtros são separados por '+' e os argumentos por
+//  vírgula:
+//
+//      chroma=R,G,B,TOL   gray=mean|weighted   colorize=R,G,B
+//      negative           lut=arquivo.cube
+//
+//  Ex.: "gray=weighted+colorize=40,0,80+negative"
+//
+
+#ifndef FilterSpec_h
+#define FilterSpec_h
+
+#include <stdlib.h>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ColorLUT.h"
+#include "FilterChain.h"
+
+namespace spec_detail {
+
+inline std::vector<std::string> split(const std::string &s, char sep) {
+    std::vector<std::string> parts;
+    std::string part;
+    std::istringstream in(s);
+    while (std::getline(in, part, sep)) {
+        if (!part.empty()) parts.push_back(part);
+    }
+    return parts;
+}
+
+inline bool numbers(const std::vector<std::string> &args, size_t count, double *out) {
+    if (args.size() != count) return false;
+    for (size_t i = 0; i < count; i++) {
+        char *end;
+        out[i] = strtod(args[i].c_str(), &end);
+        if (end == args[i].c_str() || *end != '\0') return false;
+    }
+    return true;
+}
+
+} // namespace spec_detail
+
+// Retorna false (com a mensagem em error) se a descrição for inválida.
+inline bool parseFilterSpec(const std::string &spec, FilterChain &chain, std::string &error) {
+    std::vector<std::string> filters = spec_detail::split(spec, '+');
+    if (filters.empty()) {
+        error = "nenhum filtro informado";
+        return false;
+    }
+    for (size_t i = 0; i < filters.size(); i++) {
+        const std::string &f = filters[i];
+        size_t eq = f.find('=');
+        std::string name = f.substr(0, eq);
+        std::string argText = eq == std::string::npos ? "" : f.substr(eq + 1);
+        std::vector<std::string> args = spec_detail::split(argText, ',');
+        double v[4];
+        if (name == "chroma" && spec_detail::numbers(args, 4, v)) {
+            chain.chromaKey(makeChromaKey((int)v[0], (int)v[1], (int)v[2], v[3]));
+        } else if (name == "gray" && (argText == "mean" || argText == "weighted" || argText.empty())) {
+            chain.grayScale(makeGrayScale(argText == "mean"));
+        } else if (name == "colorize" && spec_detail::numbers(args, 3, v)) {
+            chain.colorize(makeColorize((int)v[0], (int)v[1], (int)v[2]));
+        } else if (name == "negative" && args.empty()) {
+            chain.negative();
+        } else if (name == "lut" && !argText.empty()) {
+            std::shared_ptr<ColorLUT> lut = std::make_shared<ColorLUT>();
+            if (!lut->loadCube(argText)) {
+                error = "não foi possível carregar " + argText;
+                return false;
+            }
+            chain.custom([lut](unsigned char *rgb, size_t pixels) { lut->apply(rgb, pixels); });
+        } else {
+            error = "filtro inválido: " + f;
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif /* FilterSpec_h */
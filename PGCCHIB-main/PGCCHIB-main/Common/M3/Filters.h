@@ -0,0 +1,475 @@
+//
+//  Filters.h
+//  Filtros pontuais de exemplo_03 (chroma-key, tons de cinza, colorize e
+//  negativo) sobre pixels RGB intercalados, em versões escalar, SSE2 e AVX2.
+//
+//  Toda a aritmética é inteira para que as versões SIMD produzam exatamente
+//  os mesmos bytes que a versão escalar:
+//   - tons de cinza usa pesos em ponto fixo Q15;
+//   - chroma-key compara a distância ao quadrado com um limite inteiro, sem
+//     sqrt nem a normalização por 441.67 (= 255 * sqrt(3)).
+//  As versões SIMD processam blocos de 32 pixels; o resto vai para o escalar.
+//
+
+#ifndef Filters_h
+#define Filters_h
+
+#include <stddef.h>
+#include <math.h>
+
+#include "ColorSpace.h"
+#include "CpuFeatures.h"
+
+struct ChromaKeyParams {
+    unsigned char r, g, b;  // cor-chave
+    int limit;              // pixels com distância² < limit viram preto
+    double tolerance;       // original, para outras profundidades (Filters16.h)
+};
+
+// Equivale a dist(cor, chave) / 441.67 < tolerance do filtro original.
+inline ChromaKeyParams makeChromaKey(int r, int g, int b, double tolerance) {
+    ChromaKeyParams p;
+    p.r = (unsigned char)r;
+    p.g = (unsigned char)g;
+    p.b = (unsigned char)b;
+    p.tolerance = tolerance;
+    // d < t * dmax  <=>  d² < t² * 3 * 255², e d² é inteiro
+    double t = tolerance > 0.0 ? tolerance : 0.0;
+    double lim = ceil(t * t * 195075.0);
+    p.limit = lim > 195076.0 ? 195076 : (int)lim;
+    return p;
+}
+
+struct GrayScaleParams {
+    int wr, wg, wb;  // pesos em Q15
+};
+
+inline GrayScaleParams makeGrayScale(bool arithmeticMean) {
+    GrayScaleParams p;
+    if (arithmeticMean) {
+        // 10923 / 32768 ~ 1/3; para r+g+b <= 765 o resultado é (r+g+b)/3 exato
+        p.wr = p.wg = p.wb = 10923;
+    } else {
+        p.wr = LUMA_BT709.qr;
+        p.wg = LUMA_BT709.qg;
+        p.wb = LUMA_BT709.qb;
+    }
+    return p;
+}
+
+// Em 8 bits (y * soma) >> 15 == y para todo y <= 255 quando a soma dos pesos
+// fica entre 32768 e 32768 + 128; Filters16.h reescala os pesos para 32768.
+inline bool grayScaleIdempotent(const GrayScaleParams &p) {
+    int sum = p.wr + p.wg + p.wb;
+    return p.wr >= 0 && p.wg >= 0 && p.wb >= 0 && sum >= 32768 && sum <= 32768 + 128;
+}
+
+struct ColorizeParams {
+    unsigned char r, g, b;
+};
+
+inline ColorizeParams makeColorize(int r, int g, int b) {
+    ColorizeParams p;
+    p.r = (unsigned char)r;
+    p.g = (unsigned char)g;
+    p.b = (unsigned char)b;
+    return p;
+}
+
+typedef void (*ChromaKeyKernel)(unsigned char *rgb, size_t pixels, const ChromaKeyParams &p);
+typedef void (*GrayScaleKernel)(unsigned char *rgb, size_t pixels, const GrayScaleParams &p);
+typedef void (*ColorizeKernel)(unsigned char *rgb, size_t pixels, const ColorizeParams &p);
+typedef void (*NegativeKernel)(unsigned char *rgb, size_t pixels);
+
+/*---------------------------------ESCALAR----------------------------------*/
+namespace filters_scalar {
+
+inline void chromaKey(unsigned char *rgb, size_t pixels, const ChromaKeyParams &p) {
+    for (size_t i = 0; i < pixels; i++, rgb += 3) {
+        int dr = rgb[0] - p.r;
+        int dg = rgb[1] - p.g;
+        int db = rgb[2] - p.b;
+        if (dr * dr + dg * dg + db * db < p.limit) {
+            rgb[0] = rgb[1] = rgb[2] = 0;
+        }
+    }
+}
+
+inline void grayScale(unsigned char *rgb, size_t pixels, const GrayScaleParams &p) {
+    for (size_t i = 0; i < pixels; i++, rgb += 3) {
+        int y = (rgb[0] * p.wr + rgb[1] * p.wg + rgb[2] * p.wb) >> 15;
+        rgb[0] = rgb[1] = rgb[2] = (unsigned char)y;
+    }
+}
+
+inline void colorize(unsigned char *rgb, size_t pixels, const ColorizeParams &p) {
+    for (size_t i = 0; i < pixels; i++, rgb += 3) {
+        rgb[0] |= p.r;
+        rgb[1] |= p.g;
+        rgb[2] |= p.b;
+    }
+}
+
+inline void negative(unsigned char *rgb, size_t pixels) {
+    size_t length = pixels * 3;
+    for (size_t i = 0; i < length; i++) {
+        rgb[i] ^= 255;
+    }
+}
+
+} // namespace filters_scalar
+
+#ifdef M3_X86
+/*-----------------------------------SSE2-----------------------------------*/
+namespace filters_sse2 {
+
+// Um passo da separação de canais: intercala v[k] com v[k+3].
+// Cinco passos levam 32 pixels RGB (6 registradores) para r0 r1 g0 g1 b0 b1.
+M3_TARGET_SSE2 inline void unzipStep(__m128i v[6]) {
+    __m128i o0 = _mm_unpacklo_epi8(v[0], v[3]);
+    __m128i o1 = _mm_unpackhi_epi8(v[0], v[3]);
+    __m128i o2 = _mm_unpacklo_epi8(v[1], v[4]);
+    __m128i o3 = _mm_unpackhi_epi8(v[1], v[4]);
+    __m128i o4 = _mm_unpacklo_epi8(v[2], v[5]);
+    __m128i o5 = _mm_unpackhi_epi8(v[2], v[5]);
+    v[0] = o0; v[1] = o1; v[2] = o2; v[3] = o3; v[4] = o4; v[5] = o5;
+}
+
+// Inverso de unzipStep: bytes pares vão para v[k] e ímpares para v[k+3].
+M3_TARGET_SSE2 inline void zipStep(__m128i v[6]) {
+    const __m128i low = _mm_set1_epi16(0x00ff);
+    __m128i o0 = _mm_packus_epi16(_mm_and_si128(v[0], low), _mm_and_si128(v[1], low));
+    __m128i o3 = _mm_packus_epi16(_mm_srli_epi16(v[0], 8), _mm_srli_epi16(v[1], 8));
+    __m128i o1 = _mm_packus_epi16(_mm_and_si128(v[2], low), _mm_and_si128(v[3], low));
+    __m128i o4 = _mm_packus_epi16(_mm_srli_epi16(v[2], 8), _mm_srli_epi16(v[3], 8));
+    __m128i o2 = _mm_packus_epi16(_mm_and_si128(v[4], low), _mm_and_si128(v[5], low));
+    __m128i o5 = _mm_packus_epi16(_mm_srli_epi16(v[4], 8), _mm_srli_epi16(v[5], 8));
+    v[0] = o0; v[1] = o1; v[2] = o2; v[3] = o3; v[4] = o4; v[5] = o5;
+}
+
+M3_TARGET_SSE2 inline void load32(const unsigned char *p, __m128i v[6]) {
+    for (int k = 0; k < 6; k++) v[k] = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+}
+
+M3_TARGET_SSE2 inline void store32(unsigned char *p, const __m128i v[6]) {
+    for (int k = 0; k < 6; k++) _mm_storeu_si128((__m128i *)(p + 16 * k), v[k]);
+}
+
+M3_TARGET_SSE2 inline void deinterleave(__m128i v[6]) {
+    for (int i = 0; i < 5; i++) unzipStep(v);
+}
+
+M3_TARGET_SSE2 inline void interleave(__m128i v[6]) {
+    for (int i = 0; i < 5; i++) zipStep(v);
+}
+
+// (r*wr + g*wg + b*wb) >> 15 para 8 pixels de 16 bits.
+M3_TARGET_SSE2 inline __m128i gray8(__m128i r, __m128i g, __m128i b, __m128i wrg, __m128i wb) {
+    const __m128i z = _mm_setzero_si128();
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r, g), wrg),
+                               _mm_madd_epi16(_mm_unpacklo_epi16(b, z), wb));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r, g), wrg),
+                               _mm_madd_epi16(_mm_unpackhi_epi16(b, z), wb));
+    return _mm_packs_epi32(_mm_srli_epi32(lo, 15), _mm_srli_epi32(hi, 15));
+}
+
+M3_TARGET_SSE2 inline __m128i gray16(__m128i r, __m128i g, __m128i b, __m128i wrg, __m128i wb) {
+    const __m128i z = _mm_setzero_si128();
+    __m128i lo = gray8(_mm_unpacklo_epi8(r, z), _mm_unpacklo_epi8(g, z), _mm_unpacklo_epi8(b, z), wrg, wb);
+    __m128i hi = gray8(_mm_unpackhi_epi8(r, z), _mm_unpackhi_epi8(g, z), _mm_unpackhi_epi8(b, z), wrg, wb);
+    return _mm_packus_epi16(lo, hi);
+}
+
+// Máscara (0xffff) dos pixels com dr² + dg² + db² < limit; d* em 16 bits com sinal.
+M3_TARGET_SSE2 inline __m128i keyMask8(__m128i dr, __m128i dg, __m128i db, __m128i limit) {
+    const __m128i z = _mm_setzero_si128();
+    __m128i rg = _mm_unpacklo_epi16(dr, dg);
+    __m128i bz = _mm_unpacklo_epi16(db, z);
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(rg, rg), _mm_madd_epi16(bz, bz));
+    rg = _mm_unpackhi_epi16(dr, dg);
+    bz = _mm_unpackhi_epi16(db, z);
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(rg, rg), _mm_madd_epi16(bz, bz));
+    return _mm_packs_epi32(_mm_cmplt_epi32(lo, limit), _mm_cmplt_epi32(hi, limit));
+}
+
+M3_TARGET_SSE2 inline __m128i keyMask16(__m128i r, __m128i g, __m128i b,
+                                       __m128i kr, __m128i kg, __m128i kb, __m128i limit) {
+    const __m128i z = _mm_setzero_si128();
+    __m128i lo = keyMask8(_mm_sub_epi16(_mm_unpacklo_epi8(r, z), kr),
+                          _mm_sub_epi16(_mm_unpacklo_epi8(g, z), kg),
+                          _mm_sub_epi16(_mm_unpacklo_epi8(b, z), kb), limit);
+    __m128i hi = keyMask8(_mm_sub_epi16(_mm_unpackhi_epi8(r, z), kr),
+                          _mm_sub_epi16(_mm_unpackhi_epi8(g, z), kg),
+                          _mm_sub_epi16(_mm_unpackhi_epi8(b, z), kb), limit);
+    return _mm_packs_epi16(lo, hi);
+}
+
+M3_TARGET_SSE2 inline void chromaKey(unsigned char *rgb, size_t pixels, const ChromaKeyParams &p) {
+    const __m128i kr = _mm_set1_epi16(p.r);
+    const __m128i kg = _mm_set1_epi16(p.g);
+    const __m128i kb = _mm_set1_epi16(p.b);
+    const __m128i limit = _mm_set1_epi32(p.limit);
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32, rgb += 96) {
+        __m128i v[6];
+        load32(rgb, v);
+        deinterleave(v);
+        __m128i m0 = keyMask16(v[0], v[2], v[4], kr, kg, kb, limit);
+        __m128i m1 = keyMask16(v[1], v[3], v[5], kr, kg, kb, limit);
+        __m128i m[6] = { m0, m1, m0, m1, m0, m1 };
+        interleave(m);
+        load32(rgb, v);
+        for (int k = 0; k < 6; k++) v[k] = _mm_andnot_si128(m[k], v[k]);
+        store32(rgb, v);
+    }
+    filters_scalar::chromaKey(rgb, pixels - i, p);
+}
+
+M3_TARGET_SSE2 inline void grayScale(unsigned char *rgb, size_t pixels, const GrayScaleParams &p) {
+    const __m128i wrg = _mm_set1_epi32((p.wg << 16) | p.wr);
+    const __m128i wb = _mm_set1_epi32(p.wb);
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32, rgb += 96) {
+        __m128i v[6];
+        load32(rgb, v);
+        deinterleave(v);
+        __m128i y0 = gray16(v[0], v[2], v[4], wrg, wb);
+        __m128i y1 = gray16(v[1], v[3], v[5], wrg, wb);
+        __m128i y[6] = { y0, y1, y0, y1, y0, y1 };
+        interleave(y);
+        store32(rgb, y);
+    }
+    filters_scalar::grayScale(rgb, pixels - i, p);
+}
+
+M3_TARGET_SSE2 inline void colorize(unsigned char *rgb, size_t pixels, const ColorizeParams &p) {
+    unsigned char pattern[48];
+    for (int k = 0; k < 48; k++) pattern[k] = k % 3 == 0 ? p.r : (k % 3 == 1 ? p.g : p.b);
+    const __m128i c0 = _mm_loadu_si128((const __m128i *)pattern);
+    const __m128i c1 = _mm_loadu_si128((const __m128i *)(pattern + 16));
+    const __m128i c2 = _mm_loadu_si128((const __m128i *)(pattern + 32));
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16, rgb += 48) {
+        __m128i *q = (__m128i *)rgb;
+        _mm_storeu_si128(q, _mm_or_si128(_mm_loadu_si128(q), c0));
+        _mm_storeu_si128(q + 1, _mm_or_si128(_mm_loadu_si128(q + 1), c1));
+        _mm_storeu_si128(q + 2, _mm_or_si128(_mm_loadu_si128(q + 2), c2));
+    }
+    filters_scalar::colorize(rgb, pixels - i, p);
+}
+
+M3_TARGET_SSE2 inline void negative(unsigned char *rgb, size_t pixels) {
+    const __m128i ones = _mm_set1_epi8((char)0xff);
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16, rgb += 48) {
+        __m128i *q = (__m128i *)rgb;
+        _mm_storeu_si128(q, _mm_xor_si128(_mm_loadu_si128(q), ones));
+        _mm_storeu_si128(q + 1, _mm_xor_si128(_mm_loadu_si128(q + 1), ones));
+        _mm_storeu_si128(q + 2, _mm_xor_si128(_mm_loadu_si128(q + 2), ones));
+    }
+    filters_scalar::negative(rgb, pixels - i);
+}
+
+} // namespace filters_sse2
+
+/*-----------------------------------AVX2-----------------------------------*/
+namespace filters_avx2 {
+
+// Cada registrador de 256 bits carrega dois blocos de 16 pixels (um por
+// metade de 128 bits), separados/reunidos com pshufb dentro de cada metade.
+
+// Máscaras de separação: canal c vindo do trecho s (16 bytes) do bloco.
+static const signed char deinterleaveMasks[3][3][16] = {
+    { { 0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14, -128, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 1, 4, 7, 10, 13 } },
+    { { 1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14 } },
+    { { 2, 5, 8, 11, 14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, -128, 1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15 } }
+};
+
+// Máscaras que repetem um valor por pixel nos três canais do trecho s.
+static const signed char replicateMasks[3][16] = {
+    { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5 },
+    { 5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10 },
+    { 10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15 }
+};
+
+struct Shuffles {
+    __m256i split[3][3];
+    __m256i repeat[3];
+};
+
+M3_TARGET_AVX2 inline __m256i broadcast16(const signed char *m) {
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)m));
+}
+
+M3_TARGET_AVX2 inline void loadShuffles(Shuffles &s) {
+    for (int c = 0; c < 3; c++) {
+        for (int k = 0; k < 3; k++) s.split[c][k] = broadcast16(deinterleaveMasks[c][k]);
+        s.repeat[c] = broadcast16(replicateMasks[c]);
+    }
+}
+
+// 32 pixels: pixels 0..15 na metade baixa e 16..31 na metade alta.
+M3_TARGET_AVX2 inline void load32(const unsigned char *p, __m256i v[3]) {
+    for (int k = 0; k < 3; k++) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(p + 48 + 16 * k));
+        v[k] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    }
+}
+
+M3_TARGET_AVX2 inline void store32(unsigned char *p, const __m256i v[3]) {
+    for (int k = 0; k < 3; k++) {
+        _mm_storeu_si128((__m128i *)(p + 16 * k), _mm256_castsi256_si128(v[k]));
+        _mm_storeu_si128((__m128i *)(p + 48 + 16 * k), _mm256_extracti128_si256(v[k], 1));
+    }
+}
+
+M3_TARGET_AVX2 inline __m256i channel(const __m256i v[3], const Shuffles &s, int c) {
+    return _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(v[0], s.split[c][0]),
+                                           _mm256_shuffle_epi8(v[1], s.split[c][1])),
+                           _mm256_shuffle_epi8(v[2], s.split[c][2]));
+}
+
+M3_TARGET_AVX2 inline void replicate(__m256i x, const Shuffles &s, __m256i v[3]) {
+    for (int k = 0; k < 3; k++) v[k] = _mm256_shuffle_epi8(x, s.repeat[k]);
+}
+
+M3_TARGET_AVX2 inline __m256i gray16(__m256i r, __m256i g, __m256i b, __m256i wrg, __m256i wb) {
+    const __m256i z = _mm256_setzero_si256();
+    __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(r, g), wrg),
+                                  _mm256_madd_epi16(_mm256_unpacklo_epi16(b, z), wb));
+    __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(r, g), wrg),
+                                  _mm256_madd_epi16(_mm256_unpackhi_epi16(b, z), wb));
+    return _mm256_packs_epi32(_mm256_srli_epi32(lo, 15), _mm256_srli_epi32(hi, 15));
+}
+
+M3_TARGET_AVX2 inline __m256i keyMask16(__m256i dr, __m256i dg, __m256i db, __m256i limit) {
+    const __m256i z = _mm256_setzero_si256();
+    __m256i rg = _mm256_unpacklo_epi16(dr, dg);
+    __m256i bz = _mm256_unpacklo_epi16(db, z);
+    __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(rg, rg), _mm256_madd_epi16(bz, bz));
+    rg = _mm256_unpackhi_epi16(dr, dg);
+    bz = _mm256_unpackhi_epi16(db, z);
+    __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(rg, rg), _mm256_madd_epi16(bz, bz));
+    return _mm256_packs_epi32(_mm256_cmpgt_epi32(limit, lo), _mm256_cmpgt_epi32(limit, hi));
+}
+
+M3_TARGET_AVX2 inline void chromaKey(unsigned char *rgb, size_t pixels, const ChromaKeyParams &p) {
+    Shuffles s;
+    loadShuffles(s);
+    const __m256i z = _mm256_setzero_si256();
+    const __m256i kr = _mm256_set1_epi16(p.r);
+    const __m256i kg = _mm256_set1_epi16(p.g);
+    const __m256i kb = _mm256_set1_epi16(p.b);
+    const __m256i limit = _mm256_set1_epi32(p.limit);
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32, rgb += 96) {
+        __m256i v[3];
+        load32(rgb, v);
+        __m256i r = channel(v, s, 0);
+        __m256i g = channel(v, s, 1);
+        __m256i b = channel(v, s, 2);
+        __m256i lo = keyMask16(_mm256_sub_epi16(_mm256_unpacklo_epi8(r, z), kr),
+                               _mm256_sub_epi16(_mm256_unpacklo_epi8(g, z), kg),
+                               _mm256_sub_epi16(_mm256_unpacklo_epi8(b, z), kb), limit);
+        __m256i hi = keyMask16(_mm256_sub_epi16(_mm256_unpackhi_epi8(r, z), kr),
+                               _mm256_sub_epi16(_mm256_unpackhi_epi8(g, z), kg),
+                               _mm256_sub_epi16(_mm256_unpackhi_epi8(b, z), kb), limit);
+        __m256i m[3];
+        replicate(_mm256_packs_epi16(lo, hi), s, m);
+        for (int k = 0; k < 3; k++) v[k] = _mm256_andnot_si256(m[k], v[k]);
+        store32(rgb, v);
+    }
+    filters_scalar::chromaKey(rgb, pixels - i, p);
+}
+
+M3_TARGET_AVX2 inline void grayScale(unsigned char *rgb, size_t pixels, const GrayScaleParams &p) {
+    Shuffles s;
+    loadShuffles(s);
+    const __m256i z = _mm256_setzero_si256();
+    const __m256i wrg = _mm256_set1_epi32((p.wg << 16) | p.wr);
+    const __m256i wb = _mm256_set1_epi32(p.wb);
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32, rgb += 96) {
+        __m256i v[3];
+        load32(rgb, v);
+        __m256i r = channel(v, s, 0);
+        __m256i g = channel(v, s, 1);
+        __m256i b = channel(v, s, 2);
+        __m256i lo = gray16(_mm256_unpacklo_epi8(r, z), _mm256_unpacklo_epi8(g, z), _mm256_unpacklo_epi8(b, z), wrg, wb);
+        __m256i hi = gray16(_mm256_unpackhi_epi8(r, z), _mm256_unpackhi_epi8(g, z), _mm256_unpackhi_epi8(b, z), wrg, wb);
+        replicate(_mm256_packus_epi16(lo, hi), s, v);
+        store32(rgb, v);
+    }
+    filters_scalar::grayScale(rgb, pixels - i, p);
+}
+
+M3_TARGET_AVX2 inline void colorize(unsigned char *rgb, size_t pixels, const ColorizeParams &p) {
+    unsigned char pattern[96];
+    for (int k = 0; k < 96; k++) pattern[k] = k % 3 == 0 ? p.r : (k % 3 == 1 ? p.g : p.b);
+    const __m256i c0 = _mm256_loadu_si256((const __m256i *)pattern);
+    const __m256i c1 = _mm256_loadu_si256((const __m256i *)(pattern + 32));
+    const __m256i c2 = _mm256_loadu_si256((const __m256i *)(pattern + 64));
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32, rgb += 96) {
+        __m256i *q = (__m256i *)rgb;
+        _mm256_storeu_si256(q, _mm256_or_si256(_mm256_loadu_si256(q), c0));
+        _mm256_storeu_si256(q + 1, _mm256_or_si256(_mm256_loadu_si256(q + 1), c1));
+        _mm256_storeu_si256(q + 2, _mm256_or_si256(_mm256_loadu_si256(q + 2), c2));
+    }
+    filters_scalar::colorize(rgb, pixels - i, p);
+}
+
+M3_TARGET_AVX2 inline void negative(unsigned char *rgb, size_t pixels) {
+    const __m256i ones = _mm256_set1_epi8((char)0xff);
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32, rgb += 96) {
+        __m256i *q = (__m256i *)rgb;
+        _mm256_storeu_si256(q, _mm256_xor_si256(_mm256_loadu_si256(q), ones));
+        _mm256_storeu_si256(q + 1, _mm256_xor_si256(_mm256_loadu_si256(q + 1), ones));
+        _mm256_storeu_si256(q + 2, _mm256_xor_si256(_mm256_loadu_si256(q + 2), ones));
+    }
+    filters_scalar::negative(rgb, pixels - i);
+}
+
+} // namespace filters_avx2
+#endif // M3_X86
+
+/*--------------------------------DESPACHO----------------------------------*/
+struct FilterKernels {
+    SimdLevel level;
+    ChromaKeyKernel chromaKey;
+    GrayScaleKernel grayScale;
+    ColorizeKernel colorize;
+    NegativeKernel negative;
+};
+
+// Kernels de um nível específico (limitado ao que a CPU suporta).
+inline const FilterKernels &filterKernels(SimdLevel level) {
+    static const FilterKernels table[] = {
+        { SIMD_SCALAR, filters_scalar::chromaKey, filters_scalar::grayScale,
+          filters_scalar::colorize, filters_scalar::negative },
+#ifdef M3_X86
+        { SIMD_SSE2, filters_sse2::chromaKey, filters_sse2::grayScale,
+          filters_sse2::colorize, filters_sse2::negative },
+        { SIMD_AVX2, filters_avx2::chromaKey, filters_avx2::grayScale,
+          filters_avx2::colorize, filters_avx2::negative },
+#endif
+    };
+    if (level > cpuSimdLevel()) level = cpuSimdLevel();
+    return table[level];
+}
+
+// Melhores kernels para esta máquina, escolhidos na primeira chamada.
+inline const FilterKernels &filterKernels() {
+    static const FilterKernels &kernels = filterKernels(simdLevel());
+    return kernels;
+}
+
+#endif /* Filters_h */
@@ -0,0 +1,438 @@
+//
+//  Filters16.h
+//  Os filtros pontuais de Filters.h para imagens de 16 bits por canal
+//  (PPM com maxValue > 255), direto sobre amostras uint16_t RGB
+//  intercaladas, sem passar por 8 bits. Versões escalar, SSE2 e AVX2.
+//
+//  Os parâmetros de 8 bits são convertidos para a escala de maxValue
+//  (makeChromaKey16, makeGrayScale16, makeColorize16). A aritmética continua
+//  inteira e as versões SIMD dão exatamente o mesmo resultado que a escalar:
+//   - chroma-key soma os quadrados em 64 bits (3 * 65535² não cabe em 32);
+//   - tons de cinza usa os pesos Q15 ajustados para somar exatamente 32768,
+//     com produtos de 32 bits sem sinal e arredondamento: (y, y, y) dá y, a
+//     média fica a menos de 2 de (r + g + b) / 3 e o resultado é limitado a
+//     maxValue;
+//   - colorize satura em maxValue e o negativo é maxValue - v.
+//  As versões SIMD processam blocos de 16 pixels; o resto vai para o escalar.
+//  O chroma-key não tem versão SSE2: a tabela do nível SSE2 usa o escalar.
+//
+
+#ifndef Filters16_h
+#define Filters16_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "Filters.h"
+
+struct ChromaKey16Params {
+    uint16_t r, g, b;
+    uint64_t limit;     // pixels com distância² < limit viram preto
+};
+
+// A mesma tolerância de makeChromaKey, com distância máxima maxValue * sqrt(3).
+inline ChromaKey16Params makeChromaKey16(const ChromaKeyParams &key, int maxValue) {
+    ChromaKey16Params p;
+    p.r = (uint16_t)((key.r * maxValue + 127) / 255);
+    p.g = (uint16_t)((key.g * maxValue + 127) / 255);
+    p.b = (uint16_t)((key.b * maxValue + 127) / 255);
+    double t = key.tolerance > 0.0 ? key.tolerance : 0.0;
+    double dmax2 = 3.0 * maxValue * maxValue;
+    double lim = ceil(t * t * dmax2);
+    p.limit = lim > dmax2 + 1.0 ? (uint64_t)dmax2 + 1 : (uint64_t)lim;
+    return p;
+}
+
+struct GrayScale16Params {
+    uint16_t wr, wg, wb;    // Q15, somando exatamente 32768
+    uint16_t maxValue;
+};
+
+// Os pesos de 8 bits podem somar 32769 (a média usa 3 * 10923), o que em 8
+// bits não muda nada mas em 16 faz 60000 virar 60001. Aqui eles são
+// reescalados para somar 32768, e a diferença do arredondamento vai para o
+// primeiro maior peso: a média fica (10922, 10923, 10923).
+inline GrayScale16Params makeGrayScale16(const GrayScaleParams &gray, int maxValue) {
+    int w[3] = { gray.wr > 0 ? gray.wr : 0, gray.wg > 0 ? gray.wg : 0, gray.wb > 0 ? gray.wb : 0 };
+    long long sum = (long long)w[0] + w[1] + w[2];
+    if (sum == 0) {
+        w[0] = w[1] = w[2] = 1;
+        sum = 3;
+    }
+    int total = 0, largest = 0;
+    for (int c = 0; c < 3; c++) {
+        w[c] = (int)((w[c] * 32768LL + sum / 2) / sum);
+        total += w[c];
+        if (w[c] > w[largest]) largest = c;
+    }
+    w[largest] += 32768 - total;
+    GrayScale16Params p;
+    p.wr = (uint16_t)w[0];
+    p.wg = (uint16_t)w[1];
+    p.wb = (uint16_t)w[2];
+    p.maxValue = (uint16_t)maxValue;
+    return p;
+}
+
+struct Colorize16Params {
+    uint16_t r, g, b;
+    uint16_t maxValue;
+};
+
+inline Colorize16Params makeColorize16(const ColorizeParams &color, int maxValue) {
+    Colorize16Params p;
+    p.r = (uint16_t)((color.r * maxValue + 127) / 255);
+    p.g = (uint16_t)((color.g * maxValue + 127) / 255);
+    p.b = (uint16_t)((color.b * maxValue + 127) / 255);
+    p.maxValue = (uint16_t)maxValue;
+    return p;
+}
+
+typedef void (*ChromaKey16Kernel)(uint16_t *rgb, size_t pixels, const ChromaKey16Params &p);
+typedef void (*GrayScale16Kernel)(uint16_t *rgb, size_t pixels, const GrayScale16Params &p);
+typedef void (*Colorize16Kernel)(uint16_t *rgb, size_t pixels, const Colorize16Params &p);
+typedef void (*Negative16Kernel)(uint16_t *rgb, size_t pixels, uint16_t maxValue);
+
+/*---------------------------------ESCALAR----------------------------------*/
+namespace filters16_scalar {
+
+inline void chromaKey(uint16_t *rgb, size_t pixels, const ChromaKey16Params &p) {
+    for (size_t i = 0; i < pixels; i++, rgb += 3) {
+        int64_t dr = (int64_t)rgb[0] - p.r;
+        int64_t dg = (int64_t)rgb[1] - p.g;
+        int64_t db = (int64_t)rgb[2] - p.b;
+        if ((uint64_t)(dr * dr + dg * dg + db * db) < p.limit) {
+            rgb[0] = rgb[1] = rgb[2] = 0;
+        }
+    }
+}
+
+inline void grayScale(uint16_t *rgb, size_t pixels, const GrayScale16Params &p) {
+    for (size_t i = 0; i < pixels; i++, rgb += 3) {
+        uint32_t y = ((uint32_t)rgb[0] * p.wr + (uint32_t)rgb[1] * p.wg + (uint32_t)rgb[2] * p.wb + 16384) >> 15;
+        rgb[0] = rgb[1] = rgb[2] = (uint16_t)(y < p.maxValue ? y : p.maxValue);
+    }
+}
+
+inline void colorize(uint16_t *rgb, size_t pixels, const Colorize16Params &p) {
+    for (size_t i = 0; i < pixels; i++, rgb += 3) {
+        uint16_t r = rgb[0] | p.r, g = rgb[1] | p.g, b = rgb[2] | p.b;
+        rgb[0] = r < p.maxValue ? r : p.maxValue;
+        rgb[1] = g < p.maxValue ? g : p.maxValue;
+        rgb[2] = b < p.maxValue ? b : p.maxValue;
+    }
+}
+
+inline void negative(uint16_t *rgb, size_t pixels, uint16_t maxValue) {
+    size_t length = pixels * 3;
+    for (size_t i = 0; i < length; i++) {
+        rgb[i] = (uint16_t)(maxValue - rgb[i]);
+    }
+}
+
+} // namespace filters16_scalar
+
+#ifdef M3_X86
+/*-----------------------------------SSE2-----------------------------------*/
+namespace filters16_sse2 {
+
+// Como filters_sse2::unzipStep, em palavras de 16 bits: quatro passos
+// levam 16 pixels (6 registradores) para r0 r1 g0 g1 b0 b1.
+M3_TARGET_SSE2 inline void unzipStep(__m128i v[6]) {
+    __m128i o0 = _mm_unpacklo_epi16(v[0], v[3]);
+    __m128i o1 = _mm_unpackhi_epi16(v[0], v[3]);
+    __m128i o2 = _mm_unpacklo_epi16(v[1], v[4]);
+    __m128i o3 = _mm_unpackhi_epi16(v[1], v[4]);
+    __m128i o4 = _mm_unpacklo_epi16(v[2], v[5]);
+    __m128i o5 = _mm_unpackhi_epi16(v[2], v[5]);
+    v[0] = o0; v[1] = o1; v[2] = o2; v[3] = o3; v[4] = o4; v[5] = o5;
+}
+
+// Palavras de 32 bits com uma palavra de 16 estendida com sinal cabem sem
+// saturar em packs_epi32, que então preserva os 16 bits.
+M3_TARGET_SSE2 inline __m128i packLow(__m128i a, __m128i b) {
+    return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+}
+
+M3_TARGET_SSE2 inline __m128i packHigh(__m128i a, __m128i b) {
+    return _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+}
+
+M3_TARGET_SSE2 inline void zipStep(__m128i v[6]) {
+    __m128i o0 = packLow(v[0], v[1]), o3 = packHigh(v[0], v[1]);
+    __m128i o1 = packLow(v[2], v[3]), o4 = packHigh(v[2], v[3]);
+    __m128i o2 = packLow(v[4], v[5]), o5 = packHigh(v[4], v[5]);
+    v[0] = o0; v[1] = o1; v[2] = o2; v[3] = o3; v[4] = o4; v[5] = o5;
+}
+
+M3_TARGET_SSE2 inline void deinterleave(__m128i v[6]) {
+    for (int i = 0; i < 4; i++) unzipStep(v);
+}
+
+M3_TARGET_SSE2 inline void interleave(__m128i v[6]) {
+    for (int i = 0; i < 4; i++) zipStep(v);
+}
+
+// Produto de 16 x 16 bits sem sinal em 32 bits, para as metades baixa e alta.
+M3_TARGET_SSE2 inline void mul32(__m128i v, __m128i w, __m128i &lo, __m128i &hi) {
+    __m128i l = _mm_mullo_epi16(v, w), h = _mm_mulhi_epu16(v, w);
+    lo = _mm_unpacklo_epi16(l, h);
+    hi = _mm_unpackhi_epi16(l, h);
+}
+
+M3_TARGET_SSE2 inline __m128i gray16(__m128i r, __m128i g, __m128i b, __m128i wr, __m128i wg, __m128i wb) {
+    __m128i rl, rh, gl, gh, bl, bh;
+    mul32(r, wr, rl, rh);
+    mul32(g, wg, gl, gh);
+    mul32(b, wb, bl, bh);
+    // com os pesos somando 32768 a soma cabe em 32 bits e y em 16
+    const __m128i half = _mm_set1_epi32(16384);
+    __m128i lo = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_add_epi32(rl, gl), bl), half), 15);
+    __m128i hi = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_add_epi32(rh, gh), bh), half), 15);
+    return packLow(lo, hi);
+}
+
+// min(a, b) sem sinal: min_epu16 só existe a partir do SSE4.1.
+M3_TARGET_SSE2 inline __m128i minU16(__m128i a, __m128i b) {
+    return _mm_sub_epi16(a, _mm_subs_epu16(a, b));
+}
+
+M3_TARGET_SSE2 inline void grayScale(uint16_t *rgb, size_t pixels, const GrayScale16Params &p) {
+    const __m128i wr = _mm_set1_epi16((short)p.wr);
+    const __m128i wg = _mm_set1_epi16((short)p.wg);
+    const __m128i wb = _mm_set1_epi16((short)p.wb);
+    const __m128i top = _mm_set1_epi16((short)p.maxValue);
+    unsigned char *bytes = (unsigned char *)rgb;
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16, bytes += 96) {
+        __m128i v[6];
+        filters_sse2::load32(bytes, v);
+        deinterleave(v);
+        __m128i y0 = minU16(gray16(v[0], v[2], v[4], wr, wg, wb), top);
+        __m128i y1 = minU16(gray16(v[1], v[3], v[5], wr, wg, wb), top);
+        __m128i y[6] = { y0, y1, y0, y1, y0, y1 };
+        interleave(y);
+        filters_sse2::store32(bytes, y);
+    }
+    filters16_scalar::grayScale(rgb + i * 3, pixels - i, p);
+}
+
+M3_TARGET_SSE2 inline void colorize(uint16_t *rgb, size_t pixels, const Colorize16Params &p) {
+    uint16_t pattern[24];
+    for (int k = 0; k < 24; k++) pattern[k] = k % 3 == 0 ? p.r : (k % 3 == 1 ? p.g : p.b);
+    const __m128i c0 = _mm_loadu_si128((const __m128i *)pattern);
+    const __m128i c1 = _mm_loadu_si128((const __m128i *)(pattern + 8));
+    const __m128i c2 = _mm_loadu_si128((const __m128i *)(pattern + 16));
+    const __m128i top = _mm_set1_epi16((short)p.maxValue);
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m128i *q = (__m128i *)(rgb + i * 3);
+        _mm_storeu_si128(q, minU16(_mm_or_si128(_mm_loadu_si128(q), c0), top));
+        _mm_storeu_si128(q + 1, minU16(_mm_or_si128(_mm_loadu_si128(q + 1), c1), top));
+        _mm_storeu_si128(q + 2, minU16(_mm_or_si128(_mm_loadu_si128(q + 2), c2), top));
+    }
+    filters16_scalar::colorize(rgb + i * 3, pixels - i, p);
+}
+
+M3_TARGET_SSE2 inline void negative(uint16_t *rgb, size_t pixels, uint16_t maxValue) {
+    const __m128i top = _mm_set1_epi16((short)maxValue);
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m128i *q = (__m128i *)(rgb + i * 3);
+        _mm_storeu_si128(q, _mm_sub_epi16(top, _mm_loadu_si128(q)));
+        _mm_storeu_si128(q + 1, _mm_sub_epi16(top, _mm_loadu_si128(q + 1)));
+        _mm_storeu_si128(q + 2, _mm_sub_epi16(top, _mm_loadu_si128(q + 2)));
+    }
+    filters16_scalar::negative(rgb + i * 3, pixels - i, maxValue);
+}
+
+} // namespace filters16_sse2
+
+/*-----------------------------------AVX2-----------------------------------*/
+namespace filters16_avx2 {
+
+// Mesmo arranjo de filters_avx2 (filters_avx2::load32 carrega 96 bytes, 48
+// em cada metade), agora com 8 pixels de 16 bits por metade.
+
+// Máscaras de separação: canal c vindo do trecho s (16 bytes) do bloco.
+static const signed char deinterleaveMasks[3][3][16] = {
+    { { 0, 1, 6, 7, 12, 13, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, -128, -128, 2, 3, 8, 9, 14, 15, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 4, 5, 10, 11 } },
+    { { 2, 3, 8, 9, 14, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, -128, -128, 4, 5, 10, 11, -128, -128, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, 1, 6, 7, 12, 13 } },
+    { { 4, 5, 10, 11, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, 0, 1, 6, 7, 12, 13, -128, -128, -128, -128, -128, -128 },
+      { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 2, 3, 8, 9, 14, 15 } }
+};
+
+// Máscaras que repetem um valor por pixel nos três canais do trecho s.
+static const signed char replicateMasks[3][16] = {
+    { 0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2, 3, 4, 5, 4, 5 },
+    { 4, 5, 6, 7, 6, 7, 6, 7, 8, 9, 8, 9, 8, 9, 10, 11 },
+    { 10, 11, 10, 11, 12, 13, 12, 13, 12, 13, 14, 15, 14, 15, 14, 15 }
+};
+
+struct Shuffles {
+    __m256i split[3][3];
+    __m256i repeat[3];
+};
+
+M3_TARGET_AVX2 inline void loadShuffles(Shuffles &s) {
+    for (int c = 0; c < 3; c++) {
+        for (int k = 0; k < 3; k++) s.split[c][k] = filters_avx2::broadcast16(deinterleaveMasks[c][k]);
+        s.repeat[c] = filters_avx2::broadcast16(replicateMasks[c]);
+    }
+}
+
+M3_TARGET_AVX2 inline __m256i channel(const __m256i v[3], const Shuffles &s, int c) {
+    return _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(v[0], s.split[c][0]),
+                                           _mm256_shuffle_epi8(v[1], s.split[c][1])),
+                           _mm256_shuffle_epi8(v[2], s.split[c][2]));
+}
+
+M3_TARGET_AVX2 inline void replicate(__m256i x, const Shuffles &s, __m256i v[3]) {
+    for (int k = 0; k < 3; k++) v[k] = _mm256_shuffle_epi8(x, s.repeat[k]);
+}
+
+M3_TARGET_AVX2 inline __m256i absDiff(__m256i a, __m256i b) {
+    return _mm256_sub_epi16(_mm256_max_epu16(a, b), _mm256_min_epu16(a, b));
+}
+
+// Máscara (32 bits) de dr² + dg² + db² < limit, distâncias em 32 bits.
+M3_TARGET_AVX2 inline __m256i keyMask32(__m256i dr, __m256i dg, __m256i db, __m256i limit) {
+    __m256i even = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(dr, dr), _mm256_mul_epu32(dg, dg)),
+                                    _mm256_mul_epu32(db, db));
+    dr = _mm256_srli_epi64(dr, 32);
+    dg = _mm256_srli_epi64(dg, 32);
+    db = _mm256_srli_epi64(db, 32);
+    __m256i odd = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(dr, dr), _mm256_mul_epu32(dg, dg)),
+                                   _mm256_mul_epu32(db, db));
+    return _mm256_blend_epi32(_mm256_cmpgt_epi64(limit, even), _mm256_cmpgt_epi64(limit, odd), 0xaa);
+}
+
+M3_TARGET_AVX2 inline void mul32(__m256i v, __m256i w, __m256i &lo, __m256i &hi) {
+    __m256i l = _mm256_mullo_epi16(v, w), h = _mm256_mulhi_epu16(v, w);
+    lo = _mm256_unpacklo_epi16(l, h);
+    hi = _mm256_unpackhi_epi16(l, h);
+}
+
+M3_TARGET_AVX2 inline void chromaKey(uint16_t *rgb, size_t pixels, const ChromaKey16Params &p) {
+    Shuffles s;
+    loadShuffles(s);
+    const __m256i z = _mm256_setzero_si256();
+    const __m256i kr = _mm256_set1_epi16((short)p.r);
+    const __m256i kg = _mm256_set1_epi16((short)p.g);
+    const __m256i kb = _mm256_set1_epi16((short)p.b);
+    const __m256i limit = _mm256_set1_epi64x((long long)p.limit);
+    unsigned char *bytes = (unsigned char *)rgb;
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16, bytes += 96) {
+        __m256i v[3];
+        filters_avx2::load32(bytes, v);
+        __m256i dr = absDiff(channel(v, s, 0), kr);
+        __m256i dg = absDiff(channel(v, s, 1), kg);
+        __m256i db = absDiff(channel(v, s, 2), kb);
+        __m256i lo = keyMask32(_mm256_unpacklo_epi16(dr, z), _mm256_unpacklo_epi16(dg, z),
+                               _mm256_unpacklo_epi16(db, z), limit);
+        __m256i hi = keyMask32(_mm256_unpackhi_epi16(dr, z), _mm256_unpackhi_epi16(dg, z),
+                               _mm256_unpackhi_epi16(db, z), limit);
+        __m256i m[3];
+        replicate(_mm256_packs_epi32(lo, hi), s, m);
+        for (int k = 0; k < 3; k++) v[k] = _mm256_andnot_si256(m[k], v[k]);
+        filters_avx2::store32(bytes, v);
+    }
+    filters16_scalar::chromaKey(rgb + i * 3, pixels - i, p);
+}
+
+M3_TARGET_AVX2 inline void grayScale(uint16_t *rgb, size_t pixels, const GrayScale16Params &p) {
+    Shuffles s;
+    loadShuffles(s);
+    const __m256i wr = _mm256_set1_epi16((short)p.wr);
+    const __m256i wg = _mm256_set1_epi16((short)p.wg);
+    const __m256i wb = _mm256_set1_epi16((short)p.wb);
+    const __m256i top = _mm256_set1_epi16((short)p.maxValue);
+    const __m256i half = _mm256_set1_epi32(16384);
+    unsigned char *bytes = (unsigned char *)rgb;
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16, bytes += 96) {
+        __m256i v[3];
+        filters_avx2::load32(bytes, v);
+        __m256i rl, rh, gl, gh, bl, bh;
+        mul32(channel(v, s, 0), wr, rl, rh);
+        mul32(channel(v, s, 1), wg, gl, gh);
+        mul32(channel(v, s, 2), wb, bl, bh);
+        __m256i lo = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(rl, gl), bl), half), 15);
+        __m256i hi = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(rh, gh), bh), half), 15);
+        replicate(_mm256_min_epu16(_mm256_packus_epi32(lo, hi), top), s, v);
+        filters_avx2::store32(bytes, v);
+    }
+    filters16_scalar::grayScale(rgb + i * 3, pixels - i, p);
+}
+
+M3_TARGET_AVX2 inline void colorize(uint16_t *rgb, size_t pixels, const Colorize16Params &p) {
+    uint16_t pattern[48];
+    for (int k = 0; k < 48; k++) pattern[k] = k % 3 == 0 ? p.r : (k % 3 == 1 ? p.g : p.b);
+    const __m256i c0 = _mm256_loadu_si256((const __m256i *)pattern);
+    const __m256i c1 = _mm256_loadu_si256((const __m256i *)(pattern + 16));
+    const __m256i c2 = _mm256_loadu_si256((const __m256i *)(pattern + 32));
+    const __m256i top = _mm256_set1_epi16((short)p.maxValue);
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m256i *q = (__m256i *)(rgb + i * 3);
+        _mm256_storeu_si256(q, _mm256_min_epu16(_mm256_or_si256(_mm256_loadu_si256(q), c0), top));
+        _mm256_storeu_si256(q + 1, _mm256_min_epu16(_mm256_or_si256(_mm256_loadu_si256(q + 1), c1), top));
+        _mm256_storeu_si256(q + 2, _mm256_min_epu16(_mm256_or_si256(_mm256_loadu_si256(q + 2), c2), top));
+    }
+    filters16_scalar::colorize(rgb + i * 3, pixels - i, p);
+}
+
+M3_TARGET_AVX2 inline void negative(uint16_t *rgb, size_t pixels, uint16_t maxValue) {
+    const __m256i top = _mm256_set1_epi16((short)maxValue);
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m256i *q = (__m256i *)(rgb + i * 3);
+        _mm256_storeu_si256(q, _mm256_sub_epi16(top, _mm256_loadu_si256(q)));
+        _mm256_storeu_si256(q + 1, _mm256_sub_epi16(top, _mm256_loadu_si256(q + 1)));
+        _mm256_storeu_si256(q + 2, _mm256_sub_epi16(top, _mm256_loadu_si256(q + 2)));
+    }
+    filters16_scalar::negative(rgb + i * 3, pixels - i, maxValue);
+}
+
+} // namespace filters16_avx2
+#endif // M3_X86
+
+/*--------------------------------DESPACHO----------------------------------*/
+struct FilterKernels16 {
+    SimdLevel level;
+    ChromaKey16Kernel chromaKey;
+    GrayScale16Kernel grayScale;
+    Colorize16Kernel colorize;
+    Negative16Kernel negative;
+};
+
+inline const FilterKernels16 &filterKernels16(SimdLevel level) {
+    static const FilterKernels16 table[] = {
+        { SIMD_SCALAR, filters16_scalar::chromaKey, filters16_scalar::grayScale,
+          filters16_scalar::colorize, filters16_scalar::negative },
+#ifdef M3_X86
+        // sem mul de 32 bits nem min/max sem sinal, a distância² de 64 bits
+        // em SSE2 saía mais lenta que a escalar: o chroma-key fica escalar
+        { SIMD_SSE2, filters16_scalar::chromaKey, filters16_sse2::grayScale,
+          filters16_sse2::colorize, filters16_sse2::negative },
+        { SIMD_AVX2, filters16_avx2::chromaKey, filters16_avx2::grayScale,
+          filters16_avx2::colorize, filters16_avx2::negative },
+#endif
+    };
+    if (level > cpuSimdLevel()) level = cpuSimdLevel();
+    return table[level];
+}
+
+inline const FilterKernels16 &filterKernels16() {
+    static const FilterKernels16 &kernels = filterKernels16(simdLevel());
+    return kernels;
+}
+
+#endif /* Filters16_h */
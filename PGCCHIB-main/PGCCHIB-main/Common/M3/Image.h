@@ -0,0 +1,512 @@
+//
+//  Image.h
+//  Contêiner de imagem de 8 ou 16 bits por canal com linhas alinhadas em 64
+//  bytes, e visões (ImageView) que apontam para ele sem copiar pixels.
+//
+//  Uma visão descreve largura, altura, canais, passo entre linhas (stride)
+//  e o arranjo dos canais: intercalado (RGBRGB...) ou planar (um plano por
+//  canal, cada um com o mesmo stride). Recortes (sub) e planos (plane) são
+//  visões da mesma memória, então os filtros encadeados sobre uma visão
+//  trabalham sempre no mesmo buffer. Image é dono da memória e só pode ser
+//  movida; cópias são explícitas (clone, toLayout).
+//
+
+#ifndef Image_h
+#define Image_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <new>
+
+#include "Filters.h"
+#include "ThreadPool.h"
+
+enum PixelLayout {
+    LAYOUT_INTERLEAVED,
+    LAYOUT_PLANAR
+};
+
+struct ImageView {
+    unsigned char *data;    // primeiro pixel (do plano 0, se planar)
+    int width;
+    int height;
+    int channels;
+    int sampleBytes;        // 1 (8 bits) ou 2 (uint16_t, ordem da máquina)
+    size_t stride;          // bytes entre linhas
+    size_t planeStride;     // bytes entre planos (só planar)
+    PixelLayout layout;
+
+    ImageView()
+        : data(NULL), width(0), height(0), channels(0), sampleBytes(1), stride(0), planeStride(0),
+          layout(LAYOUT_INTERLEAVED) {}
+
+    // Visão intercalada de um buffer; stride 0 = linhas contíguas.
+    ImageView(unsigned char *data, int w, int h, int channels, size_t stride = 0)
+        : data(data), width(w), height(h), channels(channels), sampleBytes(1),
+          stride(stride ? stride : (size_t)w * channels), planeStride(0), layout(LAYOUT_INTERLEAVED) {}
+
+    // Visão somente leitura; quem recebe a visão não deve escrever nela.
+    ImageView(const unsigned char *data, int w, int h, int channels, size_t stride = 0)
+        : ImageView(const_cast<unsigned char *>(data), w, h, channels, stride) {}
+
+    // 16 bits por canal; stride continua em bytes.
+    ImageView(uint16_t *data, int w, int h, int channels, size_t stride = 0)
+        : ImageView((unsigned char *)data, w, h, channels, stride ? stride : (size_t)w * channels * 2) {
+        sampleBytes = 2;
+    }
+
+    ImageView(const uint16_t *data, int w, int h, int channels, size_t stride = 0)
+        : ImageView(const_cast<uint16_t *>(data), w, h, channels, stride) {}
+
+    static ImageView planar(unsigned char *data, int w, int h, int channels, size_t stride, size_t planeStride,
+                            int sampleBytes = 1) {
+        ImageView v(data, w, h, channels, stride);
+        v.sampleBytes = sampleBytes;
+        v.planeStride = planeStride;
+        v.layout = LAYOUT_PLANAR;
+        return v;
+    }
+
+    bool empty() const {
+        return data == NULL || width <= 0 || height <= 0;
+    }
+
+    bool isPlanar() const {
+        return layout == LAYOUT_PLANAR;
+    }
+
+    // Bytes de um pixel (de uma amostra, se planar).
+    size_t pixelBytes() const {
+        return (size_t)sampleBytes * (isPlanar() ? 1 : channels);
+    }
+
+    // Bytes úteis de uma linha (de um plano, se planar).
+    size_t rowBytes() const {
+        return (size_t)width * pixelBytes();
+    }
+
+    // Linhas coladas umas nas outras: a visão pode ser tratada como um bloco.
+    bool contiguous() const {
+        return stride == rowBytes();
+    }
+
+    unsigned char *row(int y, int plane = 0) const {
+        return data + (size_t)plane * planeStride + (size_t)y * stride;
+    }
+
+    unsigned char *pixel(int x, int y) const {
+        return row(y) + (size_t)x * pixelBytes();
+    }
+
+    uint16_t *row16(int y, int plane = 0) const {
+        return (uint16_t *)row(y, plane);
+    }
+
+    // Recorte [x, x + w) x [y, y + h), na mesma memória.
+    ImageView sub(int x, int y, int w, int h) const {
+        ImageView v = *this;
+        v.data = pixel(x, y);
+        v.width = w;
+        v.height = h;
+        return v;
+    }
+
+    // Linhas [y, y + h).
+    ImageView rows(int y, int h) const {
+        return sub(0, y, width, h);
+    }
+
+    // Plano c de uma visão planar, como imagem de um canal.
+    ImageView plane(int c) const {
+        ImageView v(row(0, c), width, height, 1, stride);
+        v.sampleBytes = sampleBytes;
+        return v;
+    }
+};
+
+/*----------------------CONVERSÃO INTERCALADO/PLANAR------------------------*/
+
+namespace image_scalar {
+
+inline void split3(const unsigned char *src, unsigned char *r, unsigned char *g, unsigned char *b, size_t n) {
+    for (size_t i = 0; i < n; i++, src += 3) {
+        r[i] = src[0];
+        g[i] = src[1];
+        b[i] = src[2];
+    }
+}
+
+inline void merge3(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *dst,
+                   size_t n) {
+    for (size_t i = 0; i < n; i++, dst += 3) {
+        dst[0] = r[i];
+        dst[1] = g[i];
+        dst[2] = b[i];
+    }
+}
+
+inline void split4(const unsigned char *src, unsigned char *const *planes, size_t n) {
+    unsigned char *r = planes[0], *g = planes[1], *b = planes[2], *a = planes[3];
+    for (size_t i = 0; i < n; i++, src += 4) {
+        r[i] = src[0];
+        g[i] = src[1];
+        b[i] = src[2];
+        a[i] = src[3];
+    }
+}
+
+inline void merge4(const unsigned char *const *planes, unsigned char *dst, size_t n) {
+    const unsigned char *r = planes[0], *g = planes[1], *b = planes[2], *a = planes[3];
+    for (size_t i = 0; i < n; i++, dst += 4) {
+        dst[0] = r[i];
+        dst[1] = g[i];
+        dst[2] = b[i];
+        dst[3] = a[i];
+    }
+}
+
+} // namespace image_scalar
+
+#ifdef M3_X86
+namespace image_sse2 {
+
+// 32 pixels RGB por vez, com a mesma separação de canais dos filtros.
+M3_TARGET_SSE2 inline void split3(const unsigned char *src, unsigned char *r, unsigned char *g, unsigned char *b,
+                                  size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32, src += 96) {
+        __m128i v[6];
+        filters_sse2::load32(src, v);
+        filters_sse2::deinterleave(v);
+        _mm_storeu_si128((__m128i *)(r + i), v[0]);
+        _mm_storeu_si128((__m128i *)(r + i + 16), v[1]);
+        _mm_storeu_si128((__m128i *)(g + i), v[2]);
+        _mm_storeu_si128((__m128i *)(g + i + 16), v[3]);
+        _mm_storeu_si128((__m128i *)(b + i), v[4]);
+        _mm_storeu_si128((__m128i *)(b + i + 16), v[5]);
+    }
+    image_scalar::split3(src, r + i, g + i, b + i, n - i);
+}
+
+M3_TARGET_SSE2 inline void merge3(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                                  unsigned char *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32, dst += 96) {
+        __m128i v[6];
+        v[0] = _mm_loadu_si128((const __m128i *)(r + i));
+        v[1] = _mm_loadu_si128((const __m128i *)(r + i + 16));
+        v[2] = _mm_loadu_si128((const __m128i *)(g + i));
+        v[3] = _mm_loadu_si128((const __m128i *)(g + i + 16));
+        v[4] = _mm_loadu_si128((const __m128i *)(b + i));
+        v[5] = _mm_loadu_si128((const __m128i *)(b + i + 16));
+        filters_sse2::interleave(v);
+        filters_sse2::store32(dst, v);
+    }
+    image_scalar::merge3(r + i, g + i, b + i, dst, n - i);
+}
+
+// Canal c (byte c de cada pixel de 32 bits) de 16 pixels RGBA.
+M3_TARGET_SSE2 inline __m128i channel4(const __m128i v[4], int c) {
+    const __m128i low = _mm_set1_epi32(0xff);
+    __m128i a = _mm_and_si128(_mm_srli_epi32(v[0], 8 * c), low);
+    __m128i b = _mm_and_si128(_mm_srli_epi32(v[1], 8 * c), low);
+    __m128i d = _mm_and_si128(_mm_srli_epi32(v[2], 8 * c), low);
+    __m128i e = _mm_and_si128(_mm_srli_epi32(v[3], 8 * c), low);
+    return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(d, e));
+}
+
+M3_TARGET_SSE2 inline void split4(const unsigned char *src, unsigned char *const *planes, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16, src += 64) {
+        __m128i v[4];
+        for (int k = 0; k < 4; k++) v[k] = _mm_loadu_si128((const __m128i *)(src + 16 * k));
+        for (int c = 0; c < 4; c++) _mm_storeu_si128((__m128i *)(planes[c] + i), channel4(v, c));
+    }
+    unsigned char *rest[4] = { planes[0] + i, planes[1] + i, planes[2] + i, planes[3] + i };
+    image_scalar::split4(src, rest, n - i);
+}
+
+M3_TARGET_SSE2 inline void merge4(const unsigned char *const *planes, unsigned char *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16, dst += 64) {
+        __m128i r = _mm_loadu_si128((const __m128i *)(planes[0] + i));
+        __m128i g = _mm_loadu_si128((const __m128i *)(planes[1] + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(planes[2] + i));
+        __m128i a = _mm_loadu_si128((const __m128i *)(planes[3] + i));
+        __m128i rgLo = _mm_unpacklo_epi8(r, g), rgHi = _mm_unpackhi_epi8(r, g);
+        __m128i baLo = _mm_unpacklo_epi8(b, a), baHi = _mm_unpackhi_epi8(b, a);
+        _mm_storeu_si128((__m128i *)(dst), _mm_unpacklo_epi16(rgLo, baLo));
+        _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(rgLo, baLo));
+        _mm_storeu_si128((__m128i *)(dst + 32), _mm_unpacklo_epi16(rgHi, baHi));
+        _mm_storeu_si128((__m128i *)(dst + 48), _mm_unpackhi_epi16(rgHi, baHi));
+    }
+    const unsigned char *rest[4] = { planes[0] + i, planes[1] + i, planes[2] + i, planes[3] + i };
+    image_scalar::merge4(rest, dst, n - i);
+}
+
+} // namespace image_sse2
+
+namespace image_avx2 {
+
+// Máscaras de junção: trecho s (16 bytes) da saída recebe o canal c dos
+// 16 pixels de uma metade do registrador.
+static const signed char mergeMasks[3][3][16] = {
+    { { 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128, 5 },
+      { -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10, -128 },
+      { -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128, -128 } },
+    { { -128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128 },
+      { 5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10 },
+      { -128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128 } },
+    { { -128, -128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128 },
+      { -128, 5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128 },
+      { 10, -128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15 } }
+};
+
+M3_TARGET_AVX2 inline void split3(const unsigned char *src, unsigned char *r, unsigned char *g, unsigned char *b,
+                                  size_t n) {
+    filters_avx2::Shuffles s;
+    filters_avx2::loadShuffles(s);
+    unsigned char *planes[3] = { r, g, b };
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32, src += 96) {
+        __m256i v[3];
+        filters_avx2::load32(src, v);
+        for (int c = 0; c < 3; c++) {
+            _mm256_storeu_si256((__m256i *)(planes[c] + i), filters_avx2::channel(v, s, c));
+        }
+    }
+    image_scalar::split3(src, r + i, g + i, b + i, n - i);
+}
+
+M3_TARGET_AVX2 inline void merge3(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                                  unsigned char *dst, size_t n) {
+    __m256i masks[3][3];
+    for (int c = 0; c < 3; c++) {
+        for (int k = 0; k < 3; k++) masks[c][k] = filters_avx2::broadcast16(mergeMasks[c][k]);
+    }
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32, dst += 96) {
+        __m256i pr = _mm256_loadu_si256((const __m256i *)(r + i));
+        __m256i pg = _mm256_loadu_si256((const __m256i *)(g + i));
+        __m256i pb = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i v[3];
+        for (int k = 0; k < 3; k++) {
+            v[k] = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(pr, masks[0][k]),
+                                                   _mm256_shuffle_epi8(pg, masks[1][k])),
+                                   _mm256_shuffle_epi8(pb, masks[2][k]));
+        }
+        filters_avx2::store32(dst, v);
+    }
+    image_scalar::merge3(r + i, g + i, b + i, dst, n - i);
+}
+
+} // namespace image_avx2
+#endif // M3_X86
+
+// Conversão de n pixels de uma linha, por número de canais.
+struct LayoutKernels {
+    SimdLevel level;
+    void (*split3)(const unsigned char *, unsigned char *, unsigned char *, unsigned char *, size_t);
+    void (*merge3)(const unsigned char *, const unsigned char *, const unsigned char *, unsigned char *, size_t);
+    void (*split4)(const unsigned char *, unsigned char *const *, size_t);
+    void (*merge4)(const unsigned char *const *, unsigned char *, size_t);
+};
+
+inline const LayoutKernels &layoutKernels(SimdLevel level) {
+    static const LayoutKernels table[] = {
+        { SIMD_SCALAR, image_scalar::split3, image_scalar::merge3, image_scalar::split4, image_scalar::merge4 },
+#ifdef M3_X86
+        { SIMD_SSE2, image_sse2::split3, image_sse2::merge3, image_sse2::split4, image_sse2::merge4 },
+        // RGBA já é limitado pela memória com SSE2
+        { SIMD_AVX2, image_avx2::split3, image_avx2::merge3, image_sse2::split4, image_sse2::merge4 },
+#endif
+    };
+    if (level > cpuSimdLevel()) level = cpuSimdLevel();
+    return table[level];
+}
+
+inline const LayoutKernels &layoutKernels() {
+    static const LayoutKernels &kernels = layoutKernels(simdLevel());
+    return kernels;
+}
+
+namespace image_detail {
+
+// Conversão genérica de uma linha, para qualquer número de canais.
+template <class Sample>
+inline void convertRowScalar(const ImageView &src, const ImageView &dst, int y) {
+    const int ch = src.channels;
+    const size_t n = (size_t)src.width;
+    for (int c = 0; c < ch; c++) {
+        if (src.isPlanar()) {
+            const Sample *in = (const Sample *)src.row(y, c);
+            Sample *out = (Sample *)dst.row(y);
+            for (size_t i = 0; i < n; i++) out[i * ch + c] = in[i];
+        } else {
+            const Sample *in = (const Sample *)src.row(y);
+            Sample *out = (Sample *)dst.row(y, c);
+            for (size_t i = 0; i < n; i++) out[i] = in[i * ch + c];
+        }
+    }
+}
+
+// Linha y de src (intercalada) para os planos de dst, ou o contrário.
+inline void convertRow(const ImageView &src, const ImageView &dst, int y, const LayoutKernels &k) {
+    const int ch = src.channels;
+    if (src.sampleBytes == 2) {
+        convertRowScalar<uint16_t>(src, dst, y);
+        return;
+    }
+    if (ch != 3 && ch != 4) {
+        convertRowScalar<unsigned char>(src, dst, y);
+        return;
+    }
+    const size_t n = (size_t)src.width;
+    if (!src.isPlanar()) {
+        const unsigned char *in = src.row(y);
+        unsigned char *planes[4];
+        for (int c = 0; c < ch && c < 4; c++) planes[c] = dst.row(y, c);
+        if (ch == 3) {
+            k.split3(in, planes[0], planes[1], planes[2], n);
+        } else {
+            k.split4(in, planes, n);
+        }
+        return;
+    }
+    unsigned char *out = dst.row(y);
+    const unsigned char *planes[4];
+    for (int c = 0; c < ch && c < 4; c++) planes[c] = src.row(y, c);
+    if (ch == 3) {
+        k.merge3(planes[0], planes[1], planes[2], out, n);
+    } else {
+        k.merge4(planes, out, n);
+    }
+}
+
+} // namespace image_detail
+
+// Copia src para dst (mesmo tamanho, canais e bits), convertendo o arranjo se
+// forem diferentes. Linhas em paralelo, em blocos de 64 linhas.
+inline bool copyImage(const ImageView &src, const ImageView &dst, ThreadPool &pool = ThreadPool::shared(),
+                      const LayoutKernels &k = layoutKernels()) {
+    if (src.width != dst.width || src.height != dst.height || src.channels != dst.channels ||
+        src.sampleBytes != dst.sampleBytes) {
+        std::cerr << "copyImage: tamanhos ou canais diferentes" << std::endl;
+        return false;
+    }
+    const int BLOCK = 64;
+    size_t blocks = ((size_t)src.height + BLOCK - 1) / BLOCK;
+    pool.parallelFor(blocks, [&](size_t b) {
+        int y0 = (int)b * BLOCK;
+        int y1 = y0 + BLOCK < src.height ? y0 + BLOCK : src.height;
+        for (int y = y0; y < y1; y++) {
+            if (src.layout != dst.layout) {
+                image_detail::convertRow(src, dst, y, k);
+            } else if (src.isPlanar()) {
+                for (int c = 0; c < src.channels; c++) memcpy(dst.row(y, c), src.row(y, c), src.rowBytes());
+            } else {
+                memcpy(dst.row(y), src.row(y), src.rowBytes());
+            }
+        }
+    });
+    return true;
+}
+
+class Image {
+    unsigned char *storage;
+    ImageView v;
+
+public:
+    static const size_t ALIGNMENT = 64;
+
+    Image() : storage(NULL) {}
+
+    Image(int w, int h, int channels, PixelLayout layout = LAYOUT_INTERLEAVED, int sampleBytes = 1)
+        : storage(NULL) {
+        allocate(w, h, channels, layout, sampleBytes);
+    }
+
+    ~Image() {
+        release();
+    }
+
+    Image(const Image &) = delete;
+    Image &operator=(const Image &) = delete;
+
+    Image(Image &&other) noexcept : storage(other.storage), v(other.v) {
+        other.storage = NULL;
+        other.v = ImageView();
+    }
+
+    Image &operator=(Image &&other) noexcept {
+        if (this != &other) {
+            release();
+            storage = other.storage;
+            v = other.v;
+            other.storage = NULL;
+            other.v = ImageView();
+        }
+        return *this;
+    }
+
+    // Cada linha (de cada plano) começa num múltiplo de ALIGNMENT; o
+    // conteúdo fica indefinido.
+    void allocate(int w, int h, int channels, PixelLayout layout = LAYOUT_INTERLEAVED, int sampleBytes = 1) {
+        release();
+        if (w <= 0 || h <= 0 || channels <= 0 || (sampleBytes != 1 && sampleBytes != 2)) return;
+        size_t row = (size_t)w * sampleBytes * (layout == LAYOUT_PLANAR ? 1 : channels);
+        size_t stride = (row + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        size_t planes = layout == LAYOUT_PLANAR ? (size_t)channels : 1;
+        storage = (unsigned char *)::operator new(stride * h * planes, std::align_val_t(ALIGNMENT));
+        v = ImageView::planar(storage, w, h, channels, stride, stride * h, sampleBytes);
+        if (layout == LAYOUT_INTERLEAVED) {
+            v.layout = LAYOUT_INTERLEAVED;
+            v.planeStride = 0;
+        }
+    }
+
+    void release() {
+        if (storage) ::operator delete(storage, std::align_val_t(ALIGNMENT));
+        storage = NULL;
+        v = ImageView();
+    }
+
+    bool empty() const { return v.empty(); }
+    int width() const { return v.width; }
+    int height() const { return v.height; }
+    int channels() const { return v.channels; }
+    int sampleBytes() const { return v.sampleBytes; }
+    size_t stride() const { return v.stride; }
+    PixelLayout layout() const { return v.layout; }
+
+    const ImageView &view() const {
+        return v;
+    }
+
+    operator const ImageView &() const {
+        return v;
+    }
+
+    ImageView sub(int x, int y, int w, int h) const {
+        return v.sub(x, y, w, h);
+    }
+
+    // Cópia de uma visão qualquer, no arranjo pedido.
+    static Image from(const ImageView &src, PixelLayout layout) {
+        Image out(src.width, src.height, src.channels, layout, src.sampleBytes);
+        if (!out.empty()) copyImage(src, out.view());
+        return out;
+    }
+
+    Image clone() const {
+        return from(v, v.layout);
+    }
+
+    Image toLayout(PixelLayout layout) const {
+        return from(v, layout);
+    }
+};
+
+#endif /* Image_h */
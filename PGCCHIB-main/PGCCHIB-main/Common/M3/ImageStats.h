@@ -0,0 +1,258 @@
+//
+//  ImageStats.h
+//  Histograma por canal, mínimo, máximo, média e distribuição acumulada de
+//  uma imagem de 8 bits por canal, e os filtros de equalização de
+//  histograma e níveis automáticos construídos a partir deles. Imagens de 16
+//  bits por canal não têm histograma nem esses filtros.
+//
+//  Tudo sai de uma única passada pelos pixels: só o histograma é contado, e
+//  mínimo, máximo, média e acumulada são derivados dele (256 entradas por
+//  canal) em finish(). Em paralelo, cada thread conta num histograma
+//  próprio e os histogramas são somados uma vez no fim.
+//
+
+#ifndef ImageStats_h
+#define ImageStats_h
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+#include "ThreadPool.h"
+
+struct ImageStats {
+    static const int MAX_CHANNELS = 4;
+
+    int channels;
+    uint64_t pixels;
+    uint64_t histogram[MAX_CHANNELS][256];
+    // preenchidos por finish()
+    uint64_t cdf[MAX_CHANNELS][256];   // cdf[c][v] = pixels com valor <= v
+    int min[MAX_CHANNELS];
+    int max[MAX_CHANNELS];
+    double mean[MAX_CHANNELS];
+
+    explicit ImageStats(int channels = 3) {
+        clear(channels);
+    }
+
+    void clear(int n) {
+        memset(this, 0, sizeof(*this));
+        channels = n < 1 ? 1 : (n > MAX_CHANNELS ? MAX_CHANNELS : n);
+    }
+
+    void merge(const ImageStats &other) {
+        pixels += other.pixels;
+        for (int c = 0; c < channels; c++) {
+            for (int v = 0; v < 256; v++) histogram[c][v] += other.histogram[c][v];
+        }
+    }
+
+    void finish() {
+        for (int c = 0; c < channels; c++) {
+            uint64_t sum = 0, total = 0;
+            min[c] = 255;
+            max[c] = 0;
+            for (int v = 0; v < 256; v++) {
+                uint64_t n = histogram[c][v];
+                if (n) {
+                    if (v < min[c]) min[c] = v;
+                    max[c] = v;
+                }
+                total += n;
+                sum += n * (uint64_t)v;
+                cdf[c][v] = total;
+            }
+            if (total == 0) min[c] = 0;
+            mean[c] = total ? (double)sum / total : 0.0;
+        }
+    }
+
+    // Menor valor v do canal c com cdf >= fraction * pixels.
+    int percentile(int c, double fraction) const {
+        uint64_t target = (uint64_t)ceil(fraction * pixels);
+        if (target < 1) target = 1;
+        for (int v = 0; v < 256; v++) {
+            if (cdf[c][v] >= target) return v;
+        }
+        return 255;
+    }
+};
+
+// Contagem de histograma em andamento. Oito cópias de 32 bits por canal,
+// uma para cada pixel de um grupo de oito, evitam que incrementos seguidos do
+// mesmo valor (comuns em fotos: céu, fundo liso) esperem um pelo outro; os
+// três canais de oito pixels saem de três leituras de 64 bits. flush() soma
+// as cópias em um ImageStats; com até 2^31 pixels entre dois flush() nenhuma
+// cópia transborda.
+struct HistogramCounter {
+    static const int COPIES = 8;
+    static const size_t FLUSH_PIXELS = (size_t)1 << 31;
+
+    uint32_t count[COPIES][ImageStats::MAX_CHANNELS][256];
+    size_t pending;   // pixels contados desde o último flush()
+
+    void clear() {
+        memset(count, 0, sizeof(count));
+        pending = 0;
+    }
+
+    void add(const unsigned char *data, size_t pixels, int ch) {
+        size_t i = 0;
+        if (ch == 3) {
+            for (; i + 8 <= pixels; i += 8, data += 24) {
+                uint64_t a, b, c;
+                memcpy(&a, data, 8);
+                memcpy(&b, data + 8, 8);
+                memcpy(&c, data + 16, 8);
+                count[0][0][a & 255]++;         count[0][1][(a >> 8) & 255]++;  count[0][2][(a >> 16) & 255]++;
+                count[1][0][(a >> 24) & 255]++; count[1][1][(a >> 32) & 255]++; count[1][2][(a >> 40) & 255]++;
+                count[2][0][(a >> 48) & 255]++; count[2][1][a >> 56]++;         count[2][2][b & 255]++;
+                count[3][0][(b >> 8) & 255]++;  count[3][1][(b >> 16) & 255]++; count[3][2][(b >> 24) & 255]++;
+                count[4][0][(b >> 32) & 255]++; count[4][1][(b >> 40) & 255]++; count[4][2][(b >> 48) & 255]++;
+                count[5][0][b >> 56]++;         count[5][1][c & 255]++;         count[5][2][(c >> 8) & 255]++;
+                count[6][0][(c >> 16) & 255]++; count[6][1][(c >> 24) & 255]++; count[6][2][(c >> 32) & 255]++;
+                count[7][0][(c >> 40) & 255]++; count[7][1][(c >> 48) & 255]++; count[7][2][c >> 56]++;
+            }
+        } else {
+            for (; i + COPIES <= pixels; i += COPIES) {
+                for (int k = 0; k < COPIES; k++) {
+                    for (int c = 0; c < ch; c++) count[k][c][*data++]++;
+                }
+            }
+        }
+        for (; i < pixels; i++) {
+            for (int c = 0; c < ch; c++) count[0][c][*data++]++;
+        }
+        pending += pixels;
+    }
+
+    void flush(ImageStats &stats) {
+        for (int c = 0; c < stats.channels; c++) {
+            for (int v = 0; v < 256; v++) {
+                uint64_t n = 0;
+                for (int k = 0; k < COPIES; k++) n += count[k][c][v];
+                stats.histogram[c][v] += n;
+            }
+        }
+        stats.pixels += pending;
+        clear();
+    }
+};
+
+// Conta pixels de data no histograma de stats.
+inline void accumulateHistogram(const unsigned char *data, size_t pixels, ImageStats &stats) {
+    // 32 KB: fora da pilha, e sem alocar a cada chamada
+    static thread_local HistogramCounter counter;
+    counter.clear();
+    while (pixels > 0) {
+        size_t n = pixels < HistogramCounter::FLUSH_PIXELS ? pixels : HistogramCounter::FLUSH_PIXELS;
+        counter.add(data, n, stats.channels);
+        counter.flush(stats);
+        data += n * stats.channels;
+        pixels -= n;
+    }
+}
+
+// Estatísticas da imagem inteira. Cada thread do pool conta os blocos de
+// 1 M pixels que pegar (distribuídos por um contador atômico) no seu
+// próprio histograma, e os histogramas das threads são somados uma vez no
+// fim.
+inline void computeImageStats(const unsigned char *data, int w, int h, int channels, ImageStats &stats,
+                              ThreadPool &pool = ThreadPool::shared()) {
+    const size_t BLOCK = 1 << 20;
+    size_t pixels = (size_t)w * h;
+    size_t blocks = (pixels + BLOCK - 1) / BLOCK;
+    size_t workers = pool.size() < blocks ? pool.size() : blocks;
+    stats.clear(channels);
+    std::vector<ImageStats> perWorker(workers, ImageStats(channels));
+    std::atomic<size_t> next(0);
+    pool.parallelFor(workers, [&](size_t t) {
+        static thread_local HistogramCounter counter;
+        counter.clear();
+        for (size_t b = next++; b < blocks; b = next++) {
+            size_t first = b * BLOCK;
+            size_t n = first + BLOCK <= pixels ? BLOCK : pixels - first;
+            counter.add(data + first * channels, n, perWorker[t].channels);
+            if (counter.pending + BLOCK > HistogramCounter::FLUSH_PIXELS) counter.flush(perWorker[t]);
+        }
+        counter.flush(perWorker[t]);
+    });
+    for (size_t t = 0; t < workers; t++) stats.merge(perWorker[t]);
+    stats.finish();
+}
+
+// Tabela por canal aplicada a pixels intercalados: equalização e níveis.
+struct LevelsLUT {
+    int channels;
+    unsigned char table[ImageStats::MAX_CHANNELS][256];
+
+    void apply(unsigned char *data, size_t pixels) const {
+        if (channels == 3) {
+            const unsigned char *r = table[0], *g = table[1], *b = table[2];
+            for (size_t i = 0; i < pixels; i++, data += 3) {
+                data[0] = r[data[0]];
+                data[1] = g[data[1]];
+                data[2] = b[data[2]];
+            }
+            return;
+        }
+        for (size_t i = 0; i < pixels; i++) {
+            for (int c = 0; c < channels; c++, data++) *data = table[c][*data];
+        }
+    }
+};
+
+// Equalização de histograma por canal: v -> (cdf(v) - cdf(min)) / (n - cdf(min)).
+inline LevelsLUT makeEqualize(const ImageStats &stats) {
+    LevelsLUT lut;
+    lut.channels = stats.channels;
+    for (int c = 0; c < stats.channels; c++) {
+        uint64_t low = stats.pixels ? stats.cdf[c][stats.min[c]] : 0;
+        uint64_t range = stats.pixels - low;
+        for (int v = 0; v < 256; v++) {
+            uint64_t above = stats.cdf[c][v] > low ? stats.cdf[c][v] - low : 0;
+            lut.table[c][v] = range ? (unsigned char)((above * 255 + range / 2) / range) : (unsigned char)v;
+        }
+    }
+    return lut;
+}
+
+// Níveis automáticos: estica [percentil clip, percentil 1 - clip] de cada
+// canal para [0, 255]. linked = true usa o mesmo intervalo nos canais (não
+// muda o equilíbrio de cor).
+inline LevelsLUT makeAutoLevels(const ImageStats &stats, double clip = 0.005, bool linked = false) {
+    LevelsLUT lut;
+    lut.channels = stats.channels;
+    int lo[ImageStats::MAX_CHANNELS], hi[ImageStats::MAX_CHANNELS];
+    for (int c = 0; c < stats.channels; c++) {
+        lo[c] = stats.percentile(c, clip);
+        hi[c] = stats.percentile(c, 1.0 - clip);
+    }
+    if (linked) {
+        for (int c = 1; c < stats.channels; c++) {
+            if (lo[c] < lo[0]) lo[0] = lo[c];
+            if (hi[c] > hi[0]) hi[0] = hi[c];
+        }
+        for (int c = 1; c < stats.channels; c++) {
+            lo[c] = lo[0];
+            hi[c] = hi[0];
+        }
+    }
+    for (int c = 0; c < stats.channels; c++) {
+        int range = hi[c] - lo[c];
+        for (int v = 0; v < 256; v++) {
+            int out = v;
+            if (range > 0) {
+                int x = v < lo[c] ? 0 : (v > hi[c] ? range : v - lo[c]);
+                out = (x * 255 + range / 2) / range;
+            }
+            lut.table[c][v] = (unsigned char)out;
+        }
+    }
+    return lut;
+}
+
+#endif /* ImageStats_h */
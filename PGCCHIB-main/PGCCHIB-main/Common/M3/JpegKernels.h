@@ -0,0 +1,528 @@
+//
+//  JpegKernels.h
+//  Kernels do decodificador JPEG vendorizado (M5_Material/stb_image.cpp),
+//  instalados pelos ganchos stbi_install_* dele.
+//
+//  IDCT 8x8 com a dequantização junto: a mesma DCT_ISLOW inteira do stb
+//  (constantes em 12 bits, dois bits extras entre as passadas). As versões
+//  SSE2/AVX2 reescrevem cada soma de produtos da passada como pares
+//  (a, b) . (ka, kb) para madd_epi16; como (a + b) * k = a * k + b * k em
+//  inteiros, o resultado é o mesmo bit a bit desde que os coeficientes
+//  dequantizados e os valores entre as passadas caibam em 16 bits com sinal,
+//  o que vale para todo JPEG baseline de 8 bits válido (|coef| <= 2^11 + q/2
+//  e a primeira passada multiplica por no máximo 8 * 4). Fora disso (arquivo
+//  corrompido) a saída SIMD pode diferir, mas continua limitada a 0..255.
+//
+//  Ampliação do croma (a interpolação 3:1 do stb em H, V e H+V) e YCbCr ->
+//  RGB na assinatura de stbi_YCbCr_to_RGB_run (as contas ficam em
+//  ColorConvert.h). As ampliações trabalham sobre um trecho da linha, para
+//  que o decodificador amplie e converta pedaços que cabem no L1; os
+//  resultados são os mesmos bytes do stb em todos os níveis.
+//
+
+#ifndef JpegKernels_h
+#define JpegKernels_h
+
+#include <stddef.h>
+
+#include "CpuFeatures.h"
+#include "ColorConvert.h"
+
+// A assinatura de stbi_idct_8x8: 64 coeficientes em ordem natural
+// (linha a linha), dequantize com os 64 passos de quantização na mesma
+// ordem; grava 8 linhas de 8 bytes com out_stride entre elas.
+typedef void (*IdctKernel)(unsigned char *out, int outStride, short data[64], unsigned short *dequantize);
+
+// Amplia as amostras [begin, end) de uma linha de croma com w amostras,
+// gravando a partir de out[0] duas saídas por amostra (H2, HV2) ou uma (V2).
+// near é a linha de croma mais próxima da de saída e far a vizinha (só V2 e
+// HV2 usam). Fora da linha repete-se a amostra da borda, o que reproduz os
+// casos especiais das pontas no stb (mais um em h2, ver lá).
+typedef void (*UpsampleSpan)(unsigned char *out, const unsigned char *near, const unsigned char *far, int w,
+                             int begin, int end);
+
+// A assinatura de stbi_YCbCr_to_RGB_run: count pixels, step 3 ou 4 (alfa 255).
+typedef void (*YCbCrRowKernel)(unsigned char *out, const unsigned char *y, const unsigned char *cb,
+                               const unsigned char *cr, int count, int step);
+
+namespace idct_detail {
+
+// f2f do stb: arredondamento de x * 4096 truncado para int.
+constexpr int fix(double x) {
+    return (int)(x * 4096 + 0.5);
+}
+
+const int C0_541 = fix(0.5411961), CM1_847 = fix(-1.847759065), C0_765 = fix(0.765366865);
+const int C1_175 = fix(1.175875602);
+const int C0_298 = fix(0.298631336), C2_053 = fix(2.053119869), C3_072 = fix(3.072711026), C1_501 = fix(1.501321110);
+const int CM0_899 = fix(-0.899976223), CM2_562 = fix(-2.562915447), CM1_961 = fix(-1.961570560);
+const int CM0_390 = fix(-0.390180644);
+
+// Passada 1: arredonda tirando 10 dos 12 bits das constantes. Passada 2:
+// tira os 17 bits restantes (12 + 2 + 3 da escala sqrt(8) * sqrt(8)) e
+// soma 128 para ir de -128..127 a 0..255.
+const int PASS1_BIAS = 512, PASS1_SHIFT = 10;
+const int PASS2_BIAS = 65536 + (128 << 17), PASS2_SHIFT = 17;
+
+inline unsigned char clampByte(int v) {
+    return (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+} // namespace idct_detail
+
+/*---------------------------------ESCALAR----------------------------------*/
+namespace idct_scalar {
+
+using namespace idct_detail;
+
+// IDCT 1D de s[0..7] (passo step); out[k * step] = (x + t + bias) >> shift.
+inline void idct1D(const int *s, int step, int *out, int bias, int shift) {
+    int p1 = (s[2 * step] + s[6 * step]) * C0_541;
+    int t2 = p1 + s[6 * step] * CM1_847;
+    int t3 = p1 + s[2 * step] * C0_765;
+    int t0 = (s[0] + s[4 * step]) * 4096;
+    int t1 = (s[0] - s[4 * step]) * 4096;
+    int x0 = t0 + t3 + bias, x3 = t0 - t3 + bias;
+    int x1 = t1 + t2 + bias, x2 = t1 - t2 + bias;
+
+    int o0 = s[7 * step], o1 = s[5 * step], o2 = s[3 * step], o3 = s[step];
+    int p3 = o0 + o2, p4 = o1 + o3;
+    int p5 = (p3 + p4) * C1_175;
+    p1 = p5 + (o0 + o3) * CM0_899;
+    int p2 = p5 + (o1 + o2) * CM2_562;
+    p3 *= CM1_961;
+    p4 *= CM0_390;
+    o0 = o0 * C0_298 + p1 + p3;
+    o1 = o1 * C2_053 + p2 + p4;
+    o2 = o2 * C3_072 + p2 + p3;
+    o3 = o3 * C1_501 + p1 + p4;
+
+    out[0] = (x0 + o3) >> shift;
+    out[7 * step] = (x0 - o3) >> shift;
+    out[step] = (x1 + o2) >> shift;
+    out[6 * step] = (x1 - o2) >> shift;
+    out[2 * step] = (x2 + o1) >> shift;
+    out[5 * step] = (x2 - o1) >> shift;
+    out[3 * step] = (x3 + o0) >> shift;
+    out[4 * step] = (x3 - o0) >> shift;
+}
+
+inline void idct8x8(unsigned char *out, int outStride, short data[64], unsigned short *dequantize) {
+    int in[64], mid[64], row[8];
+    for (int i = 0; i < 64; i++) in[i] = data[i] * dequantize[i];
+    for (int x = 0; x < 8; x++) idct1D(in + x, 8, mid + x, PASS1_BIAS, PASS1_SHIFT);
+    for (int y = 0; y < 8; y++, out += outStride) {
+        idct1D(mid + y * 8, 1, row, PASS2_BIAS, PASS2_SHIFT);
+        for (int x = 0; x < 8; x++) out[x] = clampByte(row[x]);
+    }
+}
+
+} // namespace idct_scalar
+
+namespace upsample_scalar {
+
+// out = (3 * near + far + 2) / 4
+inline void v2(unsigned char *out, const unsigned char *near, const unsigned char *far, int w, int begin, int end) {
+    (void)w;
+    for (int i = begin; i < end; i++) out[i - begin] = (unsigned char)((3 * near[i] + far[i] + 2) >> 2);
+}
+
+// out[2i] = (3 * in[i] + in[i - 1] + 2) / 4, out[2i + 1] = (3 * in[i] + in[i + 1] + 2) / 4.
+// Na última amostra o stb troca os pesos de out[2i] (3 * in[w - 2] + in[w - 1]);
+// mantido para dar os mesmos bytes.
+inline void h2(unsigned char *out, const unsigned char *in, const unsigned char *far, int w, int begin, int end) {
+    (void)far;
+    for (int i = begin; i < end; i++, out += 2) {
+        int n = 3 * in[i] + 2;
+        out[0] = (unsigned char)((n + in[i > 0 ? i - 1 : 0]) >> 2);
+        out[1] = (unsigned char)((n + in[i < w - 1 ? i + 1 : w - 1]) >> 2);
+        if (i == w - 1 && w > 1) out[0] = (unsigned char)((3 * in[w - 2] + in[w - 1] + 2) >> 2);
+    }
+}
+
+// Como h2 sobre t = 3 * near + far, dividindo por 16.
+inline void hv2(unsigned char *out, const unsigned char *near, const unsigned char *far, int w, int begin, int end) {
+    for (int i = begin; i < end; i++, out += 2) {
+        int l = i > 0 ? i - 1 : 0, r = i < w - 1 ? i + 1 : w - 1;
+        int n = 3 * (3 * near[i] + far[i]) + 8;
+        out[0] = (unsigned char)((n + 3 * near[l] + far[l]) >> 4);
+        out[1] = (unsigned char)((n + 3 * near[r] + far[r]) >> 4);
+    }
+}
+
+} // namespace upsample_scalar
+
+#ifdef M3_X86
+/*-----------------------------------SSE2-----------------------------------*/
+namespace idct_sse2 {
+
+using namespace idct_detail;
+
+M3_TARGET_SSE2 inline __m128i pair(int a, int b) {
+    return _mm_set1_epi32((int)(((unsigned)a & 0xffff) | ((unsigned)b << 16)));
+}
+
+// Transposição 8x8 de inteiros de 16 bits.
+M3_TARGET_SSE2 inline void transpose(__m128i r[8]) {
+    __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]), a1 = _mm_unpackhi_epi16(r[0], r[1]);
+    __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]), a3 = _mm_unpackhi_epi16(r[2], r[3]);
+    __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]), a5 = _mm_unpackhi_epi16(r[4], r[5]);
+    __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]), a7 = _mm_unpackhi_epi16(r[6], r[7]);
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+    r[0] = _mm_unpacklo_epi64(b0, b4);
+    r[1] = _mm_unpackhi_epi64(b0, b4);
+    r[2] = _mm_unpacklo_epi64(b1, b5);
+    r[3] = _mm_unpackhi_epi64(b1, b5);
+    r[4] = _mm_unpacklo_epi64(b2, b6);
+    r[5] = _mm_unpackhi_epi64(b2, b6);
+    r[6] = _mm_unpacklo_epi64(b3, b7);
+    r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+// Somas de produtos da IDCT 1D em pares para madd: cada uma é
+// (a, b) . (ka, kb), expandindo os p1..p5 do stb.
+struct Pairs {
+    __m128i t2, t3, even0, even1;       // (s2, s6) e (s0, s4)
+    __m128i o0a, o0b, o1a, o1b;         // (s7, s5) e (s3, s1)
+    __m128i o2a, o2b, o3a, o3b;
+};
+
+M3_TARGET_SSE2 inline Pairs makePairs() {
+    Pairs k;
+    k.t2 = pair(C0_541, C0_541 + CM1_847);
+    k.t3 = pair(C0_541 + C0_765, C0_541);
+    k.even0 = pair(4096, 4096);
+    k.even1 = pair(4096, -4096);
+    k.o0a = pair(C0_298 + CM0_899 + CM1_961 + C1_175, C1_175);
+    k.o0b = pair(CM1_961 + C1_175, CM0_899 + C1_175);
+    k.o1a = pair(C1_175, C2_053 + CM2_562 + CM0_390 + C1_175);
+    k.o1b = pair(CM2_562 + C1_175, CM0_390 + C1_175);
+    k.o2a = pair(CM1_961 + C1_175, CM2_562 + C1_175);
+    k.o2b = pair(C3_072 + CM2_562 + CM1_961 + C1_175, C1_175);
+    k.o3a = pair(CM0_899 + C1_175, CM0_390 + C1_175);
+    k.o3b = pair(C1_175, C1_501 + CM0_899 + CM0_390 + C1_175);
+    return k;
+}
+
+// Quatro colunas (metade baixa ou alta dos registradores) da IDCT 1D, com
+// s26 = (s2, s6), s04 = (s0, s4), s75 = (s7, s5), s31 = (s3, s1) já
+// intercalados; out[k] recebe 4 resultados de 32 bits da linha k.
+M3_TARGET_SSE2 inline void half1D(__m128i s26, __m128i s04, __m128i s75, __m128i s31, const Pairs &k,
+                                  __m128i bias, int shift, __m128i out[8]) {
+    __m128i t2 = _mm_madd_epi16(s26, k.t2), t3 = _mm_madd_epi16(s26, k.t3);
+    __m128i t0 = _mm_add_epi32(_mm_madd_epi16(s04, k.even0), bias);
+    __m128i t1 = _mm_add_epi32(_mm_madd_epi16(s04, k.even1), bias);
+    __m128i x0 = _mm_add_epi32(t0, t3), x3 = _mm_sub_epi32(t0, t3);
+    __m128i x1 = _mm_add_epi32(t1, t2), x2 = _mm_sub_epi32(t1, t2);
+    __m128i o0 = _mm_add_epi32(_mm_madd_epi16(s75, k.o0a), _mm_madd_epi16(s31, k.o0b));
+    __m128i o1 = _mm_add_epi32(_mm_madd_epi16(s75, k.o1a), _mm_madd_epi16(s31, k.o1b));
+    __m128i o2 = _mm_add_epi32(_mm_madd_epi16(s75, k.o2a), _mm_madd_epi16(s31, k.o2b));
+    __m128i o3 = _mm_add_epi32(_mm_madd_epi16(s75, k.o3a), _mm_madd_epi16(s31, k.o3b));
+    out[0] = _mm_srai_epi32(_mm_add_epi32(x0, o3), shift);
+    out[7] = _mm_srai_epi32(_mm_sub_epi32(x0, o3), shift);
+    out[1] = _mm_srai_epi32(_mm_add_epi32(x1, o2), shift);
+    out[6] = _mm_srai_epi32(_mm_sub_epi32(x1, o2), shift);
+    out[2] = _mm_srai_epi32(_mm_add_epi32(x2, o1), shift);
+    out[5] = _mm_srai_epi32(_mm_sub_epi32(x2, o1), shift);
+    out[3] = _mm_srai_epi32(_mm_add_epi32(x3, o0), shift);
+    out[4] = _mm_srai_epi32(_mm_sub_epi32(x3, o0), shift);
+}
+
+// IDCT 1D das 8 colunas: r[k] é a entrada k de cada coluna e volta com a
+// saída k, saturada em 16 bits.
+M3_TARGET_SSE2 inline void pass(__m128i r[8], const Pairs &k, int bias, int shift) {
+    const __m128i b = _mm_set1_epi32(bias);
+    __m128i lo[8], hi[8];
+    half1D(_mm_unpacklo_epi16(r[2], r[6]), _mm_unpacklo_epi16(r[0], r[4]), _mm_unpacklo_epi16(r[7], r[5]),
+           _mm_unpacklo_epi16(r[3], r[1]), k, b, shift, lo);
+    half1D(_mm_unpackhi_epi16(r[2], r[6]), _mm_unpackhi_epi16(r[0], r[4]), _mm_unpackhi_epi16(r[7], r[5]),
+           _mm_unpackhi_epi16(r[3], r[1]), k, b, shift, hi);
+    for (int i = 0; i < 8; i++) r[i] = _mm_packs_epi32(lo[i], hi[i]);
+}
+
+M3_TARGET_SSE2 inline void idct8x8(unsigned char *out, int outStride, short data[64], unsigned short *dequantize) {
+    static const Pairs k = makePairs();
+    __m128i r[8];
+    for (int i = 0; i < 8; i++) {
+        r[i] = _mm_mullo_epi16(_mm_loadu_si128((const __m128i *)(data + i * 8)),
+                               _mm_loadu_si128((const __m128i *)(dequantize + i * 8)));
+    }
+    pass(r, k, PASS1_BIAS, PASS1_SHIFT);
+    transpose(r);
+    pass(r, k, PASS2_BIAS, PASS2_SHIFT);
+    transpose(r);
+    for (int i = 0; i < 8; i += 2) {
+        __m128i bytes = _mm_packus_epi16(r[i], r[i + 1]);
+        _mm_storel_epi64((__m128i *)(out + i * outStride), bytes);
+        _mm_storel_epi64((__m128i *)(out + (i + 1) * outStride), _mm_srli_si128(bytes, 8));
+    }
+}
+
+} // namespace idct_sse2
+
+namespace upsample_sse2 {
+
+// As contas em 16 bits (no máximo 3 * 1020 + 1020 + 8), 16 amostras por vez;
+// as pontas da linha ficam com a escalar.
+M3_TARGET_SSE2 inline void v2(unsigned char *out, const unsigned char *near, const unsigned char *far, int w,
+                              int begin, int end) {
+    const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+    int i = begin;
+    for (; i + 16 <= end; i += 16) {
+        __m128i n = _mm_loadu_si128((const __m128i *)(near + i)), f = _mm_loadu_si128((const __m128i *)(far + i));
+        __m128i nl = _mm_unpacklo_epi8(n, zero), nh = _mm_unpackhi_epi8(n, zero);
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(nl, nl), nl), _mm_add_epi16(_mm_unpacklo_epi8(f, zero), two));
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(nh, nh), nh), _mm_add_epi16(_mm_unpackhi_epi8(f, zero), two));
+        _mm_storeu_si128((__m128i *)(out + i - begin), _mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2)));
+    }
+    upsample_scalar::v2(out + i - begin, near, far, w, i, end);
+}
+
+// Grava as 32 saídas de 16 amostras: a[k] e b[k] intercalados.
+M3_TARGET_SSE2 inline void storePairs(unsigned char *out, __m128i aLo, __m128i aHi, __m128i bLo, __m128i bHi) {
+    __m128i a = _mm_packus_epi16(aLo, aHi), b = _mm_packus_epi16(bLo, bHi);
+    _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi8(a, b));
+    _mm_storeu_si128((__m128i *)(out + 16), _mm_unpackhi_epi8(a, b));
+}
+
+M3_TARGET_SSE2 inline void h2(unsigned char *out, const unsigned char *in, const unsigned char *far, int w, int begin,
+                              int end) {
+    const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+    int i = begin;
+    if (i == 0 && end > 0) {
+        upsample_scalar::h2(out, in, far, w, 0, 1);
+        i = 1;
+    }
+    for (; i + 16 <= end && i + 16 < w; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i l = _mm_loadu_si128((const __m128i *)(in + i - 1)), r = _mm_loadu_si128((const __m128i *)(in + i + 1));
+        __m128i cl = _mm_unpacklo_epi8(c, zero), ch = _mm_unpackhi_epi8(c, zero);
+        __m128i nl = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(cl, cl), cl), two);
+        __m128i nh = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(ch, ch), ch), two);
+        storePairs(out + 2 * (i - begin), _mm_srli_epi16(_mm_add_epi16(nl, _mm_unpacklo_epi8(l, zero)), 2),
+                   _mm_srli_epi16(_mm_add_epi16(nh, _mm_unpackhi_epi8(l, zero)), 2),
+                   _mm_srli_epi16(_mm_add_epi16(nl, _mm_unpacklo_epi8(r, zero)), 2),
+                   _mm_srli_epi16(_mm_add_epi16(nh, _mm_unpackhi_epi8(r, zero)), 2));
+    }
+    upsample_scalar::h2(out + 2 * (i - begin), in, far, w, i, end);
+}
+
+// t = 3 * near + far das 16 amostras a partir de i, em duas metades.
+M3_TARGET_SSE2 inline void vertical(const unsigned char *near, const unsigned char *far, int i, __m128i &lo,
+                                    __m128i &hi) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i n = _mm_loadu_si128((const __m128i *)(near + i)), f = _mm_loadu_si128((const __m128i *)(far + i));
+    __m128i nl = _mm_unpacklo_epi8(n, zero), nh = _mm_unpackhi_epi8(n, zero);
+    lo = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(nl, nl), nl), _mm_unpacklo_epi8(f, zero));
+    hi = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(nh, nh), nh), _mm_unpackhi_epi8(f, zero));
+}
+
+M3_TARGET_SSE2 inline void hv2(unsigned char *out, const unsigned char *near, const unsigned char *far, int w,
+                               int begin, int end) {
+    const __m128i eight = _mm_set1_epi16(8);
+    int i = begin;
+    if (i == 0 && end > 0) {
+        upsample_scalar::hv2(out, near, far, w, 0, 1);
+        i = 1;
+    }
+    for (; i + 16 <= end && i + 16 < w; i += 16) {
+        __m128i cl, ch, ll, lh, rl, rh;
+        vertical(near, far, i, cl, ch);
+        vertical(near, far, i - 1, ll, lh);
+        vertical(near, far, i + 1, rl, rh);
+        __m128i nl = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(cl, cl), cl), eight);
+        __m128i nh = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(ch, ch), ch), eight);
+        storePairs(out + 2 * (i - begin), _mm_srli_epi16(_mm_add_epi16(nl, ll), 4),
+                   _mm_srli_epi16(_mm_add_epi16(nh, lh), 4), _mm_srli_epi16(_mm_add_epi16(nl, rl), 4),
+                   _mm_srli_epi16(_mm_add_epi16(nh, rh), 4));
+    }
+    upsample_scalar::hv2(out + 2 * (i - begin), near, far, w, i, end);
+}
+
+} // namespace upsample_sse2
+
+/*-----------------------------------AVX2-----------------------------------*/
+namespace idct_avx2 {
+
+using namespace idct_detail;
+
+// Como a SSE2, mas as 8 colunas de cada par ficam num só registrador de
+// 256 bits: metade das operações de 32 bits.
+struct Pairs {
+    __m256i t2, t3, even0, even1;
+    __m256i o0a, o0b, o1a, o1b;
+    __m256i o2a, o2b, o3a, o3b;
+};
+
+M3_TARGET_AVX2 inline __m256i widen(__m128i k) {
+    return _mm256_broadcastsi128_si256(k);
+}
+
+M3_TARGET_AVX2 inline Pairs makePairs() {
+    idct_sse2::Pairs s = idct_sse2::makePairs();
+    Pairs k;
+    k.t2 = widen(s.t2); k.t3 = widen(s.t3); k.even0 = widen(s.even0); k.even1 = widen(s.even1);
+    k.o0a = widen(s.o0a); k.o0b = widen(s.o0b); k.o1a = widen(s.o1a); k.o1b = widen(s.o1b);
+    k.o2a = widen(s.o2a); k.o2b = widen(s.o2b); k.o3a = widen(s.o3a); k.o3b = widen(s.o3b);
+    return k;
+}
+
+// (a, b) das colunas 0-3 na metade baixa e 4-7 na alta.
+M3_TARGET_AVX2 inline __m256i interleave(__m128i a, __m128i b) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(a, b)), _mm_unpackhi_epi16(a, b), 1);
+}
+
+M3_TARGET_AVX2 inline __m128i narrow(__m256i v) {
+    return _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+M3_TARGET_AVX2 inline void pass(__m128i r[8], const Pairs &k, int bias, int shift) {
+    const __m256i b = _mm256_set1_epi32(bias);
+    __m256i s26 = interleave(r[2], r[6]), s04 = interleave(r[0], r[4]);
+    __m256i s75 = interleave(r[7], r[5]), s31 = interleave(r[3], r[1]);
+    __m256i t2 = _mm256_madd_epi16(s26, k.t2), t3 = _mm256_madd_epi16(s26, k.t3);
+    __m256i t0 = _mm256_add_epi32(_mm256_madd_epi16(s04, k.even0), b);
+    __m256i t1 = _mm256_add_epi32(_mm256_madd_epi16(s04, k.even1), b);
+    __m256i x0 = _mm256_add_epi32(t0, t3), x3 = _mm256_sub_epi32(t0, t3);
+    __m256i x1 = _mm256_add_epi32(t1, t2), x2 = _mm256_sub_epi32(t1, t2);
+    __m256i o0 = _mm256_add_epi32(_mm256_madd_epi16(s75, k.o0a), _mm256_madd_epi16(s31, k.o0b));
+    __m256i o1 = _mm256_add_epi32(_mm256_madd_epi16(s75, k.o1a), _mm256_madd_epi16(s31, k.o1b));
+    __m256i o2 = _mm256_add_epi32(_mm256_madd_epi16(s75, k.o2a), _mm256_madd_epi16(s31, k.o2b));
+    __m256i o3 = _mm256_add_epi32(_mm256_madd_epi16(s75, k.o3a), _mm256_madd_epi16(s31, k.o3b));
+    r[0] = narrow(_mm256_srai_epi32(_mm256_add_epi32(x0, o3), shift));
+    r[7] = narrow(_mm256_srai_epi32(_mm256_sub_epi32(x0, o3), shift));
+    r[1] = narrow(_mm256_srai_epi32(_mm256_add_epi32(x1, o2), shift));
+    r[6] = narrow(_mm256_srai_epi32(_mm256_sub_epi32(x1, o2), shift));
+    r[2] = narrow(_mm256_srai_epi32(_mm256_add_epi32(x2, o1), shift));
+    r[5] = narrow(_mm256_srai_epi32(_mm256_sub_epi32(x2, o1), shift));
+    r[3] = narrow(_mm256_srai_epi32(_mm256_add_epi32(x3, o0), shift));
+    r[4] = narrow(_mm256_srai_epi32(_mm256_sub_epi32(x3, o0), shift));
+}
+
+M3_TARGET_AVX2 inline void idct8x8(unsigned char *out, int outStride, short data[64], unsigned short *dequantize) {
+    static const Pairs k = makePairs();
+    __m128i r[8];
+    for (int i = 0; i < 8; i += 2) {
+        __m256i d = _mm256_mullo_epi16(_mm256_loadu_si256((const __m256i *)(data + i * 8)),
+                                       _mm256_loadu_si256((const __m256i *)(dequantize + i * 8)));
+        r[i] = _mm256_castsi256_si128(d);
+        r[i + 1] = _mm256_extracti128_si256(d, 1);
+    }
+    pass(r, k, PASS1_BIAS, PASS1_SHIFT);
+    idct_sse2::transpose(r);
+    pass(r, k, PASS2_BIAS, PASS2_SHIFT);
+    idct_sse2::transpose(r);
+    for (int i = 0; i < 8; i += 2) {
+        __m128i bytes = _mm_packus_epi16(r[i], r[i + 1]);
+        _mm_storel_epi64((__m128i *)(out + i * outStride), bytes);
+        _mm_storel_epi64((__m128i *)(out + (i + 1) * outStride), _mm_srli_si128(bytes, 8));
+    }
+}
+
+} // namespace idct_avx2
+
+namespace upsample_avx2 {
+
+// h2 e hv2 fazem 16 amostras por vez num registrador de 16 bits; unpack e
+// packus por metades de 128 bits já deixam as 32 saídas em ordem.
+M3_TARGET_AVX2 inline __m256i load16(const unsigned char *p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+}
+
+M3_TARGET_AVX2 inline __m256i times3(__m256i v) {
+    return _mm256_add_epi16(_mm256_add_epi16(v, v), v);
+}
+
+M3_TARGET_AVX2 inline void storePairs(unsigned char *out, __m256i a, __m256i b) {
+    __m256i bytes = _mm256_packus_epi16(_mm256_unpacklo_epi16(a, b), _mm256_unpackhi_epi16(a, b));
+    _mm256_storeu_si256((__m256i *)out, bytes);
+}
+
+M3_TARGET_AVX2 inline void v2(unsigned char *out, const unsigned char *near, const unsigned char *far, int w,
+                              int begin, int end) {
+    const __m256i two = _mm256_set1_epi16(2);
+    int i = begin;
+    for (; i + 32 <= end; i += 32) {
+        __m256i lo = _mm256_add_epi16(_mm256_add_epi16(times3(load16(near + i)), load16(far + i)), two);
+        __m256i hi = _mm256_add_epi16(_mm256_add_epi16(times3(load16(near + i + 16)), load16(far + i + 16)), two);
+        __m256i bytes = _mm256_packus_epi16(_mm256_srli_epi16(lo, 2), _mm256_srli_epi16(hi, 2));
+        _mm256_storeu_si256((__m256i *)(out + i - begin), _mm256_permute4x64_epi64(bytes, 0xd8));
+    }
+    upsample_sse2::v2(out + i - begin, near, far, w, i, end);
+}
+
+M3_TARGET_AVX2 inline void h2(unsigned char *out, const unsigned char *in, const unsigned char *far, int w, int begin,
+                              int end) {
+    const __m256i two = _mm256_set1_epi16(2);
+    int i = begin;
+    if (i == 0 && end > 0) {
+        upsample_scalar::h2(out, in, far, w, 0, 1);
+        i = 1;
+    }
+    for (; i + 16 <= end && i + 16 < w; i += 16) {
+        __m256i n = _mm256_add_epi16(times3(load16(in + i)), two);
+        storePairs(out + 2 * (i - begin), _mm256_srli_epi16(_mm256_add_epi16(n, load16(in + i - 1)), 2),
+                   _mm256_srli_epi16(_mm256_add_epi16(n, load16(in + i + 1)), 2));
+    }
+    upsample_scalar::h2(out + 2 * (i - begin), in, far, w, i, end);
+}
+
+M3_TARGET_AVX2 inline void hv2(unsigned char *out, const unsigned char *near, const unsigned char *far, int w,
+                               int begin, int end) {
+    const __m256i eight = _mm256_set1_epi16(8);
+    int i = begin;
+    if (i == 0 && end > 0) {
+        upsample_scalar::hv2(out, near, far, w, 0, 1);
+        i = 1;
+    }
+    for (; i + 16 <= end && i + 16 < w; i += 16) {
+        __m256i n = _mm256_add_epi16(times3(_mm256_add_epi16(times3(load16(near + i)), load16(far + i))), eight);
+        __m256i l = _mm256_add_epi16(times3(load16(near + i - 1)), load16(far + i - 1));
+        __m256i r = _mm256_add_epi16(times3(load16(near + i + 1)), load16(far + i + 1));
+        storePairs(out + 2 * (i - begin), _mm256_srli_epi16(_mm256_add_epi16(n, l), 4),
+                   _mm256_srli_epi16(_mm256_add_epi16(n, r), 4));
+    }
+    upsample_scalar::hv2(out + 2 * (i - begin), near, far, w, i, end);
+}
+
+} // namespace upsample_avx2
+#endif
+
+// stb passa count como int e o y, cb, cr antes da saída.
+template <SimdLevel L>
+void ycbcrRow(unsigned char *out, const unsigned char *y, const unsigned char *cb, const unsigned char *cr, int count,
+              int step) {
+    color_rows::ycbcrToRgb<L>(y, cb, cr, out, (size_t)count, step);
+}
+
+struct JpegKernels {
+    SimdLevel level;
+    IdctKernel idct;
+    UpsampleSpan upsampleV2, upsampleH2, upsampleHV2;
+    YCbCrRowKernel ycbcrToRgb;
+};
+
+inline const JpegKernels &jpegKernels(SimdLevel level) {
+    static const JpegKernels table[] = {
+        { SIMD_SCALAR, idct_scalar::idct8x8, upsample_scalar::v2, upsample_scalar::h2, upsample_scalar::hv2,
+          ycbcrRow<SIMD_SCALAR> },
+#ifdef M3_X86
+        { SIMD_SSE2, idct_sse2::idct8x8, upsample_sse2::v2, upsample_sse2::h2, upsample_sse2::hv2,
+          ycbcrRow<SIMD_SSE2> },
+        { SIMD_AVX2, idct_avx2::idct8x8, upsample_avx2::v2, upsample_avx2::h2, upsample_avx2::hv2,
+          ycbcrRow<SIMD_AVX2> },
+#endif
+    };
+    if (level > cpuSimdLevel()) level = cpuSimdLevel();
+    return table[level];
+}
+
+inline const JpegKernels &jpegKernels() {
+    static const JpegKernels &kernels = jpegKernels(simdLevel());
+    return kernels;
+}
+
+#endif /* JpegKernels_h */
@@ -0,0 +1,311 @@
+//
+//  Mipmap.h
+//  Redimensionamento de imagens de 8 bits por canal (1 a 4 canais) com
+//  filtros box, triângulo e Lanczos-3, e geração da cadeia de mipmaps na
+//  CPU, para substituir o glGenerateMipmap.
+//
+//  Os canais de cor são tratados como sRGB: cada amostra é convertida para
+//  luz linear (tabela de 256 floats) antes de filtrar e reconvertida no fim,
+//  o que evita o escurecimento de detalhes finos que a média direta dos
+//  valores sRGB produz. Com alfa (2 ou 4 canais) a cor é pré-multiplicada
+//  pelo alfa durante a filtragem, para bordas transparentes não sangrarem.
+//
+//  O filtro é separável: a passada horizontal gera linhas em float RGBA
+//  (um __m128 por pixel) e a vertical combina essas linhas com o mesmo laço
+//  de Convolution.h. Cada nível é dividido em faixas de linhas de saída,
+//  processadas em paralelo no ThreadPool.
+//
+
+#ifndef Mipmap_h
+#define Mipmap_h
+
+#include <math.h>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+#include "Convolution.h"
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+
+enum ResampleFilter {
+    RESAMPLE_BOX,
+    RESAMPLE_TRIANGLE,
+    RESAMPLE_LANCZOS3
+};
+
+struct ResampleOptions {
+    ResampleFilter filter;
+    bool srgb;              // cor em sRGB (filtra em luz linear)
+    bool premultiplyAlpha;  // com 2 ou 4 canais, o último é alfa
+
+    ResampleOptions(ResampleFilter filter = RESAMPLE_TRIANGLE, bool srgb = true, bool premultiplyAlpha = true)
+        : filter(filter), srgb(srgb), premultiplyAlpha(premultiplyAlpha) {}
+};
+
+struct MipLevel {
+    int level;
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;   // linhas sem preenchimento
+};
+
+namespace mip_detail {
+
+inline double sinc(double x) {
+    if (fabs(x) < 1e-8) return 1.0;
+    x *= 3.14159265358979323846;
+    return sin(x) / x;
+}
+
+inline double filterSupport(ResampleFilter f) {
+    switch (f) {
+        case RESAMPLE_BOX: return 0.5;
+        case RESAMPLE_TRIANGLE: return 1.0;
+        default: return 3.0;
+    }
+}
+
+inline double filterWeight(ResampleFilter f, double x) {
+    // box em [-0.5, 0.5): cada entrada cai em exatamente uma saída
+    if (f == RESAMPLE_BOX) return x >= -0.5 && x < 0.5 ? 1.0 : 0.0;
+    x = fabs(x);
+    switch (f) {
+        case RESAMPLE_TRIANGLE: return x < 1.0 ? 1.0 - x : 0.0;
+        default: return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+}
+
+// Pesos de um eixo: a saída i usa as entradas first[i] .. first[i] + count - 1
+// com weights[i * count ..]; as de fora da imagem são repetidas da borda
+// (os pesos delas são somados ao da borda).
+struct Contributions {
+    int count;
+    std::vector<int> first;
+    std::vector<float> weights;
+};
+
+inline Contributions contributions(int srcSize, int dstSize, ResampleFilter f) {
+    double scale = (double)srcSize / dstSize;
+    double filterScale = scale > 1.0 ? scale : 1.0;   // ao reduzir, o filtro cobre scale pixels
+    double support = filterSupport(f) * filterScale;
+    Contributions c;
+    c.count = (int)ceil(2.0 * support) + 2;
+    if (c.count > srcSize) c.count = srcSize;
+    c.first.resize(dstSize);
+    c.weights.assign((size_t)dstSize * c.count, 0.0f);
+    std::vector<double> w(c.count);
+    for (int i = 0; i < dstSize; i++) {
+        double center = (i + 0.5) * scale;
+        int lo = (int)floor(center - support);
+        int hi = (int)ceil(center + support);
+        int first = lo < 0 ? 0 : lo;
+        if (first + c.count > srcSize) first = srcSize - c.count;
+        c.first[i] = first;
+        double sum = 0.0;
+        for (int k = 0; k < c.count; k++) w[k] = 0.0;
+        for (int j = lo; j <= hi; j++) {
+            double weight = filterWeight(f, (j + 0.5 - center) / filterScale);
+            if (weight == 0.0) continue;
+            int s = j < 0 ? 0 : (j >= srcSize ? srcSize - 1 : j);
+            w[s - first] += weight;
+            sum += weight;
+        }
+        for (int k = 0; k < c.count; k++) {
+            c.weights[(size_t)i * c.count + k] = (float)(sum != 0.0 ? w[k] / sum : (k == 0 ? 1.0 : 0.0));
+        }
+    }
+    return c;
+}
+
+inline double srgbToLinear(double v) {
+    return v <= 0.04045 ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+}
+
+// Conversões entre bytes e floats lineares em [0, 1].
+struct ColorTables {
+    float toLinear[256];
+    // fromLinear: byte aproximado por faixa de 1/4096 e o limiar exato
+    // entre cada byte e o seguinte (a faixa cruza no máximo um limiar)
+    static const int STEPS = 4096;
+    unsigned char approx[STEPS + 1];
+    float threshold[256];
+
+    ColorTables() {
+        for (int i = 0; i < 256; i++) toLinear[i] = (float)srgbToLinear(i / 255.0);
+        for (int i = 0; i < 255; i++) threshold[i] = (float)srgbToLinear((i + 0.5) / 255.0);
+        threshold[255] = 2.0f;
+        int b = 0;
+        for (int s = 0; s <= STEPS; s++) {
+            float v = (float)s / STEPS;
+            while (v >= threshold[b]) b++;
+            approx[s] = (unsigned char)b;
+        }
+    }
+
+    unsigned char fromLinear(float v) const {
+        if (!(v > 0.0f)) return 0;
+        if (v >= 1.0f) return 255;
+        int b = approx[(int)(v * STEPS)];
+        return (unsigned char)(b + (v >= threshold[b]));
+    }
+};
+
+inline const ColorTables &colorTables() {
+    static const ColorTables tables;
+    return tables;
+}
+
+// Converte uma linha de bytes em float RGBA (4 floats por pixel).
+inline void decodeRow(const unsigned char *src, float *dst, int w, int channels, const ResampleOptions &o) {
+    const ColorTables &t = colorTables();
+    bool alpha = o.premultiplyAlpha && (channels == 2 || channels == 4);
+    int colors = (channels == 2 || channels == 4) ? channels - 1 : channels;
+    for (int x = 0; x < w; x++, src += channels, dst += 4) {
+        float a = alpha ? src[channels - 1] * (1.0f / 255.0f) : 1.0f;
+        for (int c = 0; c < 4; c++) {
+            float v = 0.0f;
+            if (c < colors) {
+                v = (o.srgb ? t.toLinear[src[c]] : src[c] * (1.0f / 255.0f)) * a;
+            } else if (c < channels) {
+                v = src[c] * (1.0f / 255.0f);
+            }
+            dst[c] = v;
+        }
+    }
+}
+
+inline void encodeRow(const float *src, unsigned char *dst, int w, int channels, const ResampleOptions &o) {
+    const ColorTables &t = colorTables();
+    bool alpha = o.premultiplyAlpha && (channels == 2 || channels == 4);
+    int colors = (channels == 2 || channels == 4) ? channels - 1 : channels;
+    for (int x = 0; x < w; x++, src += 4, dst += channels) {
+        float a = channels > colors ? src[channels - 1] : 1.0f;
+        float inv = alpha && a > 0.0f ? 1.0f / a : 1.0f;
+        for (int c = 0; c < channels; c++) {
+            float v = src[c];
+            if (c < colors) {
+                v *= inv;
+                if (o.srgb) {
+                    dst[c] = t.fromLinear(v);
+                    continue;
+                }
+            }
+            v = v * 255.0f + 0.5f;
+            dst[c] = (unsigned char)(v <= 0.0f ? 0 : (v >= 255.0f ? 255 : (int)v));
+        }
+    }
+}
+
+// Passada horizontal: dst[x] = soma de weights * src[first[x] + k], em RGBA.
+inline void horizontalScalar(const float *src, float *dst, int dw, const Contributions &c) {
+    for (int x = 0; x < dw; x++, dst += 4) {
+        const float *s = src + (size_t)c.first[x] * 4;
+        const float *w = &c.weights[(size_t)x * c.count];
+        float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+        for (int k = 0; k < c.count; k++, s += 4) {
+            a0 = a0 + w[k] * s[0];
+            a1 = a1 + w[k] * s[1];
+            a2 = a2 + w[k] * s[2];
+            a3 = a3 + w[k] * s[3];
+        }
+        dst[0] = a0;
+        dst[1] = a1;
+        dst[2] = a2;
+        dst[3] = a3;
+    }
+}
+
+#ifdef M3_X86
+M3_TARGET_SSE2 inline void horizontalSSE2(const float *src, float *dst, int dw, const Contributions &c) {
+    for (int x = 0; x < dw; x++, dst += 4) {
+        const float *s = src + (size_t)c.first[x] * 4;
+        const float *w = &c.weights[(size_t)x * c.count];
+        __m128 acc = _mm_setzero_ps();
+        for (int k = 0; k < c.count; k++, s += 4) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(s)));
+        }
+        _mm_storeu_ps(dst, acc);
+    }
+}
+#endif
+
+inline void horizontal(const float *src, float *dst, int dw, const Contributions &c, SimdLevel level) {
+#ifdef M3_X86
+    if (level >= SIMD_SSE2) {
+        horizontalSSE2(src, dst, dw, c);
+        return;
+    }
+#endif
+    horizontalScalar(src, dst, dw, c);
+}
+
+} // namespace mip_detail
+
+// Redimensiona src (sw x sh) para dst (dw x dh), mesmo número de canais.
+inline void resampleImage(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh,
+                          int channels, const ResampleOptions &options = ResampleOptions(),
+                          ThreadPool &pool = ThreadPool::shared(), SimdLevel level = simdLevel()) {
+    using namespace mip_detail;
+    if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0) return;
+    if (level > cpuSimdLevel()) level = cpuSimdLevel();
+    const ConvolutionKernels &k = convolutionKernels(level);
+    Contributions cx = contributions(sw, dw, options.filter);
+    Contributions cy = contributions(sh, dh, options.filter);
+
+    // faixas de saída com ~64 KB de linhas horizontais cada
+    int bandRows = (int)(65536 / ((size_t)dw * 16));
+    if (bandRows < 4) bandRows = 4;
+    size_t bands = ((size_t)dh + bandRows - 1) / bandRows;
+    size_t srcRow = (size_t)sw * channels, dstRow = (size_t)dw * channels;
+    pool.parallelFor(bands, [&](size_t band) {
+        static thread_local std::vector<float> scratch;
+        int y0 = (int)band * bandRows;
+        int y1 = y0 + bandRows < dh ? y0 + bandRows : dh;
+        // linhas de entrada usadas pela faixa
+        int first = cy.first[y0];
+        int last = cy.first[y1 - 1] + cy.count;
+        int rows = last - first;
+        size_t n = (size_t)dw * 4;
+        scratch.resize((size_t)sw * 4 + n * rows + n);
+        float *line = scratch.data();
+        float *inter = line + (size_t)sw * 4;
+        float *out = inter + n * rows;
+        for (int r = 0; r < rows; r++) {
+            decodeRow(src + (size_t)(first + r) * srcRow, line, sw, channels, options);
+            horizontal(line, inter + r * n, dw, cx, level);
+        }
+        for (int y = y0; y < y1; y++) {
+            k.convolveRow(inter + (size_t)(cy.first[y] - first) * n, out, n, &cy.weights[(size_t)y * cy.count],
+                          cy.count, (ptrdiff_t)n, false);
+            encodeRow(out, dst + (size_t)y * dstRow, dw, channels, options);
+        }
+    });
+}
+
+// Níveis 1 .. n da cadeia de mipmaps de uma imagem w x h (o nível 0 é a
+// própria imagem); cada nível tem metade do anterior, arredondado para
+// baixo e no mínimo 1, até 1 x 1, e é calculado a partir do anterior.
+inline std::vector<MipLevel> buildMipChain(const unsigned char *data, int w, int h, int channels,
+                                           const ResampleOptions &options = ResampleOptions(),
+                                           ThreadPool &pool = ThreadPool::shared(),
+                                           SimdLevel simd = simdLevel()) {
+    std::vector<MipLevel> levels;
+    const unsigned char *src = data;
+    int sw = w, sh = h;
+    while (sw > 1 || sh > 1) {
+        MipLevel level;
+        level.level = (int)levels.size() + 1;
+        level.width = sw > 1 ? sw / 2 : 1;
+        level.height = sh > 1 ? sh / 2 : 1;
+        level.pixels.resize((size_t)level.width * level.height * channels);
+        resampleImage(src, sw, sh, level.pixels.data(), level.width, level.height, channels, options, pool, simd);
+        levels.push_back(std::move(level));
+        src = levels.back().pixels.data();
+        sw = levels.back().width;
+        sh = levels.back().height;
+    }
+    return levels;
+}
+
+#endif /* Mipmap_h */
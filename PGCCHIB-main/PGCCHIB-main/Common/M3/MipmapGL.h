@@ -0,0 +1,35 @@
+//
+//  MipmapGL.h
+//  Envio para o OpenGL da cadeia de mipmaps gerada na CPU por Mipmap.h, no
+//  lugar do glGenerateMipmap.
+//
+
+#ifndef MipmapGL_h
+#define MipmapGL_h
+
+#include <glad/glad.h>
+
+#include "Mipmap.h"
+
+// Gera (em paralelo, no ThreadPool) e envia os níveis 1..n da textura ligada
+// em GL_TEXTURE_2D. O nível 0 já deve ter sido enviado com glTexImage2D com
+// o mesmo format (GL_RED, GL_RG, GL_RGB ou GL_RGBA) e os mesmos dados.
+inline void uploadMipChain(GLenum format, const unsigned char *data, int width, int height,
+                           const ResampleOptions &options = ResampleOptions()) {
+    int channels = format == GL_RGBA ? 4 : (format == GL_RGB ? 3 : (format == GL_RG ? 2 : 1));
+    std::vector<MipLevel> levels = buildMipChain(data, width, height, channels, options);
+
+    // níveis pequenos têm linhas com tamanho que não é múltiplo de 4
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < levels.size(); i++) {
+        const MipLevel &l = levels[i];
+        glTexImage2D(GL_TEXTURE_2D, l.level, format, l.width, l.height, 0, format, GL_UNSIGNED_BYTE,
+                     l.pixels.data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+#endif /* MipmapGL_h */
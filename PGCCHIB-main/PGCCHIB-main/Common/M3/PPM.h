@@ -0,0 +1,850 @@
+//
+//  PPM.h
+//  Leitura e escrita de imagens PPM/PGM (P2, P3, P5 e P6).
+//
+//  Os formatos binários (P5/P6) são mapeados em memória e os filtros
+//  trabalham direto sobre os pixels mapeados, sem cópia. O mapeamento é
+//  privado (copy-on-write): alterar os pixels nunca altera o arquivo.
+//  Os formatos texto (P2/P3) são convertidos para um buffer próprio; em
+//  arquivos grandes o texto é dividido em trechos (sempre em um espaço, para
+//  não cortar números) convertidos em paralelo.
+//
+//  Com maxValue > 255 as amostras têm 16 bits e ficam em uint16_t na ordem
+//  da máquina (data16()): nos binários, os bytes big-endian do arquivo são
+//  trocados no próprio mapeamento privado; PPMWriter::write16 desfaz a troca.
+//
+
+#ifndef PPM_h
+#define PPM_h
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "CpuFeatures.h"
+#include "Image.h"
+#include "ThreadPool.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Arquivo mapeado em memória (somente leitura ou cópia privada).
+class MappedFile {
+    unsigned char *ptr;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+public:
+    MappedFile() : ptr(NULL), length(0) {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#endif
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept : MappedFile() {
+        swap(other);
+    }
+
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            close();
+            swap(other);
+        }
+        return *this;
+    }
+
+    // writable = true cria uma cópia privada: as páginas só são copiadas
+    // quando alteradas e o arquivo em disco permanece intacto.
+    // sequential = false avisa o sistema que o acesso será aleatório (sem
+    // leitura antecipada de páginas que não serão usadas).
+    bool open(const std::string &path, bool writable = false, bool sequential = true) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                           OPEN_EXISTING, sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) {
+            close();
+            return false;
+        }
+        length = (size_t)sz.QuadPart;
+        mapping = CreateFileMappingA(file, NULL, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            close();
+            return false;
+        }
+        ptr = (unsigned char *)MapViewOfFile(mapping, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+        if (ptr == NULL) {
+            close();
+            return false;
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        length = (size_t)st.st_size;
+        int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+        void *p = mmap(NULL, length, prot, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            length = 0;
+            return false;
+        }
+        ptr = (unsigned char *)p;
+        madvise(ptr, length, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (ptr) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (ptr) munmap(ptr, length);
+#endif
+        ptr = NULL;
+        length = 0;
+    }
+
+    unsigned char *data() const {
+        return ptr;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    bool isOpen() const {
+        return ptr != NULL;
+    }
+
+private:
+    void swap(MappedFile &other) {
+        std::swap(ptr, other.ptr);
+        std::swap(length, other.length);
+#ifdef _WIN32
+        std::swap(file, other.file);
+        std::swap(mapping, other.mapping);
+#endif
+    }
+};
+
+// Cabeçalho de um arquivo PPM/PGM.
+struct PPMHeader {
+    char type;          // '2', '3', '5' ou '6'
+    int width, height;
+    int maxValue;
+    int channels;       // 1 (PGM) ou 3 (PPM)
+    size_t dataOffset;  // posição do primeiro byte de pixel no arquivo
+
+    bool isBinary() const {
+        return type == '5' || type == '6';
+    }
+
+    size_t sampleCount() const {
+        return (size_t)width * (size_t)height * (size_t)channels;
+    }
+
+    // 1 ou 2 (maxValue > 255)
+    int sampleBytes() const {
+        return maxValue > 255 ? 2 : 1;
+    }
+
+    // Se um arquivo de fileSize bytes pode conter todas as amostras: nos
+    // binários, sampleBytes cada uma; no texto, ao menos um dígito e um
+    // separador entre cada duas. Vale conferir antes de alocar a imagem.
+    bool fitsIn(size_t fileSize) const {
+        if (fileSize < dataOffset) return false;
+        size_t available = fileSize - dataOffset;
+        if (isBinary()) return available / sampleBytes() >= sampleCount();
+        return (available + 1) / 2 >= sampleCount();   // available >= 2 * count - 1
+    }
+};
+
+namespace ppm_detail {
+
+inline bool isSpace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Pula espaços e comentários (# até o fim da linha).
+inline size_t skipSpaces(const unsigned char *buf, size_t len, size_t pos) {
+    while (pos < len) {
+        if (buf[pos] == '#') {
+            while (pos < len && buf[pos] != '\n') pos++;
+        } else if (isSpace(buf[pos])) {
+            pos++;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+inline bool readHeaderInt(const unsigned char *buf, size_t len, size_t &pos, int &value) {
+    pos = skipSpaces(buf, len, pos);
+    if (pos >= len || buf[pos] < '0' || buf[pos] > '9') return false;
+    long long v = 0;
+    while (pos < len && buf[pos] >= '0' && buf[pos] <= '9') {
+        v = v * 10 + (buf[pos++] - '0');
+        if (v > 0x7fffffff) return false;
+    }
+    value = (int)v;
+    return true;
+}
+
+// Espaço no sentido de isspace: ' ', \t, \n, \v, \f, \r.
+inline bool isSpaceFast(unsigned char c) {
+    return c <= ' ' && ((0x100003e00ULL >> c) & 1);
+}
+
+inline unsigned popcount32(uint32_t m) {
+    m = m - ((m >> 1) & 0x55555555u);
+    m = (m & 0x33333333u) + ((m >> 2) & 0x33333333u);
+    return (((m + (m >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24;
+}
+
+inline unsigned countTrailingZeros64(uint64_t m) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, m);
+    return (unsigned)i;
+#else
+    return (unsigned)__builtin_ctzll(m);
+#endif
+}
+
+// Conta os números (inícios de sequências sem espaço) em buf[begin, end).
+inline size_t countTextValuesScalar(const unsigned char *buf, size_t begin, size_t end, bool inSpace) {
+    size_t n = 0;
+    for (size_t i = begin; i < end; i++) {
+        bool space = isSpaceFast(buf[i]);
+        n += inSpace && !space;
+        inSpace = space;
+    }
+    return n;
+}
+
+#ifdef M3_X86
+M3_TARGET_SSE2 inline size_t countTextValuesSSE2(const unsigned char *buf, size_t begin, size_t end) {
+    const __m128i blank = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t' - 1);
+    const __m128i cr = _mm_set1_epi8('\r' + 1);
+    size_t n = 0;
+    uint32_t previous = 1;  // o byte antes de begin conta como espaço
+    size_t i = begin;
+    for (; i + 16 <= end; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(buf + i));
+        __m128i space = _mm_or_si128(_mm_cmpeq_epi8(c, blank),
+                                     _mm_and_si128(_mm_cmpgt_epi8(c, tab), _mm_cmplt_epi8(c, cr)));
+        uint32_t word = (uint32_t)(~_mm_movemask_epi8(space) & 0xffff);
+        // início: byte que não é espaço precedido de espaço
+        uint32_t spaceBefore = ~((word << 1) | (previous ^ 1)) & 0xffff;
+        n += popcount32(word & spaceBefore);
+        previous = (word >> 15) ^ 1;
+    }
+    return n + countTextValuesScalar(buf, i, end, previous != 0);
+}
+#endif
+
+inline size_t countTextValues(const unsigned char *buf, size_t begin, size_t end) {
+#ifdef M3_X86
+    if (cpuSimdLevel() >= SIMD_SSE2) return countTextValuesSSE2(buf, begin, end);
+#endif
+    return countTextValuesScalar(buf, begin, end, true);
+}
+
+// Lê até 5 dígitos de uma vez: carrega 8 bytes, acha o primeiro que não é
+// dígito e converte os anteriores sem desvios (SWAR). Retorna o número de
+// dígitos (0 se o primeiro byte não for dígito; 6 ou mais = caminho lento).
+inline unsigned parseDigitsSWAR(const unsigned char *p, unsigned &value) {
+    uint64_t x;
+    memcpy(&x, p, 8);
+    // byte não nulo em bad = não é dígito ('0'..'9' = 0x30..0x39)
+    uint64_t bad = ((x & 0xF0F0F0F0F0F0F0F0ULL) ^ 0x3030303030303030ULL) |
+                   (((x + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) ^ 0x3030303030303030ULL);
+    uint64_t high = (((bad & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL) | bad) & 0x8080808080808080ULL;
+    unsigned digits = high ? countTrailingZeros64(high) >> 3 : 8;
+    if (digits == 0 || digits > 5) return digits;
+    // little-endian: desloca para que os dígitos fiquem nos bytes altos e
+    // os bytes baixos virem zeros à esquerda
+    uint64_t d = (x - 0x3030303030303030ULL) << (8 * (8 - digits));
+    d = (d * 10 + (d >> 8)) & 0x00FF00FF00FF00FFULL;
+    d = ((d * (1 + (100ULL << 16))) >> 16) & 0x0000FFFF0000FFFFULL;
+    d = (d * (1 + (10000ULL << 32))) >> 32;
+    value = (unsigned)d;
+    return digits;
+}
+
+// Converte os digits (1 a 4) dígitos de p, já sabendo que são dígitos:
+// mesma conversão SWAR, em 32 bits e sem procurar o fim do número.
+inline unsigned parseKnownDigits4(const unsigned char *p, unsigned digits) {
+    uint32_t x;
+    memcpy(&x, p, 4);
+    uint32_t d = (x - 0x30303030u) << (8 * (4 - digits));
+    d = (d * 10 + (d >> 8)) & 0x00FF00FFu;
+    return (d * (1 + (100u << 16))) >> 16;
+}
+
+// Número em buf[pos..] pelo caminho lento, dígito a dígito; *stop recebe a
+// posição do primeiro byte depois dos dígitos.
+inline bool parseDigitsSlow(const unsigned char *buf, size_t pos, size_t end, unsigned max,
+                            unsigned &value, size_t &stop) {
+    unsigned d = buf[pos] - (unsigned)'0';
+    if (d > 9) return false;
+    unsigned v = 0;
+    do {
+        v = v * 10 + d;
+        if (v > max) return false;
+        pos++;
+    } while (pos < end && (d = buf[pos] - (unsigned)'0') <= 9);
+    value = v;
+    stop = pos;
+    return true;
+}
+
+// Um número começando em buf[pos]; depois dele deve vir espaço ou o fim.
+inline bool parseTextValue(const unsigned char *buf, size_t pos, size_t end, unsigned max,
+                           unsigned &value, size_t &stop) {
+    unsigned digits = pos + 8 <= end ? parseDigitsSWAR(buf + pos, value) : 8;
+    if (digits == 0) return false;
+    if (digits <= 5) {
+        if (value > max) return false;
+        stop = pos + digits;
+    } else if (!parseDigitsSlow(buf, pos, end, max, value, stop)) {
+        return false;
+    }
+    return stop == end || isSpaceFast(buf[stop]);
+}
+
+// Versão byte a byte de parseTextValues, para o fim do trecho e CPUs sem SSE2.
+template <class Sample>
+inline bool parseTextValuesScalar(const unsigned char *buf, size_t begin, size_t end, unsigned max,
+                                  Sample *out, size_t &k, size_t count) {
+    size_t i = begin;
+    for (;;) {
+        while (i < end && isSpaceFast(buf[i])) i++;
+        if (i >= end) return true;
+        unsigned v;
+        if (!parseTextValue(buf, i, end, max, v, i)) return false;
+        if (k < count) out[k] = (Sample)v;
+        k++;
+    }
+}
+
+#ifdef M3_X86
+// Máscaras de 64 bytes: bit i de space = buf[i] é espaço; de other = buf[i]
+// não é espaço nem dígito.
+M3_TARGET_SSE2 inline void textMasks64(const unsigned char *p, uint64_t &space, uint64_t &other) {
+    const __m128i blank = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t' - 1);
+    const __m128i cr = _mm_set1_epi8('\r' + 1);
+    const __m128i zero = _mm_set1_epi8('0' - 1);
+    const __m128i nine = _mm_set1_epi8('9' + 1);
+    space = 0;
+    other = 0;
+    for (int k = 0; k < 4; k++) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+        __m128i s = _mm_or_si128(_mm_cmpeq_epi8(c, blank),
+                                 _mm_and_si128(_mm_cmpgt_epi8(c, tab), _mm_cmplt_epi8(c, cr)));
+        __m128i d = _mm_and_si128(_mm_cmpgt_epi8(c, zero), _mm_cmplt_epi8(c, nine));
+        space |= (uint64_t)(uint32_t)_mm_movemask_epi8(s) << (16 * k);
+        other |= (uint64_t)(uint32_t)(~_mm_movemask_epi8(_mm_or_si128(s, d)) & 0xffff) << (16 * k);
+    }
+}
+#endif
+
+// Converte os números de buf[begin, end) para out[k], out[k + 1], ..., e
+// deixa em k a posição seguinte ao último número. Só grava as posições abaixo de count; os valores além disso são validados
+// e ignorados. Falha com qualquer caractere que não seja dígito ou espaço
+// (trechos não têm comentários) e com valores acima de maxValue. Sample é
+// unsigned char ou, com maxValue > 255, uint16_t.
+//
+// Com SSE2, cada bloco de 64 bytes é classificado de uma vez e os inícios
+// dos números saem da máscara de espaços; cada número é então convertido
+// independentemente dos outros, sem a dependência "fim do anterior =
+// início do próximo" que limita o laço byte a byte. Como o bloco só tem
+// dígitos e espaços, o tamanho de cada número também sai da máscara (o
+// próximo espaço depois do início); só os que cruzam o fim do bloco ou têm
+// mais de 4 dígitos passam por parseTextValue.
+template <class Sample>
+inline bool parseTextValues(const unsigned char *buf, size_t begin, size_t end, int maxValue,
+                            Sample *out, size_t &k, size_t count) {
+    const unsigned max = (unsigned)maxValue;
+    size_t i = begin;
+#ifdef M3_X86
+    if (cpuSimdLevel() >= SIMD_SSE2) {
+        uint64_t spaceBefore = 1;  // o byte antes de begin conta como espaço
+        size_t stop = begin;       // fim do último número convertido
+        for (; i + 64 <= end; i += 64) {
+            uint64_t space, other;
+            textMasks64(buf + i, space, other);
+            if (other) return false;
+            uint64_t starts = ~space & ((space << 1) | spaceBefore);
+            spaceBefore = space >> 63;
+            while (starts) {
+                unsigned bit = countTrailingZeros64(starts);
+                starts &= starts - 1;
+                size_t pos = i + bit;
+                uint64_t after = space >> bit;
+                unsigned digits = after ? countTrailingZeros64(after) : 64;
+                unsigned v;
+                if (digits <= 4 && pos + 4 <= end) {
+                    v = parseKnownDigits4(buf + pos, digits);
+                    if (v > max) return false;
+                    stop = pos + digits;
+                } else if (!parseTextValue(buf, pos, end, max, v, stop)) {
+                    return false;
+                }
+                if (k < count) out[k] = (Sample)v;
+                k++;
+            }
+        }
+        // um número que cruzou o último bloco já foi convertido
+        if (stop > i) i = stop;
+    }
+#endif
+    return parseTextValuesScalar(buf, i, end, max, out, k, count);
+}
+
+// Troca os bytes de n amostras de 16 bits (big-endian do arquivo <-> ordem
+// da máquina, que é little-endian em todas as plataformas do projeto) e
+// limita os valores a max: depois da troca na leitura, antes na escrita
+// (toFile). src e dst podem ser a mesma memória.
+inline void swapBytes16Scalar(const uint16_t *src, uint16_t *dst, size_t n, uint16_t max, bool toFile) {
+    for (size_t i = 0; i < n; i++) {
+        uint16_t v = src[i];
+        if (toFile && v > max) v = max;
+        v = (uint16_t)((v >> 8) | (v << 8));
+        if (!toFile && v > max) v = max;
+        dst[i] = v;
+    }
+}
+
+#ifdef M3_X86
+M3_TARGET_SSE2 inline void swapBytes16SSE2(const uint16_t *src, uint16_t *dst, size_t n, uint16_t max,
+                                           bool toFile) {
+    const __m128i top = _mm_set1_epi16((short)max);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        // min sem sinal (min_epu16 é SSE4.1)
+        if (toFile) v = _mm_sub_epi16(v, _mm_subs_epu16(v, top));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        if (!toFile) v = _mm_sub_epi16(v, _mm_subs_epu16(v, top));
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+    swapBytes16Scalar(src + i, dst + i, n - i, max, toFile);
+}
+
+M3_TARGET_AVX2 inline void swapBytes16AVX2(const uint16_t *src, uint16_t *dst, size_t n, uint16_t max,
+                                           bool toFile) {
+    const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const __m256i top = _mm256_set1_epi16((short)max);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        if (toFile) v = _mm256_min_epu16(v, top);
+        v = _mm256_shuffle_epi8(v, swap);
+        if (!toFile) v = _mm256_min_epu16(v, top);
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+    swapBytes16Scalar(src + i, dst + i, n - i, max, toFile);
+}
+#endif
+
+inline void swapBytes16(const uint16_t *src, uint16_t *dst, size_t n, uint16_t max = 65535, bool toFile = false) {
+#ifdef M3_X86
+    SimdLevel level = simdLevel();
+    if (level >= SIMD_AVX2) return swapBytes16AVX2(src, dst, n, max, toFile);
+    if (level >= SIMD_SSE2) return swapBytes16SSE2(src, dst, n, max, toFile);
+#endif
+    swapBytes16Scalar(src, dst, n, max, toFile);
+}
+
+} // namespace ppm_detail
+
+// Interpreta o cabeçalho a partir dos primeiros bytes do arquivo.
+inline bool parsePPMHeader(const unsigned char *buf, size_t len, PPMHeader &header) {
+    if (len < 2 || buf[0] != 'P') return false;
+    header.type = (char)buf[1];
+    switch (header.type) {
+        case '2': case '5': header.channels = 1; break;
+        case '3': case '6': header.channels = 3; break;
+        default: return false;
+    }
+    size_t pos = 2;
+    if (!ppm_detail::readHeaderInt(buf, len, pos, header.width)) return false;
+    if (!ppm_detail::readHeaderInt(buf, len, pos, header.height)) return false;
+    if (!ppm_detail::readHeaderInt(buf, len, pos, header.maxValue)) return false;
+    if (header.width <= 0 || header.height <= 0) return false;
+    if (header.maxValue <= 0 || header.maxValue > 65535) return false;
+    // exatamente um caractere de espaço separa o cabeçalho dos dados
+    if (pos >= len || !ppm_detail::isSpace(buf[pos])) return false;
+    header.dataOffset = pos + 1;
+    return true;
+}
+
+// Lê só o cabeçalho de um arquivo, sem mensagens de erro.
+inline bool readPPMHeader(const std::string &path, PPMHeader &header) {
+    FILE *in = fopen(path.c_str(), "rb");
+    if (!in) return false;
+    unsigned char prefix[4096];
+    size_t n = fread(prefix, 1, sizeof(prefix), in);
+    fclose(in);
+    return parsePPMHeader(prefix, n, header);
+}
+
+// Imagem PPM/PGM aberta para filtragem.
+class PPMImage {
+    MappedFile file;
+    std::vector<unsigned char> owned;
+    unsigned char *pixels;
+    PPMHeader header;
+
+public:
+    PPMImage() : pixels(NULL) {
+        memset(&header, 0, sizeof(header));
+    }
+
+    bool open(const std::string &path) {
+        pixels = NULL;
+        owned.clear();
+        if (!file.open(path, true)) {
+            std::cerr << "Não foi possível abrir " << path << std::endl;
+            return false;
+        }
+        if (!parsePPMHeader(file.data(), file.size(), header)) {
+            std::cerr << "Cabeçalho PPM inválido em " << path << std::endl;
+            file.close();
+            return false;
+        }
+        if (!header.fitsIn(file.size())) {
+            std::cerr << "Arquivo truncado: " << path << std::endl;
+            file.close();
+            return false;
+        }
+        if (header.isBinary()) {
+            pixels = file.data() + header.dataOffset;
+            if (header.sampleBytes() == 2) {
+                // o deslocamento dos dados pode ser ímpar
+                if ((uintptr_t)pixels % 2 != 0) {
+                    owned.resize(header.sampleCount() * 2);
+                    memcpy(owned.data(), pixels, owned.size());
+                    file.close();
+                    pixels = owned.data();
+                }
+                toNativeOrder();
+            }
+            return true;
+        }
+        bool ok = parseText();
+        file.close();
+        if (!ok) {
+            std::cerr << "Dados P" << header.type << " inválidos em " << path << std::endl;
+            owned.clear();
+            return false;
+        }
+        pixels = owned.data();
+        return true;
+    }
+
+    int width() const { return header.width; }
+    int height() const { return header.height; }
+    int channels() const { return header.channels; }
+    int maxValue() const { return header.maxValue; }
+    int sampleBytes() const { return header.sampleBytes(); }
+    char type() const { return header.type; }
+
+    // true quando os pixels apontam direto para o arquivo mapeado
+    bool isMapped() const { return pixels != NULL && owned.empty(); }
+
+    unsigned char *data() { return pixels; }
+    const unsigned char *data() const { return pixels; }
+
+    // Amostras de 16 bits (sampleBytes() == 2), na ordem da máquina.
+    uint16_t *data16() { return (uint16_t *)pixels; }
+    const uint16_t *data16() const { return (const uint16_t *)pixels; }
+
+    ImageView view() const {
+        if (header.sampleBytes() == 2) return ImageView(data16(), header.width, header.height, header.channels);
+        return ImageView(pixels, header.width, header.height, header.channels);
+    }
+
+    // Número de amostras; em bytes, size() * sampleBytes().
+    size_t size() const { return header.sampleCount(); }
+
+private:
+    // Trechos de cerca de 1 MB, convertidos em paralelo em duas passadas:
+    // a primeira conta os números de cada trecho, o que dá a posição de
+    // saída de cada um, e a segunda converte.
+    static const size_t TEXT_CHUNK = 1 << 20;
+
+    // Troca os bytes dos pixels para a ordem da máquina, em blocos paralelos.
+    void toNativeOrder() {
+        const size_t BLOCK = 1 << 19;
+        uint16_t *samples = data16();
+        size_t count = header.sampleCount();
+        size_t blocks = (count + BLOCK - 1) / BLOCK;
+        ThreadPool::shared().parallelFor(blocks, [&](size_t b) {
+            size_t first = b * BLOCK;
+            size_t n = first + BLOCK <= count ? BLOCK : count - first;
+            ppm_detail::swapBytes16(samples + first, samples + first, n, (uint16_t)header.maxValue);
+        });
+    }
+
+    bool parseText() {
+        owned.resize(header.sampleCount() * header.sampleBytes());
+        if (header.sampleBytes() == 2) return parseText((uint16_t *)owned.data());
+        return parseText(owned.data());
+    }
+
+    template <class Sample>
+    bool parseText(Sample *out) {
+        const unsigned char *buf = file.data();
+        size_t len = file.size();
+        size_t begin = header.dataOffset;
+        size_t count = header.sampleCount();
+
+        // comentários no meio dos dados são raros: caminho sequencial
+        if (memchr(buf + begin, '#', len - begin) != NULL) {
+            return parseTextSequential(buf, len, begin, count, out);
+        }
+
+        std::vector<size_t> bounds(1, begin);
+        for (size_t pos = begin + TEXT_CHUNK; pos < len; pos += TEXT_CHUNK) {
+            if (pos <= bounds.back()) continue;
+            while (pos < len && !ppm_detail::isSpace(buf[pos])) pos++;
+            if (pos < len) bounds.push_back(pos);
+        }
+        bounds.push_back(len);
+        size_t chunks = bounds.size() - 1;
+
+        ThreadPool &pool = ThreadPool::shared();
+        if (chunks == 1 || pool.size() == 1) {
+            size_t k = 0;
+            return ppm_detail::parseTextValues(buf, begin, len, header.maxValue, out, k, count) && k >= count;
+        }
+
+        std::vector<size_t> first(chunks + 1, 0);
+        pool.parallelFor(chunks, [&](size_t c) {
+            first[c + 1] = ppm_detail::countTextValues(buf, bounds[c], bounds[c + 1]);
+        });
+        for (size_t c = 0; c < chunks; c++) first[c + 1] += first[c];
+        if (first[chunks] < count) return false;
+
+        std::atomic<bool> ok(true);
+        pool.parallelFor(chunks, [&](size_t c) {
+            size_t k = first[c];
+            if (!ppm_detail::parseTextValues(buf, bounds[c], bounds[c + 1], header.maxValue, out, k, count)) {
+                ok = false;
+            }
+        });
+        return ok;
+    }
+
+    template <class Sample>
+    bool parseTextSequential(const unsigned char *buf, size_t len, size_t pos, size_t count, Sample *out) {
+        for (size_t i = 0; i < count; i++) {
+            int v;
+            if (!ppm_detail::readHeaderInt(buf, len, pos, v) || v > header.maxValue) return false;
+            out[i] = (Sample)v;
+        }
+        return true;
+    }
+};
+
+// Escrita binária (P5/P6, ou PAM P7 com 2 ou 4 canais) em blocos grandes.
+class PPMWriter {
+    FILE *out;
+    std::vector<unsigned char> block;
+    size_t used;
+    int maxValue;
+
+public:
+    static const size_t BLOCK_SIZE = 4 << 20;
+
+    PPMWriter() : out(NULL), used(0), maxValue(255) {}
+
+    ~PPMWriter() {
+        close();
+    }
+
+    PPMWriter(const PPMWriter &) = delete;
+    PPMWriter &operator=(const PPMWriter &) = delete;
+
+    bool open(const std::string &path, int w, int h, int channels, int maxValue = 255) {
+        close();
+        out = fopen(path.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Não foi possível criar " << path << std::endl;
+            return false;
+        }
+        // o buffer do stdio só duplicaria a cópia
+        setvbuf(out, NULL, _IONBF, 0);
+        // o bloco fica com o objeto: reabrir não aloca de novo
+        block.resize(BLOCK_SIZE);
+        used = 0;
+        this->maxValue = maxValue;
+        char head[128];
+        int n;
+        if (channels == 2 || channels == 4) {
+            n = snprintf(head, sizeof(head), "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL %d\nTUPLTYPE %s\nENDHDR\n",
+                         w, h, channels, maxValue, channels == 2 ? "GRAYSCALE_ALPHA" : "RGB_ALPHA");
+        } else {
+            n = snprintf(head, sizeof(head), "P%c\n%d %d\n%d\n", channels == 1 ? '5' : '6', w, h, maxValue);
+        }
+        return write(head, (size_t)n);
+    }
+
+    bool write(const void *data, size_t bytes) {
+        if (!out) return false;
+        const unsigned char *src = (const unsigned char *)data;
+        if (used + bytes <= block.size()) {
+            memcpy(block.data() + used, src, bytes);
+            used += bytes;
+            return true;
+        }
+        if (!flush()) return false;
+        // blocos grandes vão direto para o arquivo
+        if (bytes >= block.size()) {
+            return fwrite(src, 1, bytes, out) == bytes;
+        }
+        memcpy(block.data(), src, bytes);
+        used = bytes;
+        return true;
+    }
+
+    // Amostras de 16 bits na ordem da máquina (maxValue > 255 em open):
+    // gravadas em big-endian e limitadas a maxValue.
+    bool write16(const uint16_t *samples, size_t count) {
+        if (!out) return false;
+        while (count > 0) {
+            if (used + 2 > block.size() && !flush()) return false;
+            size_t n = (block.size() - used) / 2;
+            if (n > count) n = count;
+            uint16_t tmp[256];
+            for (size_t done = 0; done < n;) {
+                size_t m = n - done < 256 ? n - done : 256;
+                ppm_detail::swapBytes16(samples + done, tmp, m, (uint16_t)maxValue, true);
+                memcpy(block.data() + used, tmp, m * 2);
+                used += m * 2;
+                done += m;
+            }
+            samples += n;
+            count -= n;
+        }
+        return true;
+    }
+
+    bool flush() {
+        if (!out) return false;
+        if (used > 0 && fwrite(block.data(), 1, used, out) != used) return false;
+        used = 0;
+        return true;
+    }
+
+    bool close() {
+        if (!out) return true;
+        bool ok = flush();
+        ok = (fclose(out) == 0) && ok;
+        out = NULL;
+        return ok;
+    }
+};
+
+// Grava a imagem inteira como P6 (ou P5 quando channels == 1).
+inline bool savePPM(const std::string &path, const unsigned char *data, int w, int h, int channels = 3) {
+    PPMWriter writer;
+    if (!writer.open(path, w, h, channels)) return false;
+    if (!writer.write(data, (size_t)w * h * channels)) return false;
+    return writer.close();
+}
+
+// Amostras de 16 bits na ordem da máquina, com maxValue entre 256 e 65535.
+inline bool savePPM16(const std::string &path, const uint16_t *data, int w, int h, int channels = 3,
+                      int maxValue = 65535) {
+    PPMWriter writer;
+    if (!writer.open(path, w, h, channels, maxValue)) return false;
+    if (!writer.write16(data, (size_t)w * h * channels)) return false;
+    return writer.close();
+}
+
+namespace ppm_detail {
+
+inline bool saveView(const std::string &path, const ImageView &view, int maxValue) {
+    if (view.isPlanar() && view.channels > 1) {
+        return saveView(path, Image::from(view, LAYOUT_INTERLEAVED).view(), maxValue);
+    }
+    bool wide = view.sampleBytes == 2;
+    if (maxValue <= 0) maxValue = wide ? 65535 : 255;
+    PPMWriter writer;
+    if (!writer.open(path, view.width, view.height, view.channels, maxValue)) return false;
+    for (int y = 0; y < view.height; y++) {
+        bool ok = wide ? writer.write16(view.row16(y), (size_t)view.width * view.channels)
+                       : writer.write(view.row(y), view.rowBytes());
+        if (!ok) return false;
+    }
+    return writer.close();
+}
+
+} // namespace ppm_detail
+
+// Grava uma visão (recorte, linhas com stride ou imagem planar) como P6/P5;
+// maxValue = 0 usa 255 ou 65535 conforme os bits da visão.
+inline bool savePPM(const std::string &path, const ImageView &view, int maxValue = 0) {
+    if (view.empty() || (view.channels != 1 && view.channels != 3)) {
+        std::cerr << "savePPM: a imagem deve ter 1 ou 3 canais" << std::endl;
+        return false;
+    }
+    return ppm_detail::saveView(path, view, maxValue);
+}
+
+// Grava uma visão com alfa (2 ou 4 canais, alfa não pré-multiplicado) como
+// PAM (P7), a extensão do netpbm que os formatos P5/P6 não cobrem.
+inline bool savePAM(const std::string &path, const ImageView &view, int maxValue = 0) {
+    if (view.empty() || (view.channels != 2 && view.channels != 4)) {
+        std::cerr << "savePAM: a imagem deve ter 2 ou 4 canais" << std::endl;
+        return false;
+    }
+    return ppm_detail::saveView(path, view, maxValue);
+}
+
+#endif /* PPM_h */
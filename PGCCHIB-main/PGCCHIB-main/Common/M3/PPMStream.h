@@ -0,0 +1,223 @@
+//
+//  PPMStream.h
+//  Filtragem em faixas (strips) de imagens P5/P6 maiores que a memória, de
+//  8 ou 16 bits por canal (as de 16 chegam ao filtro na ordem da máquina).
+//
+//  Três estágios sobrepostos: uma thread lê a próxima faixa, a thread que
+//  chama filtra a atual e outra thread grava a anterior. As faixas circulam
+//  por um conjunto fixo de buffers, então o pico de memória é
+//  buffers * altura da faixa * largura * canais, qualquer que seja a imagem.
+//
+
+#ifndef PPMStream_h
+#define PPMStream_h
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlockingQueue.h"
+#include "PPM.h"
+
+// filter(strip, largura, primeira linha, linhas, canais); com maxValue > 255
+// a faixa tem amostras uint16_t na ordem da máquina.
+typedef std::function<void(unsigned char *, int, int, int, int)> StripFilter;
+
+struct StreamStats {
+    int width, height, channels;
+    int stripRows;
+    int strips;
+    size_t peakBytes;           // memória dos buffers de faixa
+    double readSeconds;
+    double filterSeconds;
+    double writeSeconds;
+    double totalSeconds;
+};
+
+// Leitura sequencial, faixa a faixa, dos pixels de um P5/P6.
+class PPMStripReader {
+    FILE *in;
+    PPMHeader header;
+    int row;
+
+public:
+    PPMStripReader() : in(NULL), row(0) {
+        memset(&header, 0, sizeof(header));
+    }
+
+    ~PPMStripReader() {
+        close();
+    }
+
+    PPMStripReader(const PPMStripReader &) = delete;
+    PPMStripReader &operator=(const PPMStripReader &) = delete;
+
+    bool open(const std::string &path) {
+        close();
+        in = fopen(path.c_str(), "rb");
+        if (!in) {
+            std::cerr << "Não foi possível abrir " << path << std::endl;
+            return false;
+        }
+        unsigned char prefix[4096];
+        size_t n = fread(prefix, 1, sizeof(prefix), in);
+        if (!parsePPMHeader(prefix, n, header)) {
+            std::cerr << "Cabeçalho PPM inválido em " << path << std::endl;
+            close();
+            return false;
+        }
+        if (!header.isBinary()) {
+            std::cerr << "Modo em faixas aceita apenas P5/P6: " << path << std::endl;
+            close();
+            return false;
+        }
+        fseek(in, (long)header.dataOffset, SEEK_SET);
+        row = 0;
+        return true;
+    }
+
+    void close() {
+        if (in) fclose(in);
+        in = NULL;
+    }
+
+    const PPMHeader &info() const {
+        return header;
+    }
+
+    size_t rowBytes() const {
+        return (size_t)header.width * header.channels * header.sampleBytes();
+    }
+
+    // Lê as próximas rows linhas (ou menos, no fim da imagem); retorna quantas leu.
+    int read(unsigned char *dst, int rows) {
+        if (!in) return 0;
+        if (rows > header.height - row) rows = header.height - row;
+        if (rows <= 0) return 0;
+        size_t bytes = rows * rowBytes();
+        if (fread(dst, 1, bytes, in) != bytes) {
+            std::cerr << "Arquivo PPM truncado na linha " << row << std::endl;
+            close();
+            return -1;
+        }
+        if (header.sampleBytes() == 2) {
+            uint16_t *samples = (uint16_t *)dst;
+            ppm_detail::swapBytes16(samples, samples, bytes / 2, (uint16_t)header.maxValue);
+        }
+        row += rows;
+        return rows;
+    }
+};
+
+// Linhas por faixa para que cada faixa tenha cerca de 4 MB.
+inline int defaultStripRows(size_t rowBytes) {
+    size_t rows = rowBytes ? (4u << 20) / rowBytes : 1;
+    return rows < 1 ? 1 : (int)rows;
+}
+
+// Lê inPath, aplica filter faixa a faixa e grava o resultado em outPath
+// (P6/P5, com o maxValue da entrada). O arquivo gerado é idêntico ao do
+// caminho em memória para qualquer filtro que dependa apenas da própria linha.
+inline bool streamFilterPPM(const std::string &inPath, const std::string &outPath,
+                            const StripFilter &filter, int stripRows = 0, int buffers = 3,
+                            StreamStats *stats = NULL) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    PPMStripReader reader;
+    if (!reader.open(inPath)) return false;
+    const PPMHeader &head = reader.info();
+    size_t rowBytes = reader.rowBytes();
+    if (stripRows <= 0) stripRows = defaultStripRows(rowBytes);
+    if (stripRows > head.height) stripRows = head.height;
+    if (buffers < 3) buffers = 3;
+
+    PPMWriter writer;
+    bool wide = head.sampleBytes() == 2;
+    if (!writer.open(outPath, head.width, head.height, head.channels, wide ? head.maxValue : 255)) return false;
+
+    struct Strip {
+        int buffer;
+        int y0;
+        int rows;
+    };
+    std::vector<std::vector<unsigned char> > pool(buffers, std::vector<unsigned char>(stripRows * rowBytes));
+    BlockingQueue<int> freeBuffers(buffers);
+    BlockingQueue<Strip> toFilter(buffers);
+    BlockingQueue<Strip> toWrite(buffers);
+    for (int i = 0; i < buffers; i++) freeBuffers.push(i);
+
+    std::atomic<bool> failed(false);
+    double readSeconds = 0.0, writeSeconds = 0.0, filterSeconds = 0.0;
+    int strips = 0;
+
+    std::thread readThread([&] {
+        int y = 0;
+        int buffer;
+        while (y < head.height && !failed && freeBuffers.pop(buffer)) {
+            Clock::time_point t0 = Clock::now();
+            int rows = reader.read(pool[buffer].data(), stripRows);
+            readSeconds += std::chrono::duration<double>(Clock::now() - t0).count();
+            if (rows <= 0) {
+                failed = true;
+                break;
+            }
+            Strip s = { buffer, y, rows };
+            toFilter.push(s);
+            y += rows;
+        }
+        toFilter.close();
+    });
+
+    std::thread writeThread([&] {
+        Strip s;
+        while (toWrite.pop(s)) {
+            if (!failed) {
+                Clock::time_point t0 = Clock::now();
+                const unsigned char *data = pool[s.buffer].data();
+                bool written = wide ? writer.write16((const uint16_t *)data, s.rows * rowBytes / 2)
+                                    : writer.write(data, s.rows * rowBytes);
+                if (!written) {
+                    std::cerr << "Erro ao gravar " << outPath << std::endl;
+                    failed = true;
+                }
+                writeSeconds += std::chrono::duration<double>(Clock::now() - t0).count();
+            }
+            freeBuffers.push(s.buffer);
+        }
+    });
+
+    Strip s;
+    while (toFilter.pop(s)) {
+        if (!failed) {
+            Clock::time_point t0 = Clock::now();
+            filter(pool[s.buffer].data(), head.width, s.y0, s.rows, head.channels);
+            filterSeconds += std::chrono::duration<double>(Clock::now() - t0).count();
+        }
+        toWrite.push(s);
+        strips++;
+    }
+    toWrite.close();
+    readThread.join();
+    writeThread.join();
+
+    bool ok = writer.close() && !failed;
+    if (stats) {
+        stats->width = head.width;
+        stats->height = head.height;
+        stats->channels = head.channels;
+        stats->stripRows = stripRows;
+        stats->strips = strips;
+        stats->peakBytes = (size_t)buffers * stripRows * rowBytes;
+        stats->readSeconds = readSeconds;
+        stats->filterSeconds = filterSeconds;
+        stats->writeSeconds = writeSeconds;
+        stats->totalSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return ok;
+}
+
+#endif /* PPMStream_h */
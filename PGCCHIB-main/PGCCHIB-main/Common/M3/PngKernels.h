@@ -0,0 +1,274 @@
+//
+//  PngKernels.h
+//  Desfiltragem das linhas de PNG de 8 bits com 3 e 4 canais, usada pelo
+//  decodificador vendorizado (M5_Material/stb_image.cpp).
+//
+//  Cada linha vem com um filtro (None, Sub, Up, Average, Paeth) que prevê o
+//  byte a partir do pixel da esquerda (a), do de cima (b) e do de cima à
+//  esquerda (c); desfiltrar é somar a previsão ao byte lido. O filtro é
+//  escolhido uma vez por linha (a tabela unfilter), e o laço de dentro não
+//  tem switch. Sub, Average e Paeth dependem do pixel recém-calculado,
+//  então as versões SSE2 andam um pixel por vez com os canais em paralelo;
+//  Up e None (sem canal extra) andam 16/32 bytes por vez. O Paeth SIMD
+//  escolhe o preditor sem desvios: calcula as três distâncias em 16 bits e
+//  seleciona com máscaras, na mesma ordem de desempate do stb (a, depois b,
+//  depois c). Todos os níveis dão os mesmos bytes.
+//
+
+#ifndef PngKernels_h
+#define PngKernels_h
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "CpuFeatures.h"
+
+// Na ordem do enum de filtros do stb; as versões _FIRST são as da primeira
+// linha, em que a linha de cima vale zero (Up vira None e Paeth vira Sub).
+enum PngFilter {
+    PNG_FILTER_NONE,
+    PNG_FILTER_SUB,
+    PNG_FILTER_UP,
+    PNG_FILTER_AVG,
+    PNG_FILTER_PAETH,
+    PNG_FILTER_AVG_FIRST,
+    PNG_FILTER_PAETH_FIRST,
+    PNG_FILTER_COUNT
+};
+
+// Desfiltra uma linha de x pixels com n canais (3 ou 4): raw são os bytes
+// filtrados (n por pixel), prior a linha de cima já desfiltrada e cur a
+// saída, ambas com outN bytes por pixel. outN = n + 1 acrescenta alfa 255
+// (RGB com tRNS). prior não é lida nos filtros _FIRST.
+typedef void (*PngUnfilterRow)(unsigned char *cur, const unsigned char *raw, const unsigned char *prior, unsigned x,
+                               int n, int outN);
+
+namespace png_scalar {
+
+// O preditor de Paeth do stb.
+inline int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    if (pb <= pc) return b;
+    return c;
+}
+
+template <int F>
+inline int predict(int a, int b, int c) {
+    switch (F) {
+        case PNG_FILTER_SUB: return a;
+        case PNG_FILTER_UP: return b;
+        case PNG_FILTER_AVG: return (a + b) >> 1;
+        case PNG_FILTER_PAETH: return paeth(a, b, c);
+        case PNG_FILTER_AVG_FIRST: return a >> 1;
+        case PNG_FILTER_PAETH_FIRST: return a;
+        default: return 0;
+    }
+}
+
+template <int N, int OUT, int F>
+inline void row(unsigned char *cur, const unsigned char *raw, const unsigned char *prior, unsigned x) {
+    const bool above = F == PNG_FILTER_UP || F == PNG_FILTER_AVG || F == PNG_FILTER_PAETH;
+    if (x == 0) return;
+    // primeiro pixel: a e c valem zero
+    for (int k = 0; k < N; k++) cur[k] = (unsigned char)(raw[k] + predict<F>(0, above ? prior[k] : 0, 0));
+    if (OUT > N) cur[N] = 255;
+    for (unsigned i = 1; i < x; i++) {
+        cur += OUT;
+        raw += N;
+        prior += OUT;
+        for (int k = 0; k < N; k++) {
+            int b = above ? prior[k] : 0, c = above ? prior[k - OUT] : 0;
+            cur[k] = (unsigned char)(raw[k] + predict<F>(cur[k - OUT], b, c));
+        }
+        if (OUT > N) cur[N] = 255;
+    }
+}
+
+// O despacho por formato também fica fora do laço.
+template <int F>
+void unfilter(unsigned char *cur, const unsigned char *raw, const unsigned char *prior, unsigned x, int n, int outN) {
+    if (n == 4) row<4, 4, F>(cur, raw, prior, x);
+    else if (outN == 4) row<3, 4, F>(cur, raw, prior, x);
+    else row<3, 3, F>(cur, raw, prior, x);
+}
+
+} // namespace png_scalar
+
+#ifdef M3_X86
+/*-----------------------------------SSE2-----------------------------------*/
+namespace png_sse2 {
+
+// Um pixel nos bytes baixos do registrador. Com N = 3, todo pixel menos o
+// último da linha é lido e gravado com 4 bytes (o quarto está dentro da
+// linha e a gravação do pixel seguinte o sobrescreve); copiar só 3 bytes
+// passa pela pilha e custa uma espera de store forwarding por pixel.
+M3_TARGET_SSE2 inline __m128i load4(const unsigned char *p) {
+    int v;
+    memcpy(&v, p, 4);
+    return _mm_cvtsi32_si128(v);
+}
+
+template <int N>
+M3_TARGET_SSE2 inline __m128i loadPixel(const unsigned char *p) {
+    int v = 0;
+    memcpy(&v, p, N);
+    return _mm_cvtsi32_si128(v);
+}
+
+// Grava OUT bytes: os N do pixel, mais o alfa 255 quando OUT = N + 1.
+template <int N, int OUT>
+M3_TARGET_SSE2 inline void storePixel(unsigned char *p, __m128i v, int bytes) {
+    unsigned w = (unsigned)_mm_cvtsi128_si32(v);
+    if (OUT > N) w |= 0xffu << (8 * N);
+    memcpy(p, &w, bytes);
+}
+
+// floor((a + b) / 2) em bytes: avg_epu8 arredonda para cima, e o bit que
+// sobra é o bit baixo de a ^ b.
+M3_TARGET_SSE2 inline __m128i average(__m128i a, __m128i b) {
+    return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+}
+
+M3_TARGET_SSE2 inline __m128i absolute(__m128i v) {
+    return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+M3_TARGET_SSE2 inline __m128i select(__m128i mask, __m128i yes, __m128i no) {
+    return _mm_or_si128(_mm_and_si128(mask, yes), _mm_andnot_si128(mask, no));
+}
+
+// Preditor de Paeth em 16 bits, sem desvios: com p = a + b - c,
+// pa = |b - c|, pb = |a - c| e pc = |a + b - 2c|; vale a se pa é o menor,
+// senão b se pb é o menor, senão c.
+M3_TARGET_SSE2 inline __m128i paeth(__m128i a, __m128i b, __m128i c) {
+    __m128i bc = _mm_sub_epi16(b, c), ac = _mm_sub_epi16(a, c);
+    __m128i pa = absolute(bc), pb = absolute(ac), pc = absolute(_mm_add_epi16(bc, ac));
+    __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+    __m128i nearest = select(_mm_cmpeq_epi16(pb, smallest), b, c);
+    return select(_mm_cmpeq_epi16(pa, smallest), a, nearest);
+}
+
+// Desfiltra um pixel: d são os bytes lidos, a o pixel da esquerda já
+// desfiltrado, b o de cima; c (o de cima à esquerda, em 16 bits) só é usado
+// e atualizado pelo Paeth. Os canais andam juntos, em bytes independentes.
+template <int F>
+M3_TARGET_SSE2 inline __m128i pixel(__m128i d, __m128i a, __m128i b, __m128i &c) {
+    const __m128i zero = _mm_setzero_si128();
+    switch (F) {
+        case PNG_FILTER_SUB:
+        case PNG_FILTER_PAETH_FIRST: return _mm_add_epi8(d, a);
+        case PNG_FILTER_UP: return _mm_add_epi8(d, b);
+        case PNG_FILTER_AVG: return _mm_add_epi8(d, average(a, b));
+        case PNG_FILTER_AVG_FIRST: return _mm_add_epi8(d, average(a, zero));
+        case PNG_FILTER_PAETH: {
+            __m128i b16 = _mm_unpacklo_epi8(b, zero);
+            __m128i p = paeth(_mm_unpacklo_epi8(a, zero), b16, c);
+            c = b16;
+            return _mm_add_epi8(d, _mm_packus_epi16(p, zero));
+        }
+        default: return d;
+    }
+}
+
+template <int N, int OUT, int F>
+M3_TARGET_SSE2 inline void pixels(unsigned char *cur, const unsigned char *raw, const unsigned char *prior, unsigned x) {
+    const bool above = F == PNG_FILTER_UP || F == PNG_FILTER_AVG || F == PNG_FILTER_PAETH;
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = zero, c = zero;
+    if (x == 0) return;
+    for (unsigned i = 0; i + 1 < x; i++, cur += OUT, raw += N, prior += OUT) {
+        a = pixel<F>(load4(raw), a, above ? load4(prior) : zero, c);
+        storePixel<N, OUT>(cur, a, 4);
+    }
+    a = pixel<F>(loadPixel<N>(raw), a, above ? loadPixel<N>(prior) : zero, c);
+    storePixel<N, OUT>(cur, a, OUT);
+}
+
+// None e Up sem canal extra são contínuos: 16 bytes por vez.
+template <int F>
+M3_TARGET_SSE2 inline void bytes(unsigned char *cur, const unsigned char *raw, const unsigned char *prior, size_t count) {
+    size_t i = 0;
+    if (F == PNG_FILTER_UP) {
+        for (; i + 16 <= count; i += 16) {
+            __m128i r = _mm_loadu_si128((const __m128i *)(raw + i)), p = _mm_loadu_si128((const __m128i *)(prior + i));
+            _mm_storeu_si128((__m128i *)(cur + i), _mm_add_epi8(r, p));
+        }
+        for (; i < count; i++) cur[i] = (unsigned char)(raw[i] + prior[i]);
+    } else {
+        memcpy(cur, raw, count);
+    }
+}
+
+template <int N, int OUT, int F>
+M3_TARGET_SSE2 inline void row(unsigned char *cur, const unsigned char *raw, const unsigned char *prior, unsigned x) {
+    if (N == OUT && (F == PNG_FILTER_NONE || F == PNG_FILTER_UP)) bytes<F>(cur, raw, prior, (size_t)x * N);
+    else pixels<N, OUT, F>(cur, raw, prior, x);
+}
+
+template <int F>
+M3_TARGET_SSE2 void unfilter(unsigned char *cur, const unsigned char *raw, const unsigned char *prior, unsigned x,
+                             int n, int outN) {
+    if (n == 4) row<4, 4, F>(cur, raw, prior, x);
+    else if (outN == 4) row<3, 4, F>(cur, raw, prior, x);
+    else row<3, 3, F>(cur, raw, prior, x);
+}
+
+} // namespace png_sse2
+
+/*-----------------------------------AVX2-----------------------------------*/
+namespace png_avx2 {
+
+// Só o Up contínuo ganha com registradores de 32 bytes; os filtros que
+// dependem do pixel da esquerda continuam os da SSE2.
+M3_TARGET_AVX2 inline void up(unsigned char *cur, const unsigned char *raw, const unsigned char *prior, unsigned x,
+                              int n, int outN) {
+    if (n != outN) {
+        png_sse2::unfilter<PNG_FILTER_UP>(cur, raw, prior, x, n, outN);
+        return;
+    }
+    size_t count = (size_t)x * n, i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i r = _mm256_loadu_si256((const __m256i *)(raw + i)), p = _mm256_loadu_si256((const __m256i *)(prior + i));
+        _mm256_storeu_si256((__m256i *)(cur + i), _mm256_add_epi8(r, p));
+    }
+    for (; i < count; i++) cur[i] = (unsigned char)(raw[i] + prior[i]);
+}
+
+} // namespace png_avx2
+#endif
+
+struct PngKernels {
+    SimdLevel level;
+    PngUnfilterRow unfilter[PNG_FILTER_COUNT];  // índice: PngFilter
+};
+
+inline const PngKernels &pngKernels(SimdLevel level) {
+    static const PngKernels table[] = {
+        { SIMD_SCALAR,
+          { png_scalar::unfilter<PNG_FILTER_NONE>, png_scalar::unfilter<PNG_FILTER_SUB>,
+            png_scalar::unfilter<PNG_FILTER_UP>, png_scalar::unfilter<PNG_FILTER_AVG>,
+            png_scalar::unfilter<PNG_FILTER_PAETH>, png_scalar::unfilter<PNG_FILTER_AVG_FIRST>,
+            png_scalar::unfilter<PNG_FILTER_PAETH_FIRST> } },
+#ifdef M3_X86
+        { SIMD_SSE2,
+          { png_sse2::unfilter<PNG_FILTER_NONE>, png_sse2::unfilter<PNG_FILTER_SUB>, png_sse2::unfilter<PNG_FILTER_UP>,
+            png_sse2::unfilter<PNG_FILTER_AVG>, png_sse2::unfilter<PNG_FILTER_PAETH>,
+            png_sse2::unfilter<PNG_FILTER_AVG_FIRST>, png_sse2::unfilter<PNG_FILTER_PAETH_FIRST> } },
+        { SIMD_AVX2,
+          { png_sse2::unfilter<PNG_FILTER_NONE>, png_sse2::unfilter<PNG_FILTER_SUB>, png_avx2::up,
+            png_sse2::unfilter<PNG_FILTER_AVG>, png_sse2::unfilter<PNG_FILTER_PAETH>,
+            png_sse2::unfilter<PNG_FILTER_AVG_FIRST>, png_sse2::unfilter<PNG_FILTER_PAETH_FIRST> } },
+#endif
+    };
+    if (level > cpuSimdLevel()) level = cpuSimdLevel();
+    return table[level];
+}
+
+inline const PngKernels &pngKernels() {
+    static const PngKernels &kernels = pngKernels(simdLevel());
+    return kernels;
+}
+
+#endif /* PngKernels_h */
@@ -0,0 +1,134 @@
+//
+//  ThreadPool.h
+//  Pool de threads fixo para laços paralelos (parallelFor). As tarefas são
+//  distribuídas dinamicamente por um contador atômico e a thread que chama
+//  também trabalha, então um pool de N threads usa N núcleos. Um
+//  parallelFor chamado de dentro de uma tarefa roda em série na própria
+//  thread (o pool já está ocupado com o laço de fora).
+//
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::mutex submit;  // um parallelFor por vez
+
+    // trabalho corrente
+    const std::function<void(size_t)> *task;
+    size_t count;
+    std::atomic<size_t> next;
+    size_t finished;
+    unsigned long long generation;
+    unsigned busy;
+    bool stopping;
+
+public:
+    // threads = 0 usa o número de núcleos da máquina.
+    explicit ThreadPool(unsigned threads = 0)
+        : task(NULL), count(0), next(0), finished(0), generation(0), busy(0), stopping(false) {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        for (unsigned i = 1; i < threads; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Número de threads que executam tarefas (incluindo a que chama).
+    unsigned size() const {
+        return (unsigned)workers.size() + 1;
+    }
+
+    // Executa fn(i) para i em [0, n) e só retorna quando todas terminarem.
+    void parallelFor(size_t n, const std::function<void(size_t)> &fn) {
+        if (n == 0) return;
+        if (workers.empty() || n == 1 || insideTask()) {
+            for (size_t i = 0; i < n; i++) fn(i);
+            return;
+        }
+        std::lock_guard<std::mutex> serial(submit);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &fn;
+            count = n;
+            next.store(0);
+            finished = 0;
+            generation++;
+        }
+        wake.notify_all();
+        size_t mine = runTasks(fn, n);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished += mine;
+        // espera as tarefas em andamento e os workers saírem do trabalho
+        done.wait(lock, [this] { return finished == count && busy == 0; });
+        task = NULL;
+    }
+
+    // Pool compartilhado, do tamanho da máquina.
+    static ThreadPool &shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+private:
+    // Verdadeiro enquanto a thread executa uma tarefa de algum pool.
+    static bool &insideTask() {
+        static thread_local bool inside = false;
+        return inside;
+    }
+
+    size_t runTasks(const std::function<void(size_t)> &fn, size_t n) {
+        size_t executed = 0;
+        insideTask() = true;
+        for (size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1)) {
+            fn(i);
+            executed++;
+        }
+        insideTask() = false;
+        return executed;
+    }
+
+    void workerLoop() {
+        unsigned long long seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || (task != NULL && generation != seen); });
+            if (stopping) return;
+            seen = generation;
+            const std::function<void(size_t)> *fn = task;
+            size_t n = count;
+            busy++;
+            lock.unlock();
+            size_t executed = runTasks(*fn, n);
+            lock.lock();
+            busy--;
+            finished += executed;
+            if (finished == count && busy == 0) done.notify_all();
+        }
+    }
+};
+
+#endif /* ThreadPool_h */
@@ -0,0 +1,497 @@
+//
+//  TiledImage.h
+//  Formato em blocos (tiles) para imagens enormes, com acesso aleatório:
+//  ler uma região custa proporcional à região, não à imagem.
+//
+//  Arquivo (.m3t, inteiros little-endian):
+//      cabeçalho  TiledHeader (40 bytes)
+//      índice     TileEntry por bloco, em ordem de linha (16 bytes cada)
+//      blocos     pixels intercalados do bloco, linha a linha
+//  Os blocos da borda direita/inferior guardam só a parte dentro da imagem.
+//  O lado do bloco vai de 16 a TILED_MAX_TILE_SIZE, para que o tamanho de
+//  um bloco (mesmo comprimido no pior caso) caiba no uint32 do índice.
+//  Com compressão, cada bloco passa por um preditor (diferença para o pixel
+//  à esquerda) e por um LZ simples no estilo do LZ4; se não ficar menor,
+//  o bloco é guardado cru.
+//
+//  O leitor mapeia o arquivo em memória: só as páginas do índice e dos
+//  blocos que a região toca são lidas do disco.
+//
+
+#ifndef TiledImage_h
+#define TiledImage_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Image.h"
+#include "PPM.h"
+#include "PPMStream.h"
+#include "ThreadPool.h"
+
+static const char TILED_MAGIC[8] = { 'M', '3', 'T', 'I', 'L', 'E', 'S', '1' };
+
+static const int TILED_MIN_TILE_SIZE = 16;
+static const int TILED_MAX_TILE_SIZE = 8192;   // 8192² * 4 canais = 256 MB por bloco
+
+enum TileCompression {
+    TILE_RAW = 0,
+    TILE_LZ = 1          // preditor horizontal + LZ
+};
+
+struct TiledHeader {
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t tileSize;
+    uint32_t tilesX;
+    uint32_t tilesY;
+    uint32_t compression;   // pedida na conversão; cada bloco tem a sua
+    uint32_t reserved;
+};
+
+struct TileEntry {
+    uint64_t offset;         // desde o início do arquivo
+    uint32_t size;           // bytes gravados
+    uint32_t compression;    // TileCompression
+};
+
+struct TiledOptions {
+    int tileSize;
+    bool compress;
+
+    TiledOptions(int tileSize = 256, bool compress = false) : tileSize(tileSize), compress(compress) {}
+};
+
+namespace tiled_detail {
+
+/*------------------------------------LZ------------------------------------*/
+// Sequências [token][literais][distância de 2 bytes][extensão]: o token
+// tem o número de literais nos 4 bits altos e o tamanho da cópia - 4 nos
+// baixos; 15 indica bytes extras (255 + 255 + ... + resto). A última
+// sequência só tem literais.
+
+static const int LZ_MIN_MATCH = 4;
+static const int LZ_HASH_BITS = 14;
+static const size_t LZ_MAX_DISTANCE = 65535;
+
+inline uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint32_t lzHash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+inline unsigned char *lzLength(unsigned char *out, size_t n) {
+    for (; n >= 255; n -= 255) *out++ = 255;
+    *out++ = (unsigned char)n;
+    return out;
+}
+
+// Tamanho máximo da saída para n bytes de entrada.
+inline size_t lzBound(size_t n) {
+    return n + n / 255 + 16;
+}
+
+// Comprime n bytes em out (com lzBound(n) bytes); retorna o tamanho.
+inline size_t lzCompress(const unsigned char *src, size_t n, unsigned char *out) {
+    static thread_local uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+    unsigned char *o = out;
+    size_t anchor = 0, i = 1;
+    // os últimos bytes ficam sempre como literais
+    size_t limit = n > 12 ? n - 12 : 0;
+    while (i < limit) {
+        uint32_t v = read32(src + i);
+        uint32_t h = lzHash(v);
+        size_t cand = table[h];
+        table[h] = (uint32_t)i;
+        if (cand == 0 || i - cand > LZ_MAX_DISTANCE || read32(src + cand) != v) {
+            i++;
+            continue;
+        }
+        size_t len = LZ_MIN_MATCH;
+        while (i + len < n - 5 && src[cand + len] == src[i + len]) len++;
+        while (i > anchor && cand > 0 && src[i - 1] == src[cand - 1]) {
+            i--;
+            cand--;
+            len++;
+        }
+        size_t literals = i - anchor;
+        size_t extra = len - LZ_MIN_MATCH;
+        *o++ = (unsigned char)(((literals < 15 ? literals : 15) << 4) | (extra < 15 ? extra : 15));
+        if (literals >= 15) o = lzLength(o, literals - 15);
+        memcpy(o, src + anchor, literals);
+        o += literals;
+        size_t distance = i - cand;
+        *o++ = (unsigned char)distance;
+        *o++ = (unsigned char)(distance >> 8);
+        if (extra >= 15) o = lzLength(o, extra - 15);
+        i += len;
+        anchor = i;
+    }
+    size_t literals = n - anchor;
+    *o++ = (unsigned char)((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15) o = lzLength(o, literals - 15);
+    memcpy(o, src + anchor, literals);
+    o += literals;
+    return (size_t)(o - out);
+}
+
+// Lê uma extensão de tamanho; false se passar do fim.
+inline bool lzReadLength(const unsigned char *&p, const unsigned char *end, size_t &n) {
+    unsigned char b;
+    do {
+        if (p >= end) return false;
+        b = *p++;
+        n += b;
+    } while (b == 255);
+    return true;
+}
+
+// Descomprime exatamente rawSize bytes; false se os dados forem inválidos.
+inline bool lzDecompress(const unsigned char *src, size_t n, unsigned char *dst, size_t rawSize) {
+    const unsigned char *p = src, *end = src + n;
+    unsigned char *o = dst, *oend = dst + rawSize;
+    while (p < end) {
+        unsigned token = *p++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !lzReadLength(p, end, literals)) return false;
+        if (literals > (size_t)(end - p) || literals > (size_t)(oend - o)) return false;
+        memcpy(o, p, literals);
+        o += literals;
+        p += literals;
+        if (p == end) break;
+        if (end - p < 2) return false;
+        size_t distance = p[0] | (p[1] << 8);
+        p += 2;
+        size_t len = token & 15;
+        if (len == 15 && !lzReadLength(p, end, len)) return false;
+        len += LZ_MIN_MATCH;
+        if (distance == 0 || distance > (size_t)(o - dst) || len > (size_t)(oend - o)) return false;
+        const unsigned char *from = o - distance;
+        if (distance >= len) {
+            memcpy(o, from, len);
+        } else {
+            for (size_t k = 0; k < len; k++) o[k] = from[k];
+        }
+        o += len;
+    }
+    return o == oend;
+}
+
+/*--------------------------------PREDITOR----------------------------------*/
+// Cada byte vira a diferença para o mesmo canal do pixel à esquerda.
+inline void deltaEncode(unsigned char *data, int w, int h, int channels) {
+    size_t rowBytes = (size_t)w * channels;
+    for (int y = 0; y < h; y++) {
+        unsigned char *row = data + y * rowBytes;
+        for (size_t i = rowBytes - 1; i >= (size_t)channels; i--) row[i] = (unsigned char)(row[i] - row[i - channels]);
+    }
+}
+
+inline void deltaDecode(unsigned char *data, int w, int h, int channels) {
+    size_t rowBytes = (size_t)w * channels;
+    for (int y = 0; y < h; y++) {
+        unsigned char *row = data + y * rowBytes;
+        for (size_t i = channels; i < rowBytes; i++) row[i] = (unsigned char)(row[i] + row[i - channels]);
+    }
+}
+
+// Bloco codificado, pronto para gravar.
+struct EncodedTile {
+    std::vector<unsigned char> bytes;
+    uint32_t compression;
+};
+
+// Codifica a região (tw x th) de src que começa em (x0, y0).
+inline void encodeTile(const ImageView &src, int x0, int y0, int tw, int th, bool compress, EncodedTile &out) {
+    size_t rowBytes = (size_t)tw * src.channels;
+    size_t raw = rowBytes * th;
+    out.bytes.resize(raw);
+    for (int y = 0; y < th; y++) memcpy(out.bytes.data() + y * rowBytes, src.pixel(x0, y0 + y), rowBytes);
+    out.compression = TILE_RAW;
+    if (!compress) return;
+
+    static thread_local std::vector<unsigned char> packed;
+    deltaEncode(out.bytes.data(), tw, th, src.channels);
+    packed.resize(lzBound(raw));
+    size_t n = lzCompress(out.bytes.data(), raw, packed.data());
+    if (n < raw) {
+        out.bytes.assign(packed.begin(), packed.begin() + n);
+        out.compression = TILE_LZ;
+        return;
+    }
+    // não compensou: volta ao bloco cru
+    for (int y = 0; y < th; y++) memcpy(out.bytes.data() + y * rowBytes, src.pixel(x0, y0 + y), rowBytes);
+}
+
+} // namespace tiled_detail
+
+// Grava um arquivo .m3t linha de blocos por linha de blocos; o índice fica
+// reservado logo após o cabeçalho e é preenchido em close().
+class TiledImageWriter {
+    FILE *out;
+    TiledHeader header;
+    std::vector<TileEntry> index;
+    uint64_t offset;
+    int nextRow;
+
+public:
+    TiledImageWriter() : out(NULL), offset(0), nextRow(0) {
+        memset(&header, 0, sizeof(header));
+    }
+
+    ~TiledImageWriter() {
+        if (out) fclose(out);
+    }
+
+    TiledImageWriter(const TiledImageWriter &) = delete;
+    TiledImageWriter &operator=(const TiledImageWriter &) = delete;
+
+    bool open(const std::string &path, int w, int h, int channels, const TiledOptions &options = TiledOptions()) {
+        if (w <= 0 || h <= 0 || channels < 1 || channels > 4 || options.tileSize < TILED_MIN_TILE_SIZE ||
+            options.tileSize > TILED_MAX_TILE_SIZE) {
+            std::cerr << "TiledImageWriter: parâmetros inválidos" << std::endl;
+            return false;
+        }
+        out = fopen(path.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Não foi possível criar " << path << std::endl;
+            return false;
+        }
+        memcpy(header.magic, TILED_MAGIC, sizeof(header.magic));
+        header.width = w;
+        header.height = h;
+        header.channels = channels;
+        header.tileSize = options.tileSize;
+        header.tilesX = (w + options.tileSize - 1) / options.tileSize;
+        header.tilesY = (h + options.tileSize - 1) / options.tileSize;
+        header.compression = options.compress ? TILE_LZ : TILE_RAW;
+        index.assign((size_t)header.tilesX * header.tilesY, TileEntry());
+        nextRow = 0;
+        offset = sizeof(header) + index.size() * sizeof(TileEntry);
+        return fwrite(&header, sizeof(header), 1, out) == 1 &&
+               fwrite(index.data(), sizeof(TileEntry), index.size(), out) == index.size();
+    }
+
+    const TiledHeader &info() const {
+        return header;
+    }
+
+    // Grava a próxima linha de blocos; strip tem as tileSize linhas dela
+    // (menos na última). Os blocos são codificados em paralelo.
+    bool writeTileRow(const ImageView &strip, ThreadPool &pool = ThreadPool::shared()) {
+        if (!out || nextRow >= (int)header.tilesY) return false;
+        const int ts = header.tileSize;
+        int th = (int)header.height - nextRow * ts < ts ? (int)header.height - nextRow * ts : ts;
+        if (strip.width != (int)header.width || strip.height < th || strip.channels != (int)header.channels ||
+            strip.isPlanar() || strip.sampleBytes != 1) {
+            std::cerr << "TiledImageWriter: faixa incompatível" << std::endl;
+            return false;
+        }
+        std::vector<tiled_detail::EncodedTile> tiles(header.tilesX);
+        pool.parallelFor(tiles.size(), [&](size_t tx) {
+            int x0 = (int)tx * ts;
+            int tw = (int)header.width - x0 < ts ? (int)header.width - x0 : ts;
+            tiled_detail::encodeTile(strip, x0, 0, tw, th, header.compression == TILE_LZ, tiles[tx]);
+        });
+        for (size_t tx = 0; tx < tiles.size(); tx++) {
+            TileEntry &e = index[(size_t)nextRow * header.tilesX + tx];
+            e.offset = offset;
+            e.size = (uint32_t)tiles[tx].bytes.size();
+            e.compression = tiles[tx].compression;
+            if (fwrite(tiles[tx].bytes.data(), 1, e.size, out) != e.size) return false;
+            offset += e.size;
+        }
+        nextRow++;
+        return true;
+    }
+
+    // Completa o índice; falha se faltar alguma linha de blocos.
+    bool close() {
+        if (!out) return false;
+        bool ok = nextRow == (int)header.tilesY;
+        if (!ok) std::cerr << "TiledImageWriter: imagem incompleta" << std::endl;
+        ok = ok && fseek(out, sizeof(header), SEEK_SET) == 0 &&
+             fwrite(index.data(), sizeof(TileEntry), index.size(), out) == index.size();
+        ok = (fclose(out) == 0) && ok;
+        out = NULL;
+        return ok;
+    }
+};
+
+// Grava uma imagem inteira (já na memória) como .m3t.
+inline bool writeTiledImage(const std::string &path, const ImageView &src,
+                            const TiledOptions &options = TiledOptions(), ThreadPool &pool = ThreadPool::shared()) {
+    ImageView image = src;
+    Image interleaved;
+    if (src.isPlanar()) {
+        interleaved = Image::from(src, LAYOUT_INTERLEAVED);
+        image = interleaved.view();
+    }
+    TiledImageWriter writer;
+    if (!writer.open(path, image.width, image.height, image.channels, options)) return false;
+    for (int y = 0; y < image.height; y += options.tileSize) {
+        int rows = image.height - y < options.tileSize ? image.height - y : options.tileSize;
+        if (!writer.writeTileRow(image.rows(y, rows), pool)) return false;
+    }
+    return writer.close();
+}
+
+// Converte um PPM/PGM para .m3t. P5/P6 são lidos uma linha de blocos por
+// vez (a memória não depende da altura); P2/P3 são carregados inteiros.
+inline bool convertPPMToTiled(const std::string &inPath, const std::string &outPath,
+                              const TiledOptions &options = TiledOptions(), ThreadPool &pool = ThreadPool::shared()) {
+    PPMHeader head;
+    if (!readPPMHeader(inPath, head)) {
+        std::cerr << "Cabeçalho PPM inválido em " << inPath << std::endl;
+        return false;
+    }
+    if (head.maxValue > 255) {
+        std::cerr << "O formato em blocos só guarda 8 bits por canal: " << inPath << std::endl;
+        return false;
+    }
+    if (!head.isBinary()) {
+        PPMImage image;
+        if (!image.open(inPath)) return false;
+        return writeTiledImage(outPath, ImageView(image.data(), image.width(), image.height(), image.channels()),
+                               options, pool);
+    }
+    PPMStripReader reader;
+    if (!reader.open(inPath)) return false;
+    TiledImageWriter writer;
+    if (!writer.open(outPath, head.width, head.height, head.channels, options)) return false;
+    std::vector<unsigned char> strip(reader.rowBytes() * options.tileSize);
+    int rows;
+    while ((rows = reader.read(strip.data(), options.tileSize)) > 0) {
+        if (!writer.writeTileRow(ImageView(strip.data(), head.width, rows, head.channels), pool)) return false;
+    }
+    return rows == 0 && writer.close();
+}
+
+// Leitura de regiões de um .m3t mapeado em memória.
+class TiledImageReader {
+    MappedFile file;
+    TiledHeader header;
+    const TileEntry *index;
+
+public:
+    TiledImageReader() : index(NULL) {
+        memset(&header, 0, sizeof(header));
+    }
+
+    bool open(const std::string &path) {
+        index = NULL;
+        if (!file.open(path, false, false)) {
+            std::cerr << "Não foi possível abrir " << path << std::endl;
+            return false;
+        }
+        const unsigned char *buf = file.data();
+        size_t len = file.size();
+        if (len < sizeof(header)) return invalid(path);
+        memcpy(&header, buf, sizeof(header));
+        if (memcmp(header.magic, TILED_MAGIC, sizeof(header.magic)) != 0 || header.width == 0 ||
+            header.height == 0 || header.channels < 1 || header.channels > 4 ||
+            header.tileSize < (uint32_t)TILED_MIN_TILE_SIZE || header.tileSize > (uint32_t)TILED_MAX_TILE_SIZE ||
+            header.tilesX != (header.width + header.tileSize - 1) / header.tileSize ||
+            header.tilesY != (header.height + header.tileSize - 1) / header.tileSize) {
+            return invalid(path);
+        }
+        size_t tiles = (size_t)header.tilesX * header.tilesY;
+        if ((len - sizeof(header)) / sizeof(TileEntry) < tiles) return invalid(path);
+        index = (const TileEntry *)(buf + sizeof(header));
+        for (size_t i = 0; i < tiles; i++) {
+            const TileEntry &e = index[i];
+            if (e.offset > len || e.size > len - e.offset || e.compression > TILE_LZ) return invalid(path);
+        }
+        return true;
+    }
+
+    bool isOpen() const { return index != NULL; }
+    int width() const { return (int)header.width; }
+    int height() const { return (int)header.height; }
+    int channels() const { return (int)header.channels; }
+    int tileSize() const { return (int)header.tileSize; }
+    const TiledHeader &info() const { return header; }
+
+    // Copia a região [x, x + dst.width) x [y, y + dst.height) para dst
+    // (intercalada, 8 bits, com os mesmos canais). Só os blocos tocados são
+    // lidos.
+    bool readRegion(int x, int y, const ImageView &dst, ThreadPool &pool = ThreadPool::shared()) const {
+        if (dst.sampleBytes != 1) {
+            std::cerr << "readRegion: o destino deve ter 8 bits por canal" << std::endl;
+            return false;
+        }
+        if (!index || dst.isPlanar() || dst.channels != (int)header.channels || x < 0 || y < 0 ||
+            dst.width <= 0 || dst.height <= 0 ||
+            x + dst.width > (int)header.width || y + dst.height > (int)header.height) {
+            std::cerr << "readRegion: região fora da imagem" << std::endl;
+            return false;
+        }
+        const int ts = header.tileSize;
+        int tx0 = x / ts, ty0 = y / ts;
+        int tx1 = (x + dst.width - 1) / ts, ty1 = (y + dst.height - 1) / ts;
+        int cols = tx1 - tx0 + 1;
+        size_t count = (size_t)cols * (ty1 - ty0 + 1);
+        std::atomic<bool> ok(true);
+        pool.parallelFor(count, [&](size_t i) {
+            int tx = tx0 + (int)(i % cols), ty = ty0 + (int)(i / cols);
+            if (!copyFromTile(tx, ty, x, y, dst)) ok = false;
+        });
+        if (!ok) std::cerr << "readRegion: bloco corrompido" << std::endl;
+        return ok;
+    }
+
+    // Região nova em out.
+    bool readRegion(int x, int y, int w, int h, Image &out, ThreadPool &pool = ThreadPool::shared()) const {
+        out.allocate(w, h, header.channels);
+        return !out.empty() && readRegion(x, y, out.view(), pool);
+    }
+
+private:
+    bool invalid(const std::string &path) {
+        std::cerr << "Arquivo de blocos inválido: " << path << std::endl;
+        index = NULL;
+        file.close();
+        return false;
+    }
+
+    // Copia a interseção do bloco (tx, ty) com a região (x, y, dst).
+    bool copyFromTile(int tx, int ty, int x, int y, const ImageView &dst) const {
+        const int ts = header.tileSize, ch = header.channels;
+        int bx = tx * ts, by = ty * ts;
+        int tw = (int)header.width - bx < ts ? (int)header.width - bx : ts;
+        int th = (int)header.height - by < ts ? (int)header.height - by : ts;
+        size_t rowBytes = (size_t)tw * ch;
+        const TileEntry &e = index[(size_t)ty * header.tilesX + tx];
+        const unsigned char *pixels = file.data() + e.offset;
+        if (e.compression == TILE_LZ) {
+            static thread_local std::vector<unsigned char> scratch;
+            scratch.resize(rowBytes * th);
+            if (!tiled_detail::lzDecompress(pixels, e.size, scratch.data(), scratch.size())) return false;
+            tiled_detail::deltaDecode(scratch.data(), tw, th, ch);
+            pixels = scratch.data();
+        } else if (e.size != rowBytes * th) {
+            return false;
+        }
+        int x0 = bx > x ? bx : x, x1 = bx + tw < x + dst.width ? bx + tw : x + dst.width;
+        int y0 = by > y ? by : y, y1 = by + th < y + dst.height ? by + th : y + dst.height;
+        size_t bytes = (size_t)(x1 - x0) * ch;
+        for (int yy = y0; yy < y1; yy++) {
+            memcpy(dst.pixel(x0 - x, yy - y), pixels + (size_t)(yy - by) * rowBytes + (size_t)(x0 - bx) * ch, bytes);
+        }
+        return true;
+    }
+};
+
+#endif /* TiledImage_h */
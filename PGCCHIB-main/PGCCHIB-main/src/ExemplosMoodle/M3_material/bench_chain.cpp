@@ -0,0 +1,117 @@
+// Compara a cadeia de filtros fundida (FilterChain::apply) com a aplicação
+// de um filtro por vez sobre a imagem inteira. O tráfego de memória é
+// estimado em bytes lidos + gravados na RAM: 2 * imagem por passada.
+//
+// Antes, cadeias com passos que compile() simplifica (negativos em par,
+// colorize seguidos, cinza repetido) têm de dar o mesmo resultado compiladas
+// e não compiladas, em 8 bits e em apply16 com maxValue 1000, 4095 e 40000.
+//
+// Uso: bench_chain [megapixels] [repetições]
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FilterChain.h"
+
+using namespace std;
+
+struct Case {
+    const char *name;
+    FilterChain chain;
+};
+
+static double timeIt(const FilterChain &chain, bool fused, const vector<unsigned char> &source,
+                     vector<unsigned char> &work, int w, int h, int reps) {
+    double best = 1e30;
+    for (int r = 0; r < reps; r++) {
+        memcpy(work.data(), source.data(), source.size());
+        auto t0 = chrono::steady_clock::now();
+        if (fused) chain.apply(work.data(), w, h);
+        else chain.applyUnfused(work.data(), w, h);
+        double s = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        if (s < best) best = s;
+    }
+    return best;
+}
+
+static vector<FilterChain> compileCases() {
+    vector<FilterChain> chains(4);
+    chains[0].colorize(makeColorize(3, 0, 0)).colorize(makeColorize(5, 0, 0));
+    chains[1].colorize(makeColorize(1, 2, 4)).colorize(makeColorize(16, 33, 200)).colorize(makeColorize(7, 0, 129));
+    chains[2].negative().negative().grayScale(makeGrayScale(false)).grayScale(makeGrayScale(false)).negative();
+    chains[3].grayScale(makeGrayScale(true)).colorize(makeColorize(32, 0, 64)).colorize(makeColorize(9, 9, 9))
+        .negative().negative().colorize(makeColorize(0, 130, 1));
+    return chains;
+}
+
+static bool checkCompile() {
+    const vector<FilterChain> chains = compileCases();
+    const int MAX_VALUES[3] = { 1000, 4095, 40000 };
+    const size_t pixels = 4096;
+    int mismatches = 0;
+    for (size_t c = 0; c < chains.size(); c++) {
+        FilterChain compiled = chains[c];
+        compiled.compile();
+        vector<unsigned char> a(pixels * 3), b;
+        for (size_t i = 0; i < a.size(); i++) a[i] = (unsigned char)((i * 2654435761u) >> 13);
+        b = a;
+        chains[c].apply(a.data(), pixels);
+        compiled.apply(b.data(), pixels);
+        mismatches += a != b;
+        for (int m : MAX_VALUES) {
+            vector<uint16_t> a16(pixels * 3), b16;
+            for (size_t i = 0; i < a16.size(); i++) a16[i] = (uint16_t)(((i * 2654435761u) >> 7) % (m + 1));
+            b16 = a16;
+            chains[c].apply16(a16.data(), pixels, m);
+            compiled.apply16(b16.data(), pixels, m);
+            mismatches += a16 != b16;
+        }
+    }
+    printf("compile(): %zu cadeias x 4 escalas, %d diferentes da cadeia original\n", chains.size(), mismatches);
+    return mismatches == 0;
+}
+
+int main(int argc, char **argv) {
+    double megapixels = argc > 1 ? atof(argv[1]) : 64.0;
+    int reps = argc > 2 ? atoi(argv[2]) : 5;
+    int w = 8192;
+    int h = (int)(megapixels * 1e6 / w);
+    if (h < 1) h = 1;
+    size_t bytes = (size_t)w * h * 3;
+
+    vector<unsigned char> source(bytes);
+    for (size_t i = 0; i < bytes; i++) {
+        source[i] = (unsigned char)((i * 2654435761u) >> 13);
+    }
+    vector<unsigned char> fused(bytes), unfused(bytes);
+    bool ok = checkCompile();
+
+    vector<Case> cases(3);
+    cases[0].name = "cinza>colorize>negativo";
+    cases[0].chain.grayScale(makeGrayScale(false)).colorize(makeColorize(32, 0, 64)).negative();
+    cases[1].name = "chroma>cinza>negativo";
+    cases[1].chain.chromaKey(makeChromaKey(0, 255, 0, 0.4)).grayScale(makeGrayScale(true)).negative();
+    cases[2].name = "6 filtros";
+    cases[2].chain.negative().chromaKey(makeChromaKey(255, 0, 255, 0.3)).colorize(makeColorize(1, 2, 4))
+        .grayScale(makeGrayScale(false)).colorize(makeColorize(16, 0, 0)).negative();
+
+    printf("Imagem %d x %d, kernels %s, %u threads\n", w, h, simdLevelName(filterKernels().level),
+           ThreadPool::shared().size());
+    printf("%-24s %6s %10s %10s %12s %12s\n", "cadeia", "passos", "separado", "fundido", "tráfego sep", "tráfego fund");
+
+    for (size_t c = 0; c < cases.size(); c++) {
+        FilterChain &chain = cases[c].chain;
+        double tu = timeIt(chain, false, source, unfused, w, h, reps);
+        double tf = timeIt(chain, true, source, fused, w, h, reps);
+        if (fused != unfused) ok = false;
+        double traffic = 2.0 * bytes / 1e6;
+        printf("%-24s %6zu %8.1f ms %8.1f ms %9.0f MB %9.0f MB  (%.2fx)\n", cases[c].name, chain.size(),
+               tu * 1e3, tf * 1e3, traffic * chain.size(), traffic, tu / tf);
+    }
+    printf("Resultados iguais: %s\n", ok ? "sim" : "NÃO");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
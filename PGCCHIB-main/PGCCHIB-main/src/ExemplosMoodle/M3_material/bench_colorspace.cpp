@@ -0,0 +1,277 @@
+// Erro e desempenho das conversões de cor de ColorConvert.h. Cada conversão
+// roda sobre todos os 2^24 valores de 8 bits (RGB ou YCbCr) em cada nível
+// SIMD disponível; a tabela mostra o erro máximo contra color_reference
+// (ColorSpace.h), se o resultado é idêntico ao da versão escalar e a vazão em
+// megapixels/s numa linha de 1920x1080 pixels em uma thread.
+//
+// Uso: bench_colorspace [--reps N]
+//
+// As inversas de HSV, HSL e Lab recebem o valor de referência (em float) de
+// cada RGB e o erro é contado contra o RGB original; a coluna "ida e volta"
+// das diretas é a maior diferença em bytes depois de ida e volta pelos
+// próprios kernels. O programa termina com erro se algum nível SIMD der um
+// resultado diferente do escalar.
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ColorConvert.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+enum Conversion {
+    YCC_TO_RGB, RGB_TO_YCC, LUMA, RGB_TO_HSV, HSV_TO_RGB, RGB_TO_HSL, HSL_TO_RGB, RGB_TO_LAB, LAB_TO_RGB,
+    CONVERSION_COUNT
+};
+
+static const char *CONVERSION_NAMES[] = { "YCbCr->RGB", "RGB->YCbCr", "luma", "RGB->HSV", "HSV->RGB",
+                                          "RGB->HSL", "HSL->RGB", "RGB->Lab", "Lab->RGB" };
+
+static const size_t CHUNK = 1 << 16;
+static const size_t TOTAL = 1 << 24;
+
+// Entrada de um bloco: os valores base..base+n como bytes intercalados
+// (R, G, B ou Y, Cb, Cr) e, para as inversas, a referência em float.
+struct Chunk {
+    vector<unsigned char> bytes;
+    vector<float> planes[3];
+    vector<double> ref[3];
+    size_t n;
+};
+
+static bool hasHue(int c) {
+    return c == RGB_TO_HSV || c == RGB_TO_HSL;
+}
+
+static bool isInverse(int c) {
+    return c == HSV_TO_RGB || c == HSL_TO_RGB || c == LAB_TO_RGB;
+}
+
+static int outputPlanes(int c) {
+    return c == LUMA ? 1 : 3;
+}
+
+static void referenceFor(int c, double r, double g, double b, double out[3]) {
+    switch (c) {
+        case YCC_TO_RGB: color_reference::ycbcrToRgb(r, g, b, out[0], out[1], out[2]); break;
+        case RGB_TO_YCC:
+        case LUMA: color_reference::rgbToYcbcr(r, g, b, out[0], out[1], out[2]); break;
+        case RGB_TO_HSV: color_reference::rgbToHsv(r, g, b, out[0], out[1], out[2]); break;
+        case RGB_TO_HSL: color_reference::rgbToHsl(r, g, b, out[0], out[1], out[2]); break;
+        case RGB_TO_LAB: color_reference::rgbToLab(r, g, b, out[0], out[1], out[2]); break;
+        default: out[0] = r; out[1] = g; out[2] = b; break;     // inversas: o próprio RGB
+    }
+    if (c == YCC_TO_RGB || c == RGB_TO_YCC || c == LUMA) {
+        for (int i = 0; i < 3; i++) out[i] = out[i] < 0.0 ? 0.0 : out[i] > 255.0 ? 255.0 : out[i];
+    }
+}
+
+// Valor de referência que alimenta as inversas.
+static void inverseInput(int c, double r, double g, double b, float out[3]) {
+    double v[3] = { 0.0, 0.0, 0.0 };
+    if (c == HSV_TO_RGB) color_reference::rgbToHsv(r, g, b, v[0], v[1], v[2]);
+    else if (c == HSL_TO_RGB) color_reference::rgbToHsl(r, g, b, v[0], v[1], v[2]);
+    else if (c == LAB_TO_RGB) color_reference::rgbToLab(r, g, b, v[0], v[1], v[2]);
+    for (int i = 0; i < 3; i++) out[i] = (float)v[i];
+}
+
+static void fillChunk(int c, size_t base, Chunk &chunk) {
+    chunk.n = min(CHUNK, TOTAL - base);
+    chunk.bytes.resize(chunk.n * 3);
+    for (int p = 0; p < 3; p++) {
+        chunk.planes[p].resize(chunk.n);
+        chunk.ref[p].resize(chunk.n);
+    }
+    for (size_t i = 0; i < chunk.n; i++) {
+        size_t v = base + i;
+        unsigned char px[3] = { (unsigned char)(v >> 16), (unsigned char)(v >> 8), (unsigned char)v };
+        memcpy(&chunk.bytes[i * 3], px, 3);
+        double ref[3];
+        referenceFor(c, px[0], px[1], px[2], ref);
+        float in[3];
+        if (isInverse(c)) inverseInput(c, px[0], px[1], px[2], in);
+        for (int p = 0; p < 3; p++) {
+            chunk.ref[p][i] = ref[p];
+            if (isInverse(c)) chunk.planes[p][i] = in[p];
+        }
+    }
+}
+
+// Roda a conversão c e devolve as saídas em planos float.
+static void run(int c, const ColorKernels &k, const Chunk &chunk, vector<float> *out, vector<unsigned char> &tmp) {
+    size_t n = chunk.n;
+    const unsigned char *bytes = &chunk.bytes[0];
+    tmp.resize(n * 4);
+    for (int p = 0; p < 3; p++) out[p].resize(n);
+    if (c == YCC_TO_RGB) {
+        vector<unsigned char> planes(n * 3);
+        for (size_t i = 0; i < n; i++) {
+            for (int p = 0; p < 3; p++) planes[p * n + i] = bytes[i * 3 + p];
+        }
+        k.ycbcrToRgb(&planes[0], &planes[n], &planes[2 * n], &tmp[0], n, 4);
+        for (size_t i = 0; i < n; i++) {
+            for (int p = 0; p < 3; p++) out[p][i] = tmp[i * 4 + p];
+            if (tmp[i * 4 + 3] != 255) out[0][i] = -1000.0f;    // alfa errado aparece como erro
+        }
+    } else if (c == RGB_TO_YCC) {
+        k.rgbToYcbcr(bytes, &tmp[0], &tmp[n], &tmp[2 * n], n);
+        for (int p = 0; p < 3; p++) {
+            for (size_t i = 0; i < n; i++) out[p][i] = tmp[p * n + i];
+        }
+    } else if (c == LUMA) {
+        vector<unsigned char> rgba(n * 4), y4(n);
+        for (size_t i = 0; i < n; i++) {
+            memcpy(&rgba[i * 4], bytes + i * 3, 3);
+            rgba[i * 4 + 3] = (unsigned char)i;
+        }
+        k.luma(bytes, &tmp[0], n, 3);
+        k.luma(&rgba[0], &y4[0], n, 4);
+        for (size_t i = 0; i < n; i++) out[0][i] = tmp[i] == y4[i] ? tmp[i] : -1000.0f;
+    } else if (isInverse(c)) {
+        PlanesToRgbKernel f = c == HSV_TO_RGB ? k.hsvToRgb : c == HSL_TO_RGB ? k.hslToRgb : k.labToRgb;
+        f(&chunk.planes[0][0], &chunk.planes[1][0], &chunk.planes[2][0], &tmp[0], n);
+        for (size_t i = 0; i < n; i++) {
+            for (int p = 0; p < 3; p++) out[p][i] = tmp[i * 3 + p];
+        }
+    } else {
+        RgbToPlanesKernel f = c == RGB_TO_HSV ? k.rgbToHsv : c == RGB_TO_HSL ? k.rgbToHsl : k.rgbToLab;
+        f(bytes, &out[0][0], &out[1][0], &out[2][0], n);
+    }
+}
+
+// Maior diferença em bytes de RGB -> espaço -> RGB pelos kernels.
+static int roundTrip(int c, const ColorKernels &k, const Chunk &chunk, const vector<float> *planes,
+                     vector<unsigned char> &tmp) {
+    PlanesToRgbKernel f = c == RGB_TO_HSV ? k.hsvToRgb : c == RGB_TO_HSL ? k.hslToRgb : k.labToRgb;
+    f(&planes[0][0], &planes[1][0], &planes[2][0], &tmp[0], chunk.n);
+    int worst = 0;
+    for (size_t i = 0; i < chunk.n * 3; i++) worst = max(worst, abs((int)tmp[i] - (int)chunk.bytes[i]));
+    return worst;
+}
+
+struct Row {
+    double maxErr[3];
+    bool exact;
+    int roundTrip;
+    double mps;
+};
+
+static double timeConversion(int c, const ColorKernels &k, int reps) {
+    const size_t n = 1920;
+    const int rows = 1080;
+    Chunk chunk;
+    fillChunk(c, 0x204080, chunk);     // valores variados, sem favorecer nenhum ramo
+    chunk.n = n;
+    vector<float> out[3];
+    vector<unsigned char> tmp;
+    vector<double> times;
+    for (int r = 0; r < reps; r++) {
+        Clock::time_point t0 = Clock::now();
+        for (int y = 0; y < rows; y++) {
+            switch (c) {
+                case YCC_TO_RGB: {
+                    tmp.resize(n * 4);
+                    const unsigned char *p = &chunk.bytes[0];
+                    k.ycbcrToRgb(p, p + n, p + 2 * n, &tmp[0], n, 4);
+                    break;
+                }
+                case RGB_TO_YCC: tmp.resize(n * 3); k.rgbToYcbcr(&chunk.bytes[0], &tmp[0], &tmp[n], &tmp[2 * n], n); break;
+                case LUMA: tmp.resize(n); k.luma(&chunk.bytes[0], &tmp[0], n, 3); break;
+                default:
+                    for (int p = 0; p < 3; p++) out[p].resize(n);
+                    tmp.resize(n * 3);
+                    if (isInverse(c)) {
+                        PlanesToRgbKernel f = c == HSV_TO_RGB ? k.hsvToRgb : c == HSL_TO_RGB ? k.hslToRgb : k.labToRgb;
+                        f(&chunk.planes[0][0], &chunk.planes[1][0], &chunk.planes[2][0], &tmp[0], n);
+                    } else {
+                        RgbToPlanesKernel f = c == RGB_TO_HSV ? k.rgbToHsv : c == RGB_TO_HSL ? k.rgbToHsl : k.rgbToLab;
+                        f(&chunk.bytes[0], &out[0][0], &out[1][0], &out[2][0], n);
+                    }
+                    break;
+            }
+        }
+        times.push_back(chrono::duration<double>(Clock::now() - t0).count());
+    }
+    sort(times.begin(), times.end());
+    return (double)n * rows / times[times.size() / 2] / 1e6;
+}
+
+int main(int argc, char **argv) {
+    int reps = 5;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--reps" && i + 1 < argc) {
+            reps = max(1, atoi(argv[++i]));
+        } else {
+            cerr << "Uso: " << argv[0] << " [--reps N]" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    vector<SimdLevel> levels;
+    for (int l = SIMD_SCALAR; l <= cpuSimdLevel(); l++) levels.push_back((SimdLevel)l);
+
+    bool allExact = true;
+    printf("%-11s %-7s %10s %10s %10s %9s %12s %8s\n", "conversao", "nivel", "erro c0", "erro c1", "erro c2",
+           "= escalar", "ida e volta", "MP/s");
+    for (int c = 0; c < CONVERSION_COUNT; c++) {
+        vector<Row> rows(levels.size());
+        for (size_t l = 0; l < levels.size(); l++) {
+            Row &row = rows[l];
+            row.maxErr[0] = row.maxErr[1] = row.maxErr[2] = 0.0;
+            row.exact = true;
+            row.roundTrip = 0;
+        }
+        Chunk chunk;
+        vector<float> scalarOut[3], out[3];
+        vector<unsigned char> tmp;
+        for (size_t base = 0; base < TOTAL; base += CHUNK) {
+            fillChunk(c, base, chunk);
+            for (size_t l = 0; l < levels.size(); l++) {
+                const ColorKernels &k = colorKernels(levels[l]);
+                Row &row = rows[l];
+                run(c, k, chunk, l == 0 ? scalarOut : out, tmp);
+                const vector<float> *result = l == 0 ? scalarOut : out;
+                for (int p = 0; p < outputPlanes(c); p++) {
+                    for (size_t i = 0; i < chunk.n; i++) {
+                        double err = fabs(result[p][i] - chunk.ref[p][i]);
+                        if (p == 0 && hasHue(c)) err = min(err, 360.0 - err);
+                        row.maxErr[p] = max(row.maxErr[p], err);
+                    }
+                    if (l > 0 && memcmp(&out[p][0], &scalarOut[p][0], chunk.n * sizeof(float)) != 0) row.exact = false;
+                }
+                if (c == RGB_TO_HSV || c == RGB_TO_HSL || c == RGB_TO_LAB) {
+                    row.roundTrip = max(row.roundTrip, roundTrip(c, k, chunk, result, tmp));
+                }
+            }
+        }
+        for (size_t l = 0; l < levels.size(); l++) {
+            Row &row = rows[l];
+            row.mps = timeConversion(c, colorKernels(levels[l]), reps);
+            allExact = allExact && row.exact;
+            char err[3][16];
+            for (int p = 0; p < 3; p++) {
+                if (p < outputPlanes(c)) snprintf(err[p], sizeof(err[p]), "%.3g", row.maxErr[p]);
+                else snprintf(err[p], sizeof(err[p]), "-");
+            }
+            char trip[16] = "-";
+            if (c == RGB_TO_HSV || c == RGB_TO_HSL || c == RGB_TO_LAB) snprintf(trip, sizeof(trip), "%d", row.roundTrip);
+            printf("%-11s %-7s %10s %10s %10s %9s %12s %8.0f\n", CONVERSION_NAMES[c], simdLevelName(levels[l]), err[0],
+                   err[1], err[2], row.exact ? "sim" : "NAO", trip, row.mps);
+        }
+    }
+    if (!allExact) {
+        cerr << "Algum nível SIMD deu resultado diferente do escalar" << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
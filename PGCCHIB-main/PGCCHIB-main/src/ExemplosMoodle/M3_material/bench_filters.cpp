@@ -0,0 +1,455 @@
+// Benchmark e teste de regressão dos filtros de exemplo_03. Para cada tamanho
+// de imagem sintética, cada filtro roda em todas as variantes disponíveis
+// (escalar, SSE2 e AVX2 em uma thread, e a melhor versão SIMD com todas as
+// threads) e a tabela mostra megapixels/s nos percentis 10, 50 e 90, e a
+// mediana em MB/s.
+//
+// Uso: bench_filters [--sizes 640x480,1920x1080] [--reps N] [--bits 8|16]
+//                    [--json saida.json] [--compare base.json] [--threshold PORCENTAGEM]
+//
+// --bits 16 mede os filtros de Filters16.h (sem as LUTs, que só existem em 8
+// bits); como cada pixel tem o dobro de bytes, é a coluna MB/s que deve ser
+// comparada com a execução de 8 bits. Em 8 bits, antes das medidas, as LUTs
+// são conferidas sobre as 2^24 cores (checkLUT).
+//
+// --json grava os resultados; --compare lê um arquivo gravado antes e
+// termina com erro se a mediana de alguma variante cair mais que
+// --threshold por cento (padrão 10) em relação a ele.
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FilterExecutor.h"
+#include "Filters16.h"
+#include "ColorLUT.h"
+
+using namespace std;
+
+enum FilterId { CHROMA_KEY, GRAY_MEAN, GRAY_WEIGHTED, COLORIZE, NEGATIVE, LUT, LUT_EXACT, FILTER_COUNT };
+
+static const char *FILTER_NAMES[] = { "chroma-key", "gray-mean", "gray-weighted", "colorize", "negative", "lut",
+                                      "lut-exata" };
+
+struct Variant {
+    string name;
+    SimdLevel level;
+    bool threaded;
+};
+
+struct Result {
+    string key;        // filtro/variante/LxA, usado na comparação
+    string filter;
+    string variant;
+    int width;
+    int height;
+    double p10;
+    double p50;
+    double p90;
+};
+
+// LUTs de exemplo: cinza ponderado seguido de colorize, em grade 33^3 e na
+// tabela exata
+static ColorLUT lut;
+static ExactColorLUT exactLut;
+
+static void grayColorize(unsigned char *rgb, size_t pixels) {
+    filters_scalar::grayScale(rgb, pixels, makeGrayScale(false));
+    filters_scalar::colorize(rgb, pixels, makeColorize(32, 0, 64));
+}
+
+static void runFilter(int f, const Variant &v, const FilterExecutor &ex, unsigned char *data, int w, int h) {
+    const FilterKernels &k = filterKernels(v.level);
+    SimdLevel level = v.level;
+    if (!v.threaded) {
+        size_t pixels = (size_t)w * h;
+        switch (f) {
+            case CHROMA_KEY: k.chromaKey(data, pixels, makeChromaKey(0, 255, 0, 0.4)); break;
+            case GRAY_MEAN: k.grayScale(data, pixels, makeGrayScale(true)); break;
+            case GRAY_WEIGHTED: k.grayScale(data, pixels, makeGrayScale(false)); break;
+            case COLORIZE: k.colorize(data, pixels, makeColorize(32, 0, 64)); break;
+            case NEGATIVE: k.negative(data, pixels); break;
+            case LUT: lut.apply(data, pixels, level); break;
+            case LUT_EXACT: exactLut.apply(data, pixels, level); break;
+        }
+        return;
+    }
+    switch (f) {
+        case CHROMA_KEY: ex.chromaKey(data, w, h, makeChromaKey(0, 255, 0, 0.4), k); break;
+        case GRAY_MEAN: ex.grayScale(data, w, h, makeGrayScale(true), k); break;
+        case GRAY_WEIGHTED: ex.grayScale(data, w, h, makeGrayScale(false), k); break;
+        case COLORIZE: ex.colorize(data, w, h, makeColorize(32, 0, 64), k); break;
+        case NEGATIVE: ex.negative(data, w, h, k); break;
+        case LUT:
+            ex.forEachBand(data, w, h, 3, [w, level](unsigned char *first, int, int rows) {
+                lut.apply(first, (size_t)w * rows, level);
+            });
+            break;
+        case LUT_EXACT:
+            ex.forEachBand(data, w, h, 3, [w, level](unsigned char *first, int, int rows) {
+                exactLut.apply(first, (size_t)w * rows, level);
+            });
+            break;
+    }
+}
+
+static void runFilter16(int f, const Variant &v, const FilterExecutor &ex, uint16_t *data, int w, int h) {
+    const FilterKernels16 &k = filterKernels16(v.level);
+    const ChromaKey16Params key = makeChromaKey16(makeChromaKey(0, 255, 0, 0.4), 65535);
+    const GrayScale16Params mean = makeGrayScale16(makeGrayScale(true), 65535);
+    const GrayScale16Params weighted = makeGrayScale16(makeGrayScale(false), 65535);
+    const Colorize16Params color = makeColorize16(makeColorize(32, 0, 64), 65535);
+    auto run = [&](uint16_t *rgb, size_t pixels) {
+        switch (f) {
+            case CHROMA_KEY: k.chromaKey(rgb, pixels, key); break;
+            case GRAY_MEAN: k.grayScale(rgb, pixels, mean); break;
+            case GRAY_WEIGHTED: k.grayScale(rgb, pixels, weighted); break;
+            case COLORIZE: k.colorize(rgb, pixels, color); break;
+            case NEGATIVE: k.negative(rgb, pixels, 65535); break;
+        }
+    };
+    if (!v.threaded) {
+        run(data, (size_t)w * h);
+        return;
+    }
+    ex.forEachBand((unsigned char *)data, w, h, 6, [&](unsigned char *first, int, int rows) {
+        run((uint16_t *)first, (size_t)w * rows);
+    });
+}
+
+// Tons de cinza em 16 bits, em todos os níveis SIMD: cinza (y, y, y) continua
+// y, a média fica a menos de 2 de (r + g + b) / 3 e nada passa de maxValue.
+static bool checkGray16() {
+    static const int maxValues[] = { 65535, 40000, 1023 };
+    int cases = 0, failures = 0;
+    for (int level = SIMD_SCALAR; level <= cpuSimdLevel(); level++) {
+        const FilterKernels16 &k = filterKernels16((SimdLevel)level);
+        for (int maxValue : maxValues) {
+            for (int mean = 0; mean < 2; mean++) {
+                GrayScale16Params p = makeGrayScale16(makeGrayScale(mean != 0), maxValue);
+                // 67 pixels: 4 blocos SIMD de 16 e um resto escalar
+                vector<uint16_t> rgb(67 * 3), in;
+                for (size_t i = 0; i < 67; i++) {
+                    uint16_t *px = &rgb[i * 3];
+                    if (i % 2 == 0) {
+                        px[0] = px[1] = px[2] = (uint16_t)(i < 2 ? maxValue : (i * 2654435761u >> 7) % (maxValue + 1));
+                    } else {
+                        for (int c = 0; c < 3; c++) {
+                            px[c] = (uint16_t)(((i * 3 + c) * 2654435761u >> 7) % (maxValue + 1));
+                        }
+                    }
+                }
+                in = rgb;
+                k.grayScale(rgb.data(), 67, p);
+                for (size_t i = 0; i < 67; i++) {
+                    const uint16_t *a = &in[i * 3], *y = &rgb[i * 3];
+                    bool bad = y[0] != y[1] || y[0] != y[2] || y[0] > maxValue;
+                    if (i % 2 == 0) bad = bad || y[0] != a[0];
+                    else if (mean) bad = bad || fabs(y[0] - (a[0] + a[1] + a[2]) / 3.0) >= 2.0;
+                    cases++;
+                    if (bad) {
+                        failures++;
+                        printf("ERRO: cinza16 %s, maxValue %d: (%d, %d, %d) -> %d\n", simdLevelName((SimdLevel)level),
+                               maxValue, a[0], a[1], a[2], y[0]);
+                    }
+                }
+            }
+        }
+    }
+    printf("Cinza de 16 bits: %d pixels, %d errados\n", cases, failures);
+    return failures == 0;
+}
+
+// Maior diferença entre dois buffers de amostras de 8 bits.
+static int maxDifference(const vector<unsigned char> &a, const vector<unsigned char> &b) {
+    int worst = 0;
+    for (size_t i = 0; i < a.size(); i++) worst = max(worst, abs((int)a[i] - (int)b[i]));
+    return worst;
+}
+
+// LUTs sobre as 2^24 cores: a grade 33^3 fica a no máximo 1 dos filtros
+// lineares (nos outros o erro só é mostrado: o colorize é um OU de bits e
+// o chroma-key tem borda dura, que a interpolação suaviza); a tabela
+// exata reproduz a cadeia com chroma-key sem nenhuma diferença; e gravar e
+// reler um .cube não muda a grade.
+static bool checkLUT() {
+    const size_t colors = (size_t)1 << 24;
+    vector<unsigned char> all(colors * 3);
+    for (size_t i = 0; i < colors; i++) {
+        all[3 * i] = (unsigned char)(i >> 16);
+        all[3 * i + 1] = (unsigned char)(i >> 8);
+        all[3 * i + 2] = (unsigned char)i;
+    }
+    struct Case {
+        const char *name;
+        PointFilter filter;
+        int bound;   // -1: só mostra o erro
+    };
+    const Case cases[] = {
+        { "cinza ponderado", [](unsigned char *rgb, size_t n) {
+              filters_scalar::grayScale(rgb, n, makeGrayScale(false)); }, 1 },
+        { "cinza pela média", [](unsigned char *rgb, size_t n) {
+              filters_scalar::grayScale(rgb, n, makeGrayScale(true)); }, 1 },
+        { "negativo", [](unsigned char *rgb, size_t n) { filters_scalar::negative(rgb, n); }, 1 },
+        { "cinza + colorize", grayColorize, -1 },
+        { "chroma-key + cinza", [](unsigned char *rgb, size_t n) {
+              filters_scalar::chromaKey(rgb, n, makeChromaKey(0, 255, 0, 0.4));
+              filters_scalar::grayScale(rgb, n, makeGrayScale(false)); }, -1 },
+    };
+    bool ok = true;
+    vector<unsigned char> direct, baked;
+    for (const Case &c : cases) {
+        direct = all;
+        c.filter(direct.data(), colors);
+
+        ColorLUT grid;
+        grid.bake(c.filter, 33);
+        baked = all;
+        grid.apply(baked.data(), colors);
+        int gridError = maxDifference(direct, baked);
+        bool gridOk = c.bound < 0 || gridError <= c.bound;
+
+        ExactColorLUT exact;
+        exact.bake(c.filter);
+        baked = all;
+        exact.apply(baked.data(), colors);
+        bool exactOk = baked == direct;
+
+        char bound[32];
+        snprintf(bound, sizeof(bound), c.bound < 0 ? "sem limite" : "limite %d", c.bound);
+        printf("LUT de %s: grade 33^3 com erro máximo %d (%s)%s; tabela exata %s\n", c.name, gridError, bound,
+               gridOk ? "" : "  ERRO", exactOk ? "igual" : "DIFERENTE");
+        ok = ok && gridOk && exactOk;
+    }
+
+    const string path = "bench_filters_lut.cube";
+    ColorLUT saved, loaded;
+    saved.bake(grayColorize, 33);
+    bool roundTrip = saved.saveCube(path) && loaded.loadCube(path) && loaded.size() == saved.size();
+    remove(path.c_str());
+    if (roundTrip) {
+        direct = all;
+        baked = all;
+        saved.apply(direct.data(), colors);
+        loaded.apply(baked.data(), colors);
+        roundTrip = direct == baked;
+    }
+    printf("LUT .cube gravada e relida: %s\n", roundTrip ? "igual" : "DIFERENTE");
+    return ok && roundTrip;
+}
+
+// Percentil pelo método do posto mais próximo; values já ordenado.
+static double percentile(const vector<double> &values, double p) {
+    size_t rank = (size_t)(p / 100.0 * values.size() + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > values.size()) rank = values.size();
+    return values[rank - 1];
+}
+
+static bool writeJson(const string &path, const vector<Result> &results) {
+    ofstream out(path);
+    if (!out) {
+        cerr << "Não foi possível criar " << path << endl;
+        return false;
+    }
+    out << "{\n  \"simd\": \"" << simdLevelName(cpuSimdLevel()) << "\",\n";
+    out << "  \"threads\": " << ThreadPool::shared().size() << ",\n";
+    out << "  \"results\": [\n";
+    char line[512];
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        // um resultado por linha, como readBaseline espera
+        snprintf(line, sizeof(line),
+                 "    {\"name\": \"%s\", \"filter\": \"%s\", \"variant\": \"%s\", \"width\": %d, \"height\": %d, "
+                 "\"mps_p10\": %.3f, \"mps_p50\": %.3f, \"mps_p90\": %.3f}%s\n",
+                 r.key.c_str(), r.filter.c_str(), r.variant.c_str(), r.width, r.height,
+                 r.p10, r.p50, r.p90, i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+    return (bool)out;
+}
+
+// Lê nome e mediana de cada resultado de um arquivo gravado por writeJson.
+static bool readBaseline(const string &path, map<string, double> &baseline) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "Não foi possível abrir " << path << endl;
+        return false;
+    }
+    string line;
+    while (getline(in, line)) {
+        size_t name = line.find("\"name\": \"");
+        size_t p50 = line.find("\"mps_p50\": ");
+        if (name == string::npos || p50 == string::npos) continue;
+        name += 9;
+        size_t end = line.find('"', name);
+        if (end == string::npos) continue;
+        baseline[line.substr(name, end - name)] = atof(line.c_str() + p50 + 11);
+    }
+    if (baseline.empty()) {
+        cerr << "Nenhum resultado em " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+static bool parseSizes(const string &text, vector<pair<int, int> > &sizes) {
+    sizes.clear();
+    stringstream ss(text);
+    string item;
+    while (getline(ss, item, ',')) {
+        int w, h;
+        if (sscanf(item.c_str(), "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) return false;
+        sizes.push_back(make_pair(w, h));
+    }
+    return !sizes.empty();
+}
+
+int main(int argc, char **argv) {
+    vector<pair<int, int> > sizes;
+    sizes.push_back(make_pair(640, 480));
+    sizes.push_back(make_pair(1920, 1080));
+    sizes.push_back(make_pair(3840, 2160));
+    sizes.push_back(make_pair(8192, 8192));
+    int reps = 15;
+    int bits = 8;
+    double threshold = 10.0;
+    string jsonPath, comparePath;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sizes" && hasValue) {
+            if (!parseSizes(argv[++i], sizes)) {
+                cerr << "Tamanhos inválidos, use LxA,LxA,..." << endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--reps" && hasValue) {
+            reps = max(1, atoi(argv[++i]));
+        } else if (arg == "--bits" && hasValue) {
+            bits = atoi(argv[++i]);
+            if (bits != 8 && bits != 16) {
+                cerr << "--bits aceita 8 ou 16" << endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (arg == "--compare" && hasValue) {
+            comparePath = argv[++i];
+        } else if (arg == "--threshold" && hasValue) {
+            threshold = atof(argv[++i]);
+        } else {
+            cerr << "Uso: " << argv[0] << " [--sizes LxA,...] [--reps N] [--bits 8|16] [--json saida.json]"
+                 << " [--compare base.json] [--threshold PORCENTAGEM]" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    map<string, double> baseline;
+    if (!comparePath.empty() && !readBaseline(comparePath, baseline)) return EXIT_FAILURE;
+
+    if (bits == 16 && !checkGray16()) return EXIT_FAILURE;
+    if (bits == 8 && !checkLUT()) return EXIT_FAILURE;
+
+    if (bits == 8) {
+        lut.bake(grayColorize);
+        exactLut.bake(grayColorize);
+    }
+
+    vector<Variant> variants;
+    variants.push_back(Variant{ "scalar", SIMD_SCALAR, false });
+    if (cpuSimdLevel() >= SIMD_SSE2) variants.push_back(Variant{ "sse2", SIMD_SSE2, false });
+    if (cpuSimdLevel() >= SIMD_AVX2) variants.push_back(Variant{ "avx2", SIMD_AVX2, false });
+    variants.push_back(Variant{ "threads", cpuSimdLevel(), true });
+
+    FilterExecutor ex;
+    printf("CPU %s, %u threads, %d repetições, %d bits por canal\n", simdLevelName(cpuSimdLevel()), ex.threads(),
+           reps, bits);
+    printf("%-14s %-8s %11s %10s %10s %10s %10s\n", "filtro", "variante", "tamanho", "MP/s p10", "p50", "p90",
+           "MB/s p50");
+    const int sampleBytes = bits / 8;
+    const int filterCount = bits == 16 ? LUT : FILTER_COUNT;
+
+    vector<Result> results;
+    bool ok = true;
+    for (size_t s = 0; s < sizes.size(); s++) {
+        int w = sizes[s].first, h = sizes[s].second;
+        size_t samples = (size_t)w * h * 3;
+        size_t bytes = samples * sampleBytes;
+        vector<unsigned char> source(bytes), work(bytes), reference(bytes);
+        for (size_t i = 0; i < samples; i++) {
+            unsigned v = (unsigned)((i * 2654435761u) >> 13);
+            if (sampleBytes == 2) ((uint16_t *)source.data())[i] = (uint16_t)v;
+            else source[i] = (unsigned char)v;
+        }
+        // imagens pequenas repetem mais para reduzir o ruído do relógio
+        int inner = max(1, (int)(4e6 / ((double)w * h)));
+
+        for (int f = 0; f < filterCount; f++) {
+            for (size_t v = 0; v < variants.size(); v++) {
+                vector<double> mps;
+                for (int r = 0; r <= reps; r++) {
+                    double seconds = 0.0;
+                    for (int k = 0; k < inner; k++) {
+                        memcpy(work.data(), source.data(), bytes);
+                        auto t0 = chrono::steady_clock::now();
+                        if (sampleBytes == 2) runFilter16(f, variants[v], ex, (uint16_t *)work.data(), w, h);
+                        else runFilter(f, variants[v], ex, work.data(), w, h);
+                        seconds += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+                    }
+                    // a primeira execução só aquece caches e threads
+                    if (r > 0) mps.push_back((double)w * h * inner / seconds / 1e6);
+                }
+                if (v == 0) {
+                    reference = work;
+                } else if (work != reference) {
+                    printf("ERRO: %s/%s difere da versão escalar\n", FILTER_NAMES[f], variants[v].name.c_str());
+                    ok = false;
+                }
+                sort(mps.begin(), mps.end());
+
+                Result res;
+                res.filter = FILTER_NAMES[f];
+                res.variant = variants[v].name;
+                res.width = w;
+                res.height = h;
+                res.key = res.filter + "/" + res.variant + "/" + to_string(w) + "x" + to_string(h);
+                if (bits == 16) res.key += "/16";
+                res.p10 = percentile(mps, 10);
+                res.p50 = percentile(mps, 50);
+                res.p90 = percentile(mps, 90);
+                results.push_back(res);
+
+                char size[32];
+                snprintf(size, sizeof(size), "%dx%d", w, h);
+                printf("%-14s %-8s %11s %10.1f %10.1f %10.1f %10.1f", res.filter.c_str(), res.variant.c_str(), size,
+                       res.p10, res.p50, res.p90, res.p50 * 3 * sampleBytes);
+                map<string, double>::const_iterator base = baseline.find(res.key);
+                if (base != baseline.end() && base->second > 0.0) {
+                    double change = (res.p50 / base->second - 1.0) * 100.0;
+                    bool regressed = change < -threshold;
+                    printf("  %+6.1f%%%s", change, regressed ? "  REGRESSÃO" : "");
+                    if (regressed) ok = false;
+                }
+                printf("\n");
+            }
+        }
+    }
+
+    if (!jsonPath.empty() && !writeJson(jsonPath, results)) return EXIT_FAILURE;
+    if (!comparePath.empty()) {
+        printf("Comparação com %s (limite %.1f%%): %s\n", comparePath.c_str(), threshold,
+               ok ? "ok" : "FALHOU");
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,557 @@
+// Benchmark do decodificador JPEG vendorizado (M5_Material/stb_image.cpp)
+// com os kernels de JpegKernels.h. Cada arquivo é lido uma vez para a
+// memória e decodificado --reps vezes em cada nível SIMD (IDCT e YCbCr ->
+// RGB trocados pelos ganchos stbi_install_*); a tabela mostra a mediana em
+// ms, megapixels/s e se a imagem saiu idêntica à do nível escalar. A
+// ampliação do croma é escolhida uma vez pelo stb (M3_SIMD), então é medida
+// à parte, em linhas de 4096 amostras. Os níveis usam o pool de threads do
+// stb (intervalos de restart e faixas de linhas em paralelo); a penúltima
+// linha de cada arquivo repete o melhor nível só na thread que chama
+// (stbi_jpeg_set_parallel(0)) e a última decodifica com stbi_load_into num
+// buffer já alocado; as duas têm de dar a mesma imagem.
+//
+// Uso: bench_jpeg ARQUIVO.jpg [ARQUIVO.jpg ...] [--reps N] [--blocks N]
+//      bench_jpeg --alloc-check [ARQUIVO.jpg ...] [--reps N]
+//
+// Antes dos arquivos, --blocks blocos 8x8 aleatórios (pixels de 8 bits
+// passados pela DCT direta e quantizados, como faria um codificador) passam
+// pela IDCT de cada nível e são comparados com a escalar, assim como trechos
+// aleatórios das ampliações. O programa termina com erro se algum nível
+// diferir.
+//
+// Com --alloc-check só se verifica que stbi_load_into_from_memory repetido no
+// mesmo buffer não aloca nada (AllocCounter.h): JPEGs gerados aqui (4:2:0 com
+// e sem restart, 4:4:4 e cinza com restart) e os arquivos dados, para
+// req_comp 1 a 4, com o pool e numa thread só, num buffer com folga no fim de
+// cada linha que não pode ser tocada.
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../M5_Material/stb_image.h"
+#include "AllocCounter.h"
+#include "JpegKernels.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static vector<SimdLevel> availableLevels() {
+    vector<SimdLevel> levels;
+    for (int l = SIMD_SCALAR; l <= cpuSimdLevel(); l++) levels.push_back((SimdLevel)l);
+    return levels;
+}
+
+static void install(SimdLevel level) {
+    stbi_install_idct(jpegKernels(level).idct);
+    stbi_install_YCbCr_to_RGB(jpegKernels(level).ycbcrToRgb);
+}
+
+struct UpsampleCase {
+    const char *name;
+    UpsampleSpan JpegKernels::*span;
+    int factor;     // saídas por amostra
+};
+
+static const UpsampleCase UPSAMPLES[] = {
+    { "v2", &JpegKernels::upsampleV2, 1 },
+    { "h2", &JpegKernels::upsampleH2, 2 },
+    { "hv2", &JpegKernels::upsampleHV2, 2 },
+};
+
+// Trechos [begin, end) aleatórios de linhas de 1 a 300 amostras.
+static bool checkUpsample(int spans) {
+    const vector<SimdLevel> levels = availableLevels();
+    bool ok = true;
+    for (const UpsampleCase &u : UPSAMPLES) {
+        vector<int> mismatches(levels.size(), 0);
+        unsigned seed = 7;
+        for (int t = 0; t < spans; t++) {
+            seed = seed * 1103515245u + 12345u;
+            int w = 1 + (seed >> 16) % 300;
+            unsigned char near[300], far[300];
+            for (int i = 0; i < w; i++) {
+                seed = seed * 1103515245u + 12345u;
+                near[i] = (unsigned char)(seed >> 16);
+                far[i] = (unsigned char)(seed >> 24);
+            }
+            seed = seed * 1103515245u + 12345u;
+            int begin = (seed >> 16) % w;
+            int end = begin + 1 + (int)((seed >> 8) % (w - begin));
+            unsigned char ref[600], out[600];
+            (jpegKernels(SIMD_SCALAR).*u.span)(ref, near, far, w, begin, end);
+            for (size_t l = 1; l < levels.size(); l++) {
+                (jpegKernels(levels[l]).*u.span)(out, near, far, w, begin, end);
+                if (memcmp(out, ref, (size_t)(end - begin) * u.factor) != 0) mismatches[l]++;
+            }
+        }
+        for (size_t l = 1; l < levels.size(); l++) {
+            printf("Ampliação %s %s: %d trechos, %d diferentes da escalar\n", u.name, simdLevelName(levels[l]), spans,
+                   mismatches[l]);
+            ok = ok && mismatches[l] == 0;
+        }
+    }
+    return ok;
+}
+
+static void benchUpsample(int reps) {
+    const int w = 4096, rows = 256;
+    vector<unsigned char> near(w), far(w), out(2 * w);
+    for (int i = 0; i < w; i++) {
+        near[i] = (unsigned char)(i * 7);
+        far[i] = (unsigned char)(i * 13);
+    }
+    const vector<SimdLevel> levels = availableLevels();
+    for (const UpsampleCase &u : UPSAMPLES) {
+        for (size_t l = 0; l < levels.size(); l++) {
+            UpsampleSpan span = jpegKernels(levels[l]).*u.span;
+            vector<double> times;
+            for (int r = 0; r < reps; r++) {
+                Clock::time_point t0 = Clock::now();
+                for (int y = 0; y < rows; y++) span(out.data(), near.data(), far.data(), w, 0, w);
+                times.push_back(chrono::duration<double>(Clock::now() - t0).count());
+            }
+            sort(times.begin(), times.end());
+            double median = times[times.size() / 2];
+            printf("ampliação %-4s %-7s %8.1f Mamostras/s\n", u.name, simdLevelName(levels[l]),
+                   (double)w * rows / median / 1e6);
+        }
+    }
+}
+
+// Bloco como o de um arquivo real: DCT direta (double) de 8x8 pixels e
+// quantização com a tabela dq, na ordem natural que stbi_idct_8x8 recebe.
+static void encodeBlock(const int pixels[64], const unsigned short dq[64], short data[64]) {
+    const double pi = 3.14159265358979323846;
+    for (int v = 0; v < 8; v++) {
+        for (int u = 0; u < 8; u++) {
+            double sum = 0.0;
+            for (int y = 0; y < 8; y++) {
+                for (int x = 0; x < 8; x++) {
+                    sum += (pixels[y * 8 + x] - 128) * cos((2 * x + 1) * u * pi / 16) * cos((2 * y + 1) * v * pi / 16);
+                }
+            }
+            double cu = u ? 1.0 : sqrt(0.5), cv = v ? 1.0 : sqrt(0.5);
+            data[v * 8 + u] = (short)lround(0.25 * cu * cv * sum / dq[v * 8 + u]);
+        }
+    }
+}
+
+// Compara a IDCT de cada nível com a escalar em blocos aleatórios: ruído,
+// degradês e blocos planos, com tabelas de qualidade 1 a 100.
+static bool checkIdct(int blocks) {
+    const vector<SimdLevel> levels = availableLevels();
+    vector<int> mismatches(levels.size(), 0);
+    unsigned seed = 2024;
+    for (int b = 0; b < blocks; b++) {
+        int pixels[64];
+        unsigned short dq[64];
+        short data[64];
+        seed = seed * 1103515245u + 12345u;
+        int q = 1 + (seed >> 16) % 255, kind = b % 3;
+        for (int i = 0; i < 64; i++) {
+            seed = seed * 1103515245u + 12345u;
+            int noise = (seed >> 16) % 256;
+            int ramp = (i % 8) * 36;
+            pixels[i] = kind == 0 ? noise : kind == 1 ? (i / 8 % 2 ? 255 - ramp : ramp) : q;
+            dq[i] = (unsigned short)(i == 0 ? 1 + q / 8 : q);
+        }
+        encodeBlock(pixels, dq, data);
+    unsigned char ref[64];
+        idct_scalar::idct8x8(ref, 8, data, dq);
+        for (size_t l = 1; l < levels.size(); l++) {
+            unsigned char out[64];
+            jpegKernels(levels[l]).idct(out, 8, data, dq);
+            if (memcmp(out, ref, sizeof(out)) != 0) mismatches[l]++;
+        }
+    }
+    bool ok = true;
+    for (size_t l = 1; l < levels.size(); l++) {
+        printf("IDCT %s: %d blocos, %d diferentes da escalar\n", simdLevelName(levels[l]), blocks, mismatches[l]);
+        ok = ok && mismatches[l] == 0;
+    }
+    return ok;
+}
+
+// ---- --alloc-check ----
+//
+// JPEGs baseline escritos aqui: as mesmas tabelas de Huffman (todos os
+// símbolos com o mesmo comprimento) para todas as componentes e uma tabela de
+// quantização só. Não comprimem bem, mas passam pelo mesmo decodificador.
+
+static const int ZIGZAG[64] = { 0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                                12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                                35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+
+// Bits do fluxo entrópico, do mais significativo para o menos, com o 0x00
+// depois de cada 0xFF; flush completa o byte com uns.
+struct JpegBitWriter {
+    vector<unsigned char> &out;
+    unsigned acc;
+    int count;
+
+    explicit JpegBitWriter(vector<unsigned char> &out) : out(out), acc(0), count(0) {}
+
+    void bits(unsigned value, int n) {
+        for (int i = n - 1; i >= 0; i--) {
+            acc = acc << 1 | ((value >> i) & 1);
+            if (++count == 8) {
+                out.push_back((unsigned char)acc);
+                if (acc == 0xff) out.push_back(0);
+                acc = 0;
+                count = 0;
+            }
+        }
+    }
+    void flush() {
+        while (count) bits(1, 1);
+    }
+};
+
+static void putMarker(vector<unsigned char> &out, int marker, const vector<unsigned char> &payload) {
+    out.push_back(0xff);
+    out.push_back((unsigned char)marker);
+    if (marker == 0xd8 || marker == 0xd9) return;
+    out.push_back((unsigned char)((payload.size() + 2) >> 8));
+    out.push_back((unsigned char)(payload.size() + 2));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+// Categoria (número de bits) de um coeficiente e os bits que o seguem.
+static int category(int v) {
+    int n = 0;
+    for (int a = abs(v); a; a >>= 1) n++;
+    return n;
+}
+
+static void putCoefficient(JpegBitWriter &w, int v, int n) {
+    w.bits(v < 0 ? (unsigned)(v - 1) : (unsigned)v, n);
+}
+
+// Códigos DC: categoria 0-11 em 4 bits. Códigos AC: EOB, ZRL e depois
+// (zeros << 4 | categoria) para 0-15 zeros e categorias 1-10, em 8 bits.
+static void putBlock(JpegBitWriter &w, const short data[64], int &pred) {
+    int diff = data[0] - pred, n = category(diff);
+    pred = data[0];
+    w.bits(n, 4);
+    putCoefficient(w, diff, n);
+    int zeros = 0;
+    for (int k = 1; k < 64; k++) {
+        int v = data[ZIGZAG[k]];
+        if (!v) {
+            zeros++;
+            continue;
+        }
+        for (; zeros >= 16; zeros -= 16) w.bits(1, 8);
+        n = category(v);
+        w.bits(2 + zeros * 10 + n - 1, 8);
+        putCoefficient(w, v, n);
+        zeros = 0;
+    }
+    if (zeros) w.bits(0, 8);
+}
+
+// Imagem w x h de degradês com ruído, em cinza (components == 1) ou YCbCr
+// 4:2:0 ou 4:4:4, com um marcador de restart a cada restart MCUs (0 = sem).
+static vector<unsigned char> syntheticJpeg(int w, int h, int components, bool subsample, int restart) {
+    vector<double> planes[3];
+    for (int c = 0; c < 3; c++) planes[c].resize((size_t)w * h);
+    unsigned seed = 7;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            seed = seed * 1103515245u + 12345u;
+            double noise = (double)((seed >> 16) % 32) - 16.0;
+            double r = 255.0 * x / w + noise, g = 255.0 * y / h, b = 128.0 + 100.0 * sin(x * 0.1 + y * 0.05);
+            size_t i = (size_t)y * w + x;
+            planes[0][i] = 0.299 * r + 0.587 * g + 0.114 * b;
+            planes[1][i] = 128.0 - 0.168736 * r - 0.331264 * g + 0.5 * b;
+            planes[2][i] = 128.0 + 0.5 * r - 0.418688 * g - 0.081312 * b;
+        }
+    }
+    if (components == 1) subsample = false;
+    const int mcu = subsample ? 16 : 8;
+    const int mcusX = (w + mcu - 1) / mcu, mcusY = (h + mcu - 1) / mcu;
+    unsigned short dq[64];
+    for (int i = 0; i < 64; i++) dq[i] = (unsigned short)(6 + 2 * (i / 8 + i % 8));
+
+    vector<unsigned char> out, payload;
+    putMarker(out, 0xd8, payload);
+    payload.push_back(0);
+    for (int k = 0; k < 64; k++) payload.push_back((unsigned char)dq[ZIGZAG[k]]);
+    putMarker(out, 0xdb, payload);
+    payload = { 8, (unsigned char)(h >> 8), (unsigned char)h, (unsigned char)(w >> 8), (unsigned char)w,
+                (unsigned char)components };
+    for (int c = 0; c < components; c++) {
+        payload.push_back((unsigned char)(c + 1));
+        payload.push_back(c == 0 && subsample ? 0x22 : 0x11);
+        payload.push_back(0);
+    }
+    putMarker(out, 0xc0, payload);
+    payload.assign(1, 0x00);
+    for (int len = 1; len <= 16; len++) payload.push_back(len == 4 ? 12 : 0);
+    for (int s = 0; s < 12; s++) payload.push_back((unsigned char)s);
+    payload.push_back(0x10);
+    for (int len = 1; len <= 16; len++) payload.push_back(len == 8 ? 162 : 0);
+    payload.push_back(0x00);
+    payload.push_back(0xf0);
+    for (int zeros = 0; zeros < 16; zeros++)
+        for (int n = 1; n <= 10; n++) payload.push_back((unsigned char)(zeros << 4 | n));
+    putMarker(out, 0xc4, payload);
+    if (restart) putMarker(out, 0xdd, { (unsigned char)(restart >> 8), (unsigned char)restart });
+    payload.assign(1, (unsigned char)components);
+    for (int c = 0; c < components; c++) {
+        payload.push_back((unsigned char)(c + 1));
+        payload.push_back(0);
+    }
+    payload.insert(payload.end(), { 0, 63, 0 });
+    putMarker(out, 0xda, payload);
+
+    JpegBitWriter bits(out);
+    int pred[3] = { 0, 0, 0 }, interval = 0;
+    for (int m = 0; m < mcusX * mcusY; m++) {
+        if (restart && m && m % restart == 0) {
+            bits.flush();
+            out.push_back(0xff);
+            out.push_back((unsigned char)(0xd0 + interval++ % 8));
+            pred[0] = pred[1] = pred[2] = 0;
+        }
+        const int mx = m % mcusX * mcu, my = m / mcusX * mcu;
+        for (int c = 0; c < components; c++) {
+            const int blocks = c == 0 && subsample ? 2 : 1, scale = subsample && c ? 2 : 1;
+            for (int by = 0; by < blocks; by++) {
+                for (int bx = 0; bx < blocks; bx++) {
+                    int pixels[64];
+                    short data[64];
+                    for (int i = 0; i < 64; i++) {
+                        // amostra da componente (média 2x2 no croma 4:2:0), com a borda repetida
+                        double sum = 0.0;
+                        for (int s = 0; s < scale * scale; s++) {
+                            int x = min(mx + (bx * 8 + i % 8) * scale + s % scale, w - 1);
+                            int y = min(my + (by * 8 + i / 8) * scale + s / scale, h - 1);
+                            sum += planes[c][(size_t)y * w + x];
+                        }
+                        pixels[i] = (int)lround(sum / (scale * scale));
+                        pixels[i] = pixels[i] < 0 ? 0 : pixels[i] > 255 ? 255 : pixels[i];
+                    }
+                    encodeBlock(pixels, dq, data);
+                    putBlock(bits, data, pred[c]);
+                }
+            }
+        }
+    }
+    bits.flush();
+    putMarker(out, 0xd9, payload);
+    return out;
+}
+
+struct AllocCase {
+    string name;
+    vector<unsigned char> file;
+};
+
+// Decodifica cada arquivo com stbi_load_into_from_memory num buffer com 13
+// bytes de folga por linha e 64 no fim, para req_comp 1 a 4, em paralelo e
+// numa thread só: a primeira vez aloca os buffers do stb e o pool, as
+// seguintes não podem alocar nada. A imagem tem de ser a de stbi_load e as
+// folgas têm de continuar intactas.
+static bool checkAlloc(const vector<AllocCase> &cases, int reps) {
+    if (!allocCountAvailable()) {
+        cerr << "--alloc-check precisa da glibc" << endl;
+        return false;
+    }
+    bool ok = true;
+    for (const AllocCase &c : cases) {
+        for (int parallel = 1; parallel >= 0; parallel--) {
+            stbi_jpeg_set_parallel(parallel);
+            for (int req = 1; req <= 4; req++) {
+                int w = 0, h = 0, comp = 0;
+                unsigned char *pixels = stbi_load_from_memory(c.file.data(), (int)c.file.size(), &w, &h, &comp, req);
+                if (!pixels) {
+                    cerr << c.name << ": " << stbi_failure_reason() << endl;
+                    return false;
+                }
+                const size_t row = (size_t)w * req, stride = row + 13;
+                vector<unsigned char> fill(stride * h + 64), out;
+                for (size_t i = 0; i < fill.size(); i++) fill[i] = (unsigned char)(i * 29 + 7);
+                out = fill;
+                int x, y, n;
+                int loaded = stbi_load_into_from_memory(c.file.data(), (int)c.file.size(), out.data(),
+                                                        (int)out.size(), (int)stride, &x, &y, &n, req);
+                startAllocCount();
+                for (int r = 0; r < reps && loaded; r++)
+                    loaded = stbi_load_into_from_memory(c.file.data(), (int)c.file.size(), out.data(), (int)out.size(),
+                                                        (int)stride, &x, &y, &n, req);
+                long allocs = stopAllocCount();
+                int badRows = 0, guards = 0;
+                for (size_t i = 0; i < out.size(); i++) {
+                    size_t ry = i / stride, rx = i % stride;
+                    if (ry < (size_t)h && rx < row) badRows += out[i] != pixels[ry * row + rx];
+                    else guards += out[i] != fill[i];
+                }
+                stbi_image_free(pixels);
+                bool good = loaded && allocs == 0 && badRows == 0 && guards == 0;
+                ok = ok && good;
+                printf("%-28s %-9s req_comp %d: %ld alocações em %d repetições, %d bytes diferentes de stbi_load, "
+                       "%d bytes de folga alterados%s\n",
+                       c.name.c_str(), parallel ? "paralelo" : "1 thread", req, allocs, reps, badRows, guards,
+                       loaded ? "" : " (FALHOU)");
+            }
+        }
+    }
+    stbi_jpeg_set_parallel(1);
+    return ok;
+}
+
+// Decodifica o arquivo reps vezes; devolve a mediana em segundos (negativa
+// se falhar) e a imagem da primeira vez.
+static double decodeMedian(const vector<unsigned char> &file, int reps, vector<unsigned char> &image, int &w,
+                           int &h) {
+    vector<double> times;
+    int comp = 0;
+    for (int r = 0; r < reps; r++) {
+        Clock::time_point t0 = Clock::now();
+        unsigned char *pixels = stbi_load_from_memory(file.data(), (int)file.size(), &w, &h, &comp, 3);
+        times.push_back(chrono::duration<double>(Clock::now() - t0).count());
+        if (!pixels) return -1.0;
+        if (r == 0) image.assign(pixels, pixels + (size_t)w * h * 3);
+        stbi_image_free(pixels);
+    }
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+// Como decodeMedian, mas com stbi_load_into no mesmo buffer todas as vezes
+// (depois da primeira o stb não aloca mais nada).
+static double intoMedian(const vector<unsigned char> &file, int reps, vector<unsigned char> &image, int w, int h) {
+    vector<double> times;
+    int x, y, comp;
+    image.assign((size_t)w * h * 3, 0);
+    for (int r = 0; r < reps; r++) {
+        Clock::time_point t0 = Clock::now();
+        int ok = stbi_load_into_from_memory(file.data(), (int)file.size(), image.data(), (int)image.size(), 0, &x, &y,
+                                            &comp, 3);
+        times.push_back(chrono::duration<double>(Clock::now() - t0).count());
+        if (!ok) return -1.0;
+    }
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+static bool benchFile(const string &path, int reps) {
+    ifstream in(path.c_str(), ios::binary);
+    vector<unsigned char> file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    if (file.empty()) {
+        cerr << "Não foi possível ler " << path << endl;
+        return false;
+    }
+    const string name = path.substr(path.find_last_of("/\\") + 1);
+    const vector<SimdLevel> levels = availableLevels();
+    vector<unsigned char> reference;
+    bool ok = true;
+    for (size_t l = 0; l <= levels.size(); l++) {
+        // a volta extra é o melhor nível sem o pool de threads
+        bool serial = l == levels.size();
+        SimdLevel level = serial ? levels.back() : levels[l];
+        install(level);
+        stbi_jpeg_set_parallel(!serial);
+        int w = 0, h = 0;
+        vector<unsigned char> image;
+        double median = decodeMedian(file, reps, image, w, h);
+        if (median < 0.0) {
+            cerr << path << ": " << stbi_failure_reason() << endl;
+            ok = false;
+            break;
+        }
+        if (l == 0) reference = image;
+        bool same = image == reference;
+        ok = ok && same;
+        printf("%-24s %5dx%-5d %-7s %-9s %9.1f ms %8.1f MP/s  %s\n", name.c_str(), w, h, simdLevelName(level),
+               serial ? "1 thread" : "paralelo", median * 1e3, (double)w * h / median / 1e6,
+               same ? "= escalar" : "DIFERENTE");
+    }
+    stbi_jpeg_set_parallel(1);
+    if (ok) {
+        int w = 0, h = 0, comp = 0;
+        stbi_info_from_memory(file.data(), (int)file.size(), &w, &h, &comp);
+        vector<unsigned char> image;
+        double median = intoMedian(file, reps, image, w, h);
+        if (median < 0.0) {
+            cerr << path << " (stbi_load_into): " << stbi_failure_reason() << endl;
+            ok = false;
+        } else {
+            bool same = image == reference;
+            ok = ok && same;
+            printf("%-24s %5dx%-5d %-7s %-9s %9.1f ms %8.1f MP/s  %s\n", name.c_str(), w, h,
+                   simdLevelName(levels.back()), "load_into", median * 1e3, (double)w * h / median / 1e6,
+                   same ? "= escalar" : "DIFERENTE");
+        }
+    }
+    install(jpegKernels().level);
+    return ok;
+}
+
+static vector<unsigned char> readFile(const string &path) {
+    ifstream in(path.c_str(), ios::binary);
+    return vector<unsigned char>((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+int main(int argc, char **argv) {
+    int reps = 5, blocks = 100000;
+    bool allocCheck = false;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--reps" && i + 1 < argc) {
+            reps = max(1, atoi(argv[++i]));
+        } else if (arg == "--blocks" && i + 1 < argc) {
+            blocks = max(0, atoi(argv[++i]));
+        } else if (arg == "--alloc-check") {
+            allocCheck = true;
+        } else if (!arg.empty() && arg[0] != '-') {
+            files.push_back(arg);
+        } else {
+            cerr << "Uso: " << argv[0] << " ARQUIVO.jpg [ARQUIVO.jpg ...] [--reps N] [--blocks N]" << endl;
+            cerr << "     " << argv[0] << " --alloc-check [ARQUIVO.jpg ...] [--reps N]" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (allocCheck) {
+        vector<AllocCase> cases = { { "gerado 4:2:0", syntheticJpeg(203, 117, 3, true, 0) },
+                                    { "gerado 4:2:0, restart/linha", syntheticJpeg(203, 117, 3, true, 13) },
+                                    { "gerado 4:4:4, restart 5", syntheticJpeg(97, 61, 3, false, 5) },
+                                    { "gerado cinza, restart 7", syntheticJpeg(131, 45, 1, false, 7) } };
+        for (size_t i = 0; i < files.size(); i++) {
+            cases.push_back(AllocCase{ files[i].substr(files[i].find_last_of("/\\") + 1), readFile(files[i]) });
+            if (cases.back().file.empty()) {
+                cerr << "Não foi possível ler " << files[i] << endl;
+                return EXIT_FAILURE;
+            }
+        }
+        printf("Pool de %d threads\n", (int)ThreadPool::shared().size());
+        if (!checkAlloc(cases, reps)) {
+            cerr << "stbi_load_into alocou memória, errou a imagem ou escreveu fora das linhas" << endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    bool ok = checkIdct(blocks);
+    ok = checkUpsample(blocks / 10) && ok;
+    benchUpsample(reps);
+    for (size_t i = 0; i < files.size(); i++) ok = benchFile(files[i], reps) && ok;
+    if (!ok) {
+        cerr << "Algum nível SIMD deu resultado diferente do escalar" << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
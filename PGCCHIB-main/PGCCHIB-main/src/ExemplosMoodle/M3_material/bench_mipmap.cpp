@@ -0,0 +1,294 @@
+// Verificação e benchmark da cadeia de mipmaps (Mipmap.h), sem contexto
+// OpenGL.
+//
+// Uso: bench_mipmap [--check] [--size LxA] [--reps N]
+//
+// Primeiro as verificações, que não dependem de GPU:
+//  - imagens pequenas fixas (tamanhos ímpares, dimensões de 1 pixel e 1 a 4
+//    canais) passam por buildMipChain com box, triângulo e Lanczos-3, e os
+//    bytes de todos os níveis são comparados com os valores guardados aqui;
+//  - box sem sRGB reduz cada bloco 2x2 à média dos bytes;
+//  - um xadrez preto e branco de 1 pixel vira cinza 188 em sRGB (a média em
+//    luz linear, não 128);
+//  - imagens constantes continuam constantes em todos os níveis;
+//  - cada nível SIMD dá os mesmos bytes que o escalar.
+// Depois (a menos de --check) mede buildMipChain numa imagem RGBA de --size
+// (2048x2048 por padrão) com cada filtro e nível SIMD. O programa termina com
+// erro se alguma verificação falhar.
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Mipmap.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static const ResampleFilter FILTERS[] = { RESAMPLE_BOX, RESAMPLE_TRIANGLE, RESAMPLE_LANCZOS3 };
+static const char *FILTER_NAMES[] = { "box", "triangle", "lanczos3" };
+
+// Pixel (x, y, c) das imagens de teste: variado e com alfa de 0 a 255.
+static unsigned char fixturePixel(int x, int y, int c) {
+    return (unsigned char)((x * 37 + y * 91 + c * 53 + x * y * 7 + 11) & 255);
+}
+
+static vector<unsigned char> fixture(int w, int h, int channels) {
+    vector<unsigned char> image((size_t)w * h * channels);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            for (int c = 0; c < channels; c++) image[((size_t)y * w + x) * channels + c] = fixturePixel(x, y, c);
+    return image;
+}
+
+// Todos os níveis, um depois do outro.
+static vector<unsigned char> chainBytes(const vector<MipLevel> &levels) {
+    vector<unsigned char> bytes;
+    for (const MipLevel &l : levels) bytes.insert(bytes.end(), l.pixels.begin(), l.pixels.end());
+    return bytes;
+}
+
+static unsigned fnv1a(const vector<unsigned char> &bytes) {
+    unsigned h = 2166136261u;
+    for (unsigned char b : bytes) h = (h ^ b) * 16777619u;
+    return h;
+}
+
+// Bytes esperados de duas imagens pequenas, por filtro: 4x4 cinza (níveis
+// 2x2 e 1x1) e 5x3 RGB (níveis 2x1 e 1x1). Conferidos com uma implementação
+// de referência em double, fora do repositório.
+struct SmallCase {
+    int w, h, channels;
+    unsigned char expected[3][9];
+};
+
+static const SmallCase SMALL_CASES[] = {
+    { 4, 4, 1, { { 95, 171, 167, 136, 146 }, { 117, 155, 148, 160, 146 }, { 118, 160, 158, 161, 151 } } },
+    { 5, 3, 3, { { 152, 157, 164, 140, 162, 165, 146, 160, 165 },
+                 { 147, 160, 161, 143, 159, 169, 145, 160, 165 },
+                 { 149, 159, 160, 144, 158, 170, 147, 159, 165 } } },
+};
+
+// Hash FNV-1a de todos os níveis, por filtro e número de canais, para cada
+// tamanho da lista (1x1 não tem níveis abaixo do 0: hash da sequência vazia).
+// Gravados da versão escalar; a referência em double só discorda em empates
+// de arredondamento do alfa (82,5 vira 83 aqui).
+struct Size {
+    int w, h;
+};
+
+static const Size SIZES[] = { { 5, 3 }, { 7, 1 }, { 1, 6 }, { 3, 3 }, { 9, 10 }, { 1, 1 } };
+static const int SIZE_COUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+
+static const unsigned CHAIN_HASHES[3][4][SIZE_COUNT] = {
+    {
+        { 0xc83e5fd9, 0xba9a1191, 0x807c0522, 0x950baccf, 0x515ed64f, 0x811c9dc5 },
+        { 0x376c29d2, 0x6e43e099, 0x77a1f8a4, 0xa25b4865, 0xc1d94c7f, 0x811c9dc5 },
+        { 0xfd35ce7c, 0xfe5b442f, 0xde1265fb, 0xa8ce1c6e, 0x589f0159, 0x811c9dc5 },
+        { 0x767d508d, 0xf3ec5e65, 0xb1c6970a, 0x191b1737, 0x2924197f, 0x811c9dc5 },
+    },
+    {
+        { 0x17025ff2, 0x6b83c60c, 0xb43edf2b, 0x950baccf, 0xb0388161, 0x811c9dc5 },
+        { 0xcb8b19c5, 0xb0759e8f, 0x2066f3ef, 0xa25b4865, 0x3dcaeebf, 0x811c9dc5 },
+        { 0x604330d6, 0xfbb6316f, 0xf6d94223, 0xa8ce1c6e, 0xa8ad8464, 0x811c9dc5 },
+        { 0x54d85a80, 0xb8b83362, 0x285a3b4d, 0x191b1737, 0xc2258f63, 0x811c9dc5 },
+    },
+    {
+        { 0xbcdd12c9, 0xd2c5e2b8, 0x11588ba5, 0x950baccf, 0xd5c4e95c, 0x811c9dc5 },
+        { 0x0df268bb, 0xaa0d9e60, 0xb6c8d148, 0xa25b4865, 0xca0f196d, 0x811c9dc5 },
+        { 0xe79c86ea, 0x4b2f7461, 0x3a26a528, 0xa8ce1c6e, 0xe6505d86, 0x811c9dc5 },
+        { 0x5a87016b, 0x0669eaf4, 0x84fe32af, 0x191b1737, 0x141a6abf, 0x811c9dc5 },
+    },
+};
+
+static bool checkFixtures() {
+    bool ok = true;
+    int failures = 0, cases = 0;
+    for (const SmallCase &s : SMALL_CASES) {
+        vector<unsigned char> image = fixture(s.w, s.h, s.channels);
+        for (int f = 0; f < 3; f++) {
+            vector<unsigned char> bytes = chainBytes(buildMipChain(image.data(), s.w, s.h, s.channels,
+                                                                   ResampleOptions(FILTERS[f]), ThreadPool::shared(),
+                                                                   SIMD_SCALAR));
+            cases++;
+            if (!equal(bytes.begin(), bytes.end(), s.expected[f])) {
+                failures++;
+                printf("  %dx%d, %d canais, %s: obtido", s.w, s.h, s.channels, FILTER_NAMES[f]);
+                for (unsigned char b : bytes) printf(" %d", b);
+                printf("\n");
+            }
+        }
+    }
+    for (int f = 0; f < 3; f++) {
+        for (int channels = 1; channels <= 4; channels++) {
+            for (int i = 0; i < SIZE_COUNT; i++) {
+                const Size &s = SIZES[i];
+                vector<unsigned char> image = fixture(s.w, s.h, channels);
+                vector<MipLevel> levels = buildMipChain(image.data(), s.w, s.h, channels,
+                                                        ResampleOptions(FILTERS[f]), ThreadPool::shared(), SIMD_SCALAR);
+                unsigned hash = fnv1a(chainBytes(levels));
+                cases++;
+                if (hash != CHAIN_HASHES[f][channels - 1][i]) {
+                    failures++;
+                    printf("  %dx%d, %d canais, %s: hash 0x%08x, esperado 0x%08x\n", s.w, s.h, channels,
+                           FILTER_NAMES[f], hash, CHAIN_HASHES[f][channels - 1][i]);
+                }
+            }
+        }
+    }
+    printf("Imagens fixas: %d casos, %d diferentes do esperado\n", cases, failures);
+    ok = failures == 0;
+    return ok;
+}
+
+// Box 2x sem sRGB nem pré-multiplicação: média dos 4 bytes, arredondada.
+static bool checkBoxAverage() {
+    int w = 16, h = 10, failures = 0;
+    for (int channels = 1; channels <= 4; channels++) {
+        vector<unsigned char> image = fixture(w, h, channels);
+        vector<unsigned char> out((size_t)(w / 2) * (h / 2) * channels);
+        resampleImage(image.data(), w, h, out.data(), w / 2, h / 2, channels,
+                      ResampleOptions(RESAMPLE_BOX, false, false), ThreadPool::shared(), SIMD_SCALAR);
+        for (int y = 0; y < h / 2; y++)
+            for (int x = 0; x < w / 2; x++)
+                for (int c = 0; c < channels; c++) {
+                    int sum = fixturePixel(2 * x, 2 * y, c) + fixturePixel(2 * x + 1, 2 * y, c) +
+                              fixturePixel(2 * x, 2 * y + 1, c) + fixturePixel(2 * x + 1, 2 * y + 1, c);
+                    if (out[((size_t)y * (w / 2) + x) * channels + c] != (sum + 2) / 4) failures++;
+                }
+    }
+    printf("Box 2x sem sRGB = média dos bytes: %d diferentes\n", failures);
+    return failures == 0;
+}
+
+// Xadrez preto e branco de 1 pixel: todo pixel do nível 1 tem de ser 188.
+static bool checkChecker() {
+    int w = 8, h = 8, failures = 0;
+    vector<unsigned char> image((size_t)w * h * 3);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            for (int c = 0; c < 3; c++) image[((size_t)y * w + x) * 3 + c] = (x + y) % 2 ? 255 : 0;
+    vector<MipLevel> levels = buildMipChain(image.data(), w, h, 3, ResampleOptions(RESAMPLE_BOX));
+    for (unsigned char v : levels[0].pixels) failures += v != 188;
+    printf("Xadrez preto e branco -> nível 1 em sRGB: %d, %d pixels diferentes de 188\n", levels[0].pixels[0],
+           failures);
+    return failures == 0;
+}
+
+// Imagens constantes (alfa de 1 a 255) ficam iguais em todos os níveis.
+static bool checkConstant() {
+    static const Size sizes[] = { { 13, 7 }, { 1, 9 }, { 6, 1 }, { 32, 32 } };
+    static const unsigned char colors[][4] = { { 0, 0, 0, 255 }, { 255, 255, 255, 255 }, { 17, 128, 250, 200 },
+                                               { 90, 3, 77, 1 } };
+    int failures = 0, cases = 0;
+    for (int f = 0; f < 3; f++) {
+        for (int channels = 1; channels <= 4; channels++) {
+            for (const Size &s : sizes) {
+                for (const unsigned char *color : colors) {
+                    // Com 2 canais o segundo é o alfa (color[3]).
+                    unsigned char pixel[4] = { color[0], channels == 2 ? color[3] : color[1], color[2], color[3] };
+                    vector<unsigned char> image((size_t)s.w * s.h * channels);
+                    for (size_t i = 0; i < image.size(); i++) image[i] = pixel[i % channels];
+                    vector<MipLevel> levels = buildMipChain(image.data(), s.w, s.h, channels,
+                                                            ResampleOptions(FILTERS[f]));
+                    cases++;
+                    bool same = true;
+                    for (const MipLevel &l : levels)
+                        for (size_t i = 0; i < l.pixels.size(); i++) same = same && l.pixels[i] == pixel[i % channels];
+                    if (!same) {
+                        failures++;
+                        printf("  constante %dx%d, %d canais, %s mudou\n", s.w, s.h, channels, FILTER_NAMES[f]);
+                    }
+                }
+            }
+        }
+    }
+    printf("Imagens constantes: %d casos, %d mudaram\n", cases, failures);
+    return failures == 0;
+}
+
+// Cada nível SIMD contra o escalar em imagens aleatórias.
+static bool checkSimd() {
+    static const Size sizes[] = { { 37, 23 }, { 1, 17 }, { 64, 1 }, { 129, 65 } };
+    bool ok = true;
+    for (int level = SIMD_SSE2; level <= cpuSimdLevel(); level++) {
+        int failures = 0, cases = 0;
+        unsigned seed = 7;
+        for (int f = 0; f < 3; f++) {
+            for (int channels = 1; channels <= 4; channels++) {
+                for (const Size &s : sizes) {
+                    vector<unsigned char> image((size_t)s.w * s.h * channels);
+                    for (size_t i = 0; i < image.size(); i++) {
+                        seed = seed * 1103515245u + 12345u;
+                        image[i] = (unsigned char)(seed >> 16);
+                    }
+                    ResampleOptions options(FILTERS[f]);
+                    vector<unsigned char> scalar = chainBytes(buildMipChain(
+                        image.data(), s.w, s.h, channels, options, ThreadPool::shared(), SIMD_SCALAR));
+                    vector<unsigned char> simd = chainBytes(buildMipChain(
+                        image.data(), s.w, s.h, channels, options, ThreadPool::shared(), (SimdLevel)level));
+                    cases++;
+                    failures += simd != scalar;
+                }
+            }
+        }
+        printf("Cadeias %s: %d casos, %d diferentes da escalar\n", simdLevelName((SimdLevel)level), cases, failures);
+        ok = ok && failures == 0;
+    }
+    return ok;
+}
+
+static void bench(int w, int h, int reps) {
+    vector<unsigned char> image((size_t)w * h * 4);
+    for (size_t i = 0; i < image.size(); i++) image[i] = (unsigned char)((i * 2654435761u) >> 13);
+    printf("Cadeia de %dx%d RGBA, %u threads\n", w, h, ThreadPool::shared().size());
+    for (int f = 0; f < 3; f++) {
+        for (int level = SIMD_SCALAR; level <= cpuSimdLevel(); level++) {
+            vector<double> times;
+            for (int r = 0; r < reps; r++) {
+                Clock::time_point t0 = Clock::now();
+                vector<MipLevel> levels = buildMipChain(image.data(), w, h, 4, ResampleOptions(FILTERS[f]),
+                                                        ThreadPool::shared(), (SimdLevel)level);
+                times.push_back(chrono::duration<double>(Clock::now() - t0).count());
+            }
+            sort(times.begin(), times.end());
+            double median = times[times.size() / 2];
+            printf("%-10s %-7s %9.2f ms %8.1f MP/s\n", FILTER_NAMES[f], simdLevelName((SimdLevel)level),
+                   median * 1e3, (double)w * h / median / 1e6);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int w = 2048, h = 2048, reps = 5;
+    bool checkOnly = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--check") {
+            checkOnly = true;
+        } else if (arg == "--size" && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+            i++;
+        } else if (arg == "--reps" && i + 1 < argc) {
+            reps = max(1, atoi(argv[++i]));
+        } else {
+            cerr << "Uso: " << argv[0] << " [--check] [--size LxA] [--reps N]" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    bool ok = checkFixtures();
+    ok = checkBoxAverage() && ok;
+    ok = checkChecker() && ok;
+    ok = checkConstant() && ok;
+    ok = checkSimd() && ok;
+    if (!ok) {
+        cerr << "A cadeia de mipmaps não deu o resultado esperado" << endl;
+        return EXIT_FAILURE;
+    }
+    if (!checkOnly) bench(w, h, reps);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,1008 @@
+// Benchmark da desfiltragem de PNG (PngKernels.h) usada pelo decodificador
+// vendorizado (M5_Material/stb_image.cpp).
+//
+// Uso: bench_png [ARQUIVO.png ...] [--reps N] [--rows N] [--check]
+//      bench_png --alloc-check [ARQUIVO.png ...] [--reps N]
+//
+// Primeiro, fluxos deflate gerados aqui (blocos armazenados, fixos e
+// dinâmicos, distância 1, cópias sobrepostas, cópias de 258 bytes e todos os
+// códigos de comprimento e distância) passam pelo inflate do stb e têm de dar
+// a saída gravada; os inválidos (16 sem nada para repetir, comprimentos
+// 286/287, distâncias 30/31, códigos sobrepostos...) têm de ser recusados.
+// Depois, --rows linhas aleatórias (1 a 300 pixels, RGB, RGB + alfa e
+// RGBA) passam por cada filtro em cada nível SIMD e são comparadas com a
+// escalar; depois cada filtro é medido em linhas de 4096 pixels. Para cada
+// arquivo (RGB ou RGBA de 8 bits, sem entrelaçamento) o IDAT é
+// descomprimido uma vez e a imagem inteira é desfiltrada --reps vezes em cada
+// nível: a tabela mostra quantas linhas usam cada filtro, a mediana em ms,
+// megapixels/s e se a imagem saiu idêntica à do nível escalar. Por último, o
+// tempo de descomprimir o IDAT (stbi_zlib_decode_buffer, em MB/s de saída) e
+// o de stbi_load_from_memory inteiro no nível escolhido pelo stb (M3_SIMD),
+// também com stbi_load_into num buffer já alocado (que tem de dar a mesma
+// imagem). Com --check só as verificações rodam, sem as medidas. O programa
+// termina com erro se algum vetor do inflate falhar ou algum nível diferir.
+//
+// Com --alloc-check só se verifica que stbi_load_into_from_memory repetido no
+// mesmo buffer não aloca nada (AllocCounter.h): PNGs gerados aqui (cinza,
+// cinza + alfa, RGB, RGB com tRNS, paleta e RGBA) e os arquivos dados (de 8
+// bits, sem entrelaçamento), para req_comp 1 a 4, num buffer com folga no fim
+// de cada linha que não pode ser tocada.
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <queue>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../M5_Material/stb_image.h"
+#include "AllocCounter.h"
+#include "PngKernels.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static const char *FILTER_NAMES[PNG_FILTER_COUNT] = { "none", "sub", "up", "avg", "paeth", "avg-1a", "paeth-1a" };
+
+struct Format {
+    int n, outN;
+};
+
+static const Format FORMATS[] = { { 3, 3 }, { 3, 4 }, { 4, 4 } };
+
+static vector<SimdLevel> availableLevels() {
+    vector<SimdLevel> levels;
+    for (int l = SIMD_SCALAR; l <= cpuSimdLevel(); l++) levels.push_back((SimdLevel)l);
+    return levels;
+}
+
+static bool checkRows(int rows) {
+    const vector<SimdLevel> levels = availableLevels();
+    bool ok = true;
+    for (const Format &f : FORMATS) {
+        vector<int> mismatches(levels.size(), 0);
+        unsigned seed = 11;
+        for (int t = 0; t < rows; t++) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned x = 1 + (seed >> 16) % 300;
+            vector<unsigned char> raw(x * f.n), prior(x * f.outN);
+            for (size_t i = 0; i < raw.size(); i++) {
+                seed = seed * 1103515245u + 12345u;
+                raw[i] = (unsigned char)(seed >> 16);
+            }
+            for (size_t i = 0; i < prior.size(); i++) {
+                seed = seed * 1103515245u + 12345u;
+                prior[i] = (unsigned char)(seed >> 16);
+            }
+            for (int filter = 0; filter < PNG_FILTER_COUNT; filter++) {
+                vector<unsigned char> ref(x * f.outN), out(x * f.outN);
+                pngKernels(SIMD_SCALAR).unfilter[filter](ref.data(), raw.data(), prior.data(), x, f.n, f.outN);
+                for (size_t l = 1; l < levels.size(); l++) {
+                    pngKernels(levels[l]).unfilter[filter](out.data(), raw.data(), prior.data(), x, f.n, f.outN);
+                    if (out != ref) mismatches[l]++;
+                }
+            }
+        }
+        for (size_t l = 1; l < levels.size(); l++) {
+            printf("Desfiltragem %d -> %d canais %s: %d linhas x %d filtros, %d diferentes da escalar\n", f.n, f.outN,
+                   simdLevelName(levels[l]), rows, (int)PNG_FILTER_COUNT, mismatches[l]);
+            ok = ok && mismatches[l] == 0;
+        }
+    }
+    return ok;
+}
+
+// ---- Vetores do inflate ----
+//
+// Os fluxos deflate (sem cabeçalho zlib) são montados aqui bit a bit a partir
+// de uma lista de literais e cópias; a saída esperada vem de expandir a mesma
+// lista byte a byte e ainda tem de bater com o tamanho e o hash FNV-1a
+// gravados em cada caso (conferidos contra o zlib quando os casos foram
+// escritos). Os fluxos inválidos têm de ser recusados.
+
+static const int LENGTH_BASE[29] = { 3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                     31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const int LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const int DIST_BASE[30] = { 1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
+                                   33,   49,   65,   97,   129,  193,  257,  385,   513,   769,
+                                   1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const int DIST_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const int CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Campos entram a partir do bit menos significativo; códigos de Huffman, a
+// partir do mais significativo.
+struct BitWriter {
+    vector<unsigned char> bytes;
+    unsigned acc = 0;
+    int count = 0;
+
+    void bits(unsigned value, int n) {
+        for (int i = 0; i < n; i++) {
+            acc |= ((value >> i) & 1) << count;
+            if (++count == 8) {
+                bytes.push_back((unsigned char)acc);
+                acc = 0;
+                count = 0;
+            }
+        }
+    }
+    void code(unsigned code, int len) {
+        for (int i = len - 1; i >= 0; i--) bits(code >> i, 1);
+    }
+    void align() {
+        if (count) bits(0, 8 - count);
+    }
+};
+
+// Um literal (literal >= 0) ou uma cópia; symbol/distSymbol >= 0 gravam esse
+// símbolo cru, sem bits extras, para os fluxos inválidos.
+struct Token {
+    int literal, length, dist, symbol, distSymbol;
+};
+
+static Token lit(int c) { return Token{ c, 0, 0, -1, -1 }; }
+static Token copy(int length, int dist) { return Token{ -1, length, dist, -1, -1 }; }
+static Token rawLength(int symbol) { return Token{ -1, 0, 0, symbol, -1 }; }
+static Token rawDist(int length, int distSymbol) { return Token{ -1, length, 0, -1, distSymbol }; }
+
+static int lengthCode(int length) {
+    int i = 28;
+    while (LENGTH_BASE[i] > length) i--;
+    return i;
+}
+
+static int distCode(int dist) {
+    int i = 29;
+    while (DIST_BASE[i] > dist) i--;
+    return i;
+}
+
+static void expand(const vector<Token> &tokens, vector<unsigned char> &out) {
+    for (const Token &t : tokens) {
+        if (t.literal >= 0) {
+            out.push_back((unsigned char)t.literal);
+        } else {
+            for (int i = 0; i < t.length; i++) out.push_back(out[out.size() - t.dist]);
+        }
+    }
+}
+
+static vector<unsigned> canonicalCodes(const vector<int> &lengths) {
+    int count[16] = { 0 };
+    for (int l : lengths) count[l]++;
+    count[0] = 0;
+    unsigned next[16] = { 0 }, code = 0;
+    for (int b = 1; b < 16; b++) {
+        code = (code + count[b - 1]) << 1;
+        next[b] = code;
+    }
+    vector<unsigned> codes(lengths.size(), 0);
+    for (size_t i = 0; i < lengths.size(); i++)
+        if (lengths[i]) codes[i] = next[lengths[i]]++;
+    return codes;
+}
+
+// Comprimentos de Huffman para as frequências, até maxBits (achatando as
+// frequências enquanto passar); um símbolo só fica com 1 bit.
+static vector<int> huffmanLengths(vector<unsigned> freq, int maxBits) {
+    for (;;) {
+        vector<unsigned> weight;
+        vector<int> parent, leaf(freq.size(), -1);
+        typedef pair<unsigned, int> Node;
+        priority_queue<Node, vector<Node>, greater<Node> > queue;
+        for (size_t s = 0; s < freq.size(); s++) {
+            if (!freq[s]) continue;
+            leaf[s] = (int)weight.size();
+            queue.push(Node(freq[s], (int)weight.size()));
+            weight.push_back(freq[s]);
+            parent.push_back(-1);
+        }
+        vector<int> lengths(freq.size(), 0);
+        if (queue.size() == 1) {
+            for (size_t s = 0; s < freq.size(); s++) lengths[s] = freq[s] ? 1 : 0;
+            return lengths;
+        }
+        while (queue.size() > 1) {
+            Node a = queue.top();
+            queue.pop();
+            Node b = queue.top();
+            queue.pop();
+            parent[a.second] = parent[b.second] = (int)weight.size();
+            queue.push(Node(a.first + b.first, (int)weight.size()));
+            weight.push_back(a.first + b.first);
+            parent.push_back(-1);
+        }
+        int longest = 0;
+        for (size_t s = 0; s < freq.size(); s++) {
+            if (leaf[s] < 0) continue;
+            for (int n = leaf[s]; parent[n] >= 0; n = parent[n]) lengths[s]++;
+            longest = max(longest, lengths[s]);
+        }
+        if (longest <= maxBits) return lengths;
+        for (unsigned &f : freq)
+            if (f) f = f / 2 + 1;
+    }
+}
+
+// Os códigos de um bloco dinâmico: comprimentos dos literais/comprimentos e
+// das distâncias, a sequência de comprimentos codificada (símbolo 0-18 e o
+// valor dos bits extras) e os comprimentos do código dessa sequência. Cada
+// parte pode ser trocada antes de gravar o bloco.
+struct DynamicCodes {
+    vector<int> lit, dist, cl;
+    vector<pair<int, int> > items;
+};
+
+static DynamicCodes dynamicLengths(const vector<Token> &tokens) {
+    vector<unsigned> litFreq(288, 0), distFreq(32, 0);
+    for (const Token &t : tokens) {
+        if (t.literal >= 0) {
+            litFreq[t.literal]++;
+        } else if (t.symbol >= 0) {
+            litFreq[t.symbol]++;
+        } else {
+            litFreq[257 + lengthCode(t.length)]++;
+            distFreq[t.distSymbol >= 0 ? t.distSymbol : distCode(t.dist)]++;
+        }
+    }
+    litFreq[256]++;
+    bool anyDist = false;
+    for (unsigned f : distFreq) anyDist = anyDist || f;
+    if (!anyDist) distFreq[0] = 1;
+    DynamicCodes d;
+    d.lit = huffmanLengths(litFreq, 15);
+    d.dist = huffmanLengths(distFreq, 15);
+    while (d.lit.size() > 257 && !d.lit.back()) d.lit.pop_back();
+    while (d.dist.size() > 1 && !d.dist.back()) d.dist.pop_back();
+    return d;
+}
+
+// Sequência de comprimentos com as repetições 16 (anterior), 17 e 18 (zeros).
+static void encodeLengths(DynamicCodes &d) {
+    vector<int> all(d.lit);
+    all.insert(all.end(), d.dist.begin(), d.dist.end());
+    d.items.clear();
+    for (size_t i = 0; i < all.size();) {
+        size_t run = 1;
+        while (i + run < all.size() && all[i + run] == all[i]) run++;
+        i += run;
+        if (all[i - run] == 0) {
+            for (; run >= 11; run -= min(run, (size_t)138))
+                d.items.push_back(make_pair(18, (int)min(run, (size_t)138) - 11));
+            if (run >= 3) {
+                d.items.push_back(make_pair(17, (int)run - 3));
+                run = 0;
+            }
+        } else {
+            d.items.push_back(make_pair(all[i - run], 0));
+            run--;
+            for (; run >= 3; run -= min(run, (size_t)6))
+                d.items.push_back(make_pair(16, (int)min(run, (size_t)6) - 3));
+        }
+        for (; run > 0; run--) d.items.push_back(make_pair(all[i - run], 0));
+    }
+}
+
+static void codeLengthLengths(DynamicCodes &d) {
+    vector<unsigned> freq(19, 0);
+    for (const pair<int, int> &item : d.items) freq[item.first]++;
+    d.cl = huffmanLengths(freq, 7);
+}
+
+static void putTokens(BitWriter &w, const vector<Token> &tokens, const vector<int> &litLen,
+                      const vector<int> &distLen) {
+    const vector<unsigned> litCode = canonicalCodes(litLen), distCodes = canonicalCodes(distLen);
+    for (const Token &t : tokens) {
+        if (t.literal >= 0 || t.symbol >= 0) {
+            int s = t.literal >= 0 ? t.literal : t.symbol;
+            w.code(litCode[s], litLen[s]);
+            continue;
+        }
+        int lc = lengthCode(t.length);
+        w.code(litCode[257 + lc], litLen[257 + lc]);
+        w.bits(t.length - LENGTH_BASE[lc], LENGTH_EXTRA[lc]);
+        if (t.distSymbol >= 0) {
+            w.code(distCodes[t.distSymbol], distLen[t.distSymbol]);
+        } else {
+            int dc = distCode(t.dist);
+            w.code(distCodes[dc], distLen[dc]);
+            w.bits(t.dist - DIST_BASE[dc], DIST_EXTRA[dc]);
+        }
+    }
+    w.code(litCode[256], litLen[256]);
+}
+
+static void putStored(BitWriter &w, const vector<unsigned char> &data, bool final, unsigned nlenXor = 0xffff) {
+    w.bits(final, 1);
+    w.bits(0, 2);
+    w.align();
+    unsigned len = (unsigned)data.size();
+    w.bits(len, 16);
+    w.bits(len ^ nlenXor, 16);
+    w.bytes.insert(w.bytes.end(), data.begin(), data.end());
+}
+
+static void putFixed(BitWriter &w, const vector<Token> &tokens, bool final) {
+    vector<int> litLen(288, 8), distLen(32, 5);
+    for (int s = 144; s < 256; s++) litLen[s] = 9;
+    for (int s = 256; s < 280; s++) litLen[s] = 7;
+    w.bits(final, 1);
+    w.bits(1, 2);
+    putTokens(w, tokens, litLen, distLen);
+}
+
+static void putDynamic(BitWriter &w, const vector<Token> &tokens, const DynamicCodes &d, bool final) {
+    int hclen = 19;
+    while (hclen > 4 && !d.cl[CODE_LENGTH_ORDER[hclen - 1]]) hclen--;
+    w.bits(final, 1);
+    w.bits(2, 2);
+    w.bits((unsigned)d.lit.size() - 257, 5);
+    w.bits((unsigned)d.dist.size() - 1, 5);
+    w.bits(hclen - 4, 4);
+    for (int i = 0; i < hclen; i++) w.bits(d.cl[CODE_LENGTH_ORDER[i]], 3);
+    const vector<unsigned> clCode = canonicalCodes(d.cl);
+    for (const pair<int, int> &item : d.items) {
+        w.code(clCode[item.first], d.cl[item.first]);
+        if (item.first >= 16) w.bits(item.second, item.first == 16 ? 2 : item.first == 17 ? 3 : 7);
+    }
+    putTokens(w, tokens, d.lit, d.dist);
+}
+
+static void putDynamic(BitWriter &w, const vector<Token> &tokens, bool final) {
+    DynamicCodes d = dynamicLengths(tokens);
+    encodeLengths(d);
+    codeLengthLengths(d);
+    putDynamic(w, tokens, d, final);
+}
+
+struct InflateCase {
+    string name;
+    vector<unsigned char> stream, expected;
+    bool valid;
+    unsigned size, hash;
+};
+
+static unsigned fnv1a(const vector<unsigned char> &data) {
+    unsigned h = 2166136261u;
+    for (unsigned char c : data) h = (h ^ c) * 16777619u;
+    return h;
+}
+
+static vector<unsigned char> randomBytes(size_t n, unsigned seed) {
+    vector<unsigned char> bytes(n);
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1103515245u + 12345u;
+        bytes[i] = (unsigned char)(seed >> 16);
+    }
+    return bytes;
+}
+
+// Literais de texto repetitivo, para os blocos dinâmicos terem frequências
+// desiguais.
+static vector<Token> textLiterals(size_t n, unsigned seed) {
+    static const char ALPHABET[] = "eeeeeeeetttaaoinnsshrdlu  \n";
+    vector<Token> tokens;
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1103515245u + 12345u;
+        tokens.push_back(lit(ALPHABET[(seed >> 16) % (sizeof(ALPHABET) - 1)]));
+    }
+    return tokens;
+}
+
+static vector<InflateCase> inflateCases() {
+    vector<InflateCase> cases;
+    // size e hash valem 0 nos inválidos
+    auto add = [&](const string &name, BitWriter &w, const vector<unsigned char> &expected, bool valid,
+                   unsigned size, unsigned hash) {
+        w.align();
+        cases.push_back(InflateCase{ name, w.bytes, expected, valid, size, hash });
+    };
+    // o mesmo fluxo de tokens num bloco fixo e num dinâmico, depois de um
+    // bloco armazenado opcional com o histórico
+    auto addBoth = [&](const string &name, const vector<unsigned char> &history, const vector<Token> &tokens,
+                       unsigned size, unsigned hash) {
+        for (int dynamic = 0; dynamic <= 1; dynamic++) {
+            BitWriter w;
+            vector<unsigned char> expected(history);
+            if (!history.empty()) putStored(w, history, false);
+            if (dynamic) putDynamic(w, tokens, true);
+            else putFixed(w, tokens, true);
+            expand(tokens, expected);
+            add(name + (dynamic ? " (dinâmico)" : " (fixo)"), w, expected, true, size, hash);
+        }
+    };
+
+    {
+        const vector<unsigned char> data = randomBytes(1000, 1);
+        BitWriter w;
+        putStored(w, data, false);
+        putStored(w, vector<unsigned char>(), true);
+        add("armazenado + armazenado vazio", w, data, true, 1000, 0x6e20cd58u);
+    }
+    {
+        BitWriter w;
+        putStored(w, vector<unsigned char>(), true);
+        add("armazenado vazio", w, vector<unsigned char>(), true, 0, 0x811c9dc5u);
+    }
+    {
+        vector<Token> tokens;
+        for (int c = 0; c < 256; c++) tokens.push_back(lit(c));
+        vector<Token> text = textLiterals(700, 2);
+        tokens.insert(tokens.end(), text.begin(), text.end());
+        addBoth("só literais", vector<unsigned char>(), tokens, 956, 0xd510dc1bu);
+    }
+    {
+        vector<Token> tokens = { lit('a'), copy(258, 1), copy(258, 1), copy(3, 1), lit('b'), copy(100, 1) };
+        for (int length = 3; length <= 258; length += 17) {
+            tokens.push_back(lit(length & 0x7f));
+            tokens.push_back(copy(length, 1));
+        }
+        addBoth("distância 1", vector<unsigned char>(), tokens, 2725, 0xa8c4b00du);
+    }
+    {
+        // cópias que se sobrepõem à própria saída, com distâncias 2 a 31
+        vector<Token> tokens;
+        for (int dist = 2; dist < 32; dist++) {
+            vector<Token> text = textLiterals(dist, dist);
+            tokens.insert(tokens.end(), text.begin(), text.end());
+            const int lengths[] = { dist + 1, 3, 2 * dist + 1, 17, 258 };
+            for (int length : lengths)
+                if (length >= 3 && length <= 258) tokens.push_back(copy(length, dist));
+        }
+        addBoth("sobreposição 2..31", vector<unsigned char>(), tokens, 10380, 0x19611c80u);
+    }
+    {
+        // 258 bytes de cada vez, longe e perto
+        vector<Token> tokens = textLiterals(600, 3);
+        const int dists[] = { 258, 259, 300, 600, 257, 129, 1, 2, 7, 8, 9, 16 };
+        for (int dist : dists) {
+            tokens.push_back(copy(258, dist));
+            tokens.push_back(lit('x'));
+        }
+        tokens.push_back(copy(258, 500));
+        addBoth("cópias de 258", vector<unsigned char>(), tokens, 3966, 0xd4955059u);
+    }
+    {
+        // todos os códigos de comprimento e distância, com os bits extras no
+        // mínimo e no máximo, sobre 33000 bytes armazenados
+        vector<int> lengths, dists;
+        for (int i = 0; i < 29; i++) {
+            lengths.push_back(LENGTH_BASE[i]);
+            if (LENGTH_EXTRA[i]) lengths.push_back(LENGTH_BASE[i] + (1 << LENGTH_EXTRA[i]) - 1);
+        }
+        for (int i = 0; i < 30; i++) {
+            dists.push_back(DIST_BASE[i]);
+            if (DIST_EXTRA[i]) dists.push_back(DIST_BASE[i] + (1 << DIST_EXTRA[i]) - 1);
+        }
+        vector<Token> tokens;
+        for (size_t k = 0; k < max(lengths.size(), dists.size()) * 2; k++) {
+            tokens.push_back(copy(lengths[k % lengths.size()], dists[(k * 7) % dists.size()]));
+            tokens.push_back(lit((int)k));
+        }
+        addBoth("todos os comprimentos e distâncias", randomBytes(33000, 4), tokens, 40017, 0xd6309d87u);
+    }
+    {
+        // blocos de tipos diferentes em sequência, com cópias que atravessam
+        // a fronteira entre eles
+        BitWriter w;
+        vector<unsigned char> expected = randomBytes(300, 5);
+        putStored(w, expected, false);
+        vector<Token> fixed = textLiterals(50, 6);
+        fixed.push_back(copy(200, 320));
+        putFixed(w, fixed, false);
+        expand(fixed, expected);
+        vector<Token> dynamic = textLiterals(30, 7);
+        dynamic.push_back(copy(258, 290));
+        dynamic.push_back(copy(40, 3));
+        putDynamic(w, dynamic, false);
+        expand(dynamic, expected);
+        const vector<unsigned char> stored = randomBytes(70, 8);
+        putStored(w, stored, false);
+        expected.insert(expected.end(), stored.begin(), stored.end());
+        vector<Token> last = { copy(258, 100), copy(258, 800) };
+        putFixed(w, last, true);
+        expand(last, expected);
+        add("armazenado, fixo, dinâmico, armazenado, fixo", w, expected, true, 1464, 0x604ad12au);
+    }
+
+    // Inválidos: cada símbolo proibido num bloco curto (caminho lento) e
+    // depois de 400 bytes e antes de mais 40 literais (caminho rápido).
+    const vector<Token> before = textLiterals(400, 9), after = textLiterals(40, 10);
+    auto addBad = [&](const string &name, const Token &bad, bool dynamic) {
+        for (int fast = 0; fast <= 1; fast++) {
+            vector<Token> tokens;
+            if (fast) tokens = before;
+            else tokens = { lit('a'), lit('b'), lit('c') };
+            tokens.push_back(bad);
+            if (fast) tokens.insert(tokens.end(), after.begin(), after.end());
+            BitWriter w;
+            if (dynamic) putDynamic(w, tokens, true);
+            else putFixed(w, tokens, true);
+            add(name + (dynamic ? " (dinâmico" : " (fixo") + (fast ? ", rápido)" : ", lento)"), w,
+                vector<unsigned char>(), false, 0, 0);
+        }
+    };
+    for (int dynamic = 0; dynamic <= 1; dynamic++) {
+        addBad("comprimento 286", rawLength(286), dynamic);
+        addBad("comprimento 287", rawLength(287), dynamic);
+        addBad("distância 30", rawDist(10, 30), dynamic);
+        addBad("distância 31", rawDist(10, 31), dynamic);
+    }
+    addBad("distância antes do início", copy(10, 1000), false);
+
+    const vector<Token> tokens = textLiterals(200, 11);
+    {
+        // 16 (repetir o anterior) no lugar dos três primeiros zeros, com a
+        // contagem certa: o texto não usa os bytes 0 a 9, então a sequência
+        // começa com um 17 de 10 zeros
+        DynamicCodes d = dynamicLengths(tokens);
+        encodeLengths(d);
+        d.items[0].second -= 3;
+        d.items.insert(d.items.begin(), make_pair(16, 0));
+        codeLengthLengths(d);
+        BitWriter w;
+        putDynamic(w, tokens, d, true);
+        add("16 sem nada para repetir", w, vector<unsigned char>(), false, 0, 0);
+    }
+    {
+        // dez zeros antes do último comprimento: a repetição passa de
+        // hlit + hdist
+        DynamicCodes d = dynamicLengths(tokens);
+        encodeLengths(d);
+        d.items.insert(d.items.end() - 1, make_pair(17, 7));
+        codeLengthLengths(d);
+        BitWriter w;
+        putDynamic(w, tokens, d, true);
+        add("repetição além de hlit + hdist", w, vector<unsigned char>(), false, 0, 0);
+    }
+    {
+        // comprimentos sobrepostos (soma de Kraft > 1): 1, 2, 2, 2 para os
+        // literais a, b, c e o fim de bloco
+        const vector<Token> abc = { lit('a'), lit('b'), lit('c'), lit('a') };
+        DynamicCodes d = dynamicLengths(abc);
+        d.lit.assign(257, 0);
+        d.lit['a'] = 1;
+        d.lit['b'] = d.lit['c'] = d.lit[256] = 2;
+        encodeLengths(d);
+        codeLengthLengths(d);
+        BitWriter w;
+        putDynamic(w, abc, d, true);
+        add("código de literais sobreposto", w, vector<unsigned char>(), false, 0, 0);
+    }
+    {
+        DynamicCodes d = dynamicLengths(tokens);
+        d.dist = { 1, 2, 2, 2 };
+        encodeLengths(d);
+        codeLengthLengths(d);
+        BitWriter w;
+        putDynamic(w, tokens, d, true);
+        add("código de distâncias sobreposto", w, vector<unsigned char>(), false, 0, 0);
+    }
+    {
+        // 19 códigos de 4 bits
+        DynamicCodes d = dynamicLengths(tokens);
+        encodeLengths(d);
+        d.cl.assign(19, 4);
+        BitWriter w;
+        putDynamic(w, tokens, d, true);
+        add("código dos comprimentos sobreposto", w, vector<unsigned char>(), false, 0, 0);
+    }
+    {
+        BitWriter w;
+        putStored(w, randomBytes(20, 12), true, 0xfffe);
+        add("armazenado com NLEN errado", w, vector<unsigned char>(), false, 0, 0);
+    }
+    {
+        BitWriter w;
+        w.bits(1, 1);
+        w.bits(3, 2);
+        w.bits(0, 29);
+        add("bloco tipo 3", w, vector<unsigned char>(), false, 0, 0);
+    }
+    return cases;
+}
+
+static unsigned adler32(const vector<unsigned char> &data) {
+    unsigned a = 1, b = 0;
+    for (unsigned char v : data) {
+        a = (a + v) % 65521;
+        b = (b + a) % 65521;
+    }
+    return b << 16 | a;
+}
+
+// Os válidos têm de dar a saída esperada; os inválidos, erro (len < 0).
+static bool inflated(const InflateCase &c, int len, const char *out) {
+    if (!c.valid) return len < 0;
+    return len == (int)c.expected.size() && equal(c.expected.begin(), c.expected.end(), (const unsigned char *)out);
+}
+
+// Cada caso no buffer de tamanho exato, com folga para o laço rápido, pelo
+// malloc e com o cabeçalho zlib.
+static bool checkInflate() {
+    const vector<InflateCase> cases = inflateCases();
+    int failures = 0;
+    for (const InflateCase &c : cases) {
+        vector<string> errors;
+        if (c.valid && (c.expected.size() != c.size || fnv1a(c.expected) != c.hash)) {
+            char buf[80];
+            snprintf(buf, sizeof(buf), "saída esperada %u bytes, hash %08x", (unsigned)c.expected.size(),
+                     fnv1a(c.expected));
+            errors.push_back(buf);
+        }
+        const int size = c.valid ? (int)c.expected.size() : 65536;
+        const char *in = (const char *)c.stream.data();
+        const int inLen = (int)c.stream.size();
+        for (int slack = 0; slack <= 300; slack += 300) {
+            vector<char> out(size + slack + 1);
+            int len = stbi_zlib_decode_noheader_buffer(out.data(), size + slack, in, inLen);
+            if (!inflated(c, len, out.data())) errors.push_back(slack ? "buffer com folga" : "buffer exato");
+        }
+        int len = 0;
+        char *out = stbi_zlib_decode_noheader_malloc(in, inLen, &len);
+        if (!inflated(c, out ? len : -1, out)) errors.push_back("malloc");
+        free(out);
+        vector<char> zlib = { 0x78, 0x01 };
+        zlib.insert(zlib.end(), c.stream.begin(), c.stream.end());
+        const unsigned adler = adler32(c.expected);
+        for (int i = 3; i >= 0; i--) zlib.push_back((char)(adler >> (8 * i)));
+        vector<char> zout(size + 1);
+        len = stbi_zlib_decode_buffer(zout.data(), size, zlib.data(), (int)zlib.size());
+        if (!inflated(c, len, zout.data())) errors.push_back("zlib");
+        if (!errors.empty()) {
+            failures++;
+            string joined;
+            for (const string &e : errors) joined += (joined.empty() ? "" : ", ") + e;
+            printf("  inflate %s: %s\n", c.name.c_str(), joined.c_str());
+        }
+    }
+    printf("Inflate: %d vetores, %d falharam\n", (int)cases.size(), failures);
+    return failures == 0;
+}
+
+// ---- --alloc-check ----
+
+static unsigned crc32(const unsigned char *p, size_t n) {
+    unsigned crc = 0xffffffffu;
+    for (size_t i = 0; i < n; i++) {
+        crc ^= p[i];
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static void putBe32(vector<unsigned char> &out, unsigned v) {
+    for (int i = 3; i >= 0; i--) out.push_back((unsigned char)(v >> (8 * i)));
+}
+
+static void putChunk(vector<unsigned char> &png, const char *type, const vector<unsigned char> &data) {
+    putBe32(png, (unsigned)data.size());
+    const size_t start = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data.begin(), data.end());
+    putBe32(png, crc32(&png[start], png.size() - start));
+}
+
+// PNG de 8 bits sem entrelaçamento com linhas aleatórias (o byte de filtro
+// alterna entre os cinco) e as linhas ímpares copiadas da anterior num
+// bloco fixo; paleta de 256 cores e, se trns, cor transparente no RGB. O
+// IDAT vem em dois pedaços.
+static vector<unsigned char> syntheticPng(unsigned w, unsigned h, int colorType, bool trns) {
+    static const int CHANNELS[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    const unsigned rowBytes = w * CHANNELS[colorType] + 1;
+    vector<Token> tokens;
+    vector<unsigned char> raw;
+    unsigned seed = 3 + colorType;
+    for (unsigned y = 0; y < h; y++) {
+        tokens.push_back(lit(y % 5));
+        if (y % 2) {
+            tokens.push_back(copy(rowBytes - 1, rowBytes));
+            continue;
+        }
+        for (unsigned i = 1; i < rowBytes; i++) {
+            seed = seed * 1103515245u + 12345u;
+            tokens.push_back(lit((seed >> 16) & 0xff));
+        }
+    }
+    expand(tokens, raw);
+    BitWriter w0;
+    putFixed(w0, tokens, true);
+    w0.align();
+    vector<unsigned char> zlib = { 0x78, 0x01 };
+    zlib.insert(zlib.end(), w0.bytes.begin(), w0.bytes.end());
+    putBe32(zlib, adler32(raw));
+
+    vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' }, ihdr;
+    putBe32(ihdr, w);
+    putBe32(ihdr, h);
+    ihdr.insert(ihdr.end(), { 8, (unsigned char)colorType, 0, 0, 0 });
+    putChunk(png, "IHDR", ihdr);
+    if (colorType == 3) {
+        vector<unsigned char> palette;
+        for (int i = 0; i < 256; i++)
+            palette.insert(palette.end(), { (unsigned char)i, (unsigned char)(255 - i), (unsigned char)(i * 7) });
+        putChunk(png, "PLTE", palette);
+    }
+    if (trns) putChunk(png, "tRNS", { 0, raw[1], 0, raw[2], 0, raw[3] });
+    const size_t half = zlib.size() / 2;
+    putChunk(png, "IDAT", vector<unsigned char>(zlib.begin(), zlib.begin() + half));
+    putChunk(png, "IDAT", vector<unsigned char>(zlib.begin() + half, zlib.end()));
+    putChunk(png, "IEND", vector<unsigned char>());
+    return png;
+}
+
+struct AllocCase {
+    string name;
+    vector<unsigned char> file;
+};
+
+// Decodifica cada arquivo com stbi_load_into_from_memory num buffer com 13
+// bytes de folga por linha e 64 no fim, para req_comp 1 a 4: a primeira vez
+// aloca os buffers do stb, as seguintes não podem alocar nada. A imagem tem
+// de ser a de stbi_load e as folgas têm de continuar intactas.
+static bool checkAlloc(const vector<AllocCase> &cases, int reps) {
+    if (!allocCountAvailable()) {
+        cerr << "--alloc-check precisa da glibc" << endl;
+        return false;
+    }
+    bool ok = true;
+    for (const AllocCase &c : cases) {
+        for (int req = 1; req <= 4; req++) {
+            int w = 0, h = 0, comp = 0;
+            unsigned char *pixels = stbi_load_from_memory(c.file.data(), (int)c.file.size(), &w, &h, &comp, req);
+            if (!pixels) {
+                cerr << c.name << ": " << stbi_failure_reason() << endl;
+                return false;
+            }
+            const size_t row = (size_t)w * req, stride = row + 13;
+            vector<unsigned char> fill(stride * h + 64), out;
+            for (size_t i = 0; i < fill.size(); i++) fill[i] = (unsigned char)(i * 29 + 7);
+            out = fill;
+            int x, y, n;
+            int loaded = stbi_load_into_from_memory(c.file.data(), (int)c.file.size(), out.data(), (int)out.size(),
+                                                    (int)stride, &x, &y, &n, req);
+            startAllocCount();
+            for (int r = 0; r < reps && loaded; r++)
+                loaded = stbi_load_into_from_memory(c.file.data(), (int)c.file.size(), out.data(), (int)out.size(),
+                                                    (int)stride, &x, &y, &n, req);
+            long allocs = stopAllocCount();
+            int badRows = 0, guards = 0;
+            for (size_t i = 0; i < out.size(); i++) {
+                size_t ry = i / stride, rx = i % stride;
+                if (ry < (size_t)h && rx < row) badRows += out[i] != pixels[ry * row + rx];
+                else guards += out[i] != fill[i];
+            }
+            stbi_image_free(pixels);
+            bool good = loaded && allocs == 0 && badRows == 0 && guards == 0;
+            ok = ok && good;
+            printf("%-24s req_comp %d: %ld alocações em %d repetições, %d bytes diferentes de stbi_load, "
+                   "%d bytes de folga alterados%s\n",
+                   c.name.c_str(), req, allocs, reps, badRows, guards, loaded ? "" : " (FALHOU)");
+        }
+    }
+    return ok;
+}
+
+static void benchRows(int reps) {
+    const unsigned x = 4096;
+    const int rows = 64;
+    const vector<SimdLevel> levels = availableLevels();
+    for (int n = 3; n <= 4; n++) {
+        vector<unsigned char> raw(x * n), image((size_t)(rows + 1) * x * n);
+        for (size_t i = 0; i < raw.size(); i++) raw[i] = (unsigned char)(i * 7 + i / 5);
+        for (int filter = 0; filter <= PNG_FILTER_PAETH; filter++) {
+            for (size_t l = 0; l < levels.size(); l++) {
+                PngUnfilterRow unfilter = pngKernels(levels[l]).unfilter[filter];
+                vector<double> times;
+                for (int r = 0; r < reps; r++) {
+                    Clock::time_point t0 = Clock::now();
+                    for (int y = 1; y <= rows; y++) {
+                        unsigned char *cur = image.data() + (size_t)y * x * n;
+                        unfilter(cur, raw.data(), cur - x * n, x, n, n);
+                    }
+                    times.push_back(chrono::duration<double>(Clock::now() - t0).count());
+                }
+                sort(times.begin(), times.end());
+                double median = times[times.size() / 2];
+                printf("%-5s %d canais %-7s %8.1f Mpixels/s\n", FILTER_NAMES[filter], n, simdLevelName(levels[l]),
+                       (double)x * rows / median / 1e6);
+            }
+        }
+    }
+}
+
+static unsigned be32(const unsigned char *p) {
+    return (unsigned)p[0] << 24 | (unsigned)p[1] << 16 | (unsigned)p[2] << 8 | p[3];
+}
+
+// Largura, altura, canais, o IDAT e os dados filtrados (um byte de filtro por
+// linha) de um PNG RGB/RGBA de 8 bits sem entrelaçamento.
+static bool filteredData(const vector<unsigned char> &file, unsigned &w, unsigned &h, int &n,
+                         vector<unsigned char> &idat, vector<unsigned char> &data) {
+    if (file.size() < 8 + 25 || memcmp(file.data() + 12, "IHDR", 4) != 0) return false;
+    const unsigned char *ihdr = file.data() + 16;
+    w = be32(ihdr);
+    h = be32(ihdr + 4);
+    n = ihdr[9] == 2 ? 3 : ihdr[9] == 6 ? 4 : 0;
+    if (ihdr[8] != 8 || n == 0 || ihdr[12] != 0) return false;
+    idat.clear();
+    for (size_t p = 8; p + 12 <= file.size();) {
+        unsigned len = be32(&file[p]);
+        if (p + 12 + len > file.size()) return false;
+        if (memcmp(&file[p + 4], "IDAT", 4) == 0) idat.insert(idat.end(), &file[p + 8], &file[p + 8] + len);
+        p += 12 + len;
+    }
+    int outLen = 0;
+    char *out = stbi_zlib_decode_malloc((const char *)idat.data(), (int)idat.size(), &outLen);
+    if (!out) return false;
+    data.assign(out, out + outLen);
+    free(out);
+    return data.size() == (size_t)(w * n + 1) * h;
+}
+
+// A imagem inteira, com a troca dos filtros da primeira linha do stb.
+static void unfilterImage(const PngKernels &kernels, const vector<unsigned char> &data, unsigned w, unsigned h,
+                          int n, vector<unsigned char> &image) {
+    static const int FIRST_ROW[5] = { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_NONE, PNG_FILTER_AVG_FIRST,
+                                      PNG_FILTER_PAETH_FIRST };
+    const size_t stride = (size_t)w * n;
+    const unsigned char *raw = data.data();
+    for (unsigned y = 0; y < h; y++, raw += stride + 1) {
+        unsigned char *cur = image.data() + stride * y;
+        int filter = raw[0] > PNG_FILTER_PAETH ? (int)PNG_FILTER_NONE : raw[0];
+        if (y == 0) filter = FIRST_ROW[filter];
+        kernels.unfilter[filter](cur, raw + 1, y ? cur - stride : cur, w, n, n);
+    }
+}
+
+static bool benchFile(const string &path, int reps) {
+    ifstream in(path.c_str(), ios::binary);
+    vector<unsigned char> file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    const string name = path.substr(path.find_last_of("/\\") + 1);
+    unsigned w = 0, h = 0;
+    int n = 0;
+    vector<unsigned char> idat, data;
+    if (!filteredData(file, w, h, n, idat, data)) {
+        cerr << path << ": não é um PNG RGB/RGBA de 8 bits sem entrelaçamento" << endl;
+        return false;
+    }
+    int counts[5] = { 0, 0, 0, 0, 0 };
+    for (unsigned y = 0; y < h; y++) counts[min(data[(size_t)y * (w * n + 1)], (unsigned char)4)]++;
+    printf("%s: %ux%u, %d canais; linhas por filtro: none %d, sub %d, up %d, avg %d, paeth %d\n", name.c_str(), w, h,
+           n, counts[0], counts[1], counts[2], counts[3], counts[4]);
+
+    const vector<SimdLevel> levels = availableLevels();
+    vector<unsigned char> reference;
+    bool ok = true;
+    for (size_t l = 0; l < levels.size(); l++) {
+        vector<unsigned char> image((size_t)w * h * n);
+        vector<double> times;
+        for (int r = 0; r < reps; r++) {
+            Clock::time_point t0 = Clock::now();
+            unfilterImage(pngKernels(levels[l]), data, w, h, n, image);
+            times.push_back(chrono::duration<double>(Clock::now() - t0).count());
+        }
+        if (l == 0) reference = image;
+        bool same = image == reference;
+        ok = ok && same;
+        sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+        printf("  desfiltragem %-7s %9.2f ms %8.1f MP/s  %s\n", simdLevelName(levels[l]), median * 1e3,
+               (double)w * h / median / 1e6, same ? "= escalar" : "DIFERENTE");
+    }
+
+    vector<unsigned char> inflated(data.size());
+    vector<double> times;
+    for (int r = 0; r < reps; r++) {
+        Clock::time_point t0 = Clock::now();
+        stbi_zlib_decode_buffer((char *)inflated.data(), (int)inflated.size(), (const char *)idat.data(), (int)idat.size());
+        times.push_back(chrono::duration<double>(Clock::now() - t0).count());
+    }
+    sort(times.begin(), times.end());
+    printf("  inflate              %9.2f ms %8.1f MB/s\n", times[times.size() / 2] * 1e3,
+           (double)data.size() / times[times.size() / 2] / 1e6);
+
+    times.clear();
+    for (int r = 0; r < reps; r++) {
+        int x, y, comp;
+        Clock::time_point t0 = Clock::now();
+        unsigned char *pixels = stbi_load_from_memory(file.data(), (int)file.size(), &x, &y, &comp, 0);
+        times.push_back(chrono::duration<double>(Clock::now() - t0).count());
+        if (!pixels) {
+            cerr << path << ": " << stbi_failure_reason() << endl;
+            return false;
+        }
+        if (r == 0) reference.assign(pixels, pixels + (size_t)w * h * n);
+        stbi_image_free(pixels);
+    }
+    sort(times.begin(), times.end());
+    printf("  stbi_load (%s)   %9.2f ms\n", simdLevelName(pngKernels().level), times[times.size() / 2] * 1e3);
+
+    // o mesmo buffer todas as vezes: depois da primeira o stb não aloca nada
+    vector<unsigned char> image(reference.size());
+    times.clear();
+    for (int r = 0; r < reps; r++) {
+        int x, y, comp;
+        Clock::time_point t0 = Clock::now();
+        int loaded = stbi_load_into_from_memory(file.data(), (int)file.size(), image.data(), (int)image.size(), 0, &x,
+                                                &y, &comp, n);
+        times.push_back(chrono::duration<double>(Clock::now() - t0).count());
+        if (!loaded) {
+            cerr << path << ": " << stbi_failure_reason() << endl;
+            return false;
+        }
+    }
+    sort(times.begin(), times.end());
+    bool same = image == reference;
+    printf("  stbi_load_into (%s) %6.2f ms  %s\n", simdLevelName(pngKernels().level), times[times.size() / 2] * 1e3,
+           same ? "= stbi_load" : "DIFERENTE");
+    return ok && same;
+}
+
+int main(int argc, char **argv) {
+    int reps = 5, rows = 2000;
+    bool checkOnly = false, allocCheck = false;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--reps" && i + 1 < argc) {
+            reps = max(1, atoi(argv[++i]));
+        } else if (arg == "--rows" && i + 1 < argc) {
+            rows = max(0, atoi(argv[++i]));
+        } else if (arg == "--check") {
+            checkOnly = true;
+        } else if (arg == "--alloc-check") {
+            allocCheck = true;
+        } else if (!arg.empty() && arg[0] != '-') {
+            files.push_back(arg);
+        } else {
+            cerr << "Uso: " << argv[0] << " [ARQUIVO.png ...] [--reps N] [--rows N] [--check]" << endl;
+            cerr << "     " << argv[0] << " --alloc-check [ARQUIVO.png ...] [--reps N]" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (allocCheck) {
+        vector<AllocCase> cases = { { "gerado cinza", syntheticPng(61, 37, 0, false) },
+                                    { "gerado cinza + alfa", syntheticPng(61, 37, 4, false) },
+                                    { "gerado RGB", syntheticPng(61, 37, 2, false) },
+                                    { "gerado RGB com tRNS", syntheticPng(61, 37, 2, true) },
+                                    { "gerado paleta", syntheticPng(61, 37, 3, false) },
+                                    { "gerado RGBA", syntheticPng(61, 37, 6, false) } };
+        for (size_t i = 0; i < files.size(); i++) {
+            ifstream in(files[i].c_str(), ios::binary);
+            vector<unsigned char> file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            if (file.empty()) {
+                cerr << "Não foi possível ler " << files[i] << endl;
+                return EXIT_FAILURE;
+            }
+            cases.push_back(AllocCase{ files[i].substr(files[i].find_last_of("/\\") + 1), file });
+        }
+        if (!checkAlloc(cases, reps)) {
+            cerr << "stbi_load_into alocou memória, errou a imagem ou escreveu fora das linhas" << endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    if (!checkInflate()) {
+        cerr << "O inflate errou algum vetor" << endl;
+        return EXIT_FAILURE;
+    }
+    bool ok = checkRows(rows);
+    if (checkOnly) return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    benchRows(reps);
+    for (size_t i = 0; i < files.size(); i++) ok = benchFile(files[i], reps) && ok;
+    if (!ok) {
+        cerr << "Algum nível SIMD deu resultado diferente do escalar" << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
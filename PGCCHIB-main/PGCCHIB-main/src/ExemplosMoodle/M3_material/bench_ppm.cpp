@@ -0,0 +1,224 @@
+// Mede a vazão (MB/s) da leitura e escrita de PPM:
+// caminho P3 original (ifstream >> int / endl) x P6 mapeado em memória
+// com escrita em blocos grandes, e a razão entre as duas leituras P3 (a
+// meta é 10x em um núcleo). Antes, um P3 de 30 bytes que declara
+// 100000 x 100000 tem de ser recusado sem alocar a imagem, e filtrar em
+// faixas (streamFilterPPM) tem de gerar o mesmo arquivo que filtrar a imagem
+// inteira em memória, em 8 e 16 bits, para alturas de faixa que dividem ou
+// não a altura da imagem.
+//
+// Uso: bench_ppm [megapixels] [diretório de trabalho]
+
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "FilterChain.h"
+#include "PPM.h"
+#include "PPMStream.h"
+
+using namespace std;
+
+// Leitura P3 como era feita em exemplo_03.cpp (com o limite de escrita corrigido).
+static unsigned char *legacyOpen(string file, int &width, int &height) {
+    ifstream arq(file);
+    char BUFFER[1024];
+    arq.getline(BUFFER, 1024);
+    do {
+        arq.getline(BUFFER, 1024);
+    } while (BUFFER[0] == '#');
+    stringstream sstr(BUFFER);
+    sstr >> width;
+    sstr >> height;
+    int maxValue;
+    arq >> maxValue;
+    int length = width * height * 3;
+    unsigned char *data = new unsigned char [length];
+    int g;
+    for (int j = 0; j < length && (arq >> g); j++) {
+        data[j] = (unsigned char)g;
+    }
+    return data;
+}
+
+// Escrita P3 como era feita em exemplo_03.cpp.
+static void legacySave(string file, unsigned char *data, int w, int h) {
+    ofstream arq(file);
+    arq << "P3" << endl;
+    arq << "#Gerado por chroma-key." << endl;
+    arq << w << " " << h << endl << "255" << endl;
+    int length = w * h * 3;
+    for (int i = 0; i < length; i++) {
+        arq << (int)data[i] << endl;
+    }
+}
+
+// P3 pequeno demais para as dimensões do cabeçalho.
+static bool checkShortText(const string &dir) {
+    string path = dir + "/bench_short.ppm";
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    fputs("P3\n100000 100000\n255\n1 2 3\n", f);
+    fclose(f);
+    PPMImage image;
+    bool rejected = !image.open(path);
+    remove(path.c_str());
+    printf("P3 truncado com 100000 x 100000: %s\n", rejected ? "recusado" : "ACEITO");
+    return rejected;
+}
+
+static bool readFile(const string &path, vector<unsigned char> &bytes) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    bytes.clear();
+    unsigned char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) bytes.insert(bytes.end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+// Filtro das faixas: a cadeia, e a primeira amostra de cada linha trocada
+// pelo número da linha, para que uma faixa fora do lugar apareça na
+// comparação.
+static void filterRows(const FilterChain &chain, unsigned char *data, int w, int y0, int rows, int maxValue) {
+    size_t pixels = (size_t)w * rows;
+    if (maxValue > 255) {
+        uint16_t *samples = (uint16_t *)data;
+        chain.apply16(samples, pixels, maxValue);
+        for (int r = 0; r < rows; r++) samples[(size_t)r * w * 3] = (uint16_t)((y0 + r) % (maxValue + 1));
+    } else {
+        chain.apply(data, pixels);
+        for (int r = 0; r < rows; r++) data[(size_t)r * w * 3] = (unsigned char)(y0 + r);
+    }
+}
+
+// streamFilterPPM x imagem inteira em memória: os arquivos gravados têm de
+// ser idênticos byte a byte.
+static bool checkStream(const string &dir) {
+    static const int SIZES[][2] = { { 1, 1 }, { 5, 7 }, { 301, 203 }, { 1031, 67 } };
+    static const int STRIPS[] = { 1, 4, 7, 64, 0 };
+    static const int MAX_VALUES[] = { 255, 4095, 65535 };
+    FilterChain chain;
+    chain.chromaKey(makeChromaKey(0, 255, 0, 0.4)).grayScale(makeGrayScale(false)).colorize(makeColorize(32, 0, 64));
+    string in = dir + "/bench_stream_in.ppm";
+    string memory = dir + "/bench_stream_mem.ppm";
+    string streamed = dir + "/bench_stream_out.ppm";
+    int cases = 0, failures = 0;
+    for (const int *size : SIZES) {
+        int w = size[0], h = size[1];
+        for (int maxValue : MAX_VALUES) {
+            size_t samples = (size_t)w * h * 3;
+            bool saved;
+            if (maxValue > 255) {
+                vector<uint16_t> src(samples);
+                for (size_t i = 0; i < samples; i++) src[i] = (uint16_t)(((i * 2654435761u) >> 7) % (maxValue + 1));
+                saved = savePPM16(in, src.data(), w, h, 3, maxValue);
+            } else {
+                vector<unsigned char> src(samples);
+                for (size_t i = 0; i < samples; i++) src[i] = (unsigned char)((i * 2654435761u) >> 13);
+                saved = savePPM(in, src.data(), w, h);
+            }
+            PPMImage image;
+            if (!saved || !image.open(in)) return false;
+            filterRows(chain, image.data(), w, 0, h, maxValue);
+            if (!savePPM(memory, image.view(), maxValue)) return false;
+            vector<unsigned char> expected, actual;
+            if (!readFile(memory, expected)) return false;
+
+            for (int rows : STRIPS) {
+                StripFilter filter = [&](unsigned char *strip, int sw, int y0, int n, int) {
+                    filterRows(chain, strip, sw, y0, n, maxValue);
+                };
+                bool same = streamFilterPPM(in, streamed, filter, rows) && readFile(streamed, actual) &&
+                            actual == expected;
+                cases++;
+                if (!same) {
+                    failures++;
+                    printf("  faixas DIVERGENTES: %d x %d, maxValue %d, %d linhas por faixa\n", w, h, maxValue, rows);
+                }
+            }
+        }
+    }
+    remove(in.c_str());
+    remove(memory.c_str());
+    remove(streamed.c_str());
+    printf("Faixas x memória: %d casos, %s\n", cases, failures == 0 ? "idênticos" : "DIVERGENTES");
+    return failures == 0;
+}
+
+static double seconds(chrono::steady_clock::time_point t0) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+static void report(const char *what, size_t pixelBytes, double s) {
+    printf("  %-28s %8.3f s  %9.1f MB/s\n", what, s, pixelBytes / s / 1e6);
+}
+
+int main(int argc, char **argv) {
+    double megapixels = argc > 1 ? atof(argv[1]) : 16.0;
+    string dir = argc > 2 ? argv[2] : ".";
+    int w = 4096;
+    int h = (int)(megapixels * 1e6 / w);
+    if (h < 1) h = 1;
+    size_t bytes = (size_t)w * h * 3;
+
+    vector<unsigned char> image(bytes);
+    for (size_t i = 0; i < bytes; i++) {
+        image[i] = (unsigned char)((i * 2654435761u) >> 13);
+    }
+    if (!checkShortText(dir) || !checkStream(dir)) return EXIT_FAILURE;
+    printf("Imagem %d x %d (%.1f MB de pixels)\n", w, h, bytes / 1e6);
+
+    string p3 = dir + "/bench_p3.ppm";
+    string p6 = dir + "/bench_p6.ppm";
+
+    auto t0 = chrono::steady_clock::now();
+    legacySave(p3, image.data(), w, h);
+    report("P3 escrita (original)", bytes, seconds(t0));
+
+    t0 = chrono::steady_clock::now();
+    int lw, lh;
+    unsigned char *legacy = legacyOpen(p3, lw, lh);
+    double legacySeconds = seconds(t0);
+    report("P3 leitura (original)", bytes, legacySeconds);
+    delete [] legacy;
+
+    bool same;
+    {
+        t0 = chrono::steady_clock::now();
+        PPMImage text;
+        text.open(p3);
+        double textSeconds = seconds(t0);
+        report("P3 leitura (PPM.h)", bytes, textSeconds);
+        printf("  P3 PPM.h / original: %.1fx (meta: 10x em um núcleo; %u threads no pool)\n",
+               legacySeconds / textSeconds, ThreadPool::shared().size());
+
+        t0 = chrono::steady_clock::now();
+        savePPM(p6, image.data(), w, h);
+        report("P6 escrita (PPMWriter)", bytes, seconds(t0));
+
+        t0 = chrono::steady_clock::now();
+        PPMImage binary;
+        binary.open(p6);
+        // percorre os pixels para incluir o custo das faltas de página
+        const unsigned char *px = binary.data();
+        unsigned long long sum = 0;
+        for (size_t i = 0; i < binary.size(); i += 64) sum += px[i];
+        report("P6 leitura (mmap)", bytes, seconds(t0));
+
+        same = binary.size() == bytes && text.size() == bytes &&
+               memcmp(binary.data(), image.data(), bytes) == 0 &&
+               memcmp(text.data(), image.data(), bytes) == 0;
+        printf("Conferência: %s (soma %llu)\n", same ? "ok" : "DIVERGENTE", sum);
+    }
+
+    remove(p3.c_str());
+    remove(p6.c_str());
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,92 @@
+// Mede o ganho do FilterExecutor com o número de threads: cada filtro de
+// exemplo_03 roda sobre uma imagem sintética com 1, 2, 4, ... threads e a
+// tabela mostra megapixels/s e o speedup em relação a uma thread.
+//
+// Uso: bench_threads [megapixels] [repetições]
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FilterExecutor.h"
+#include "ImageStats.h"
+
+using namespace std;
+
+static const char *FILTER_NAMES[] = { "chroma-key", "gray-scale", "colorize", "negative", "histogram", "auto-levels" };
+static const int FILTER_COUNT = 6;
+
+static void runFilter(const FilterExecutor &ex, ThreadPool &pool, int f, unsigned char *data, int w, int h) {
+    ImageStats stats;
+    switch (f) {
+        case 0: ex.chromaKey(data, w, h, makeChromaKey(0, 255, 0, 0.4)); break;
+        case 1: ex.grayScale(data, w, h, makeGrayScale(false)); break;
+        case 2: ex.colorize(data, w, h, makeColorize(32, 0, 64)); break;
+        case 3: ex.negative(data, w, h); break;
+        case 4: computeImageStats(data, w, h, 3, stats, pool); break;
+        case 5: {
+            // histograma + tabela de níveis, como a opção 6 de exemplo_03
+            computeImageStats(data, w, h, 3, stats, pool);
+            LevelsLUT lut = makeAutoLevels(stats);
+            ex.forEachBand(data, w, h, 3, [&](unsigned char *first, int, int rows) {
+                lut.apply(first, (size_t)w * rows);
+            });
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    double megapixels = argc > 1 ? atof(argv[1]) : 64.0;
+    int reps = argc > 2 ? atoi(argv[2]) : 5;
+    int w = 8192;
+    int h = (int)(megapixels * 1e6 / w);
+    if (h < 1) h = 1;
+    size_t bytes = (size_t)w * h * 3;
+
+    vector<unsigned char> source(bytes);
+    for (size_t i = 0; i < bytes; i++) {
+        source[i] = (unsigned char)((i * 2654435761u) >> 13);
+    }
+    vector<unsigned char> work(bytes), reference(bytes);
+
+    unsigned cores = thread::hardware_concurrency();
+    if (cores == 0) cores = 1;
+    vector<unsigned> counts;
+    for (unsigned n = 1; n < cores; n *= 2) counts.push_back(n);
+    counts.push_back(cores);
+
+    printf("Imagem %d x %d, kernels %s, %u núcleos\n", w, h, simdLevelName(filterKernels().level), cores);
+    printf("%-12s %8s %12s %9s\n", "filtro", "threads", "MP/s", "speedup");
+
+    bool ok = true;
+    for (int f = 0; f < FILTER_COUNT; f++) {
+        double base = 0.0;
+        for (size_t c = 0; c < counts.size(); c++) {
+            ThreadPool pool(counts[c]);
+            FilterExecutor ex(pool);
+            double best = 1e30;
+            for (int r = 0; r < reps; r++) {
+                memcpy(work.data(), source.data(), bytes);
+                auto t0 = chrono::steady_clock::now();
+                runFilter(ex, pool, f, work.data(), w, h);
+                double s = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+                if (s < best) best = s;
+            }
+            if (c == 0) {
+                base = best;
+                reference = work;
+            } else if (work != reference) {
+                ok = false;
+            }
+            printf("%-12s %8u %12.1f %8.2fx\n", FILTER_NAMES[f], counts[c],
+                   (double)w * h / best / 1e6, base / best);
+        }
+    }
+    printf("Resultados iguais entre execuções: %s\n", ok ? "sim" : "NÃO");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
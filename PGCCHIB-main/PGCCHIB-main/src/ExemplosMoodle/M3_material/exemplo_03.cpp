@@ -5,66 +5,21 @@
 #include <fstream>
 #include <sstream>
 #include <math.h>
+#include <memory>
+#include <functional>
 
-using namespace std;
-
-unsigned char *open(string file, int &width, int &height) {
-    ifstream arq(file);
-    char BUFFER[1024];
-    arq.getline(BUFFER, 1024);
-    char type = BUFFER[1];
-    cout << BUFFER << endl;
-    do {
-        arq.getline(BUFFER, 1024);
-        cout << "." << BUFFER << "." << endl;
-    } while (BUFFER[0] == '#');
-    stringstream sstr(BUFFER);
-    int w;
-    int h;
-    sstr >> w;
-    sstr >> h;
-    width = w;
-    height = h;
-    int maxValue;
-    arq >> maxValue;
-    cout << w << " X " << h << " mv: " << maxValue << endl; 
-    unsigned char *data = new unsigned char [w * h * 3];
-    if (type == '3') {
-        // modo texto
-        int j=0;
-        while (!arq.eof()) {
-            int g;
-            arq >> g;
-            data[j++] = (unsigned char)g;
-        }
-    } else { 
-        // modo binário
-        arq.read(reinterpret_cast<char*> (&data), sizeof(data));
-    }
-    arq.close();
-    return data;
-}
+#include "PPM.h"
+#include "FilterChain.h"
+#include "ColorLUT.h"
+#include "PPMStream.h"
+#include "FilterSpec.h"
+#include "Batch.h"
+#include "Convolution.h"
+#include "ImageStats.h"
 
-void save(string file, unsigned char *data, int &w, int &h) {
-    ofstream arq(file);
-    arq << "P3" << endl;
-    arq << "#Gerado por chroma-key." << endl;
-    arq << w << " " << h << endl << "255" << endl;
-    int length = w * h * 3;
-    for (int i = 0; i < length; i++) {
-        arq << (int)data[i] << endl;
-    }    
-    arq.close();
-}
-
-double dist(int &r1, int &g1, int &b1, int &r2, int &g2, int &b2) {
-    double r = r1 - r2;
-    double g = g1 - g2;
-    double b = b1 - b2;
-    return sqrt(r*r + g*g + b*b);
-}
+using namespace std;
 
-void chromaKey(unsigned char *data, int w, int h) {
+void chromaKey(FilterChain &chain) {
     int r, g, b;
     cout << "Cor-chave: " << endl;
     cout << "\tR: ";
@@ -77,48 +32,20 @@ void chromaKey(unsigned char *data, int w, int h) {
     cout << "% Tolerência (0..1): ";
     double t;
     cin >> t;
-    
 
-    double dmax = 441.6729559301;
-
-    int length = w * h * 3;
-    for (int i = 0; i < length; i += 3) {
-        int ri = data[i] & 0xff;
-        int gi = data[i+1] & 0xff;
-        int bi = data[i+2] & 0xff;
-        double d = dist(r, g, b, ri, gi, bi);
-        if (d/dmax < t) {
-            data[i] = 0;
-            data[i+1] = 0;
-            data[i+2] = 0;
-        }
-    }
+    chain.chromaKey(makeChromaKey(r, g, b, t));
 }
 
-void grayScale(unsigned char *data, int w, int h) {
+void grayScale(FilterChain &chain) {
     cout << "Média aritmética (S) ou ponderada? ";
     char op;
     cin >> op;
-    double rw, gw, bw;
-    if ((op == 'S') || (op == 's')) {
-        rw = gw = bw = 1.0/3.0;
-    } else {
-        rw = 0.2125; 
-        gw = 0.7154;
-        bw = 0.0721;
-    }
-
-    int length = w * h * 3;
-    for (int i = 0; i < length; i += 3) {
-        int ri = data[i] & 0xff;
-        int gi = data[i+1] & 0xff;
-        int bi = data[i+2] & 0xff;
+    bool mean = (op == 'S') || (op == 's');
 
-        data[i] = data[i+1] = data[i+2] = (int)(ri * rw + gi * gw + bi * bw);
-    }
+    chain.grayScale(makeGrayScale(mean));
 }
 
-void colorize(unsigned char *data, int w, int h) {
+void colorize(FilterChain &chain) {
     int r, g, b;
     cout << "Cor de base: " << endl;
     cout << "\tR: ";
@@ -127,61 +54,300 @@ void colorize(unsigned char *data, int w, int h) {
     cin >> g;
     cout << "\tB: ";
     cin >> b;
-    
-    int length = w * h * 3;
-    for (int i = 0; i < length; i += 3) {
-        int ri = data[i] & 0xff;
-        int gi = data[i+1] & 0xff;
-        int bi = data[i+2] & 0xff;
 
-        data[i]   = ri | r;
-        data[i+1] = gi | g;
-        data[i+2] = bi | b;
+    chain.colorize(makeColorize(r, g, b));
+}
+
+void negative(FilterChain &chain) {
+    chain.negative();
+}
+
+void cubeLUT(FilterChain &chain) {
+    cout << "Arquivo .cube: ";
+    string path;
+    cin >> path;
+
+    shared_ptr<ColorLUT> lut = make_shared<ColorLUT>();
+    if (lut->loadCube(path)) {
+        chain.custom([lut](unsigned char *rgb, size_t pixels) { lut->apply(rgb, pixels); });
+    }
+}
+
+// Troca os filtros escolhidos até aqui por uma LUT que passa cada cor pela
+// cadeia uma só vez: uma grade size^3 com interpolação tetraédrica, que pode
+// ser gravada como .cube, ou (size 0) a tabela exata de 2^24 cores (64 MB),
+// que reproduz também a borda dura do chroma-key.
+void bakeLUT(FilterChain &chain) {
+    if (chain.empty()) {
+        cout << "Escolha antes os filtros que vão para a LUT." << endl;
+        return;
     }
+    cout << "Tamanho da grade (17, 33, 65; 0 = tabela exata de 2^24 cores): ";
+    int size;
+    if (!(cin >> size)) return;
+
+    FilterChain baked = chain;
+    baked.compile();
+    PointFilter filter = [baked](unsigned char *rgb, size_t pixels) { baked.apply(rgb, pixels); };
+    FilterChain result;
+    if (size == 0) {
+        shared_ptr<ExactColorLUT> lut = make_shared<ExactColorLUT>();
+        lut->bake(filter);
+        result.custom([lut](unsigned char *rgb, size_t pixels) { lut->apply(rgb, pixels); });
+    } else {
+        shared_ptr<ColorLUT> lut = make_shared<ColorLUT>();
+        lut->bake(filter, size);
+        cout << "Gravar a LUT em .cube (caminho, ou - para não gravar): ";
+        string path;
+        cin >> path;
+        if (path != "-") lut->saveCube(path);
+        result.custom([lut](unsigned char *rgb, size_t pixels) { lut->apply(rgb, pixels); });
+    }
+    chain = result;
+}
+
+// Níveis automáticos ou equalização, calculados sobre o histograma da
+// imagem de entrada; por isso só valem como primeiro filtro da cadeia.
+void levels(FilterChain &chain, bool equalize, const function<bool(ImageStats &)> &computeStats) {
+    if (!chain.empty()) {
+        cout << "Níveis e equalização usam o histograma da entrada: escolha antes dos outros filtros." << endl;
+        return;
+    }
+    ImageStats stats;
+    if (!computeStats(stats)) return;
+    cout << "Média R " << stats.mean[0] << ", G " << stats.mean[1] << ", B " << stats.mean[2]
+         << "; faixa R " << stats.min[0] << "-" << stats.max[0] << ", G " << stats.min[1] << "-" << stats.max[1]
+         << ", B " << stats.min[2] << "-" << stats.max[2] << endl;
+    LevelsLUT lut = equalize ? makeEqualize(stats) : makeAutoLevels(stats);
+    chain.custom([lut](unsigned char *rgb, size_t pixels) { lut.apply(rgb, pixels); });
 }
 
-void negative(unsigned char *data, int w, int h) {
-    int length = w * h * 3;
-    for (int i = 0; i < length; i += 3) {
-        int ri = data[i] & 0xff;
-        int gi = data[i+1] & 0xff;
-        int bi = data[i+2] & 0xff;
+// Pergunta os filtros até o usuário digitar 0; todos são aplicados
+// juntos, em uma única passada pela imagem. computeStats calcula o
+// histograma da imagem de entrada (opções 6 e 7).
+FilterChain askChain(const function<bool(ImageStats &)> &computeStats) {
+    FilterChain chain;
+    for (;;) {
+        int opt;
+        cout << "Qual opção de filtro você quer aplicar (1-chroma-key, 2-gray-scale, 3-colorize, 4-negative, 5-LUT .cube, "
+                "6-níveis automáticos, 7-equalizar, 8-assar os filtros anteriores em uma LUT, 0-aplicar)? ";
+        if (!(cin >> opt) || opt == 0) break;
 
-        data[i]   = ri ^ 255;
-        data[i+1] = gi ^ 255;
-        data[i+2] = bi ^ 255;
+        switch(opt) {
+            case 1:  chromaKey(chain); break;
+            case 2:  grayScale(chain); break;
+            case 3:  colorize(chain);  break;
+            case 4:  negative(chain);  break;
+            case 5:  cubeLUT(chain);   break;
+            case 6:  levels(chain, false, computeStats); break;
+            case 7:  levels(chain, true, computeStats);  break;
+            case 8:  bakeLUT(chain);   break;
+            default: cout << "Opção inválida!!" << endl;
+        }
     }
+    return chain.compile();
 }
 
-int main() {
+// A cadeia escolhida como filtro de faixas; com maxValue > 255 as faixas
+// têm amostras de 16 bits. Retorna false se a cadeia não roda nessa escala.
+bool askFilter(const function<bool(ImageStats &)> &computeStats, int maxValue, StripFilter &filter) {
+    FilterChain chain = askChain(computeStats);
+    filter = StripFilter();
+    if (chain.empty()) {
+        return true;
+    }
+    if (maxValue <= 255) {
+        filter = [chain](unsigned char *data, int w, int, int h, int) {
+            chain.apply(data, w, h);
+        };
+        return true;
+    }
+    if (!chain.supports16()) {
+        cout << "LUTs, níveis e equalização só existem para 8 bits por canal." << endl;
+        return false;
+    }
+    filter = [chain, maxValue](unsigned char *data, int w, int, int h, int) {
+        chain.apply16((uint16_t *)data, w, h, maxValue);
+    };
+    return true;
+}
+
+// Convolução sobre a imagem inteira (precisa dos vizinhos de cada pixel, por
+// isso não entra na cadeia de filtros pontuais nem no modo --stream).
+// Retorna false se nenhuma foi escolhida.
+bool askConvolution(const ImageView &src, Image &result) {
+    int opt;
+    cout << "Aplicar convolução (1-blur gaussiano, 2-unsharp mask, 3-sobel, 0-nenhuma)? ";
+    if (!(cin >> opt) || opt < 1 || opt > 3) return false;
+
+    double sigma = 2.0;
+    float amount = 1.0f;
+    if (opt != 3) {
+        cout << "Sigma: ";
+        cin >> sigma;
+    }
+    if (opt == 2) {
+        cout << "Intensidade: ";
+        cin >> amount;
+    }
+    result.allocate(src.width, src.height, src.channels, LAYOUT_INTERLEAVED, src.sampleBytes);
+    Convolver conv;
+    switch (opt) {
+        case 1: conv.gaussianBlur(src, result.view(), sigma); break;
+        case 2: conv.unsharpMask(src, result.view(), sigma, amount); break;
+        case 3: conv.sobel(src, result.view()); break;
+    }
+    return true;
+}
+
+// Modo em lote: exemplo_03 --batch FILTROS ENTRADA SAIDA [ARQUIVOS_SIMULTANEOS]
+// (FILTROS no formato de FilterSpec.h, ex. "gray=weighted+negative").
+// Sem ARQUIVOS_SIMULTANEOS, os arquivos passam pelo pipeline leitura/filtro/
+// escrita (Batch.h); com ele, cada thread processa um arquivo inteiro.
+int batch(int argc, char **argv) {
+    if (argc < 5) {
+        cout << "Uso: " << argv[0] << " --batch FILTROS DIR_ENTRADA DIR_SAIDA [ARQUIVOS_SIMULTANEOS]" << endl;
+        return EXIT_FAILURE;
+    }
+    FilterChain chain;
+    string error;
+    if (!parseFilterSpec(argv[2], chain, error)) {
+        cout << "Filtros: " << error << endl;
+        return EXIT_FAILURE;
+    }
+    chain.compile();
+
+    BatchOptions options;
+    options.inputDir = argv[3];
+    options.outputDir = argv[4];
+    options.jobs = argc > 5 ? atoi(argv[5]) : 0;
+    options.depth = argc > 5 ? 0 : 3;
+
+    BatchStats stats;
+    bool ok = runBatch(options, chain, stats);
+    double mb = stats.bytes / 1e6;
+    printf("%d arquivos (%d falhas), %.1f MB em %.2f s: %.2f arquivos/s, %.1f MB/s\n",
+           stats.files, stats.failed, mb, stats.wallSeconds,
+           stats.files / stats.wallSeconds, mb / stats.wallSeconds);
+    if (options.depth > 0) {
+        printf("Utilização: leitura %.0f%% (%.2f s), filtro %.0f%% (%.2f s), escrita %.0f%% (%.2f s); gargalo: %s\n",
+               100.0 * stageUtilization(stats, stats.readSeconds), stats.readSeconds,
+               100.0 * stageUtilization(stats, stats.filterSeconds), stats.filterSeconds,
+               100.0 * stageUtilization(stats, stats.writeSeconds), stats.writeSeconds, batchBottleneck(stats));
+        printf("%d buffers, %.1f MB, %d alocações\n", stats.buffers, stats.bufferBytes / 1e6, stats.allocations);
+    } else {
+        printf("Tempo por estágio (somado nas threads): leitura %.2f s, filtro %.2f s, escrita %.2f s\n",
+               stats.readSeconds, stats.filterSeconds, stats.writeSeconds);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// --stream filtra em faixas, sem carregar a imagem inteira na memória.
+int main(int argc, char **argv) {
     string file;
+    if ((argc > 1) && (string(argv[1]) == "--batch")) {
+        return batch(argc, argv);
+    }
+    bool stream = (argc > 1) && (string(argv[1]) == "--stream");
     
     // AQUI PRA LER DO USUÁRIO O NOME DO ARQUIVO
     // cout << "Digite caminho para o arquivo da imagem de entrada: ";
     // getline(cin, file);
     file = "../src/ExemplosMoodle/M3_material/M3_exemplo1.ppm";
+    string output = "../src/ExemplosMoodle/M3_material/output.ppm";
 
-    int w, h;
-    unsigned char *data = open(file, w, h);
-    // cout << ((int)data[0]) << "..." << ((int)data[w * h * 3 - 1]) << endl;
+    cout << "Kernels: " << simdLevelName(filterKernels().level)
+         << ", threads: " << ThreadPool::shared().size() << endl;
 
+    if (stream) {
+        PPMStripReader reader;
+        if (!reader.open(file)) {
+            return EXIT_FAILURE;
+        }
+        if (reader.info().channels != 3) {
+            cout << "Os filtros exigem uma imagem colorida (P6)." << endl;
+            return EXIT_FAILURE;
+        }
+        int maxValue = reader.info().maxValue;
+        reader.close();
 
-    int opt;
-    cout << "Qual opção de filtro você quer aplicar (1-chroma-key, 2-gray-scale, 3-colorize, 4-negative)? ";
-    cin >> opt;
+        // o histograma exige uma passada a mais pelo arquivo, faixa a faixa
+        StripFilter filter;
+        bool ok = askFilter([&file, maxValue](ImageStats &stats) {
+            if (maxValue > 255) {
+                cout << "Níveis e equalização só existem para 8 bits por canal." << endl;
+                return false;
+            }
+            PPMStripReader in;
+            if (!in.open(file)) return false;
+            int w = in.info().width;
+            int rows = defaultStripRows(in.rowBytes());
+            vector<unsigned char> strip(in.rowBytes() * rows);
+            stats.clear(3);
+            int n;
+            while ((n = in.read(strip.data(), rows)) > 0) {
+                ImageStats part;
+                computeImageStats(strip.data(), w, n, 3, part);
+                stats.merge(part);
+            }
+            stats.finish();
+            return n == 0;
+        }, maxValue, filter);
+        if (!ok) {
+            return EXIT_FAILURE;
+        }
+        if (!filter) {
+            return EXIT_SUCCESS;
+        }
+        StreamStats stats;
+        if (!streamFilterPPM(file, output, filter, 0, 3, &stats)) {
+            return EXIT_FAILURE;
+        }
+        cout << stats.strips << " faixas de " << stats.stripRows << " linhas, "
+             << stats.peakBytes / (1024 * 1024.0) << " MB em buffers, "
+             << stats.totalSeconds << " s" << endl;
+        return EXIT_SUCCESS;
+    }
 
-    switch(opt) {
-        case 1:  chromaKey(data, w, h); break;
-        case 2:  grayScale(data, w, h); break;
-        case 3:  colorize(data, w, h);  break;
-        case 4:  negative(data, w, h);  break;
-        default: cout << "Opção inválida!!";
+    PPMImage image;
+    if (!image.open(file)) {
+        return EXIT_FAILURE;
+    }
+    if (image.channels() != 3) {
+        cout << "Os filtros exigem uma imagem colorida (P3 ou P6)." << endl;
+        return EXIT_FAILURE;
     }
+    int w = image.width();
+    int h = image.height();
+    // pixels mapeados direto do arquivo (P6) ou convertidos do texto (P3);
+    // com maxValue > 255, amostras de 16 bits
+    bool wide = image.sampleBytes() == 2;
+    ImageView view = image.view();
 
-    if ((opt > 0) && (opt < 5)){
-        save("../src/ExemplosMoodle/M3_material/output.ppm", data, w, h);
+    FilterChain chain = askChain([&](ImageStats &stats) {
+        if (wide) {
+            cout << "Níveis e equalização só existem para 8 bits por canal." << endl;
+            return false;
+        }
+        computeImageStats(image.data(), w, h, 3, stats);
+        return true;
+    });
+    if (!chain.empty()) {
+        if (wide) {
+            if (!chain.apply16(image.data16(), w, h, image.maxValue())) {
+                return EXIT_FAILURE;
+            }
+        } else {
+            chain.apply(image.data(), w, h);
+        }
+    }
+    Image convolved;
+    if (askConvolution(view, convolved)) {
+        view = convolved.view();
+    }
+    if (!chain.empty() || !convolved.empty()) {
+        savePPM(output, view, wide ? image.maxValue() : 0);
     }
     
-    delete [] data;
     return EXIT_SUCCESS;
 }
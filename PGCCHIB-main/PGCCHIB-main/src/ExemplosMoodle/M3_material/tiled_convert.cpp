@@ -0,0 +1,203 @@
+// Conversão para o formato em blocos (TiledImage.h) e leitura de regiões.
+//
+// Uso: tiled_convert ENTRADA SAIDA.m3t [--tile N] [--compress]
+//      tiled_convert --region X,Y,L,A ARQUIVO.m3t SAIDA.ppm
+//      tiled_convert --check [diretório de trabalho]
+//
+// ENTRADA pode ser PPM/PGM (P5/P6 são lidos em faixas, sem carregar a
+// imagem inteira) ou qualquer formato do stb_image (PNG, JPEG, BMP, ...).
+// --region extrai só os blocos que a região toca e grava a região em PPM.
+// --check grava e relê imagens sintéticas (1 a 4 canais, com e sem
+// --compress, bordas que não completam um bloco, também via P6 em faixas)
+// e confere que a leitura devolve os mesmos pixels.
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "TiledImage.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point t0) {
+    return chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static bool isPPM(const string &path) {
+    string ext = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+    transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".ppm" || ext == ".pgm" || ext == ".pnm";
+}
+
+static int convert(const string &in, const string &out, const TiledOptions &options) {
+    Clock::time_point t0 = Clock::now();
+    bool ok;
+    if (isPPM(in)) {
+        ok = convertPPMToTiled(in, out, options);
+    } else {
+        int w, h, comp;
+        unsigned char *data = stbi_load(in.c_str(), &w, &h, &comp, 0);
+        if (!data) {
+            cerr << "Não foi possível carregar " << in << ": " << stbi_failure_reason() << endl;
+            return EXIT_FAILURE;
+        }
+        ok = writeTiledImage(out, ImageView(data, w, h, comp), options);
+        stbi_image_free(data);
+    }
+    if (!ok) return EXIT_FAILURE;
+
+    TiledImageReader reader;
+    if (!reader.open(out)) return EXIT_FAILURE;
+    printf("%dx%d, %d canais, blocos de %d (%ux%u) em %.2f s\n", reader.width(), reader.height(),
+           reader.channels(), reader.tileSize(), reader.info().tilesX, reader.info().tilesY, secondsSince(t0));
+    return EXIT_SUCCESS;
+}
+
+static int region(const string &spec, const string &in, const string &out) {
+    int x, y, w, h;
+    if (sscanf(spec.c_str(), "%d,%d,%d,%d", &x, &y, &w, &h) != 4) {
+        cerr << "Região inválida, use X,Y,L,A" << endl;
+        return EXIT_FAILURE;
+    }
+    Clock::time_point t0 = Clock::now();
+    TiledImageReader reader;
+    if (!reader.open(in)) return EXIT_FAILURE;
+    Image image;
+    if (!reader.readRegion(x, y, w, h, image)) return EXIT_FAILURE;
+    double seconds = secondsSince(t0);
+
+    // PPM só tem cinza ou RGB: o alfa é descartado
+    ImageView view = image.view();
+    Image rgb;
+    if (view.channels == 2 || view.channels == 4) {
+        rgb.allocate(w, h, view.channels - 1);
+        for (int r = 0; r < h; r++) {
+            const unsigned char *src = view.row(r);
+            unsigned char *dst = rgb.view().row(r);
+            for (int i = 0; i < w; i++) {
+                for (int c = 0; c < view.channels - 1; c++) *dst++ = src[c];
+                src += view.channels;
+            }
+        }
+        view = rgb.view();
+    }
+    if (!savePPM(out, view)) return EXIT_FAILURE;
+    printf("Região %dx%d em (%d, %d) lida em %.3f ms\n", w, h, x, y, seconds * 1e3);
+    return EXIT_SUCCESS;
+}
+
+// Cada região lida de path tem de ser igual ao recorte de src.
+static bool sameRegions(const string &path, const ImageView &src) {
+    static const int REGIONS[][4] = { { 0, 0, 1, 1 }, { 5, 3, 40, 17 }, { 17, 31, 1, 50 }, { 60, 60, 200, 130 } };
+    TiledImageReader reader;
+    if (!reader.open(path)) return false;
+    Image all;
+    if (!reader.readRegion(0, 0, src.width, src.height, all)) return false;
+    for (int y = 0; y < src.height; y++) {
+        if (memcmp(all.view().row(y), src.row(y), src.rowBytes()) != 0) return false;
+    }
+    for (const int *r : REGIONS) {
+        int x = min(r[0], src.width - 1), y = min(r[1], src.height - 1);
+        int w = min(r[2], src.width - x), h = min(r[3], src.height - y);
+        Image part;
+        if (!reader.readRegion(x, y, w, h, part)) return false;
+        for (int yy = 0; yy < h; yy++) {
+            if (memcmp(part.view().row(yy), src.pixel(x, y + yy), (size_t)w * src.channels) != 0) return false;
+        }
+    }
+    return true;
+}
+
+static int check(const string &dir) {
+    static const int SIZES[][2] = { { 1, 1 }, { 64, 64 }, { 301, 203 } };
+    static const int TILES[] = { 16, 64 };
+    string path = dir + "/check.m3t";
+    string ppm = dir + "/check.ppm";
+    int cases = 0, failures = 0;
+    for (const int *size : SIZES) {
+        int w = size[0], h = size[1];
+        for (int channels = 1; channels <= 4; channels++) {
+            // metade lisa (comprimível), metade ruído (bloco cru)
+            Image image;
+            image.allocate(w, h, channels);
+            for (int y = 0; y < h; y++) {
+                unsigned char *row = image.view().row(y);
+                for (int i = 0; i < w * channels; i++) {
+                    unsigned noise = (i * 2654435761u + y) >> 13;
+                    row[i] = (unsigned char)(y < h / 2 ? i / channels + y : noise);
+                }
+            }
+            for (int tile : TILES) {
+                for (int compress = 0; compress < 2; compress++) {
+                    TiledOptions options(tile, compress != 0);
+                    bool ok = writeTiledImage(path, image.view(), options) && sameRegions(path, image.view());
+                    if (ok && (channels == 1 || channels == 3)) {
+                        ok = savePPM(ppm, image.view()) && convertPPMToTiled(ppm, path, options) &&
+                             sameRegions(path, image.view());
+                    }
+                    cases++;
+                    if (!ok) {
+                        failures++;
+                        printf("  DIVERGENTE: %dx%d, %d canais, blocos de %d%s\n", w, h, channels, tile,
+                               compress ? ", comprimido" : "");
+                    }
+                }
+            }
+        }
+    }
+
+    // parâmetros que o formato não comporta têm de ser recusados
+    Image image;
+    image.allocate(64, 64, 3);
+    memset(image.view().row(0), 0, image.view().rowBytes() * 64);
+    bool rejected = !writeTiledImage(path, image.view(), TiledOptions(TILED_MAX_TILE_SIZE + 1));
+    TiledImageReader reader;
+    Image wide;
+    wide.allocate(8, 8, 3, LAYOUT_INTERLEAVED, 2);
+    rejected = rejected && writeTiledImage(path, image.view()) && reader.open(path) &&
+               !reader.readRegion(0, 0, wide.view());
+    printf("Blocos maiores que %d e destino de 16 bits: %s\n", TILED_MAX_TILE_SIZE, rejected ? "recusados" : "ACEITOS");
+
+    remove(path.c_str());
+    remove(ppm.c_str());
+    printf("Gravar e reler: %d casos, %s\n", cases, failures == 0 ? "iguais" : "DIVERGENTES");
+    return failures == 0 && rejected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 5 && string(argv[1]) == "--region") {
+        return region(argv[2], argv[3], argv[4]);
+    }
+    if (argc <= 3 && argc >= 2 && string(argv[1]) == "--check") {
+        return check(argc == 3 ? argv[2] : ".");
+    }
+    TiledOptions options;
+    bool ok = argc >= 3;
+    for (int i = 3; ok && i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--tile" && i + 1 < argc) {
+            options.tileSize = atoi(argv[++i]);
+            ok = options.tileSize >= TILED_MIN_TILE_SIZE && options.tileSize <= TILED_MAX_TILE_SIZE;
+        } else if (arg == "--compress") {
+            options.compress = true;
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        cerr << "Uso: " << argv[0] << " ENTRADA SAIDA.m3t [--tile N] [--compress]" << endl
+             << "     " << argv[0] << " --region X,Y,L,A ARQUIVO.m3t SAIDA.ppm" << endl
+             << "     " << argv[0] << " --check [diretório de trabalho]" << endl;
+        return EXIT_FAILURE;
+    }
+    return convert(argv[1], argv[2], options);
+}
@@ -16,6 +16,8 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "MipmapGL.h"
+
 const GLint WIDTH = 800, HEIGHT = 600;
 glm::mat4 matrix = glm::mat4(1);
 
@@ -55,7 +57,8 @@ bool load_texture (const char* file_name, GLuint* tex) {
     glActiveTexture (GL_TEXTURE0);
     glBindTexture (GL_TEXTURE_2D, *tex);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
-    glGenerateMipmap (GL_TEXTURE_2D);
+    // níveis 1..n gerados na CPU, em luz linear (Mipmap.h)
+    uploadMipChain (GL_RGBA, image_data, x, y);
     glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -18,6 +18,7 @@
 #include <vector>
 
 #include "Layer.h"
+#include "MipmapGL.h"
 
 using namespace std;
 
@@ -58,7 +59,8 @@ int loadTexture(unsigned int &texture, char *filename)
 			cout << "Without Alpha channel" << endl;
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
 		}
-		glGenerateMipmap(GL_TEXTURE_2D);
+		// níveis 1..n gerados na CPU, em luz linear (Mipmap.h)
+		uploadMipChain(nrChannels == 4 ? GL_RGBA : GL_RGB, data, width, height);
 	}
 	else
 	{
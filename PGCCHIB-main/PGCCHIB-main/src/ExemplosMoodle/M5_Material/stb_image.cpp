@@ -15,6 +15,14 @@
 #include <assert.h>
 #include <stdarg.h>
 
+// vectorized colour conversion (YCbCr -> RGB, luma), IDCT, chroma
+// upsampling and PNG unfiltering from Common/M3
+#include "ColorConvert.h"
+#include "JpegKernels.h"
+#include "PngKernels.h"
+// restart intervals and bands of rows of large JPEGs are decoded in parallel
+#include "ThreadPool.h"
+
 #ifndef _MSC_VER
    #ifdef __cplusplus
    #define stbi_inline inline
@@ -32,6 +40,7 @@ typedef unsigned short uint16;
 typedef   signed short  int16;
 typedef unsigned int   uint32;
 typedef   signed int    int32;
+typedef unsigned long long uint64;
 typedef unsigned int   uint;
 
 // should produce compiler error if size is wrong
@@ -73,6 +82,10 @@ typedef struct
 
    uint8 *img_buffer, *img_buffer_end;
    uint8 *img_buffer_original;
+
+   // stbi_load_into: the caller's buffer (NULL when the result is malloc'd)
+   uint8 *out;
+   int out_size, out_stride;
 } stbi;
 
 
@@ -83,6 +96,7 @@ static void start_mem(stbi *s, uint8 const *buffer, int len)
 {
    s->io.read = NULL;
    s->read_from_callbacks = 0;
+   s->out = NULL;
    s->img_buffer = s->img_buffer_original = (uint8 *) buffer;
    s->img_buffer_end = (uint8 *) buffer+len;
 }
@@ -95,6 +109,7 @@ static void start_callbacks(stbi *s, stbi_io_callbacks *c, void *user)
    s->buflen = sizeof(s->buffer_start);
    s->read_from_callbacks = 1;
    s->img_buffer_original = s->buffer_start;
+   s->out = NULL;
    refill_buffer(s);
 }
 
@@ -161,8 +176,9 @@ static stbi_uc *stbi_gif_load(stbi *s, int *x, int *y, int *comp, int req_comp);
 static int      stbi_gif_info(stbi *s, int *x, int *y, int *comp);
 
 
-// this is not threadsafe
-static const char *failure_reason;
+// one per thread: decodes running at the same time (and the tasks of a
+// parallel JPEG decode) don't overwrite each other's reason
+static thread_local const char *failure_reason;
 
 const char *stbi_failure_reason(void)
 {
@@ -195,6 +211,73 @@ void stbi_image_free(void *retval_from_stbi_load)
    free(retval_from_stbi_load);
 }
 
+// stbi_load_into keeps the decoders' scratch memory (JPEG component planes,
+// line buffers and restart interval tables; PNG compressed, inflated and
+// unconverted pixels) per thread and reuses it on the next call, so once it
+// has decoded an image of a given size, the same size again doesn't touch
+// the heap
+enum
+{
+   SCRATCH_JPEG_COMP,                            // one per component
+   SCRATCH_JPEG_LINEBUF = SCRATCH_JPEG_COMP + 4,
+   SCRATCH_JPEG_SEGMENT = SCRATCH_JPEG_LINEBUF + 4,
+   SCRATCH_JPEG_RESTARTS,
+   SCRATCH_JPEG_TASKS,
+   SCRATCH_PNG_IDATA,
+   SCRATCH_PNG_INFLATED,
+   SCRATCH_PNG_PIXELS,
+   SCRATCH_PNG_PALETTE,
+   SCRATCH_COUNT
+};
+
+typedef struct
+{
+   void *p;
+   size_t size;
+} stbi_scratch;
+
+static thread_local stbi_scratch scratch[SCRATCH_COUNT];
+
+// size bytes for slot, keeping what old (NULL or the slot's memory) held, as
+// realloc does; outside stbi_load_into it is just realloc
+static void *scratch_alloc(stbi *s, int slot, void *old, size_t size)
+{
+   void *p;
+   if (!s->out) return realloc(old, size);
+   if (scratch[slot].size >= size) return scratch[slot].p;
+   p = realloc(scratch[slot].p, size);
+   if (p == NULL) return NULL;
+   scratch[slot].p = p;
+   scratch[slot].size = size;
+   return p;
+}
+
+static void scratch_free(stbi *s, void *p)
+{
+   if (!s->out) free(p);
+}
+
+void stbi_load_into_release(void)
+{
+   int i;
+   for (i=0; i < SCRATCH_COUNT; ++i) {
+      free(scratch[i].p);
+      scratch[i].p = NULL;
+      scratch[i].size = 0;
+   }
+}
+
+// the caller's buffer of stbi_load_into, if a w x h image with n components
+// fits in it at its stride (0 = rows of w*n bytes)
+static uint8 *out_rows(stbi *s, uint32 w, uint32 h, int n, int *stride)
+{
+   size_t row = (size_t) w * n;
+   *stride = s->out_stride ? s->out_stride : (int) row;
+   if ((size_t) *stride < row || h == 0 || (size_t) *stride * (h-1) + row > (size_t) s->out_size)
+      return epuc("buffer too small", "Output buffer too small");
+   return s->out;
+}
+
 #ifndef STBI_NO_HDR
 static float   *ldr_to_hdr(stbi_uc *data, int x, int y, int comp);
 static stbi_uc *hdr_to_ldr(float   *data, int x, int y, int comp);
@@ -255,6 +338,66 @@ unsigned char *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *use
    return stbi_load_main(&s,x,y,comp,req_comp);
 }
 
+// JPEG and PNG write into s->out themselves when they can; anything else is
+// loaded as usual and its rows copied in
+static int stbi_load_into_main(stbi *s, stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_uc *result, *dest = NULL;
+   int w, h, n, j;
+   if (req_comp < 1 || req_comp > 4) return e("bad req_comp", "Internal error");
+   if (out == NULL || out_size < 0 || stride < 0) return e("bad buffer", "Internal error");
+   s->out = out;
+   s->out_size = out_size;
+   s->out_stride = stride;
+   result = stbi_load_main(s, &w, &h, &n, req_comp);
+   if (result == NULL) return 0;
+   if (result != out) {
+      dest = out_rows(s, w, h, req_comp, &stride);
+      if (dest)
+         for (j=0; j < h; ++j)
+            memcpy(dest + (size_t) stride * j, result + (size_t) w * req_comp * j, (size_t) w * req_comp);
+      free(result);
+      if (dest == NULL) return 0;
+   }
+   *x = w;
+   *y = h;
+   if (comp) *comp = n;
+   return 1;
+}
+
+#ifndef STBI_NO_STDIO
+int stbi_load_into(char const *filename, stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = fopen(filename, "rb");
+   int result;
+   if (!f) return e("can't fopen", "Unable to open file");
+   result = stbi_load_into_from_file(f,out,out_size,stride,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
+int stbi_load_into_from_file(FILE *f, stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp)
+{
+   stbi s;
+   start_file(&s,f);
+   return stbi_load_into_main(&s,out,out_size,stride,x,y,comp,req_comp);
+}
+#endif //!STBI_NO_STDIO
+
+int stbi_load_into_from_memory(stbi_uc const *buffer, int len, stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp)
+{
+   stbi s;
+   start_mem(&s,buffer,len);
+   return stbi_load_into_main(&s,out,out_size,stride,x,y,comp,req_comp);
+}
+
+int stbi_load_into_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp)
+{
+   stbi s;
+   start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi_load_into_main(&s,out,out_size,stride,x,y,comp,req_comp);
+}
+
 #ifndef STBI_NO_HDR
 
 float *stbi_loadf_main(stbi *s, int *x, int *y, int *comp, int req_comp)
@@ -495,28 +638,26 @@ static uint32 get32le(stbi *s)
 //  assume data buffer is malloced, so malloc a new one and free that one
 //  only failure mode is malloc failing
 
+// stb's own truncating weights, not ycc::luma: req_comp 1/2 output stays the
+// same as upstream stb_image (the rounded Q14 luma is +1 on most pixels)
 static uint8 compute_y(int r, int g, int b)
 {
    return (uint8) (((r*77) + (g*150) +  (29*b)) >> 8);
 }
 
-static unsigned char *convert_format(unsigned char *data, int img_n, int req_comp, uint x, uint y)
+// rows of img_n components to rows of req_comp components, 'stride' bytes apart
+static void convert_rows(unsigned char *data, int img_n, unsigned char *good, size_t stride, int req_comp, uint x, uint y)
 {
    int i,j;
-   unsigned char *good;
-
-   if (req_comp == img_n) return data;
-   assert(req_comp >= 1 && req_comp <= 4);
-
-   good = (unsigned char *) malloc(req_comp * x * y);
-   if (good == NULL) {
-      free(data);
-      return epuc("outofmem", "Out of memory");
-   }
 
    for (j=0; j < (int) y; ++j) {
-      unsigned char *src  = data + j * x * img_n   ;
-      unsigned char *dest = good + j * x * req_comp;
+      unsigned char *src  = data + (size_t) j * x * img_n;
+      unsigned char *dest = good + stride * j;
+
+      if (img_n == req_comp) {
+         memcpy(dest, src, x * img_n);
+         continue;
+      }
 
       #define COMBO(a,b)  ((a)*8+(b))
       #define CASE(a,b)   case COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
@@ -539,6 +680,22 @@ static unsigned char *convert_format(unsigned char *data, int img_n, int req_com
       }
       #undef CASE
    }
+}
+
+static unsigned char *convert_format(unsigned char *data, int img_n, int req_comp, uint x, uint y)
+{
+   unsigned char *good;
+
+   if (req_comp == img_n) return data;
+   assert(req_comp >= 1 && req_comp <= 4);
+
+   good = (unsigned char *) malloc(req_comp * x * y);
+   if (good == NULL) {
+      free(data);
+      return epuc("outofmem", "Out of memory");
+   }
+
+   convert_rows(data, img_n, good, (size_t) x * req_comp, req_comp, x, y);
 
    free(data);
    return good;
@@ -617,7 +774,7 @@ static stbi_uc *hdr_to_ldr(float   *data, int x, int y, int comp)
 //          IJG 1998:   0.95 seconds (MSVC6, makefile + proc=PPro)
 
 // huffman decoding acceleration
-#define FAST_BITS   9  // larger handles more cases; smaller stomps less cache
+#define FAST_BITS   10 // larger handles more cases; smaller stomps less cache
 
 typedef struct
 {
@@ -638,6 +795,7 @@ typedef struct
    stbi *s;
    huffman huff_dc[4];
    huffman huff_ac[4];
+   int32 fast_ac[4][1 << FAST_BITS];
    uint8 dequant[4][64];
 
 // sizes for components, interleaved MCUs
@@ -660,10 +818,11 @@ typedef struct
       uint8 *linebuf;
    } img_comp[4];
 
-   uint32         code_buffer; // jpeg entropy-coded buffer
+   uint64         code_buffer; // jpeg entropy-coded buffer, next bit in the msb
    int            code_bits;   // number of valid bits
    unsigned char  marker;      // marker seen while filling entropy buffer
    int            nomore;      // flag if we saw a marker so must stop
+   int            pad_bits;    // zero bits padded in after the marker
 
    int scan_n, order[4];
    int restart_interval, todo;
@@ -710,26 +869,76 @@ static int build_huffman(huffman *h, int *count)
    return 1;
 }
 
+// AC codes whose huffman code plus magnitude bits fit in FAST_BITS decode in
+// a single lookup: value << 8 | run << 4 | total bit length (0 = not fast)
+static void build_fast_ac(int32 *fast_ac, huffman *h)
+{
+   int i;
+   for (i=0; i < (1 << FAST_BITS); ++i) {
+      uint8 fast = h->fast[i];
+      fast_ac[i] = 0;
+      if (fast < 255) {
+         int rs = h->values[fast];
+         int run = (rs >> 4) & 15;
+         int magbits = rs & 15;
+         int len = h->size[fast];
+         if (magbits && len + magbits <= FAST_BITS) {
+            // the magnitude bits follow the code in the same lookup index
+            int k = ((i << len) & ((1 << FAST_BITS) - 1)) >> (FAST_BITS - magbits);
+            if (k < (1 << (magbits - 1)))
+               k += 1 - (1 << magbits);
+            fast_ac[i] = k * 256 + run * 16 + len + magbits;
+         }
+      }
+   }
+}
+
+// 0xff in any of the top n bytes of v (n = 1..8); a 0xff further down can
+// also set the result, which only sends the caller to the byte-wise path
+stbi_inline static int has_ff_byte(uint64 v, int n)
+{
+   uint64 x = ~v;
+   uint64 zero = (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+   return (zero & (~(uint64) 0 << (64 - 8 * n))) != 0;
+}
+
+// fill the bit buffer to at least 56 bits. Plain data is loaded up to 7 bytes at
+// once; only when one of them is 0xff (a stuffed zero or a marker) does it
+// go byte by byte, so decode_block never looks at the stuffing itself
 static void grow_buffer_unsafe(jpeg *j)
 {
-   do {
+   stbi *s = j->s;
+   int n = (63 - j->code_bits) >> 3;
+   if (n > 0 && !j->nomore && s->img_buffer_end - s->img_buffer >= 8) {
+      uint8 *p = s->img_buffer;
+      uint64 v = ((uint64) p[0] << 56) | ((uint64) p[1] << 48) | ((uint64) p[2] << 40) | ((uint64) p[3] << 32) |
+                 ((uint64) p[4] << 24) | ((uint64) p[5] << 16) | ((uint64) p[6] << 8) | (uint64) p[7];
+      if (!has_ff_byte(v, n)) {
+         j->code_buffer |= (v & (~(uint64) 0 << (64 - 8 * n))) >> j->code_bits;
+         j->code_bits += 8 * n;
+         s->img_buffer += n;
+         return;
+      }
+   }
+   while (j->code_bits <= 56) {
       int b = j->nomore ? 0 : get8(j->s);
       if (b == 0xff) {
          int c = get8(j->s);
          if (c != 0) {
+            // a marker ends the entropy-coded data: keep it for the caller
+            // and pad with zeros, so the buffer is always full enough for
+            // the lookups in decode_block
             j->marker = (unsigned char) c;
             j->nomore = 1;
-            return;
+            b = 0;
          }
       }
-      j->code_buffer |= b << (24 - j->code_bits);
+      if (j->nomore) j->pad_bits += 8;
+      j->code_buffer |= (uint64) b << (56 - j->code_bits);
       j->code_bits += 8;
-   } while (j->code_bits <= 24);
+   }
 }
 
-// (1 << n) - 1
-static uint32 bmask[17]={0,1,3,7,15,31,63,127,255,511,1023,2047,4095,8191,16383,32767,65535};
-
 // decode a jpeg huffman value from the bitstream
 stbi_inline static int decode(jpeg *j, huffman *h)
 {
@@ -740,7 +949,7 @@ stbi_inline static int decode(jpeg *j, huffman *h)
 
    // look at the top FAST_BITS and determine what symbol ID it is,
    // if the code is <= FAST_BITS
-   c = (j->code_buffer >> (32 - FAST_BITS)) & ((1 << FAST_BITS)-1);
+   c = (int) (j->code_buffer >> (64 - FAST_BITS));
    k = h->fast[c];
    if (k < 255) {
       int s = h->size[k];
@@ -757,7 +966,7 @@ stbi_inline static int decode(jpeg *j, huffman *h)
    // end; in other words, regardless of the number of bits, it
    // wants to be compared against something shifted to have 16;
    // that way we don't need to shift inside the loop.
-   temp = j->code_buffer >> 16;
+   temp = (unsigned int) (j->code_buffer >> 48);
    for (k=FAST_BITS+1 ; ; ++k)
       if (temp < h->maxcode[k])
          break;
@@ -771,8 +980,8 @@ stbi_inline static int decode(jpeg *j, huffman *h)
       return -1;
 
    // convert the huffman code to the symbol id
-   c = ((j->code_buffer >> (32 - k)) & bmask[k]) + h->delta[k];
-   assert((((j->code_buffer) >> (32 - h->size[c])) & bmask[h->size[c]]) == h->code[c]);
+   c = (int) (j->code_buffer >> (64 - k)) + h->delta[k];
+   assert((j->code_buffer >> (64 - h->size[c])) == h->code[c]);
 
    // convert the id to a symbol
    j->code_bits -= k;
@@ -784,27 +993,14 @@ stbi_inline static int decode(jpeg *j, huffman *h)
 // always extends everything it receives.
 stbi_inline static int extend_receive(jpeg *j, int n)
 {
-   unsigned int m = 1 << (n-1);
-   unsigned int k;
+   int k;
    if (j->code_bits < n) grow_buffer_unsafe(j);
 
-   #if 1
-   k = stbi_lrot(j->code_buffer, n);
-   j->code_buffer = k & ~bmask[n];
-   k &= bmask[n];
-   j->code_bits -= n;
-   #else
-   k = (j->code_buffer >> (32 - n)) & bmask[n];
-   j->code_bits -= n;
+   k = (int) (j->code_buffer >> (64 - n));
    j->code_buffer <<= n;
-   #endif
-   // the following test is probably a random branch that won't
-   // predict well. I tried to table accelerate it but failed.
-   // maybe it's compiling as a conditional move?
-   if (k < m)
-      return (-1 << n) + k + 1;
-   else
-      return k;
+   j->code_bits -= n;
+   // values below 2^(n-1) are the negative half
+   return k < (1 << (n-1)) ? k + 1 - (1 << n) : k;
 }
 
 // given a value that's at position X in the zigzag stream,
@@ -825,11 +1021,11 @@ static uint8 dezigzag[64+15] =
 };
 
 // decode one 64-entry block--
-static int decode_block(jpeg *j, short data[64], huffman *hdc, huffman *hac, int b)
+static int decode_block(jpeg *j, short data[64], huffman *hdc, huffman *hac, int32 *fac, int b)
 {
    int diff,dc,k;
    int t = decode(j, hdc);
-   if (t < 0) return e("bad huffman code","Corrupt JPEG");
+   if (t < 0 || t > 15) return e("bad huffman code","Corrupt JPEG");
 
    // 0 all the ac values now so we can do it 32-bits at a time
    memset(data,0,64*sizeof(data[0]));
@@ -843,7 +1039,19 @@ static int decode_block(jpeg *j, short data[64], huffman *hdc, huffman *hac, int
    k = 1;
    do {
       int r,s;
-      int rs = decode(j, hac);
+      int rs;
+      if (j->code_bits < 16) grow_buffer_unsafe(j);
+      // code, run and value of the common short coefficients in one lookup
+      r = fac[j->code_buffer >> (64 - FAST_BITS)];
+      if (r) {
+         s = r & 15;
+         j->code_buffer <<= s;
+         j->code_bits -= s;
+         k += (r >> 4) & 15;
+         data[dezigzag[k++]] = (short) (r >> 8);
+         continue;
+      }
+      rs = decode(j, hac);
       if (rs < 0) return e("bad huffman code","Corrupt JPEG");
       s = rs & 15;
       r = rs >> 4;
@@ -913,7 +1121,13 @@ stbi_inline static uint8 clamp(int x)
 
 #ifdef STBI_SIMD
 typedef unsigned short stbi_dequantize_t;
+#ifdef _MSC_VER
+#define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 #else
+#define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
+#endif
+#else
+#define STBI_SIMD_ALIGN(type, name) type name
 typedef uint8 stbi_dequantize_t;
 #endif
 
@@ -980,7 +1194,9 @@ static void idct_block(uint8 *out, int out_stride, short data[64], stbi_dequanti
 }
 
 #ifdef STBI_SIMD
-static stbi_idct_8x8 stbi_idct_installed = idct_block;
+// the SSE2/AVX2 IDCT (JpegKernels.h) gives the same bytes as idct_block for
+// every valid baseline JPEG
+static stbi_idct_8x8 stbi_idct_installed = jpegKernels().level > SIMD_SCALAR ? jpegKernels().idct : idct_block;
 
 void stbi_install_idct(stbi_idct_8x8 func)
 {
@@ -1014,6 +1230,7 @@ static void reset(jpeg *j)
    j->code_bits = 0;
    j->code_buffer = 0;
    j->nomore = 0;
+   j->pad_bits = 0;
    j->img_comp[0].dc_pred = j->img_comp[1].dc_pred = j->img_comp[2].dc_pred = 0;
    j->marker = MARKER_none;
    j->todo = j->restart_interval ? j->restart_interval : 0x7fffffff;
@@ -1021,78 +1238,356 @@ static void reset(jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
-static int parse_entropy_coded_data(jpeg *z)
+// The original reader refilled a 32-bit buffer one byte at a time, so it
+// never looked more than 32 bits past the bits consumed, and at the end of a
+// restart interval it reached the marker only if at most 24 bits of data were
+// left; grow_buffer_unsafe reads up to 4 bytes further. On a damaged interval
+// that stops short of its marker, both checks below go by the bits actually
+// consumed, so such streams are rejected as before. (Exactly 24 bits left, or
+// a byte straddling 24-32 bits at the end of the scan, depended on how full
+// that buffer happened to be; those are accepted.)
+
+// the marker that ends a restart interval, if the original reader saw it
+static int interval_marker(jpeg *j)
+{
+   if (j->code_bits < 24) grow_buffer_unsafe(j);
+   if (!j->nomore || j->code_bits - j->pad_bits > 24) return MARKER_none;
+   return j->marker;
+}
+
+// at the end of the scan, the bytes the original reader had not buffered yet
+// must be zero (decode_jpeg_image skips those and fails on anything else)
+static int scan_tail_clean(jpeg *j)
+{
+   int left = j->code_bits - j->pad_bits;
+   int rest = left > 24 ? 8 * ((left - 25) / 8) : 0;   // whole bytes past 32 bits
+   if (rest <= 0) return 1;
+   return ((j->code_buffer << (left - rest)) >> (64 - rest)) == 0;
+}
+
+// number of MCUs in the current scan: blocks of the component for a
+// non-interleaved scan, interleaved MCUs otherwise
+static int scan_mcu_count(jpeg *z)
 {
-   reset(z);
    if (z->scan_n == 1) {
-      int i,j;
-      #ifdef STBI_SIMD
-      __declspec(align(16))
-      #endif
-      short data[64];
+      int n = z->order[0];
+      return ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3);
+   }
+   return z->img_mcu_x * z->img_mcu_y;
+}
+
+// decode MCUs [first, first+count) of the current scan and IDCT them into
+// the component buffers; restart markers are handled by the caller
+static int decode_mcu_range(jpeg *z, int first, int count)
+{
+   int m;
+   if (z->scan_n == 1) {
+      STBI_SIMD_ALIGN(short, data[64]);
       int n = z->order[0];
       // non-interleaved data, we just need to process one block at a time,
       // in trivial scanline order
       // number of blocks to do just depends on how many actual "pixels" this
       // component has, independent of interleaved MCU blocking and such
       int w = (z->img_comp[n].x+7) >> 3;
-      int h = (z->img_comp[n].y+7) >> 3;
-      for (j=0; j < h; ++j) {
-         for (i=0; i < w; ++i) {
-            if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, n)) return 0;
-            #ifdef STBI_SIMD
-            stbi_idct_installed(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
-            #else
-            idct_block(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
-            #endif
-            // every data block is an MCU, so countdown the restart interval
-            if (--z->todo <= 0) {
-               if (z->code_bits < 24) grow_buffer_unsafe(z);
-               // if it's NOT a restart, then just bail, so we get corrupt data
-               // rather than no data
-               if (!RESTART(z->marker)) return 1;
-               reset(z);
-            }
-         }
+      for (m=first; m < first+count; ++m) {
+         int i = m % w, j = m / w;
+         if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, z->fast_ac[z->img_comp[n].ha], n)) return 0;
+         #ifdef STBI_SIMD
+         stbi_idct_installed(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
+         #else
+         idct_block(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
+         #endif
       }
    } else { // interleaved!
-      int i,j,k,x,y;
-      short data[64];
-      for (j=0; j < z->img_mcu_y; ++j) {
-         for (i=0; i < z->img_mcu_x; ++i) {
-            // scan an interleaved mcu... process scan_n components in order
-            for (k=0; k < z->scan_n; ++k) {
-               int n = z->order[k];
-               // scan out an mcu's worth of this component; that's just determined
-               // by the basic H and V specified for the component
-               for (y=0; y < z->img_comp[n].v; ++y) {
-                  for (x=0; x < z->img_comp[n].h; ++x) {
-                     int x2 = (i*z->img_comp[n].h + x)*8;
-                     int y2 = (j*z->img_comp[n].v + y)*8;
-                     if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, n)) return 0;
-                     #ifdef STBI_SIMD
-                     stbi_idct_installed(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
-                     #else
-                     idct_block(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
-                     #endif
-                  }
+      int k,x,y;
+      STBI_SIMD_ALIGN(short, data[64]);
+      for (m=first; m < first+count; ++m) {
+         int i = m % z->img_mcu_x, j = m / z->img_mcu_x;
+         // scan an interleaved mcu... process scan_n components in order
+         for (k=0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            // scan out an mcu's worth of this component; that's just determined
+            // by the basic H and V specified for the component
+            for (y=0; y < z->img_comp[n].v; ++y) {
+               for (x=0; x < z->img_comp[n].h; ++x) {
+                  int x2 = (i*z->img_comp[n].h + x)*8;
+                  int y2 = (j*z->img_comp[n].v + y)*8;
+                  if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, z->fast_ac[z->img_comp[n].ha], n)) return 0;
+                  #ifdef STBI_SIMD
+                  stbi_idct_installed(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
+                  #else
+                  idct_block(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
+                  #endif
                }
             }
-            // after all interleaved components, that's an interleaved MCU,
-            // so now count down the restart interval
-            if (--z->todo <= 0) {
-               if (z->code_bits < 24) grow_buffer_unsafe(z);
-               // if it's NOT a restart, then just bail, so we get corrupt data
-               // rather than no data
-               if (!RESTART(z->marker)) return 1;
-               reset(z);
-            }
          }
       }
    }
    return 1;
 }
 
+// decode the scan from z->s one restart interval at a time
+static int parse_entropy_serial(jpeg *z)
+{
+   int total = scan_mcu_count(z), m = 0;
+   reset(z);
+   while (m < total) {
+      int count = total - m < z->todo ? total - m : z->todo;
+      if (!decode_mcu_range(z, m, count)) return 0;
+      m += count;
+      // count down the restart interval (every data block is an MCU in a
+      // non-interleaved scan)
+      z->todo -= count;
+      if (z->todo <= 0) {
+         // if it's NOT a restart, then just bail, so we get corrupt data
+         // rather than no data
+         if (!RESTART(interval_marker(z))) return scan_tail_clean(z);
+         reset(z);
+      }
+   }
+   return scan_tail_clean(z);
+}
+
+static int stbi_jpeg_parallel = 1;
+
+void stbi_jpeg_set_parallel(int flag_true_if_should_decode_in_parallel)
+{
+   stbi_jpeg_parallel = flag_true_if_should_decode_in_parallel;
+}
+
+// images smaller than this are decoded on the calling thread only
+#define PARALLEL_MIN_PIXELS  (1 << 18)
+
+static int use_thread_pool(jpeg *z)
+{
+   return stbi_jpeg_parallel && z->s->img_x * z->s->img_y >= PARALLEL_MIN_PIXELS && ThreadPool::shared().size() > 1;
+}
+
+// the bytes of one entropy-coded segment and where its restart intervals
+// start, found by looking for RSTn markers (each interval is self-contained:
+// the bit reader and the DC predictions restart at every RSTn)
+typedef struct
+{
+   stbi *s;
+   uint8 *data;       // segment bytes; points into the source for memory input
+   uint8 *owned;      // copy of the segment for callback input
+   int len, cap;      // bytes gathered so far (terminating marker included)
+   int scanned;       // bytes already searched for markers
+   int *start;        // offset of each restart interval
+   int count, max;
+   uint8 marker;      // marker that ended the segment
+} stbi_segment;
+
+static int segment_add_interval(stbi_segment *g, int offset)
+{
+   if (g->count == g->max) {
+      int *p = (int *) scratch_alloc(g->s, SCRATCH_JPEG_RESTARTS, g->start, sizeof(int) * (g->max ? g->max * 2 : 64));
+      if (!p) return 0;
+      g->start = p;
+      g->max = g->max ? g->max * 2 : 64;
+   }
+   g->start[g->count++] = offset;
+   return 1;
+}
+
+// search data[scanned, len) for RSTn and for the marker that ends the
+// segment (0xff not followed by a stuffed 0x00 or an RSTn; 0xff fill bytes
+// before a marker are skipped). 1 if the end was found, in which case len is
+// cut just after it; 0 if more bytes are needed; -1 out of memory
+static int segment_scan(stbi_segment *g)
+{
+   int i = g->scanned;
+   while (i < g->len) {
+      uint8 *p = (uint8 *) memchr(g->data + i, 0xff, g->len - i);
+      int k;
+      if (!p) { i = g->len; break; }
+      k = (int) (p - g->data) + 1;
+      while (k < g->len && g->data[k] == 0xff) ++k;
+      if (k == g->len) { i = (int) (p - g->data); break; } // marker split across reads
+      if (g->data[k] == 0x00) { i = k+1; continue; }
+      if (RESTART(g->data[k])) {
+         if (!segment_add_interval(g, k+1)) return -1;
+         i = k+1;
+         continue;
+      }
+      g->marker = g->data[k];
+      g->len = g->scanned = k+1;
+      return 1;
+   }
+   g->scanned = i;
+   return 0;
+}
+
+// gather the rest of the scan from z->s. Memory input is searched in place
+// and not consumed; callback input is copied and consumed up to the
+// terminating marker (or the end of the stream). 1 if the terminating
+// marker was found, 0 if not, -1 out of memory
+static int segment_gather(jpeg *z, stbi_segment *g)
+{
+   stbi *s = z->s;
+   int r;
+   memset(g, 0, sizeof(*g));
+   g->s = s;
+   g->marker = MARKER_none;
+   if (!segment_add_interval(g, 0)) return -1;
+   if (!s->read_from_callbacks) {
+      g->data = s->img_buffer;
+      g->len = (int) (s->img_buffer_end - s->img_buffer);
+      return segment_scan(g);
+   }
+   for (;;) {
+      int n = (int) (s->img_buffer_end - s->img_buffer), before = g->len;
+      if (g->len + n > g->cap) {
+         int cap = g->cap ? g->cap * 2 : 1 << 16;
+         uint8 *p;
+         while (cap < g->len + n) cap *= 2;
+         p = (uint8 *) scratch_alloc(s, SCRATCH_JPEG_SEGMENT, g->owned, cap);
+         if (!p) return -1;
+         g->owned = g->data = p;
+         g->cap = cap;
+      }
+      memcpy(g->data + g->len, s->img_buffer, n);
+      g->len += n;
+      r = segment_scan(g);
+      if (r != 0) {
+         // give back what was read past the terminating marker
+         if (r > 0) s->img_buffer += g->len - before;
+         return r;
+      }
+      s->img_buffer = s->img_buffer_end;
+      if (!s->read_from_callbacks) return 0; // end of stream
+      refill_buffer(s);
+      if (!s->read_from_callbacks) return 0;
+   }
+}
+
+// leave the stream where the decoder stopped reading the segment, offset pos
+// (usually its end). Callback input can only step back within its read
+// buffer; further back, which only happens with corrupt data, the bytes
+// decode_jpeg_image would look at next are taken from the copy instead: 0 if
+// they are not the zeros it skips before a marker
+static int segment_seek(jpeg *z, stbi_segment *g, int pos)
+{
+   stbi *s = z->s;
+   if (!g->owned) {
+      s->img_buffer = g->data + pos;
+      return 1;
+   }
+   while (z->marker == MARKER_none && g->len - pos > s->img_buffer - s->img_buffer_original) {
+      int x = g->data[pos++];
+      if (x == 255)
+         z->marker = pos < g->len ? g->data[pos++] : get8u(s);
+      else if (x != 0)
+         return 0;
+   }
+   if (g->len - pos <= s->img_buffer - s->img_buffer_original)
+      s->img_buffer -= g->len - pos;
+   return 1;
+}
+
+// decode the restart intervals of the scan on the shared thread pool. Each
+// task takes a run of consecutive intervals and decodes them (entropy
+// decoding and IDCT) with its own copy of the decoder reading the interval's
+// bytes, RSTn included; blocks land in disjoint parts of the component
+// buffers. Returns -1, with memory input untouched, when the serial decoder
+// should run instead: no restart markers, a small image, RSTn markers that
+// don't match the interval count, or an interval the serial decoder would
+// have failed or stopped at (so corrupt data behaves exactly as before)
+static int parse_entropy_parallel(jpeg *z)
+{
+   stbi_segment g;
+   int result, clean, end_pos = 0, t;
+   // what the tasks share, captured by one reference so std::function
+   // doesn't allocate
+   struct {
+      jpeg *z;
+      stbi_segment *g;
+      char *stopped;
+      int total, intervals, tasks, end_pos;
+      unsigned char end_marker;
+   } job;
+   if (!z->restart_interval || !use_thread_pool(z)) return -1;
+   job.total = scan_mcu_count(z);
+   job.intervals = (job.total + z->restart_interval-1) / z->restart_interval;
+   if (job.intervals < 2) return -1;
+
+   result = segment_gather(z, &g);
+   if (result < 0) {
+      scratch_free(z->s, g.start); scratch_free(z->s, g.owned);
+      return e("outofmem", "Out of memory");
+   }
+
+   clean = result > 0 && g.count == job.intervals;
+   if (clean) {
+      job.tasks = (int) ThreadPool::shared().size() * 4;
+      if (job.tasks > job.intervals) job.tasks = job.intervals;
+      job.stopped = (char *) scratch_alloc(z->s, SCRATCH_JPEG_TASKS, NULL, job.tasks);
+      if (job.stopped == NULL) {
+         scratch_free(z->s, g.start); scratch_free(z->s, g.owned);
+         return e("outofmem", "Out of memory");
+      }
+      memset(job.stopped, 0, job.tasks);
+      job.z = z;
+      job.g = &g;
+      job.end_pos = 0;
+      job.end_marker = MARKER_none;
+      ThreadPool::shared().parallelFor(job.tasks, [&job](size_t task) {
+         jpeg *z = job.z;
+         stbi_segment *g = job.g;
+         int intervals = job.intervals, tasks = job.tasks;
+         jpeg local = *z;
+         stbi src;
+         int r;
+         for (r = (int) (task * intervals / tasks); r < (int) ((task+1) * intervals / tasks); ++r) {
+            int first = r * z->restart_interval;
+            int count = job.total - first < z->restart_interval ? job.total - first : z->restart_interval;
+            int end = r+1 < intervals ? g->start[r+1] : g->len;
+            start_mem(&src, g->data + g->start[r], end - g->start[r]);
+            local.s = &src;
+            reset(&local);
+            if (!decode_mcu_range(&local, first, count)) { job.stopped[task] = 1; return; }
+            // same end-of-interval check as parse_entropy_serial
+            if (count == z->restart_interval) {
+               if (!RESTART(interval_marker(&local)) && r+1 < intervals) { job.stopped[task] = 1; return; }
+            }
+            if (r+1 == intervals) {
+               if (!scan_tail_clean(&local)) { job.stopped[task] = 1; return; }
+               job.end_marker = local.marker;
+               job.end_pos = (int) (src.img_buffer - g->data);
+            }
+         }
+      });
+      for (t=0; t < job.tasks; ++t)
+         clean = clean && !job.stopped[t];
+      scratch_free(z->s, job.stopped);
+      end_pos = job.end_pos;
+   }
+
+   if (clean) {
+      result = 1;
+      z->marker = job.end_marker;
+   } else if (!g.owned) {
+      result = -1;
+   } else {
+      // callback input was consumed: decode the copy serially
+      stbi *s = z->s, copy;
+      start_mem(&copy, g.data, g.len);
+      z->s = &copy;
+      result = parse_entropy_serial(z);
+      z->s = s;
+      end_pos = (int) (copy.img_buffer - g.data);
+   }
+   if (result > 0) result = segment_seek(z, &g, end_pos);
+   scratch_free(z->s, g.start); scratch_free(z->s, g.owned);
+   return result;
+}
+
+static int parse_entropy_coded_data(jpeg *z)
+{
+   int result = parse_entropy_parallel(z);
+   return result >= 0 ? result : parse_entropy_serial(z);
+}
+
 static int process_marker(jpeg *z, int m)
 {
    int L;
@@ -1140,6 +1635,7 @@ static int process_marker(jpeg *z, int m)
                m += sizes[i];
             }
             L -= 17;
+            if (m > 256) return e("bad DHT header","Corrupt JPEG");
             if (tc == 0) {
                if (!build_huffman(z->huff_dc+th, sizes)) return 0;
                v = z->huff_dc[th].values;
@@ -1149,6 +1645,8 @@ static int process_marker(jpeg *z, int m)
             }
             for (i=0; i < m; ++i)
                v[i] = get8u(z->s);
+            if (tc == 1)
+               build_fast_ac(z->fast_ac[th], z->huff_ac + th);
             L -= m;
          }
          return L==0;
@@ -1243,10 +1741,10 @@ static int process_frame_header(jpeg *z, int scan)
       // discard the extra data until colorspace conversion
       z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
       z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
-      z->img_comp[i].raw_data = malloc(z->img_comp[i].w2 * z->img_comp[i].h2+15);
+      z->img_comp[i].raw_data = scratch_alloc(s, SCRATCH_JPEG_COMP + i, NULL, z->img_comp[i].w2 * z->img_comp[i].h2+15);
       if (z->img_comp[i].raw_data == NULL) {
          for(--i; i >= 0; --i) {
-            free(z->img_comp[i].raw_data);
+            scratch_free(s, z->img_comp[i].raw_data);
             z->img_comp[i].data = NULL;
          }
          return e("outofmem", "Out of memory");
@@ -1323,8 +1821,6 @@ static int decode_jpeg_image(jpeg *j)
 typedef uint8 *(*resample_row_func)(uint8 *out, uint8 *in0, uint8 *in1,
                                     int w, int hs);
 
-#define div4(x) ((uint8) ((x) >> 2))
-
 static uint8 *resample_row_1(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
 {
    STBI_NOTUSED(out);
@@ -1334,67 +1830,29 @@ static uint8 *resample_row_1(uint8 *out, uint8 *in_near, uint8 *in_far, int w, i
    return in_near;
 }
 
+// the interpolating upsamplers run the SSE2/AVX2 spans from JpegKernels.h
+// (same bytes as the original per-pixel loops, borders included)
 static uint8* resample_row_v_2(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
 {
    // need to generate two samples vertically for every one in input
-   int i;
    STBI_NOTUSED(hs);
-   for (i=0; i < w; ++i)
-      out[i] = div4(3*in_near[i] + in_far[i] + 2);
+   jpegKernels().upsampleV2(out, in_near, in_far, w, 0, w);
    return out;
 }
 
 static uint8*  resample_row_h_2(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
 {
    // need to generate two samples horizontally for every one in input
-   int i;
-   uint8 *input = in_near;
-
-   if (w == 1) {
-      // if only one sample, can't do any interpolation
-      out[0] = out[1] = input[0];
-      return out;
-   }
-
-   out[0] = input[0];
-   out[1] = div4(input[0]*3 + input[1] + 2);
-   for (i=1; i < w-1; ++i) {
-      int n = 3*input[i]+2;
-      out[i*2+0] = div4(n+input[i-1]);
-      out[i*2+1] = div4(n+input[i+1]);
-   }
-   out[i*2+0] = div4(input[w-2]*3 + input[w-1] + 2);
-   out[i*2+1] = input[w-1];
-
-   STBI_NOTUSED(in_far);
    STBI_NOTUSED(hs);
-
+   jpegKernels().upsampleH2(out, in_near, in_far, w, 0, w);
    return out;
 }
 
-#define div16(x) ((uint8) ((x) >> 4))
-
 static uint8 *resample_row_hv_2(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
 {
    // need to generate 2x2 samples for every one in input
-   int i,t0,t1;
-   if (w == 1) {
-      out[0] = out[1] = div4(3*in_near[0] + in_far[0] + 2);
-      return out;
-   }
-
-   t1 = 3*in_near[0] + in_far[0];
-   out[0] = div4(t1+2);
-   for (i=1; i < w; ++i) {
-      t0 = t1;
-      t1 = 3*in_near[i]+in_far[i];
-      out[i*2-1] = div16(3*t0 + t1 + 8);
-      out[i*2  ] = div16(3*t1 + t0 + 8);
-   }
-   out[w*2-1] = div4(t1+2);
-
    STBI_NOTUSED(hs);
-
+   jpegKernels().upsampleHV2(out, in_near, in_far, w, 0, w);
    return out;
 }
 
@@ -1409,38 +1867,11 @@ static uint8 *resample_row_generic(uint8 *out, uint8 *in_near, uint8 *in_far, in
    return out;
 }
 
-#define float2fixed(x)  ((int) ((x) * 65536 + 0.5))
-
-// 0.38 seconds on 3*anemones.jpg   (0.25 with processor = Pro)
-// VC6 without processor=Pro is generating multiple LEAs per multiply!
-static void YCbCr_to_RGB_row(uint8 *out, const uint8 *y, const uint8 *pcb, const uint8 *pcr, int count, int step)
-{
-   int i;
-   for (i=0; i < count; ++i) {
-      int y_fixed = (y[i] << 16) + 32768; // rounding
-      int r,g,b;
-      int cr = pcr[i] - 128;
-      int cb = pcb[i] - 128;
-      r = y_fixed + cr*float2fixed(1.40200f);
-      g = y_fixed - cr*float2fixed(0.71414f) - cb*float2fixed(0.34414f);
-      b = y_fixed                            + cb*float2fixed(1.77200f);
-      r >>= 16;
-      g >>= 16;
-      b >>= 16;
-      if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
-      if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
-      if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
-      out[0] = (uint8)r;
-      out[1] = (uint8)g;
-      out[2] = (uint8)b;
-      out[3] = 255;
-      out += step;
-   }
-}
+// BT.601 in Q14 fixed point at the CPU's SIMD level (ColorConvert.h through
+// JpegKernels.h); out[3] = 255 is written only when step == 4
+static YCbCrRowKernel stbi_YCbCr_installed = jpegKernels().ycbcrToRgb;
 
 #ifdef STBI_SIMD
-static stbi_YCbCr_to_RGB_run stbi_YCbCr_installed = YCbCr_to_RGB_row;
-
 void stbi_install_YCbCr_to_RGB(stbi_YCbCr_to_RGB_run func)
 {
    stbi_YCbCr_installed = func;
@@ -1454,11 +1885,11 @@ static void cleanup_jpeg(jpeg *j)
    int i;
    for (i=0; i < j->s->img_n; ++i) {
       if (j->img_comp[i].data) {
-         free(j->img_comp[i].raw_data);
+         scratch_free(j->s, j->img_comp[i].raw_data);
          j->img_comp[i].data = NULL;
       }
       if (j->img_comp[i].linebuf) {
-         free(j->img_comp[i].linebuf);
+         scratch_free(j->s, j->img_comp[i].linebuf);
          j->img_comp[i].linebuf = NULL;
       }
    }
@@ -1467,6 +1898,7 @@ static void cleanup_jpeg(jpeg *j)
 typedef struct
 {
    resample_row_func resample;
+   UpsampleSpan span; // same as resample over part of a row; NULL if hs, vs > 2
    uint8 *line0,*line1;
    int hs,vs;   // expansion factor in each axis
    int w_lores; // horizontal pixels pre-expansion 
@@ -1474,6 +1906,99 @@ typedef struct
    int ypos;    // which pre-expansion row we're on
 } stbi_resample;
 
+// output pixels per span of the fused path: the upsampled Cb and Cr of a span
+// (2 * 512 bytes) are converted while still in L1, instead of upsampling the
+// whole row of each component first
+#define FUSED_SPAN 512
+
+// upsample the chroma of one output row span by span and convert each span;
+// near/far are the chroma rows the upsamplers would have been given
+static void resample_convert_row(uint8 *out, uint8 *y, stbi_resample *chroma, uint8 *near[2], uint8 *far[2], int width, int step)
+{
+   uint8 buffer[2][FUSED_SPAN];
+   int x,k;
+   for (x=0; x < width; x += FUSED_SPAN) {
+      int m = width - x < FUSED_SPAN ? width - x : FUSED_SPAN;
+      uint8 *c[2];
+      for (k=0; k < 2; ++k) {
+         stbi_resample *r = &chroma[k];
+         if (r->span) {
+            int begin = x / r->hs;
+            int end = (x + m + r->hs-1) / r->hs;
+            if (end > r->w_lores) end = r->w_lores;
+            r->span(buffer[k], near[k], far[k], r->w_lores, begin, end);
+            c[k] = buffer[k];
+         } else
+            c[k] = near[k] + x;
+      }
+      stbi_YCbCr_installed(out + x * step, y + x, c[0], c[1], m, step);
+   }
+}
+
+// resample and color-convert output rows [j0, j1) (stride bytes apart) using
+// the line buffers linebuf[k]. The resamplers in res are at row 0; a copy is
+// stepped down to j0 first, so bands of rows can be converted independently
+static void resample_rows(jpeg *z, stbi_resample *res, uint8 *linebuf[4], uint8 *output, int stride, int n, int decode_n, int fused, uint j0, uint j1)
+{
+   stbi_resample res_comp[4];
+   uint8 *coutput[4];
+   uint8 *near[4], *far[4];
+   uint i,j;
+   int k;
+
+   for (k=0; k < decode_n; ++k) {
+      stbi_resample *r = &res_comp[k];
+      *r = res[k];
+      for (j=0; j < j0; ++j) {
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+   }
+
+   for (j=j0; j < j1; ++j) {
+      uint8 *out = output + (size_t) stride * j;
+      for (k=0; k < decode_n; ++k) {
+         stbi_resample *r = &res_comp[k];
+         int y_bot = r->ystep >= (r->vs >> 1);
+         near[k] = y_bot ? r->line1 : r->line0;
+         far[k]  = y_bot ? r->line0 : r->line1;
+         if (!fused || k == 0)
+            coutput[k] = r->resample(linebuf[k], near[k], far[k], r->w_lores, r->hs);
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+      if (fused) {
+         resample_convert_row(out, coutput[0], &res_comp[1], near + 1, far + 1, z->s->img_x, n);
+      } else if (n >= 3) {
+         uint8 *y = coutput[0];
+         if (z->s->img_n == 3) {
+            stbi_YCbCr_installed(out, y, coutput[1], coutput[2], z->s->img_x, n);
+         } else
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               // only when n==4: with n==3 it would land on the next pixel,
+               // which may belong to another band
+               if (n == 4) out[3] = 255;
+               out += n;
+            }
+      } else {
+         uint8 *y = coutput[0];
+         if (n == 1)
+            for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
+         else
+            for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
+      }
+   }
+}
+
 static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
    int n, decode_n;
@@ -1495,18 +2020,25 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int re
    // resample and color-convert
    {
       int k;
-      uint i,j;
       uint8 *output;
-      uint8 *coutput[4];
+      int stride, fused;
 
       stbi_resample res_comp[4];
 
+      // converted in bands of whole MCU rows, one per thread of the pool (a
+      // single band on the calling thread for small images), each with its
+      // own line buffers
+      int rows = z->img_v_max * 8;
+      int mcu_rows = (z->s->img_y + rows-1) / rows;
+      int bands = use_thread_pool(z) ? (int) ThreadPool::shared().size() : 1;
+      if (bands > mcu_rows) bands = mcu_rows;
+
       for (k=0; k < decode_n; ++k) {
          stbi_resample *r = &res_comp[k];
 
          // allocate line buffer big enough for upsampling off the edges
          // with upsample factor of 4
-         z->img_comp[k].linebuf = (uint8 *) malloc(z->s->img_x + 3);
+         z->img_comp[k].linebuf = (uint8 *) scratch_alloc(z->s, SCRATCH_JPEG_LINEBUF + k, NULL, (z->s->img_x + 3) * bands);
          if (!z->img_comp[k].linebuf) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
 
          r->hs      = z->img_h_max / z->img_comp[k].h;
@@ -1521,51 +2053,48 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int re
          else if (r->hs == 2 && r->vs == 1) r->resample = resample_row_h_2;
          else if (r->hs == 2 && r->vs == 2) r->resample = resample_row_hv_2;
          else                               r->resample = resample_row_generic;
+
+         if      (r->resample == resample_row_v_2)  r->span = jpegKernels().upsampleV2;
+         else if (r->resample == resample_row_h_2)  r->span = jpegKernels().upsampleH2;
+         else if (r->resample == resample_row_hv_2) r->span = jpegKernels().upsampleHV2;
+         else                                       r->span = NULL;
       }
 
+      // YCbCr with full-resolution luma and chroma at most halved: upsample
+      // and convert the chroma together (resample_convert_row)
+      fused = n >= 3 && z->s->img_n == 3 && res_comp[0].resample == resample_row_1;
+      for (k=1; k < decode_n && fused; ++k)
+         fused = res_comp[k].span || res_comp[k].resample == resample_row_1;
+
       // can't error after this so, this is safe
-      output = (uint8 *) malloc(n * z->s->img_x * z->s->img_y + 1);
-      if (!output) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
-
-      // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         uint8 *out = output + n * z->s->img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi_resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            uint8 *y = coutput[0];
-            if (z->s->img_n == 3) {
-               #ifdef STBI_SIMD
-               stbi_YCbCr_installed(out, y, coutput[1], coutput[2], z->s.img_x, n);
-               #else
-               YCbCr_to_RGB_row(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               #endif
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            uint8 *y = coutput[0];
-            if (n == 1)
-               for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-            else
-               for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
-         }
+      if (z->s->out) {
+         // stbi_load_into: straight into the caller's rows
+         output = out_rows(z->s, z->s->img_x, z->s->img_y, n, &stride);
+         if (!output) { cleanup_jpeg(z); return NULL; }
+      } else {
+         stride = n * z->s->img_x;
+         output = (uint8 *) malloc(n * z->s->img_x * z->s->img_y + 1);
+         if (!output) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
       }
+
+      // now go ahead and resample. The task only captures one reference, so
+      // std::function keeps it inline instead of allocating
+      struct {
+         jpeg *z;
+         stbi_resample *res;
+         uint8 *output;
+         int stride, n, decode_n, fused, rows, mcu_rows, bands;
+      } job = { z, res_comp, output, stride, n, decode_n, fused, rows, mcu_rows, bands };
+      ThreadPool::shared().parallelFor(bands, [&job](size_t band) {
+         jpeg *z = job.z;
+         uint8 *linebuf[4];
+         uint j0 = (uint) (band * job.mcu_rows / job.bands) * job.rows;
+         uint j1 = (uint) ((band+1) * job.mcu_rows / job.bands) * job.rows;
+         int c;
+         if (j1 > z->s->img_y) j1 = z->s->img_y;
+         for (c=0; c < job.decode_n; ++c) linebuf[c] = z->img_comp[c].linebuf + (z->s->img_x + 3) * band;
+         resample_rows(z, job.res, linebuf, job.output, job.stride, job.n, job.decode_n, job.fused, j0, j1);
+      });
       cleanup_jpeg(z);
       *out_x = z->s->img_x;
       *out_y = z->s->img_y;
@@ -1615,22 +2144,38 @@ static int stbi_jpeg_info(stbi *s, int *x, int *y, int *comp)
 //      - all input must be provided in an upfront buffer
 //      - all output is written to a single output buffer (can malloc/realloc)
 //    performance
-//      - fast huffman
+//      - fast huffman: one table lookup gives the symbol together with its
+//        base length/distance and extra bit count
+//      - 64-bit bit buffer, refilled with one 8-byte load
+//      - matches are copied 8 bytes at a time
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
-#define ZFAST_BITS  9 // accelerate all cases in default tables
+#define ZFAST_BITS  10 // accelerate all cases in default tables, and most dynamic codes
 #define ZFAST_MASK  ((1 << ZFAST_BITS) - 1)
 
+// what a symbol decodes to, packed in one word:
+//    bits  0-3   code length
+//    bits  4-7   extra bits that follow the code (lengths and distances)
+//    bits  8-9   ZSYM_* kind
+//    bits 16-31  literal byte or code length symbol, or base length/distance
+enum { ZSYM_LITERAL, ZSYM_BASE, ZSYM_END, ZSYM_BAD };
+enum { ZTABLE_CODELENGTH, ZTABLE_LENGTH, ZTABLE_DISTANCE };
+
+#define ZENTRY(size,extra,kind,value)  ((uint32) (size) | (uint32) (extra) << 4 | (uint32) (kind) << 8 | (uint32) (value) << 16)
+#define ZENTRY_SIZE(t)   ((t) & 15)
+#define ZENTRY_EXTRA(t)  (((t) >> 4) & 15)
+#define ZENTRY_KIND(t)   (((t) >> 8) & 3)
+#define ZENTRY_VALUE(t)  ((int) ((t) >> 16))
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
 {
-   uint16 fast[1 << ZFAST_BITS];
+   uint32 fast[1 << ZFAST_BITS]; // entry, or 0 for codes longer than ZFAST_BITS
    uint16 firstcode[16];
    int maxcode[17];
    uint16 firstsymbol[16];
-   uint8  size[288];
-   uint16 value[288]; 
+   uint32 entry[288];
 } zhuffman;
 
 stbi_inline static int bitreverse16(int n)
@@ -1650,19 +2195,49 @@ stbi_inline static int bit_reverse(int v, int bits)
    return bitreverse16(v) >> (16-bits);
 }
 
-static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num)
+static int length_base[31] = {
+   3,4,5,6,7,8,9,10,11,13,
+   15,17,19,23,27,31,35,43,51,59,
+   67,83,99,115,131,163,195,227,258,0,0 };
+
+static int length_extra[31]=
+{ 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
+
+static int dist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,
+257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0};
+
+static int dist_extra[32] =
+{ 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+
+static uint32 zsymbol_entry(int table, int sym, int s)
+{
+   if (table == ZTABLE_LENGTH) {
+      if (sym < 256)  return ZENTRY(s, 0, ZSYM_LITERAL, sym);
+      if (sym == 256) return ZENTRY(s, 0, ZSYM_END, 0);
+      sym -= 257;
+      if (sym >= 29)  return ZENTRY(s, 0, ZSYM_BAD, 0); // 286 and 287 can't occur
+      return ZENTRY(s, length_extra[sym], ZSYM_BASE, length_base[sym]);
+   }
+   if (table == ZTABLE_DISTANCE) {
+      if (sym >= 30)  return ZENTRY(s, 0, ZSYM_BAD, 0); // 30 and 31 can't occur
+      return ZENTRY(s, dist_extra[sym], ZSYM_BASE, dist_base[sym]);
+   }
+   return ZENTRY(s, 0, ZSYM_LITERAL, sym);
+}
+
+static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num, int table)
 {
    int i,k=0;
    int code, next_code[16], sizes[17];
 
    // DEFLATE spec for generating codes
    memset(sizes, 0, sizeof(sizes));
-   memset(z->fast, 255, sizeof(z->fast));
-   for (i=0; i < num; ++i) 
+   memset(z->fast, 0, sizeof(z->fast));
+   for (i=0; i < num; ++i)
       ++sizes[sizelist[i]];
    sizes[0] = 0;
    for (i=1; i < 16; ++i)
-      assert(sizes[i] <= (1 << i));
+      if (sizes[i] > (1 << i)) return e("bad sizes","Corrupt PNG");
    code = 0;
    for (i=1; i < 16; ++i) {
       next_code[i] = code;
@@ -1680,12 +2255,11 @@ static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num)
       int s = sizelist[i];
       if (s) {
          int c = next_code[s] - z->firstcode[s] + z->firstsymbol[s];
-         z->size[c] = (uint8)s;
-         z->value[c] = (uint16)i;
+         z->entry[c] = zsymbol_entry(table, i, s);
          if (s <= ZFAST_BITS) {
             int k = bit_reverse(next_code[s],s);
             while (k < (1 << ZFAST_BITS)) {
-               z->fast[k] = (uint16) c;
+               z->fast[k] = z->entry[c];
                k += (1 << s);
             }
          }
@@ -1705,7 +2279,8 @@ typedef struct
 {
    uint8 *zbuffer, *zbuffer_end;
    int num_bits;
-   uint32 code_buffer;
+   int zpad;           // zero bytes fed in past zbuffer_end
+   uint64 code_buffer; // next bit in the lsb
 
    char *zout;
    char *zout_start;
@@ -1721,50 +2296,68 @@ stbi_inline static int zget8(zbuf *z)
    return *z->zbuffer++;
 }
 
+stbi_inline static uint64 zload64(const uint8 *p)
+{
+   return (uint64) p[0] | ((uint64) p[1] << 8) | ((uint64) p[2] << 16) | ((uint64) p[3] << 24) |
+          ((uint64) p[4] << 32) | ((uint64) p[5] << 40) | ((uint64) p[6] << 48) | ((uint64) p[7] << 56);
+}
+
+// fill the bit buffer to at least 56 bits. With 8 bytes of input left that is
+// one load: the whole bytes that fit are consumed, and the low bits of the
+// next byte land above num_bits, where the next refill ORs in the same bits.
+// Past the end of the input the stream reads as zeros
 static void fill_bits(zbuf *z)
 {
+   if (z->zbuffer_end - z->zbuffer >= 8) {
+      z->code_buffer |= zload64(z->zbuffer) << z->num_bits;
+      z->zbuffer += (63 - z->num_bits) >> 3;
+      z->num_bits |= 56;
+      return;
+   }
    do {
-      assert(z->code_buffer < (1U << z->num_bits));
-      z->code_buffer |= zget8(z) << z->num_bits;
+      if (z->zbuffer < z->zbuffer_end)
+         z->code_buffer |= (uint64) *z->zbuffer++ << z->num_bits;
+      else
+         ++z->zpad;
       z->num_bits += 8;
-   } while (z->num_bits <= 24);
+   } while (z->num_bits <= 56);
 }
 
 stbi_inline static unsigned int zreceive(zbuf *z, int n)
 {
    unsigned int k;
    if (z->num_bits < n) fill_bits(z);
-   k = z->code_buffer & ((1 << n) - 1);
+   k = (unsigned int) (z->code_buffer & ((1 << n) - 1));
    z->code_buffer >>= n;
    z->num_bits -= n;
-   return k;   
+   return k;
 }
 
-stbi_inline static int zhuffman_decode(zbuf *a, zhuffman *z)
+// not resolved by fast table, so compute it the slow way; needs 16 valid bits
+static uint32 zhuffman_slow(zhuffman *z, uint64 bits)
 {
    int b,s,k;
-   if (a->num_bits < 16) fill_bits(a);
-   b = z->fast[a->code_buffer & ZFAST_MASK];
-   if (b < 0xffff) {
-      s = z->size[b];
-      a->code_buffer >>= s;
-      a->num_bits -= s;
-      return z->value[b];
-   }
-
-   // not resolved by fast table, so compute it the slow way
    // use jpeg approach, which requires MSbits at top
-   k = bit_reverse(a->code_buffer, 16);
+   k = bit_reverse((int) (bits & 0xffff), 16);
    for (s=ZFAST_BITS+1; ; ++s)
       if (k < z->maxcode[s])
          break;
-   if (s == 16) return -1; // invalid code!
+   if (s == 16) return ZENTRY(0, 0, ZSYM_BAD, 0); // invalid code!
    // code size is s, so:
    b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
-   assert(z->size[b] == s);
-   a->code_buffer >>= s;
-   a->num_bits -= s;
-   return z->value[b];
+   assert(ZENTRY_SIZE(z->entry[b]) == (uint32) s);
+   return z->entry[b];
+}
+
+stbi_inline static uint32 zhuffman_decode(zbuf *a, zhuffman *z)
+{
+   uint32 t;
+   if (a->num_bits < 16) fill_bits(a);
+   t = z->fast[a->code_buffer & ZFAST_MASK];
+   if (!t) t = zhuffman_slow(z, a->code_buffer);
+   a->code_buffer >>= ZENTRY_SIZE(t);
+   a->num_bits -= ZENTRY_SIZE(t);
+   return t;
 }
 
 static int expand(zbuf *z, int n)  // need to make room for n bytes
@@ -1784,44 +2377,131 @@ static int expand(zbuf *z, int n)  // need to make room for n bytes
    return 1;
 }
 
-static int length_base[31] = {
-   3,4,5,6,7,8,9,10,11,13,
-   15,17,19,23,27,31,35,43,51,59,
-   67,83,99,115,131,163,195,227,258,0,0 };
-
-static int length_extra[31]= 
-{ 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
+// copy a match 8 bytes at a time, so it may write up to 7 bytes past out+len.
+// A match that overlaps itself (dist < len) repeats its last dist bytes;
+// short distances first widen that pattern to 8 bytes or more, so every word
+// read is already written
+static void zcopy_match(uint8 *out, int dist, int len)
+{
+   uint8 *end = out + len;
+   const uint8 *src = out - dist;
+   if (dist == 1) {
+      memset(out, src[0], len);
+      return;
+   }
+   if (dist < 8) {
+      uint8 *start = out;
+      int period = dist;
+      while (period < 8) period += dist;
+      for (; out < end && out - start < period; ++out)
+         *out = out[-dist];
+      src = out - period;
+   }
+   while (out < end) {
+      uint64 v;
+      memcpy(&v, src, 8);
+      memcpy(out, &v, 8);
+      out += 8;
+      src += 8;
+   }
+}
 
-static int dist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,
-257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0};
+// room the fast loop keeps in the output: the longest match plus the slack
+// zcopy_match writes past it
+#define ZFAST_OUT_SLACK  (258 + 8)
+
+// the bulk of a huffman block. It runs while 8 bytes of input are left and
+// the output has ZFAST_OUT_SLACK bytes of room, so a refill is one load and
+// nothing is bounds-checked per byte; state lives in locals, since the
+// output writes could alias the zbuf. Returns 1 at the end of the block, 0
+// on error and -1 near either end, where parse_huffman_block takes over
+static int inflate_fast(zbuf *a)
+{
+   uint8 *in = a->zbuffer, *in_end = a->zbuffer_end;
+   uint8 *out = (uint8 *) a->zout, *out_start = (uint8 *) a->zout_start, *out_end = (uint8 *) a->zout_end;
+   uint64 bits = a->code_buffer;
+   int num_bits = a->num_bits;
+   zhuffman *zlength = &a->z_length, *zdistance = &a->z_distance;
+   int result = -1;
+
+   while (in_end - in >= 8 && out_end - out >= ZFAST_OUT_SLACK) {
+      uint32 t;
+      int len, dist;
+      // a length/distance pair takes at most 15+5+15+13 = 48 bits
+      if (num_bits < 48) {
+         bits |= zload64(in) << num_bits;
+         in += (63 - num_bits) >> 3;
+         num_bits |= 56;
+      }
+      t = zlength->fast[bits & ZFAST_MASK];
+      if (!t) t = zhuffman_slow(zlength, bits);
+      bits >>= ZENTRY_SIZE(t);
+      num_bits -= ZENTRY_SIZE(t);
+      if (ZENTRY_KIND(t) == ZSYM_LITERAL) {
+         *out++ = (uint8) ZENTRY_VALUE(t);
+         continue;
+      }
+      if (ZENTRY_KIND(t) != ZSYM_BASE) {
+         result = ZENTRY_KIND(t) == ZSYM_END ? 1 : e("bad huffman code","Corrupt PNG");
+         break;
+      }
+      len = ZENTRY_VALUE(t) + (int) (bits & ((1 << ZENTRY_EXTRA(t)) - 1));
+      bits >>= ZENTRY_EXTRA(t);
+      num_bits -= ZENTRY_EXTRA(t);
+
+      t = zdistance->fast[bits & ZFAST_MASK];
+      if (!t) t = zhuffman_slow(zdistance, bits);
+      if (ZENTRY_KIND(t) != ZSYM_BASE) {
+         result = e("bad huffman code","Corrupt PNG");
+         break;
+      }
+      bits >>= ZENTRY_SIZE(t);
+      num_bits -= ZENTRY_SIZE(t);
+      dist = ZENTRY_VALUE(t) + (int) (bits & ((1 << ZENTRY_EXTRA(t)) - 1));
+      bits >>= ZENTRY_EXTRA(t);
+      num_bits -= ZENTRY_EXTRA(t);
+      if (out - out_start < dist) {
+         result = e("bad dist","Corrupt PNG");
+         break;
+      }
+      zcopy_match(out, dist, len);
+      out += len;
+   }
 
-static int dist_extra[32] =
-{ 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+   a->zbuffer = in;
+   a->code_buffer = bits;
+   a->num_bits = num_bits;
+   a->zout = (char *) out;
+   return result;
+}
 
 static int parse_huffman_block(zbuf *a)
 {
    for(;;) {
-      int z = zhuffman_decode(a, &a->z_length);
-      if (z < 256) {
-         if (z < 0) return e("bad huffman code","Corrupt PNG"); // error in huffman codes
+      uint32 t;
+      int r = inflate_fast(a);
+      if (r >= 0) return r;
+      // one symbol at a time near the end of the input or of the output
+      t = zhuffman_decode(a, &a->z_length);
+      if (ZENTRY_KIND(t) == ZSYM_LITERAL) {
          if (a->zout >= a->zout_end) if (!expand(a, 1)) return 0;
-         *a->zout++ = (char) z;
-      } else {
+         *a->zout++ = (char) ZENTRY_VALUE(t);
+      } else if (ZENTRY_KIND(t) == ZSYM_BASE) {
          uint8 *p;
          int len,dist;
-         if (z == 256) return 1;
-         z -= 257;
-         len = length_base[z];
-         if (length_extra[z]) len += zreceive(a, length_extra[z]);
-         z = zhuffman_decode(a, &a->z_distance);
-         if (z < 0) return e("bad huffman code","Corrupt PNG");
-         dist = dist_base[z];
-         if (dist_extra[z]) dist += zreceive(a, dist_extra[z]);
+         len = ZENTRY_VALUE(t) + zreceive(a, ZENTRY_EXTRA(t));
+         t = zhuffman_decode(a, &a->z_distance);
+         if (ZENTRY_KIND(t) != ZSYM_BASE) return e("bad huffman code","Corrupt PNG");
+         dist = ZENTRY_VALUE(t) + zreceive(a, ZENTRY_EXTRA(t));
          if (a->zout - a->zout_start < dist) return e("bad dist","Corrupt PNG");
          if (a->zout + len > a->zout_end) if (!expand(a, len)) return 0;
          p = (uint8 *) (a->zout - dist);
          while (len--)
             *a->zout++ = *p++;
+      } else if (ZENTRY_KIND(t) == ZSYM_END) {
+         return 1;
+      } else {
+         return e("bad huffman code","Corrupt PNG"); // error in huffman codes
       }
    }
 }
@@ -1843,16 +2523,18 @@ static int compute_huffman_codes(zbuf *a)
       int s = zreceive(a,3);
       codelength_sizes[length_dezigzag[i]] = (uint8) s;
    }
-   if (!zbuild_huffman(&z_codelength, codelength_sizes, 19)) return 0;
+   if (!zbuild_huffman(&z_codelength, codelength_sizes, 19, ZTABLE_CODELENGTH)) return 0;
 
    n = 0;
    while (n < hlit + hdist) {
-      int c = zhuffman_decode(a, &z_codelength);
-      assert(c >= 0 && c < 19);
+      uint32 t = zhuffman_decode(a, &z_codelength);
+      int c = ZENTRY_VALUE(t);
+      if (ZENTRY_KIND(t) == ZSYM_BAD) return e("bad codelengths","Corrupt PNG");
       if (c < 16)
          lencodes[n++] = (uint8) c;
       else if (c == 16) {
          c = zreceive(a,2)+3;
+         if (n == 0) return e("bad codelengths","Corrupt PNG"); // nothing to repeat
          memset(lencodes+n, lencodes[n-1], c);
          n += c;
       } else if (c == 17) {
@@ -1867,8 +2549,8 @@ static int compute_huffman_codes(zbuf *a)
       }
    }
    if (n != hlit+hdist) return e("bad codelengths","Corrupt PNG");
-   if (!zbuild_huffman(&a->z_length, lencodes, hlit)) return 0;
-   if (!zbuild_huffman(&a->z_distance, lencodes+hlit, hdist)) return 0;
+   if (!zbuild_huffman(&a->z_length, lencodes, hlit, ZTABLE_LENGTH)) return 0;
+   if (!zbuild_huffman(&a->z_distance, lencodes+hlit, hdist, ZTABLE_DISTANCE)) return 0;
    return 1;
 }
 
@@ -1878,17 +2560,15 @@ static int parse_uncompressed_block(zbuf *a)
    int len,nlen,k;
    if (a->num_bits & 7)
       zreceive(a, a->num_bits & 7); // discard
-   // drain the bit-packed data into header
-   k = 0;
-   while (a->num_bits > 0) {
-      header[k++] = (uint8) (a->code_buffer & 255); // wtf this warns?
-      a->code_buffer >>= 8;
-      a->num_bits -= 8;
-   }
-   assert(a->num_bits == 0);
-   // now fill header the normal way
-   while (k < 4)
-      header[k++] = (uint8) zget8(a);
+   // the whole bytes still in the bit buffer go back to the input (the zeros
+   // fed in past its end were never there), then the header is read plainly
+   k = a->num_bits >> 3;
+   if (k > a->zpad) a->zbuffer -= k - a->zpad;
+   a->zpad = 0;
+   a->num_bits = 0;
+   a->code_buffer = 0;
+   for (k=0; k < 4; ++k)
+      header[k] = (uint8) zget8(a);
    len  = header[1] * 256 + header[0];
    nlen = header[3] * 256 + header[2];
    if (nlen != (len ^ 0xffff)) return e("zlib corrupt","Corrupt PNG");
@@ -1934,6 +2614,7 @@ static int parse_zlib(zbuf *a, int parse_header)
    if (parse_header)
       if (!parse_zlib_header(a)) return 0;
    a->num_bits = 0;
+   a->zpad = 0;
    a->code_buffer = 0;
    do {
       final = zreceive(a,1);
@@ -1946,8 +2627,8 @@ static int parse_zlib(zbuf *a, int parse_header)
          if (type == 1) {
             // use fixed code lengths
             if (!default_distance[31]) init_defaults();
-            if (!zbuild_huffman(&a->z_length  , default_length  , 288)) return 0;
-            if (!zbuild_huffman(&a->z_distance, default_distance,  32)) return 0;
+            if (!zbuild_huffman(&a->z_length  , default_length  , 288, ZTABLE_LENGTH  )) return 0;
+            if (!zbuild_huffman(&a->z_distance, default_distance,  32, ZTABLE_DISTANCE)) return 0;
          } else {
             if (!compute_huffman_codes(a)) return 0;
          }
@@ -1994,7 +2675,7 @@ char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, int len,
 {
    zbuf a;
    char *p = (char *) malloc(initial_size);
-   if (p == NULL) return NULL;
+   if (p == NULL) return (char *) epuc("outofmem", "Out of memory");
    a.zbuffer = (uint8 *) buffer;
    a.zbuffer_end = (uint8 *) buffer + len;
    if (do_zlib(&a, p, initial_size, 1, parse_header)) {
@@ -2080,10 +2761,20 @@ static int check_png_header(stbi *s)
    return 1;
 }
 
+// what out is: a malloc'd image, or for stbi_load_into the caller's rows, or
+// scratch memory that do_png converts into the caller's rows at the end
+enum
+{
+   PNG_OUT_MALLOC, PNG_OUT_DEST, PNG_OUT_SCRATCH
+};
+
 typedef struct
 {
    stbi *s;
    uint8 *idata, *expanded, *out;
+   uint8 *dest;      // the caller's buffer, when out_kind isn't PNG_OUT_MALLOC
+   int dest_stride, dest_n;
+   int out_kind;
 } png;
 
 
@@ -2117,7 +2808,13 @@ static int create_png_image_raw(png *a, uint8 *raw, uint32 raw_len, int out_n, u
    int img_n = s->img_n; // copy it into a local for later
    assert(out_n == s->img_n || out_n == s->img_n+1);
    if (stbi_png_partial) y = 1;
-   a->out = (uint8 *) malloc(x * y * out_n);
+   if (a->out_kind == PNG_OUT_DEST) {
+      a->out = a->dest;
+      stride = a->dest_stride;
+   } else if (a->out_kind == PNG_OUT_SCRATCH)
+      a->out = (uint8 *) scratch_alloc(s, SCRATCH_PNG_PIXELS, NULL, x * y * out_n);
+   else
+      a->out = (uint8 *) malloc(x * y * out_n);
    if (!a->out) return e("outofmem", "Out of memory");
    if (!stbi_png_partial) {
       if (s->img_x == x && s->img_y == y) {
@@ -2127,12 +2824,19 @@ static int create_png_image_raw(png *a, uint8 *raw, uint32 raw_len, int out_n, u
       }
    }
    for (j=0; j < y; ++j) {
-      uint8 *cur = a->out + stride*j;
+      uint8 *cur = a->out + (size_t) stride*j;
       uint8 *prior = cur - stride;
       int filter = *raw++;
       if (filter > 4) return e("invalid filter","Corrupt PNG");
       // if first row, use special filter that doesn't sample previous row
       if (j == 0) filter = first_row_filter[filter];
+      // RGB and RGBA rows go through the PngKernels.h unfilters (SSE2/AVX2,
+      // same bytes), one call per row
+      if (img_n >= 3) {
+         pngKernels().unfilter[filter](cur, raw, prior, x, img_n, out_n);
+         raw += img_n * x;
+         continue;
+      }
       // handle first pixel explicitly
       for (k=0; k < img_n; ++k) {
          switch (filter) {
@@ -2186,6 +2890,31 @@ static int create_png_image_raw(png *a, uint8 *raw, uint32 raw_len, int out_n, u
    return 1;
 }
 
+// Adam7 passes: origin and spacing of each
+static int adam7_xorig[7] = { 0,4,0,2,0,1,0 };
+static int adam7_yorig[7] = { 0,0,4,0,2,0,1 };
+static int adam7_xspc[7]  = { 8,8,4,4,2,2,1 };
+static int adam7_yspc[7]  = { 8,8,8,4,4,2,2 };
+
+// size of the filtered data (a filter byte per row) of the image, so inflate
+// can write it into an exactly sized buffer. A deflate stream expands at most
+// 1032:1, which caps what corrupt dimensions can make it allocate
+static int png_raw_size(stbi *s, int interlaced, uint32 compressed)
+{
+   uint64 size = 0, limit = (uint64) compressed * 1032 + 1;
+   int p;
+   if (!interlaced)
+      size = ((uint64) s->img_x * s->img_n + 1) * s->img_y;
+   else {
+      for (p=0; p < 7; ++p) {
+         uint64 x = (s->img_x - adam7_xorig[p] + adam7_xspc[p]-1) / adam7_xspc[p];
+         uint64 y = (s->img_y - adam7_yorig[p] + adam7_yspc[p]-1) / adam7_yspc[p];
+         if (x && y) size += (x * s->img_n + 1) * y;
+      }
+   }
+   return (int) (size < limit ? size : limit);
+}
+
 static int create_png_image(png *a, uint8 *raw, uint32 raw_len, int out_n, int interlaced)
 {
    uint8 *final;
@@ -2199,14 +2928,10 @@ static int create_png_image(png *a, uint8 *raw, uint32 raw_len, int out_n, int i
    // de-interlacing
    final = (uint8 *) malloc(a->s->img_x * a->s->img_y * out_n);
    for (p=0; p < 7; ++p) {
-      int xorig[] = { 0,4,0,2,0,1,0 };
-      int yorig[] = { 0,0,4,0,2,0,1 };
-      int xspc[]  = { 8,8,4,4,2,2,1 };
-      int yspc[]  = { 8,8,8,4,4,2,2 };
       int i,j,x,y;
       // pass1_x[4] = 0, pass1_x[5] = 1, pass1_x[12] = 1
-      x = (a->s->img_x - xorig[p] + xspc[p]-1) / xspc[p];
-      y = (a->s->img_y - yorig[p] + yspc[p]-1) / yspc[p];
+      x = (a->s->img_x - adam7_xorig[p] + adam7_xspc[p]-1) / adam7_xspc[p];
+      y = (a->s->img_y - adam7_yorig[p] + adam7_yspc[p]-1) / adam7_yspc[p];
       if (x && y) {
          if (!create_png_image_raw(a, raw, raw_len, out_n, x, y)) {
             free(final);
@@ -2214,7 +2939,7 @@ static int create_png_image(png *a, uint8 *raw, uint32 raw_len, int out_n, int i
          }
          for (j=0; j < y; ++j)
             for (i=0; i < x; ++i)
-               memcpy(final + (j*yspc[p]+yorig[p])*a->s->img_x*out_n + (i*xspc[p]+xorig[p])*out_n,
+               memcpy(final + (j*adam7_yspc[p]+adam7_yorig[p])*a->s->img_x*out_n + (i*adam7_xspc[p]+adam7_xorig[p])*out_n,
                       a->out + (j*x+i)*out_n, out_n);
          free(a->out);
          raw += (x*out_n+1)*y;
@@ -2254,34 +2979,46 @@ static int compute_transparency(png *z, uint8 tc[3], int out_n)
 
 static int expand_palette(png *a, uint8 *palette, int len, int pal_img_n)
 {
-   uint32 i, pixel_count = a->s->img_x * a->s->img_y;
+   uint32 i, j, w = a->s->img_x, h = a->s->img_y;
+   size_t stride = (size_t) w * pal_img_n;
    uint8 *p, *temp_out, *orig = a->out;
 
-   p = (uint8 *) malloc(pixel_count * pal_img_n);
-   if (p == NULL) return e("outofmem", "Out of memory");
+   if (a->out_kind == PNG_OUT_MALLOC)
+      temp_out = (uint8 *) malloc(w * h * pal_img_n);
+   else if (pal_img_n == a->dest_n) {
+      // stbi_load_into: the colours go straight to the caller's rows
+      temp_out = a->dest;
+      stride = a->dest_stride;
+   } else
+      temp_out = (uint8 *) scratch_alloc(a->s, SCRATCH_PNG_PALETTE, NULL, w * h * pal_img_n);
+   if (temp_out == NULL) return e("outofmem", "Out of memory");
 
    // between here and free(out) below, exitting would leak
-   temp_out = p;
-
-   if (pal_img_n == 3) {
-      for (i=0; i < pixel_count; ++i) {
-         int n = orig[i]*4;
-         p[0] = palette[n  ];
-         p[1] = palette[n+1];
-         p[2] = palette[n+2];
-         p += 3;
-      }
-   } else {
-      for (i=0; i < pixel_count; ++i) {
-         int n = orig[i]*4;
-         p[0] = palette[n  ];
-         p[1] = palette[n+1];
-         p[2] = palette[n+2];
-         p[3] = palette[n+3];
-         p += 4;
+   for (j=0; j < h; ++j, orig += w) {
+      p = temp_out + stride * j;
+      if (pal_img_n == 3) {
+         for (i=0; i < w; ++i) {
+            int n = orig[i]*4;
+            p[0] = palette[n  ];
+            p[1] = palette[n+1];
+            p[2] = palette[n+2];
+            p += 3;
+         }
+      } else {
+         for (i=0; i < w; ++i) {
+            int n = orig[i]*4;
+            p[0] = palette[n  ];
+            p[1] = palette[n+1];
+            p[2] = palette[n+2];
+            p[3] = palette[n+3];
+            p += 4;
+         }
       }
    }
-   free(a->out);
+   if (a->out_kind == PNG_OUT_MALLOC)
+      free(a->out);
+   else if (temp_out == a->dest)
+      a->out_kind = PNG_OUT_DEST;
    a->out = temp_out;
 
    STBI_NOTUSED(len);
@@ -2343,6 +3080,26 @@ static void stbi_de_iphone(png *z)
    }
 }
 
+// inflate the IDAT data; for stbi_load_into into the thread's scratch buffer
+static uint8 *png_inflate(png *z, uint32 len, int initial_size, uint32 *outlen, int parse_header)
+{
+   stbi_scratch *slot = &scratch[SCRATCH_PNG_INFLATED];
+   zbuf a;
+   int ok;
+   if (!z->s->out)
+      return (uint8 *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, len, initial_size, (int *) outlen, parse_header);
+   if (!scratch_alloc(z->s, SCRATCH_PNG_INFLATED, NULL, initial_size)) return epuc("outofmem", "Out of memory");
+   a.zbuffer = z->idata;
+   a.zbuffer_end = z->idata + len;
+   ok = do_zlib(&a, (char *) slot->p, (int) slot->size, 1, parse_header);
+   // the buffer may have grown (and moved) while inflating
+   slot->p = a.zout_start;
+   slot->size = a.zout_end - a.zout_start;
+   if (!ok) return NULL;
+   *outlen = (uint32) (a.zout - a.zout_start);
+   return (uint8 *) a.zout_start;
+}
+
 static int parse_png_file(png *z, int scan, int req_comp)
 {
    uint8 palette[1024], pal_img_n=0;
@@ -2354,6 +3111,7 @@ static int parse_png_file(png *z, int scan, int req_comp)
    z->expanded = NULL;
    z->idata = NULL;
    z->out = NULL;
+   z->out_kind = PNG_OUT_MALLOC;
 
    if (!check_png_header(s)) return 0;
 
@@ -2437,7 +3195,7 @@ static int parse_png_file(png *z, int scan, int req_comp)
                if (idata_limit == 0) idata_limit = c.length > 4096 ? c.length : 4096;
                while (ioff + c.length > idata_limit)
                   idata_limit *= 2;
-               p = (uint8 *) realloc(z->idata, idata_limit); if (p == NULL) return e("outofmem", "Out of memory");
+               p = (uint8 *) scratch_alloc(s, SCRATCH_PNG_IDATA, z->idata, idata_limit); if (p == NULL) return e("outofmem", "Out of memory");
                z->idata = p;
             }
             if (!getn(s, z->idata+ioff,c.length)) return e("outofdata","Corrupt PNG");
@@ -2450,13 +3208,26 @@ static int parse_png_file(png *z, int scan, int req_comp)
             if (first) return e("first not IHDR", "Corrupt PNG");
             if (scan != SCAN_load) return 1;
             if (z->idata == NULL) return e("no IDAT","Corrupt PNG");
-            z->expanded = (uint8 *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, 16384, (int *) &raw_len, !iphone);
-            if (z->expanded == NULL) return 0; // zlib should set error
-            free(z->idata); z->idata = NULL;
             if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
                s->img_out_n = s->img_n+1;
             else
                s->img_out_n = s->img_n;
+            // stbi_load_into: rows that come out of unfiltering in their
+            // final form go straight to the caller's buffer, anything else
+            // is decoded in scratch memory and converted into it
+            if (s->out && !interlace && !stbi_png_partial) {
+               z->dest = out_rows(s, s->img_x, s->img_y, req_comp, &z->dest_stride);
+               if (z->dest == NULL) return 0;
+               z->dest_n = req_comp;
+               if (s->img_out_n == req_comp && !pal_img_n && !has_trans && !iphone)
+                  z->out_kind = PNG_OUT_DEST;
+               else
+                  z->out_kind = PNG_OUT_SCRATCH;
+            }
+            // the inflated size is known up front, so the output is allocated once
+            z->expanded = png_inflate(z, ioff, png_raw_size(s, interlace, ioff), &raw_len, !iphone);
+            if (z->expanded == NULL) return 0; // zlib should set error
+            scratch_free(s, z->idata); z->idata = NULL;
             if (!create_png_image(z, z->expanded, raw_len, s->img_out_n, interlace)) return 0;
             if (has_trans)
                if (!compute_transparency(z, tc, s->img_out_n)) return 0;
@@ -2470,7 +3241,7 @@ static int parse_png_file(png *z, int scan, int req_comp)
                if (!expand_palette(z, palette, pal_len, s->img_out_n))
                   return 0;
             }
-            free(z->expanded); z->expanded = NULL;
+            scratch_free(s, z->expanded); z->expanded = NULL;
             return 1;
          }
 
@@ -2503,7 +3274,11 @@ static unsigned char *do_png(png *p, int *x, int *y, int *n, int req_comp)
    if (parse_png_file(p, SCAN_load, req_comp)) {
       result = p->out;
       p->out = NULL;
-      if (req_comp && req_comp != p->s->img_out_n) {
+      if (p->out_kind == PNG_OUT_SCRATCH) {
+         convert_rows(result, p->s->img_out_n, p->dest, p->dest_stride, req_comp, p->s->img_x, p->s->img_y);
+         result = p->dest;
+         p->s->img_out_n = req_comp;
+      } else if (req_comp && req_comp != p->s->img_out_n) {
          result = convert_format(result, p->s->img_out_n, req_comp, p->s->img_x, p->s->img_y);
          p->s->img_out_n = req_comp;
          if (result == NULL) return result;
@@ -2512,9 +3287,10 @@ static unsigned char *do_png(png *p, int *x, int *y, int *n, int req_comp)
       *y = p->s->img_y;
       if (n) *n = p->s->img_n;
    }
-   free(p->out);      p->out      = NULL;
-   free(p->expanded); p->expanded = NULL;
-   free(p->idata);    p->idata    = NULL;
+   if (p->out_kind == PNG_OUT_MALLOC) free(p->out);
+   p->out = NULL;
+   scratch_free(p->s, p->expanded); p->expanded = NULL;
+   scratch_free(p->s, p->idata);    p->idata    = NULL;
 
    return result;
 }
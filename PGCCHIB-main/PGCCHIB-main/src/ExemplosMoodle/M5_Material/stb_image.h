@@ -237,6 +237,27 @@ typedef struct
 
 extern stbi_uc *stbi_load_from_callbacks  (stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp);
 
+//
+// decode into a caller-provided buffer: req_comp (1..4) is required, rows
+// are 'stride' bytes apart (0 means x*req_comp) and the image must fit in
+// 'out_size' bytes -- use stbi_info to size the buffer. Returns 1 on success,
+// 0 on failure (see stbi_failure_reason). JPEG, and non-interlaced PNG
+// without tRNS, decode straight into 'out' and reuse per-thread scratch
+// memory, so repeated loads don't touch the heap; other formats decode as
+// usual and are copied in. stbi_load_into_release frees the calling
+// thread's scratch memory.
+//
+
+extern int      stbi_load_into_from_memory   (stbi_uc const *buffer, int len, stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp);
+extern int      stbi_load_into_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp);
+
+#ifndef STBI_NO_STDIO
+extern int      stbi_load_into               (char const *filename, stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp);
+extern int      stbi_load_into_from_file     (FILE *f,              stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp);
+#endif
+
+extern void     stbi_load_into_release(void);
+
 #ifndef STBI_NO_HDR
    extern float *stbi_loadf_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
 
@@ -264,7 +285,7 @@ extern int      stbi_is_hdr_from_file(FILE *f);
 
 
 // get a VERY brief reason for failure
-// NOT THREADSAFE
+// (per thread: it reports the last failure on the calling thread)
 extern const char *stbi_failure_reason  (void); 
 
 // free the loaded image -- this is just free()
@@ -287,6 +308,13 @@ extern int      stbi_info_from_file  (FILE *f,                  int *x, int *y,
 // unpremultiplication. results are undefined if the unpremultiply overflow.
 extern void stbi_set_unpremultiply_on_load(int flag_true_if_should_unpremultiply);
 
+// large baseline JPEGs are decoded on the shared thread pool (Common/M3/
+// ThreadPool.h): restart intervals are entropy-decoded in parallel when the
+// file has RSTn markers, and upsampling/color conversion runs in bands of
+// MCU rows. The output is the same either way; pass 0 to decode on the
+// calling thread only.
+extern void stbi_jpeg_set_parallel(int flag_true_if_should_decode_in_parallel);
+
 // indicate whether we should process iphone images back to canonical format,
 // or just pass them through "as-is"
 extern void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
@@ -303,6 +331,10 @@ extern int   stbi_zlib_decode_noheader_buffer(char *obuffer, int olen, const cha
 
 
 // define faster low-level operations (typically SIMD support)
+// on by default: stb_image.cpp installs the SSE2/AVX2 kernels from Common/M3
+#ifndef STBI_NO_SIMD
+#define STBI_SIMD
+#endif
 #ifdef STBI_SIMD
 typedef void (*stbi_idct_8x8)(stbi_uc *out, int out_stride, short data[64], unsigned short *dequantize);
 // compute an integer IDCT on "input"
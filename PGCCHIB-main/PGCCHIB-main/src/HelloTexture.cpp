@@ -40,6 +40,8 @@ using namespace std;
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "MipmapGL.h"
+
 // Protótipo da função de callback de teclado
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
 
@@ -366,7 +368,8 @@ int loadTexture(string filePath)
 		{
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
 		}
-		glGenerateMipmap(GL_TEXTURE_2D);
+		// níveis 1..n gerados na CPU, em luz linear (Mipmap.h)
+		uploadMipChain(nrChannels == 3 ? GL_RGB : GL_RGBA, data, width, height);
 	}
 	else
 	{